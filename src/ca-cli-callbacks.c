@@ -20,6 +20,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 #include <glib.h>
 #include <glib-object.h>
 #include <glib/gi18n.h>
@@ -30,21 +31,333 @@
 #include "ca_creation.h"
 #include "ca_file.h"
 #include "csr_creation.h"
+#include "dh_cache.h"
 #include "export.h"
 #include "import.h"
+#include "key_pool.h"
 #include "new_cert.h"
 #include "pkey_manage.h"
 #include "preferences.h"
+#include "stats.h"
 #include "tls.h"
 #include "crl.h"
 
 extern CaCommand ca_commands[];
-#define CA_COMMAND_NUMBER 31
+#define CA_COMMAND_NUMBER 45
+
+extern GList * ca_attached_dbs;
+
+#define CA_CLI_FOREACHDB_MAX_THREADS 8
 
 extern gchar * gnomint_current_opened_file;
 extern gchar * ca_creation_message;
 extern gchar * csr_creation_message;
 
+typedef enum {
+	CA_CLI_OUTPUT_TEXT = 0,
+	CA_CLI_OUTPUT_JSONL = 1,
+	CA_CLI_OUTPUT_CSV = 2
+} CaCliOutputFormat;
+
+typedef enum {
+	CA_CLI_FIELD_STRING = 0,
+	CA_CLI_FIELD_NUMBER = 1,
+	CA_CLI_FIELD_BOOLEAN = 2,
+	CA_CLI_FIELD_LIST = 3     // Items separated with '\n'
+} CaCliFieldType;
+
+typedef struct {
+	const gchar *name;
+	CaCliFieldType type;
+} CaCliField;
+
+typedef struct {
+	CaCliOutputFormat format;
+	gboolean see_revoked;
+	guint rows;
+	gchar *last_id;
+} CaCliListOptions;
+
+typedef struct {
+	CaCliListOptions list;
+	gchar *last_ca_id;
+} CaCliExpiringOptions;
+
+static const CaCliField ca_cli_cert_list_fields[] = {
+	{"id", CA_CLI_FIELD_NUMBER},
+	{"is_ca", CA_CLI_FIELD_BOOLEAN},
+	{"serial", CA_CLI_FIELD_STRING},
+	{"subject", CA_CLI_FIELD_STRING},
+	{"dn", CA_CLI_FIELD_STRING},
+	{"parent_dn", CA_CLI_FIELD_STRING},
+	{"activation", CA_CLI_FIELD_NUMBER},
+	{"expiration", CA_CLI_FIELD_NUMBER},
+	{"revocation", CA_CLI_FIELD_NUMBER},
+	{"private_key_in_db", CA_CLI_FIELD_BOOLEAN}
+};
+#define CA_CLI_CERT_LIST_FIELD_NUMBER 10
+
+static const CaCliField ca_cli_expiring_fields[] = {
+	{"ca_id", CA_CLI_FIELD_NUMBER},
+	{"ca_subject", CA_CLI_FIELD_STRING},
+	{"id", CA_CLI_FIELD_NUMBER},
+	{"serial", CA_CLI_FIELD_STRING},
+	{"subject", CA_CLI_FIELD_STRING},
+	{"dn", CA_CLI_FIELD_STRING},
+	{"expiration", CA_CLI_FIELD_NUMBER},
+	{"revocation", CA_CLI_FIELD_NUMBER},
+	{"is_ca", CA_CLI_FIELD_BOOLEAN},
+	{"private_key_in_db", CA_CLI_FIELD_BOOLEAN}
+};
+#define CA_CLI_EXPIRING_FIELD_NUMBER 10
+
+static const CaCliField ca_cli_csr_list_fields[] = {
+	{"id", CA_CLI_FIELD_NUMBER},
+	{"parent_id", CA_CLI_FIELD_NUMBER},
+	{"subject", CA_CLI_FIELD_STRING},
+	{"private_key_in_db", CA_CLI_FIELD_BOOLEAN}
+};
+#define CA_CLI_CSR_LIST_FIELD_NUMBER 4
+
+static const CaCliField ca_cli_cert_fields[] = {
+	{"id", CA_CLI_FIELD_NUMBER},
+	{"serial", CA_CLI_FIELD_STRING},
+	{"dn", CA_CLI_FIELD_STRING},
+	{"subject_key_id", CA_CLI_FIELD_STRING},
+	{"issuer_dn", CA_CLI_FIELD_STRING},
+	{"issuer_key_id", CA_CLI_FIELD_STRING},
+	{"activation", CA_CLI_FIELD_NUMBER},
+	{"expiration", CA_CLI_FIELD_NUMBER},
+	{"sha1", CA_CLI_FIELD_STRING},
+	{"md5", CA_CLI_FIELD_STRING},
+	{"sha256", CA_CLI_FIELD_STRING},
+	{"uses", CA_CLI_FIELD_LIST}
+};
+#define CA_CLI_CERT_FIELD_NUMBER 12
+
+static const CaCliField ca_cli_csr_fields[] = {
+	{"id", CA_CLI_FIELD_NUMBER},
+	{"dn", CA_CLI_FIELD_STRING},
+	{"key_id", CA_CLI_FIELD_STRING}
+};
+#define CA_CLI_CSR_FIELD_NUMBER 3
+
+static const CaCliField ca_cli_policy_fields[] = {
+	{"ca_id", CA_CLI_FIELD_NUMBER},
+	{"policy_id", CA_CLI_FIELD_NUMBER},
+	{"name", CA_CLI_FIELD_STRING},
+	{"value", CA_CLI_FIELD_STRING}
+};
+#define CA_CLI_POLICY_FIELD_NUMBER 4
+
+static const CaCliField ca_cli_profile_fields[] = {
+	{"id", CA_CLI_FIELD_NUMBER},
+	{"ca_id", CA_CLI_FIELD_NUMBER},
+	{"name", CA_CLI_FIELD_STRING},
+	{"months_to_expire", CA_CLI_FIELD_NUMBER},
+	{"uses", CA_CLI_FIELD_LIST},
+	{"crl_distribution_point", CA_CLI_FIELD_STRING}
+};
+#define CA_CLI_PROFILE_FIELD_NUMBER 6
+
+static const CaCliField ca_cli_stats_fields[] = {
+	{"operation", CA_CLI_FIELD_STRING},
+	{"count", CA_CLI_FIELD_NUMBER},
+	{"total_us", CA_CLI_FIELD_NUMBER},
+	{"mean_us", CA_CLI_FIELD_NUMBER},
+	{"max_us", CA_CLI_FIELD_NUMBER},
+	{"lt_10us", CA_CLI_FIELD_NUMBER},
+	{"lt_100us", CA_CLI_FIELD_NUMBER},
+	{"lt_1ms", CA_CLI_FIELD_NUMBER},
+	{"lt_10ms", CA_CLI_FIELD_NUMBER},
+	{"lt_100ms", CA_CLI_FIELD_NUMBER},
+	{"lt_1s", CA_CLI_FIELD_NUMBER},
+	{"ge_1s", CA_CLI_FIELD_NUMBER}
+};
+#define CA_CLI_STATS_FIELD_NUMBER (5 + STATS_HISTOGRAM_BUCKETS)
+
+static const struct {
+	const gchar *name;
+	guint use;
+} ca_cli_cert_uses[] = {
+	{"ca", TLS_CERT_USE_CA},
+	{"crl-signing", TLS_CERT_USE_CRL_SIGNING},
+	{"digital-signature", TLS_CERT_USE_DIGITAL_SIGNATURE},
+	{"data-encipherment", TLS_CERT_USE_DATA_ENCIPHERMENT},
+	{"key-encipherment", TLS_CERT_USE_KEY_ENCIPHERMENT},
+	{"non-repudiation", TLS_CERT_USE_NON_REPUDIATION},
+	{"key-agreement", TLS_CERT_USE_KEY_AGREEMENT},
+	{"email-protection", TLS_CERT_USE_EMAIL_PROTECTION},
+	{"code-signing", TLS_CERT_USE_CODE_SIGNING},
+	{"tls-web-client", TLS_CERT_USE_WEB_CLIENT},
+	{"tls-web-server", TLS_CERT_USE_WEB_SERVER},
+	{"time-stamping", TLS_CERT_USE_TIME_STAMPING},
+	{"ocsp-signing", TLS_CERT_USE_OCSP_SIGNING},
+	{"any-purpose", TLS_CERT_USE_ANY_PURPOSE},
+	{NULL, 0}
+};
+
+/* Commands run over several databases at once write into a file of their own,
+   so their results can be shown one database after another */
+static GPrivate ca_cli_output = G_PRIVATE_INIT (NULL);
+
+static FILE * __ca_cli_out (void)
+{
+	FILE *out = g_private_get (&ca_cli_output);
+
+	return (out ? out : stdout);
+}
+
+static gboolean __ca_cli_output_parse_format (const gchar *arg, CaCliOutputFormat *format)
+{
+	if (! g_str_has_prefix (arg, "--format="))
+		return FALSE;
+
+	arg = arg + strlen ("--format=");
+
+	if (! strcmp (arg, "text"))
+		*format = CA_CLI_OUTPUT_TEXT;
+	else if (! strcmp (arg, "jsonl") || ! strcmp (arg, "json"))
+		*format = CA_CLI_OUTPUT_JSONL;
+	else if (! strcmp (arg, "csv"))
+		*format = CA_CLI_OUTPUT_CSV;
+	else
+		return FALSE;
+
+	return TRUE;
+}
+
+static void __ca_cli_output_json_string (const gchar *value)
+{
+	const gchar *c;
+
+	fputc ('"', __ca_cli_out ());
+	for (c = value; *c; c++) {
+		switch (*c) {
+		case '"':
+			fputs ("\\\"", __ca_cli_out ());
+			break;
+		case '\\':
+			fputs ("\\\\", __ca_cli_out ());
+			break;
+		case '\n':
+			fputs ("\\n", __ca_cli_out ());
+			break;
+		case '\t':
+			fputs ("\\t", __ca_cli_out ());
+			break;
+		default:
+			if ((guchar) *c < 0x20)
+				fprintf (__ca_cli_out (), "\\u%04x", (guchar) *c);
+			else
+				fputc (*c, __ca_cli_out ());
+		}
+	}
+	fputc ('"', __ca_cli_out ());
+}
+
+static void __ca_cli_output_csv_field (const gchar *value)
+{
+	const gchar *c;
+
+	if (! strpbrk (value, ",\"\r\n")) {
+		fputs (value, __ca_cli_out ());
+		return;
+	}
+
+	fputc ('"', __ca_cli_out ());
+	for (c = value; *c; c++) {
+		if (*c == '"')
+			fputc ('"', __ca_cli_out ());
+		fputc (*c, __ca_cli_out ());
+	}
+	fputc ('"', __ca_cli_out ());
+}
+
+static void __ca_cli_output_header (CaCliOutputFormat format, const CaCliField *fields, guint field_number)
+{
+	guint i;
+
+	if (format != CA_CLI_OUTPUT_CSV)
+		return;
+
+	for (i = 0; i < field_number; i++) {
+		if (i)
+			fputc (',', __ca_cli_out ());
+		fputs (fields[i].name, __ca_cli_out ());
+	}
+	fputc ('\n', __ca_cli_out ());
+}
+
+/* Writes a row as soon as it is read, so no output is accumulated
+   in memory however big the listing is */
+static void __ca_cli_output_row (CaCliOutputFormat format, const CaCliField *fields, guint field_number, 
+				 const gchar **values)
+{
+	guint i;
+	gchar **items;
+	gint j;
+
+	if (format == CA_CLI_OUTPUT_CSV) {
+		for (i = 0; i < field_number; i++) {
+			if (i)
+				fputc (',', __ca_cli_out ());
+			if (! values[i])
+				continue;
+			if (fields[i].type == CA_CLI_FIELD_LIST) {
+				/* Multivalued fields are written as a single field, separated with ';' */
+				gchar *joined;
+				items = g_strsplit (values[i], "\n", -1);
+				joined = g_strjoinv (";", items);
+				__ca_cli_output_csv_field (joined);
+				g_free (joined);
+				g_strfreev (items);
+			} else {
+				__ca_cli_output_csv_field (values[i]);
+			}
+		}
+		fputc ('\n', __ca_cli_out ());
+		return;
+	}
+
+	fputc ('{', __ca_cli_out ());
+	for (i = 0; i < field_number; i++) {
+		if (i)
+			fputc (',', __ca_cli_out ());
+		__ca_cli_output_json_string (fields[i].name);
+		fputc (':', __ca_cli_out ());
+
+		if (! values[i] || (fields[i].type != CA_CLI_FIELD_STRING && values[i][0] == '\0')) {
+			fputs ("null", __ca_cli_out ());
+			continue;
+		}
+
+		switch (fields[i].type) {
+		case CA_CLI_FIELD_NUMBER:
+			fputs (values[i], __ca_cli_out ());
+			break;
+		case CA_CLI_FIELD_BOOLEAN:
+			fputs ((atoi (values[i]) ? "true" : "false"), __ca_cli_out ());
+			break;
+		case CA_CLI_FIELD_LIST:
+			items = g_strsplit (values[i], "\n", -1);
+			fputc ('[', __ca_cli_out ());
+			for (j = 0; items[j]; j++) {
+				if (j)
+					fputc (',', __ca_cli_out ());
+				__ca_cli_output_json_string (items[j]);
+			}
+			fputc (']', __ca_cli_out ());
+			g_strfreev (items);
+			break;
+		default:
+			__ca_cli_output_json_string (values[i]);
+		}
+	}
+	fputs ("}\n", __ca_cli_out ());
+}
+
+
 
 int ca_cli_callback_newdb (int argc, char **argv)
 {
@@ -54,7 +367,7 @@ int ca_cli_callback_newdb (int argc, char **argv)
         if (g_file_test(filename, G_FILE_TEST_EXISTS)) {
                 /* The file already exists. We ask the user about overwriting it */
                 
-                if (! dialog_ask_for_confirmation (_("The file already exists, so it will be overwritten."), _("Are you sure? Yes/[No] "), FALSE)) 
+                if (! dialog_confirm_action (_("The file already exists, so it will be overwritten."), _("Are you sure? Yes/[No] "), FALSE)) 
 			return 1;
 
                 /* If he wants to overwrite it, we first rename it to "filename~", after deleting "filename~" if it already exists */
@@ -91,6 +404,7 @@ int ca_cli_callback_opendb (int argc, char **argv)
 
 	if (! ca_open (filename, FALSE)) {
                 fprintf (stderr, _("Problem when opening '%s' CA database\n"), filename);
+		return 1;
 	} 
 
 	return 0;
@@ -103,7 +417,7 @@ int ca_cli_callback_savedbas (int argc, char **argv)
         if (g_file_test(filename, G_FILE_TEST_EXISTS)) {
                 /* The file already exists. We ask the user about overwriting it */
                 
-                if (! dialog_ask_for_confirmation (_("The file already exists, so it will be overwritten."), _("Are you sure? Yes/[No] "), FALSE)) 
+                if (! dialog_confirm_action (_("The file already exists, so it will be overwritten."), _("Are you sure? Yes/[No] "), FALSE)) 
 			return 1;
 
                 /* If he wants to overwrite it, we first rename it to "filename~", after deleting "filename~" if it already exists */
@@ -122,11 +436,222 @@ int ca_cli_callback_savedbas (int argc, char **argv)
 
 }
 
+int ca_cli_callback_attachdb (int argc, char **argv)
+{
+	return (ca_attach (argv[1]) ? 0 : 1);
+}
+
+int ca_cli_callback_detachdb (int argc, char **argv)
+{
+	GList *list;
+
+	for (list = ca_attached_dbs; list; list = list->next) {
+		if (! strcmp (ca_file_get_filename (list->data), argv[1])) {
+			ca_file_handle_close (list->data);
+			ca_attached_dbs = g_list_delete_link (ca_attached_dbs, list);
+			return 0;
+		}
+	}
+
+	dialog_error (_("The given database is not attached"));
+	return 1;
+}
+
+int ca_cli_callback_listdb (int argc, char **argv)
+{
+	GList *list;
+
+	printf (_("Opened database: %s\n"), ca_file_get_filename (ca_file_get_current ()));
+	for (list = ca_attached_dbs; list; list = list->next)
+		printf (_("Attached database: %s\n"), ca_file_get_filename (list->data));
+
+	return 0;
+}
+
+typedef struct {
+	CaFile *ca_file;
+	CaCommandCallback callback;
+	gint argc;
+	gchar **argv;
+	FILE *out;
+	gint result;
+} CaCliForeachDbTask;
+
+static void __ca_cli_callback_foreachdb_run (gpointer data, gpointer user_data)
+{
+	CaCliForeachDbTask *task = (CaCliForeachDbTask *) data;
+
+	ca_file_set_current (task->ca_file);
+	g_private_set (&ca_cli_output, task->out);
+
+	task->result = task->callback (task->argc, task->argv);
+
+	g_private_set (&ca_cli_output, NULL);
+	ca_file_release_thread_connection ();
+	ca_file_set_current (NULL);
+}
+
+/* Arguments for the given database, with {db} replaced with its name */
+static gchar ** __ca_cli_callback_foreachdb_argv (CaFile *ca_file, gint argc, char **argv)
+{
+	gchar **result = g_new0 (gchar *, argc + 1);
+	gchar *basename = g_path_get_basename (ca_file_get_filename (ca_file));
+	gchar **parts;
+	gint i;
+
+	if (g_str_has_suffix (basename, ".gnomint"))
+		basename[strlen (basename) - strlen (".gnomint")] = '\0';
+
+	for (i = 0; i < argc; i++) {
+		parts = g_strsplit (argv[i], "{db}", -1);
+		result[i] = g_strjoinv (basename, parts);
+		g_strfreev (parts);
+	}
+
+	g_free (basename);
+
+	return result;
+}
+
+int ca_cli_callback_foreachdb (int argc, char **argv)
+{
+	static const gchar * allowed_commands[] = {"status", "expiring", "crlgen", NULL};
+	CaCommand *command = NULL;
+	GList *databases = NULL;
+	GList *list;
+	GPtrArray *tasks;
+	GThreadPool *pool;
+	CaCliForeachDbTask *task;
+	gboolean text_format = TRUE;
+	gchar buffer[4096];
+	gchar *password;
+	size_t length;
+	gint result = 0;
+	gint i;
+
+	for (i = 0; allowed_commands[i] && strcmp (argv[1], allowed_commands[i]); i++);
+
+	if (! allowed_commands[i]) {
+		dialog_error (_("Only status, expiring and crlgen can be run over several databases"));
+		return -1;
+	}
+
+	for (i = 0; strcmp (ca_commands[i].command, argv[1]); i++);
+	command = &ca_commands[i];
+
+	if (argc - 2 < command->mandatory_params || argc - 2 > command->optional_params) {
+		fprintf (stderr, _("Incorrect number of parameters.\n"));
+		fprintf (stderr, _("Syntax: %s\n"), _(command->syntax));
+		return -1;
+	}
+
+	for (i = 2; i < argc; i++) {
+		if (g_str_has_prefix (argv[i], "--format=") && strcmp (argv[i], "--format=text"))
+			text_format = FALSE;
+	}
+
+	if (ca_file_get_current ())
+		databases = g_list_append (databases, ca_file_get_current ());
+	for (list = ca_attached_dbs; list; list = list->next)
+		databases = g_list_append (databases, list->data);
+
+	/* Passwords are asked here, one database after another, so workers never wait for them */
+	if (! strcmp (argv[1], "crlgen")) {
+		for (list = databases; list; list = list->next) {
+			ca_file_set_current (list->data);
+			if (! ca_file_is_password_protected ())
+				continue;
+
+			fprintf (stderr, _("Database %s:\n"), ca_file_get_filename (list->data));
+			password = pkey_manage_ask_password ();
+			if (! password) {
+				ca_file_set_current (NULL);
+				g_list_free (databases);
+				return 1;
+			}
+			ca_file_set_unlocked_password (password);
+			memset (password, 0, strlen (password));
+			g_free (password);
+		}
+		ca_file_set_current (NULL);
+	}
+
+	tasks = g_ptr_array_new ();
+	pool = g_thread_pool_new (__ca_cli_callback_foreachdb_run, NULL, CA_CLI_FOREACHDB_MAX_THREADS, FALSE, NULL);
+
+	for (list = databases; list; list = list->next) {
+		task = g_new0 (CaCliForeachDbTask, 1);
+		task->ca_file = list->data;
+		task->callback = command->callback;
+		task->argc = argc - 1;
+		task->argv = __ca_cli_callback_foreachdb_argv (list->data, argc - 1, &argv[1]);
+		task->out = tmpfile ();
+		g_ptr_array_add (tasks, task);
+
+		if (! task->out) {
+			task->result = 1;
+			continue;
+		}
+
+		g_thread_pool_push (pool, task, NULL);
+	}
+
+	g_thread_pool_free (pool, FALSE, TRUE);
+
+	for (i = 0; i < tasks->len; i++) {
+		task = g_ptr_array_index (tasks, i);
+
+		if (text_format)
+			printf (_("\n==> %s <==\n"), ca_file_get_filename (task->ca_file));
+
+		if (task->out) {
+			rewind (task->out);
+			while ((length = fread (buffer, 1, sizeof (buffer), task->out)) > 0)
+				fwrite (buffer, 1, length, stdout);
+			fclose (task->out);
+		} else {
+			fprintf (stderr, _("Couldn't run the command over database %s\n"), ca_file_get_filename (task->ca_file));
+		}
+
+		if (task->result)
+			result = 1;
+
+		g_strfreev (task->argv);
+		g_free (task);
+	}
+
+	g_ptr_array_free (tasks, TRUE);
+	g_list_free (databases);
+
+	return result;
+}
+
+int __ca_cli_callback_status_aux (void *pArg, int argc, char **argv, char **columnNames)
+{
+	if (atoll (argv[CA_FILE_COUNTERS_COLUMN_CA_ID]) && argv[CA_FILE_COUNTERS_COLUMN_CA_SUBJECT])
+		fprintf (__ca_cli_out (), Q_("StatusList CA|%s (%s)\n"), argv[CA_FILE_COUNTERS_COLUMN_CA_ID], argv[CA_FILE_COUNTERS_COLUMN_CA_SUBJECT]);
+	else
+		fprintf (__ca_cli_out (), _("Self-signed certificates, or with unknown issuer\n"));
+
+	fprintf (__ca_cli_out (), _("\tCertificates: %s (%s revoked, %s expired, %s CAs)\tCSRs: %s\tArchived: %s\n"),
+		argv[CA_FILE_COUNTERS_COLUMN_CERTS], argv[CA_FILE_COUNTERS_COLUMN_REVOKED], 
+		argv[CA_FILE_COUNTERS_COLUMN_EXPIRED], argv[CA_FILE_COUNTERS_COLUMN_CAS],
+		argv[CA_FILE_COUNTERS_COLUMN_CSRS], argv[CA_FILE_COUNTERS_COLUMN_ARCHIVED]);
+
+	return 0;
+}
+
 int ca_cli_callback_status (int argc, char **argv)
 {
-	printf (_("Current opened file: %s\n"), gnomint_current_opened_file);
-	printf (_("Number of certificates in file: %d\n"), ca_file_get_number_of_certs());
-	printf (_("Number of CSRs in file: %d\n"), ca_file_get_number_of_csrs());
+	fprintf (__ca_cli_out (), _("Current opened file: %s\n"), ca_file_get_filename (ca_file_get_current ()));
+	fprintf (__ca_cli_out (), _("Number of certificates in file: %d\n"), ca_file_get_number_of_certs());
+	fprintf (__ca_cli_out (), _("Number of revoked certificates: %d\n"), ca_file_get_number_of_revoked_certs());
+	fprintf (__ca_cli_out (), _("Number of CSRs in file: %d\n"), ca_file_get_number_of_csrs());
+	fprintf (__ca_cli_out (), _("Number of archived certificates: %d\n"), ca_file_get_number_of_archived_certs());
+
+	fprintf (__ca_cli_out (), _("\nBy issuer CA:\n"));
+	if (! ca_file_foreach_counters (__ca_cli_callback_status_aux, NULL))
+		return 1;
 
 	return 0;
 }
@@ -140,32 +665,37 @@ int __ca_cli_callback_listcert_aux (void *pArg, int argc, char **argv, char **co
 #endif
 	time_t aux_date;
 	gchar model_time_str[100];
+	CaCliListOptions *options = (CaCliListOptions *) pArg;
+
+	options->rows ++;
+	g_free (options->last_id);
+	options->last_id = g_strdup (argv[CA_FILE_CERT_COLUMN_ID]);
 
-	printf (Q_("CertList ID|%s\t"), argv[CA_FILE_CERT_COLUMN_ID]);
+	fprintf (__ca_cli_out (), Q_("CertList ID|%s\t"), argv[CA_FILE_CERT_COLUMN_ID]);
 	
 	if (atoi(argv[CA_FILE_CERT_COLUMN_IS_CA]))
-		printf (Q_("CertList IsCA|Y\t"));
+		fprintf (__ca_cli_out (), Q_("CertList IsCA|Y\t"));
 	else
-		printf (Q_("CertList IsCA|N\t"));
+		fprintf (__ca_cli_out (), Q_("CertList IsCA|N\t"));
 
 	if (strlen(argv[CA_FILE_CERT_COLUMN_SUBJECT]) > 16)
 		argv[CA_FILE_CERT_COLUMN_SUBJECT][16] = '\0';
 
-	printf (Q_("CertList Subject|%s\t"), argv[CA_FILE_CERT_COLUMN_SUBJECT]);
+	fprintf (__ca_cli_out (), Q_("CertList Subject|%s\t"), argv[CA_FILE_CERT_COLUMN_SUBJECT]);
 
 	if (strlen (argv[CA_FILE_CERT_COLUMN_SUBJECT]) / 8 < 2)
-		printf (Q_("CertList PadIfSubject<16|\t"));
+		fprintf (__ca_cli_out (), Q_("CertList PadIfSubject<16|\t"));
 	if (strlen (argv[CA_FILE_CERT_COLUMN_SUBJECT]) / 8 < 1)
-		printf (Q_("CertList PadIfSubject<8|\t"));
+		fprintf (__ca_cli_out (), Q_("CertList PadIfSubject<8|\t"));
 
 	if (atoi(argv[CA_FILE_CERT_COLUMN_PRIVATE_KEY_IN_DB]))
-		printf (Q_("CertList PKeyInDB|Y\t\t"));
+		fprintf (__ca_cli_out (), Q_("CertList PKeyInDB|Y\t\t"));
 	else
-		printf (Q_("CertList PKeyInDB|N\t\t"));
+		fprintf (__ca_cli_out (), Q_("CertList PKeyInDB|N\t\t"));
 
 	aux_date = atol(argv[CA_FILE_CERT_COLUMN_ACTIVATION]);
 	if (aux_date == 0) {
-		printf (Q_("CertList Activation|\t"));
+		fprintf (__ca_cli_out (), Q_("CertList Activation|\t"));
 	} else {	
 #ifndef WIN32	
 		gmtime_r (&aux_date, &tmp);
@@ -174,12 +704,12 @@ int __ca_cli_callback_listcert_aux (void *pArg, int argc, char **argv, char **co
 		tmp = gmtime (&aux_date);
 		strftime (model_time_str, 100, _("%m/%d/%Y %H:%M GMT"), tmp);
 #endif
-		printf (Q_("CertList Activation|%s\t"), model_time_str);
+		fprintf (__ca_cli_out (), Q_("CertList Activation|%s\t"), model_time_str);
 	}
 
 	aux_date = atol(argv[CA_FILE_CERT_COLUMN_EXPIRATION]);
 	if (aux_date == 0) {
-		printf (Q_("CertList Expiration|\t"));
+		fprintf (__ca_cli_out (), Q_("CertList Expiration|\t"));
 	} else {
 #ifndef WIN32
 		gmtime_r (&aux_date, &tmp);
@@ -188,13 +718,13 @@ int __ca_cli_callback_listcert_aux (void *pArg, int argc, char **argv, char **co
 		tmp = gmtime (&aux_date);
 		strftime (model_time_str, 100, _("%m/%d/%Y %H:%M GMT"), tmp);
 #endif
-		printf (Q_("CertList Expiration|%s\t"), model_time_str);
+		fprintf (__ca_cli_out (), Q_("CertList Expiration|%s\t"), model_time_str);
 	}
 
 	if (argc > CA_FILE_CERT_COLUMN_REVOCATION && argv[CA_FILE_CERT_COLUMN_REVOCATION]) {
 		aux_date = atol(argv[CA_FILE_CERT_COLUMN_REVOCATION]);
 		if (aux_date == 0) {
-			printf (Q_("CertList Revocation|\n"));
+			fprintf (__ca_cli_out (), Q_("CertList Revocation|\n"));
 		} else {	
 #ifndef WIN32
 			gmtime_r (&aux_date, &tmp);		
@@ -203,32 +733,377 @@ int __ca_cli_callback_listcert_aux (void *pArg, int argc, char **argv, char **co
 			tmp = gmtime (&aux_date);
 			strftime (model_time_str, 100, _("%m/%d/%Y %H:%M GMT"), tmp);
 #endif
-			printf (Q_("CertList Revocation|%s\n"), model_time_str);
+			fprintf (__ca_cli_out (), Q_("CertList Revocation|%s\n"), model_time_str);
 		}
 	} else {
-		printf ("\n");
+		fprintf (__ca_cli_out (), "\n");
 	}
 
 	return 0;
 }
 
 
+int __ca_cli_callback_listcert_formatted_aux (void *pArg, int argc, char **argv, char **columnNames)
+{
+	CaCliListOptions *options = (CaCliListOptions *) pArg;
+	const gchar *values[CA_CLI_CERT_LIST_FIELD_NUMBER];
+
+	options->rows ++;
+	g_free (options->last_id);
+	options->last_id = g_strdup (argv[CA_FILE_CERT_COLUMN_ID]);
+
+	values[0] = argv[CA_FILE_CERT_COLUMN_ID];
+	values[1] = argv[CA_FILE_CERT_COLUMN_IS_CA];
+	values[2] = argv[CA_FILE_CERT_COLUMN_SERIAL];
+	values[3] = argv[CA_FILE_CERT_COLUMN_SUBJECT];
+	values[4] = argv[CA_FILE_CERT_COLUMN_DN];
+	values[5] = argv[CA_FILE_CERT_COLUMN_PARENT_DN];
+	values[6] = argv[CA_FILE_CERT_COLUMN_ACTIVATION];
+	values[7] = argv[CA_FILE_CERT_COLUMN_EXPIRATION];
+	values[8] = argv[CA_FILE_CERT_COLUMN_REVOCATION];
+	values[9] = argv[CA_FILE_CERT_COLUMN_PRIVATE_KEY_IN_DB];
+
+	__ca_cli_output_row (options->format, ca_cli_cert_list_fields, CA_CLI_CERT_LIST_FIELD_NUMBER, values);
+
+	return 0;
+}
+
+static gboolean __ca_cli_parse_date (const gchar *str, time_t *result)
+{
+	GDate *date = NULL;
+	GDate *epoch = NULL;
+	guint year, month, day;
+	gchar *end = NULL;
+
+	// Dates can be given as YYYY-MM-DD (GMT), or as UNIX timestamps
+	if (sscanf (str, "%u-%u-%u", &year, &month, &day) == 3 && strlen (str) == 10) {
+		if (! g_date_valid_dmy (day, month, year))
+			return FALSE;
+		date = g_date_new_dmy (day, month, year);
+		epoch = g_date_new_dmy (1, 1, 1970);
+		*result = (time_t) g_date_days_between (epoch, date) * 24 * 60 * 60;
+		g_date_free (date);
+		g_date_free (epoch);
+		return TRUE;
+	}
+
+	*result = (time_t) g_ascii_strtoll (str, &end, 10);
+
+	return (end && end != str && *end == '\0');
+}
+
 int ca_cli_callback_listcert (int argc, char **argv)
 {
 	gboolean see_revoked = FALSE;
+	gboolean use_filter = FALSE;
+	gboolean result;
+	CaCliListOptions options;
+	CaFileCertFilter filter;
+	gchar *aux;
+	gint i;
 
-	if (argc==2 && !strcmp (argv[1], "--see-revoked"))
-		see_revoked = TRUE;
+	memset (&options, 0, sizeof (CaCliListOptions));
+	memset (&filter, 0, sizeof (CaFileCertFilter));
+	options.format = CA_CLI_OUTPUT_TEXT;
+	filter.revoked = CA_FILE_REVOKED_FILTER_NOT_REVOKED;
+
+	for (i = 1; i < argc; i++) {
+		aux = strchr (argv[i], '=');
+		aux = (aux ? aux + 1 : "");
+
+		if (!strcmp (argv[i], "--see-revoked")) {
+			see_revoked = TRUE;
+			filter.revoked = CA_FILE_REVOKED_FILTER_ANY;
+		} else if (!strcmp (argv[i], "--revoked")) {
+			see_revoked = TRUE;
+			use_filter = TRUE;
+			filter.revoked = CA_FILE_REVOKED_FILTER_ONLY_REVOKED;
+		} else if (g_str_has_prefix (argv[i], "--ca=")) {
+			use_filter = TRUE;
+			filter.ca_id = atoll (aux);
+			if (! ca_file_check_if_is_ca_id (filter.ca_id)) {
+				dialog_error (_("The given CA id. is not valid"));
+				return -1;
+			}
+		} else if (g_str_has_prefix (argv[i], "--expiring-before=")) {
+			use_filter = TRUE;
+			if (! __ca_cli_parse_date (aux, &filter.expiring_before)) {
+				dialog_error (_("Invalid date. Dates must be given as YYYY-MM-DD or as a UNIX timestamp"));
+				return -1;
+			}
+		} else if (g_str_has_prefix (argv[i], "--expiring-after=")) {
+			use_filter = TRUE;
+			if (! __ca_cli_parse_date (aux, &filter.expiring_after)) {
+				dialog_error (_("Invalid date. Dates must be given as YYYY-MM-DD or as a UNIX timestamp"));
+				return -1;
+			}
+		} else if (g_str_has_prefix (argv[i], "--subject=")) {
+			use_filter = TRUE;
+			filter.subject_prefix = aux;
+		} else if (g_str_has_prefix (argv[i], "--after=")) {
+			use_filter = TRUE;
+			filter.after_id = atoll (aux);
+		} else if (g_str_has_prefix (argv[i], "--limit=")) {
+			use_filter = TRUE;
+			filter.limit = atoi (aux);
+		} else if (! __ca_cli_output_parse_format (argv[i], &options.format)) {
+			dialog_error (_("Unrecognized option. Try 'help' for getting the list of valid options"));
+			return -1;
+		}
+	}
+	options.see_revoked = see_revoked;
+
+	if (options.format != CA_CLI_OUTPUT_TEXT) {
+		__ca_cli_output_header (options.format, ca_cli_cert_list_fields, CA_CLI_CERT_LIST_FIELD_NUMBER);
+	} else {
+		printf (_("Certificates in Database:\n"));
+		printf (_("Id.\tIs CA?\tCertificate Subject\tKey in DB?\tActivation\t\tExpiration"));
 
-	printf (_("Certificates in Database:\n"));
-	printf (_("Id.\tIs CA?\tCertificate Subject\tKey in DB?\tActivation\t\tExpiration"));
+		if (see_revoked)
+			printf (_("\t\tRevocation\n"));
+		else
+			printf ("\n");
+	}
 
-	if (see_revoked)
-		printf (_("\t\tRevocation\n"));
-	else
-		printf ("\n");
+	if (use_filter) {
+		/* Filtered listings are sorted by id, so they can be paginated */
+		result = ca_file_foreach_crt_filtered ((options.format != CA_CLI_OUTPUT_TEXT ? 
+							__ca_cli_callback_listcert_formatted_aux : __ca_cli_callback_listcert_aux),
+						       &filter, &options);
+
+		if (result && filter.limit && options.rows == filter.limit) {
+			fflush (stdout);
+			fprintf (stderr, _("More certificates may match. Use --after=%s for getting the next page.\n"), 
+				 options.last_id);
+		}
+	} else {
+		result = ca_file_foreach_crt ((options.format != CA_CLI_OUTPUT_TEXT ? 
+					       __ca_cli_callback_listcert_formatted_aux : __ca_cli_callback_listcert_aux),
+					      see_revoked, &options);
+	}
+
+	g_free (options.last_id);
+
+	return (result ? 0 : 1);
+}
+
+int ca_cli_callback_search (int argc, char **argv)
+{
+	const gchar *text = NULL;
+	guint limit = 0;
+	gboolean result;
+	CaCliListOptions options;
+	gint i;
+
+	memset (&options, 0, sizeof (CaCliListOptions));
+	options.format = CA_CLI_OUTPUT_TEXT;
+
+	for (i = 1; i < argc; i++) {
+		if (!strcmp (argv[i], "--see-revoked")) {
+			options.see_revoked = TRUE;
+		} else if (g_str_has_prefix (argv[i], "--limit=")) {
+			limit = atoi (argv[i] + strlen ("--limit="));
+		} else if (g_str_has_prefix (argv[i], "--format=")) {
+			if (! __ca_cli_output_parse_format (argv[i], &options.format)) {
+				dialog_error (_("Unrecognized option. Try 'help' for getting the list of valid options"));
+				return -1;
+			}
+		} else if (! text) {
+			text = argv[i];
+		} else {
+			dialog_error (_("Only one search text can be given. Use quotes for searching several words"));
+			return -1;
+		}
+	}
+
+	if (! text) {
+		dialog_error (_("A search text must be given"));
+		return -1;
+	}
+
+	if (options.format != CA_CLI_OUTPUT_TEXT) {
+		__ca_cli_output_header (options.format, ca_cli_cert_list_fields, CA_CLI_CERT_LIST_FIELD_NUMBER);
+	} else {
+		printf (_("Certificates matching \"%s\":\n"), text);
+		printf (_("Id.\tIs CA?\tCertificate Subject\tKey in DB?\tActivation\t\tExpiration"));
+
+		if (options.see_revoked)
+			printf (_("\t\tRevocation\n"));
+		else
+			printf ("\n");
+	}
+
+	result = ca_file_search_crt ((options.format != CA_CLI_OUTPUT_TEXT ? 
+				      __ca_cli_callback_listcert_formatted_aux : __ca_cli_callback_listcert_aux),
+				     text, options.see_revoked, limit, &options);
+
+	if (result && options.format == CA_CLI_OUTPUT_TEXT && options.rows == 0)
+		printf (_("No certificate matches the given text.\n"));
+
+	g_free (options.last_id);
+
+	return (result ? 0 : 1);
+}
+
+int __ca_cli_callback_expiring_aux (void *pArg, int argc, char **argv, char **columnNames)
+{
+	CaCliExpiringOptions *options = (CaCliExpiringOptions *) pArg;
+	const gchar *values[CA_CLI_EXPIRING_FIELD_NUMBER];
+
+	if (options->list.format != CA_CLI_OUTPUT_TEXT) {
+		options->list.rows ++;
+
+		values[0] = argv[CA_FILE_EXPIRING_COLUMN_CA_ID];
+		values[1] = argv[CA_FILE_EXPIRING_COLUMN_CA_SUBJECT];
+		values[2] = argv[CA_FILE_CERT_COLUMN_ID];
+		values[3] = argv[CA_FILE_CERT_COLUMN_SERIAL];
+		values[4] = argv[CA_FILE_CERT_COLUMN_SUBJECT];
+		values[5] = argv[CA_FILE_CERT_COLUMN_DN];
+		values[6] = argv[CA_FILE_CERT_COLUMN_EXPIRATION];
+		values[7] = argv[CA_FILE_CERT_COLUMN_REVOCATION];
+		values[8] = argv[CA_FILE_CERT_COLUMN_IS_CA];
+		values[9] = argv[CA_FILE_CERT_COLUMN_PRIVATE_KEY_IN_DB];
+
+		__ca_cli_output_row (options->list.format, ca_cli_expiring_fields, CA_CLI_EXPIRING_FIELD_NUMBER, values);
+		return 0;
+	}
+
+	/* Rows come sorted by CA, so a header is printed each time it changes */
+	if (! options->last_ca_id || strcmp (options->last_ca_id, argv[CA_FILE_EXPIRING_COLUMN_CA_ID])) {
+		g_free (options->last_ca_id);
+		options->last_ca_id = g_strdup (argv[CA_FILE_EXPIRING_COLUMN_CA_ID]);
+
+		if (argv[CA_FILE_EXPIRING_COLUMN_CA_SUBJECT])
+			fprintf (__ca_cli_out (), _("\nIssued by CA %s (%s):\n"), argv[CA_FILE_EXPIRING_COLUMN_CA_ID], 
+				argv[CA_FILE_EXPIRING_COLUMN_CA_SUBJECT]);
+		else
+			fprintf (__ca_cli_out (), _("\nIssuer not in database:\n"));
+	}
+
+	return __ca_cli_callback_listcert_aux (&options->list, argc, argv, columnNames);
+}
+
+int ca_cli_callback_expiring (int argc, char **argv)
+{
+	CaCliExpiringOptions options;
+	guint64 ca_id = 0;
+	gint days = 30;
+	gboolean include_expired = FALSE;
+	gboolean result;
+	time_t now = time (NULL);
+	gchar *aux;
+	gint i;
+
+	memset (&options, 0, sizeof (CaCliExpiringOptions));
+	options.list.format = CA_CLI_OUTPUT_TEXT;
+
+	for (i = 1; i < argc; i++) {
+		aux = strchr (argv[i], '=');
+		aux = (aux ? aux + 1 : "");
+
+		if (g_str_has_prefix (argv[i], "--days=")) {
+			days = atoi (aux);
+			if (days <= 0) {
+				dialog_error (_("The number of days must be a positive number"));
+				return -1;
+			}
+		} else if (g_str_has_prefix (argv[i], "--ca=")) {
+			ca_id = atoll (aux);
+			if (! ca_file_check_if_is_ca_id (ca_id)) {
+				dialog_error (_("The given CA id. is not valid"));
+				return -1;
+			}
+		} else if (!strcmp (argv[i], "--include-expired")) {
+			include_expired = TRUE;
+		} else if (!strcmp (argv[i], "--see-revoked")) {
+			options.list.see_revoked = TRUE;
+		} else if (! __ca_cli_output_parse_format (argv[i], &options.list.format)) {
+			dialog_error (_("Unrecognized option. Try 'help' for getting the list of valid options"));
+			return -1;
+		}
+	}
+
+	if (options.list.format != CA_CLI_OUTPUT_TEXT) {
+		__ca_cli_output_header (options.list.format, ca_cli_expiring_fields, CA_CLI_EXPIRING_FIELD_NUMBER);
+	} else {
+		fprintf (__ca_cli_out (), _("Certificates expiring in the next %d days:\n"), days);
+		fprintf (__ca_cli_out (), _("Id.\tIs CA?\tCertificate Subject\tKey in DB?\tActivation\t\tExpiration"));
+
+		if (options.list.see_revoked)
+			fprintf (__ca_cli_out (), _("\t\tRevocation\n"));
+		else
+			fprintf (__ca_cli_out (), "\n");
+	}
+
+	result = ca_file_foreach_crt_expiring (__ca_cli_callback_expiring_aux, 
+					       (include_expired ? 0 : now), now + (time_t) days * 24 * 60 * 60,
+					       ca_id, options.list.see_revoked, &options);
+
+	if (result && options.list.format == CA_CLI_OUTPUT_TEXT && options.list.rows == 0)
+		fprintf (__ca_cli_out (), _("No certificate expires in the given period.\n"));
+
+	g_free (options.list.last_id);
+	g_free (options.last_ca_id);
+
+	return (result ? 0 : 1);
+}
+
+int ca_cli_callback_archive (int argc, char **argv)
+{
+	gint grace_days = -1;
+	gint auto_days = -1;
+	gint archived;
+	gchar *error = NULL;
+	gchar *aux;
+	gint i;
+
+	for (i = 1; i < argc; i++) {
+		aux = strchr (argv[i], '=');
+		aux = (aux ? aux + 1 : "");
+
+		if (g_str_has_prefix (argv[i], "--grace=")) {
+			grace_days = atoi (aux);
+		} else if (!strcmp (argv[i], "--auto=off")) {
+			auto_days = 0;
+		} else if (g_str_has_prefix (argv[i], "--auto=")) {
+			auto_days = atoi (aux);
+			if (auto_days <= 0) {
+				dialog_error (_("The number of days must be a positive number"));
+				return -1;
+			}
+		} else {
+			dialog_error (_("Unrecognized option. Try 'help' for getting the list of valid options"));
+			return -1;
+		}
+	}
+
+	if (auto_days >= 0) {
+		if (! ca_file_set_archive_policy (auto_days)) {
+			dialog_error (_("Error while saving the archive policy"));
+			return 1;
+		}
+		if (auto_days)
+			printf (_("Certificates will be archived %d days after their expiration, each time the database is opened.\n"), 
+				auto_days);
+		else
+			printf (_("Certificates will only be archived with the archive command.\n"));
+
+		// Only changing the policy
+		if (grace_days < 0)
+			return 0;
+	}
+
+	if (grace_days < 0)
+		grace_days = 0;
+
+	archived = ca_file_archive_crts (time (NULL) - (time_t) grace_days * 24 * 60 * 60, &error);
+	if (archived < 0) {
+		dialog_error (error);
+		return 1;
+	}
+
+	printf (_("%d certificates moved to the archive.\n"), archived);
 
-	ca_file_foreach_crt (__ca_cli_callback_listcert_aux, see_revoked, GINT_TO_POINTER(see_revoked));
 	return 0;
 }
 
@@ -257,8 +1132,38 @@ int __ca_cli_callback_listcsr_aux (void *pArg, int argc, char **argv, char **col
 }
 
 
+int __ca_cli_callback_listcsr_formatted_aux (void *pArg, int argc, char **argv, char **columnNames)
+{
+	CaCliListOptions *options = (CaCliListOptions *) pArg;
+	const gchar *values[CA_CLI_CSR_LIST_FIELD_NUMBER];
+
+	values[0] = argv[CA_FILE_CSR_COLUMN_ID];
+	values[1] = argv[CA_FILE_CSR_COLUMN_PARENT_ID];
+	values[2] = argv[CA_FILE_CSR_COLUMN_SUBJECT];
+	values[3] = argv[CA_FILE_CSR_COLUMN_PRIVATE_KEY_IN_DB];
+
+	__ca_cli_output_row (options->format, ca_cli_csr_list_fields, CA_CLI_CSR_LIST_FIELD_NUMBER, values);
+
+	return 0;
+}
+
 int ca_cli_callback_listcsr (int argc, char **argv)
 {
+	CaCliListOptions options;
+
+	options.format = CA_CLI_OUTPUT_TEXT;
+	options.see_revoked = FALSE;
+
+	if (argc == 2 && ! __ca_cli_output_parse_format (argv[1], &options.format)) {
+		dialog_error (_("Unrecognized option. Valid option is --format=text|jsonl|csv"));
+		return -1;
+	}
+
+	if (options.format != CA_CLI_OUTPUT_TEXT) {
+		__ca_cli_output_header (options.format, ca_cli_csr_list_fields, CA_CLI_CSR_LIST_FIELD_NUMBER);
+		return (ca_file_foreach_csr (__ca_cli_callback_listcsr_formatted_aux, &options) ? 0 : 1);
+	}
+
 	printf (_("Certificate Requests in Database:\n"));
 	printf (_("Id.\tParent Id.\tCSR Subject\t\tKey in DB?\n"));
 
@@ -269,6 +1174,47 @@ int ca_cli_callback_listcsr (int argc, char **argv)
 
 
 
+// Asks for the type and size of a new key pair
+static void __ca_cli_callback_ask_key (TlsCreationData *creation_data)
+{
+	gchar *aux = NULL;
+	gint key_type;
+
+	do {
+		if (aux)
+			g_free (aux);
+
+		aux = dialog_ask_for_string (_("Enter type of key you are going to create (RSA/DSA/ECDSA/Ed25519)"), 
+					     (gchar *) tls_key_type_name (creation_data->key_type));
+		key_type = tls_key_type_from_name (aux);
+	} while (key_type < 0);
+	g_free (aux);
+
+	if (key_type != creation_data->key_type) {
+		creation_data->key_type = key_type;
+		creation_data->key_bitlength = (key_type == TLS_KEY_TYPE_RSA || key_type == TLS_KEY_TYPE_DSA ? 2048 : 256);
+	}
+
+	switch (key_type) {
+	case TLS_KEY_TYPE_ED25519:
+		// Its size is fixed
+		break;
+	case TLS_KEY_TYPE_ECDSA:
+		do {
+			creation_data->key_bitlength = dialog_ask_for_number (_("Enter the size of the elliptic curve (256 for P-256, 384 for P-384)"),
+									      256, 384, creation_data->key_bitlength);
+		} while (! tls_key_type_check_bitlength (key_type, creation_data->key_bitlength));
+		break;
+	default:
+		do {
+			creation_data->key_bitlength = dialog_ask_for_number (_("Enter bitlength for the key (it must be a whole multiple of 1024)"),
+									      1024, (key_type == TLS_KEY_TYPE_DSA ? 3072 : 10240), 
+									      creation_data->key_bitlength);
+		} while (! tls_key_type_check_bitlength (key_type, creation_data->key_bitlength));
+		break;
+	}
+}
+
 int ca_cli_callback_addcsr (int argc, char **argv)
 {
 	gboolean with_ca_id = FALSE;
@@ -283,7 +1229,6 @@ int ca_cli_callback_addcsr (int argc, char **argv)
 	gboolean change_data = FALSE;
 
 	TlsCreationData *csr_creation_data = NULL;
-	guint max_key_length;
 
 
 	if (argc == 2) {
@@ -300,34 +1245,36 @@ int ca_cli_callback_addcsr (int argc, char **argv)
 	if (with_ca_id) {
 		TlsCert *tlscert = NULL;
 		gchar *pem = NULL;
+		const CaPolicy *policy = NULL;
 
 		pem = ca_file_get_public_pem_from_id (CA_FILE_ELEMENT_TYPE_CERT, ca_id);
 		g_assert (pem);
 
                 tlscert = tls_parse_cert_pem (pem);
+		policy = ca_file_policy_get_all (ca_id);
 
-                if (ca_file_policy_get_int (ca_id, "C_INHERIT")) {
-                        c_force_same = ca_file_policy_get_int (ca_id, "C_FORCE_SAME");
+                if (policy->c_inherit) {
+                        c_force_same = policy->c_force_same;
 			csr_creation_data->country = g_strdup (tlscert->c);
                 } 
 		
-		if (ca_file_policy_get_int (ca_id, "ST_INHERIT")) {
-			st_force_same = ca_file_policy_get_int (ca_id, "ST_FORCE_SAME");
+		if (policy->st_inherit) {
+			st_force_same = policy->st_force_same;
 			csr_creation_data->state = g_strdup (tlscert->st);
 		}
 
-		if (ca_file_policy_get_int (ca_id, "L_INHERIT")) {
-			l_force_same = ca_file_policy_get_int (ca_id, "L_FORCE_SAME");
+		if (policy->l_inherit) {
+			l_force_same = policy->l_force_same;
 			csr_creation_data->city = g_strdup (tlscert->l);
 		}
 
-		if (ca_file_policy_get_int (ca_id, "O_INHERIT")) {
-			o_force_same = ca_file_policy_get_int (ca_id, "O_FORCE_SAME");
+		if (policy->o_inherit) {
+			o_force_same = policy->o_force_same;
 			csr_creation_data->org = g_strdup (tlscert->o);
 		}
 
-		if (ca_file_policy_get_int (ca_id, "OU_INHERIT")) {
-			ou_force_same = ca_file_policy_get_int (ca_id, "OU_FORCE_SAME");
+		if (policy->ou_inherit) {
+			ou_force_same = policy->ou_force_same;
 			csr_creation_data->ou = g_strdup (tlscert->ou);
 		}
 
@@ -392,28 +1339,7 @@ int ca_cli_callback_addcsr (int argc, char **argv)
 		csr_creation_data->cn = aux;
 		aux = NULL;
 
-		do {
-			if (aux)
-				g_free (aux);
-
-			aux = dialog_ask_for_string (_("Enter type of key you are going to create (RSA/DSA)"), (csr_creation_data->key_type ? "DSA" : "RSA"));
-		} while (g_ascii_strcasecmp (aux, "RSA") && g_ascii_strcasecmp (aux, "DSA"));
-
-		if (! g_ascii_strcasecmp (aux, "RSA")) {
-			csr_creation_data->key_type = 0;
-			max_key_length = 10240;
-		} else if (! g_ascii_strcasecmp (aux, "DSA")) {
-			csr_creation_data->key_type = 1;
-			max_key_length = 3072;
-		}
-		g_free (aux);
-		aux = NULL;
-		
-		do {
-				csr_creation_data->key_bitlength = dialog_ask_for_number (_("Enter bitlength for the key (it must be a whole multiple of 1024)"),
-											  1024, max_key_length, csr_creation_data->key_bitlength);
-				
-		} while (csr_creation_data->key_bitlength % 1024);
+		__ca_cli_callback_ask_key (csr_creation_data);
 
 		printf (_("These are the provided CSR properties:\n"));
 
@@ -433,7 +1359,7 @@ int ca_cli_callback_addcsr (int argc, char **argv)
 			printf ("CN=%s", csr_creation_data->cn);
 		printf ("\n");
 		printf (_("Key pair\n"));
-		printf (_("\tType: %s\n"), (csr_creation_data->key_type ? "DSA" : "RSA"));
+		printf (_("\tType: %s\n"), tls_key_type_name (csr_creation_data->key_type));
 		printf (_("\tKey bitlength: %d\n"), csr_creation_data->key_bitlength);
 
 		change_data = dialog_ask_for_confirmation (NULL, _("Do you want to change anything? Yes/[No] "), FALSE);
@@ -455,6 +1381,454 @@ int ca_cli_callback_addcsr (int argc, char **argv)
 
 
 
+static GHashTable * __ca_cli_input_record_new (void)
+{
+	return g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+}
+
+// Records of a CSV file, as tables from the (lowercase) names in its first row to the values
+static GPtrArray * __ca_cli_input_csv_records (const gchar *contents, gchar **error)
+{
+	GPtrArray *records = g_ptr_array_new_with_free_func ((GDestroyNotify) g_hash_table_unref);
+	GPtrArray *header = NULL;
+	GPtrArray *row = g_ptr_array_new_with_free_func (g_free);
+	GString *field = g_string_new (NULL);
+	GHashTable *record;
+	gboolean quoted = FALSE;
+	gboolean field_started = FALSE;
+	const gchar *c = contents;
+	guint i;
+
+	for (;;) {
+		if (quoted && *c) {
+			if (*c == '"' && c[1] == '"') {
+				g_string_append_c (field, '"');
+				c++;
+			} else if (*c == '"') {
+				quoted = FALSE;
+			} else {
+				g_string_append_c (field, *c);
+			}
+		} else if (*c == '"') {
+			quoted = TRUE;
+			field_started = TRUE;
+		} else if (*c == ',') {
+			g_ptr_array_add (row, g_string_free (field, FALSE));
+			field = g_string_new (NULL);
+			field_started = TRUE;
+		} else if (*c == '\r' || *c == '\n' || ! *c) {
+			// End of row. Empty lines are skipped
+			if (field_started || field->len) {
+				g_ptr_array_add (row, g_string_free (field, FALSE));
+				field = g_string_new (NULL);
+			}
+
+			if (! header && row->len) {
+				header = row;
+				for (i = 0; i < header->len; i++) {
+					gchar *name = g_ascii_strdown (g_strstrip ((gchar *) g_ptr_array_index (header, i)), -1);
+					g_free (g_ptr_array_index (header, i));
+					g_ptr_array_index (header, i) = name;
+				}
+				row = g_ptr_array_new_with_free_func (g_free);
+			} else if (row->len) {
+				if (row->len > header->len) {
+					*error = g_strdup_printf (_("Row %u has more fields than the header"), records->len + 1);
+					break;
+				}
+				record = __ca_cli_input_record_new ();
+				for (i = 0; i < row->len; i++) {
+					if (strlen (g_ptr_array_index (row, i)))
+						g_hash_table_replace (record, g_strdup (g_ptr_array_index (header, i)), 
+								      g_strdup (g_ptr_array_index (row, i)));
+				}
+				g_ptr_array_add (records, record);
+				g_ptr_array_set_size (row, 0);
+			}
+			field_started = FALSE;
+
+			if (! *c)
+				break;
+		} else {
+			g_string_append_c (field, *c);
+		}
+		c++;
+	}
+
+	if (quoted && ! *error)
+		*error = g_strdup (_("Unterminated quoted field"));
+
+	g_string_free (field, TRUE);
+	g_ptr_array_free (row, TRUE);
+	if (header)
+		g_ptr_array_free (header, TRUE);
+
+	if (*error) {
+		g_ptr_array_free (records, TRUE);
+		return NULL;
+	}
+
+	return records;
+}
+
+static gchar * __ca_cli_input_json_string (const gchar **c)
+{
+	GString *value = g_string_new (NULL);
+	gunichar unichar;
+	gchar utf8[6];
+	gint i;
+
+	for ((*c)++; **c != '"'; (*c)++) {
+		if (! **c || (guchar) **c < 0x20) {
+			g_string_free (value, TRUE);
+			return NULL;
+		}
+		if (**c != '\\') {
+			g_string_append_c (value, **c);
+			continue;
+		}
+
+		(*c)++;
+		switch (**c) {
+		case '"':
+		case '\\':
+		case '/':
+			g_string_append_c (value, **c);
+			break;
+		case 'b':
+			g_string_append_c (value, '\b');
+			break;
+		case 'f':
+			g_string_append_c (value, '\f');
+			break;
+		case 'n':
+			g_string_append_c (value, '\n');
+			break;
+		case 'r':
+			g_string_append_c (value, '\r');
+			break;
+		case 't':
+			g_string_append_c (value, '\t');
+			break;
+		case 'u':
+			unichar = 0;
+			for (i = 0; i < 4; i++) {
+				if (g_ascii_xdigit_value ((*c)[1]) < 0) {
+					g_string_free (value, TRUE);
+					return NULL;
+				}
+				(*c)++;
+				unichar = unichar * 16 + g_ascii_xdigit_value (**c);
+			}
+			g_string_append_len (value, utf8, g_unichar_to_utf8 (unichar, utf8));
+			break;
+		default:
+			g_string_free (value, TRUE);
+			return NULL;
+		}
+	}
+	(*c)++;
+
+	return g_string_free (value, FALSE);
+}
+
+// Records of a JSON file: an array of flat objects, or one object per line
+static GPtrArray * __ca_cli_input_json_records (const gchar *contents, gchar **error)
+{
+	GPtrArray *records = g_ptr_array_new_with_free_func ((GDestroyNotify) g_hash_table_unref);
+	GHashTable *record;
+	const gchar *c = contents;
+	const gchar *token;
+	gchar *name;
+	gchar *value;
+
+	while (! *error) {
+		while (g_ascii_isspace (*c) || *c == '[' || *c == ']' || *c == ',')
+			c++;
+		if (! *c)
+			break;
+		if (*c != '{') {
+			*error = g_strdup_printf (_("Object %u: an object was expected"), records->len + 1);
+			break;
+		}
+		c++;
+
+		record = __ca_cli_input_record_new ();
+		g_ptr_array_add (records, record);
+
+		for (;;) {
+			while (g_ascii_isspace (*c))
+				c++;
+			if (*c == '}') {
+				c++;
+				break;
+			}
+			if (*c != '"' || ! (name = __ca_cli_input_json_string (&c))) {
+				*error = g_strdup_printf (_("Object %u: a field name was expected"), records->len);
+				break;
+			}
+
+			while (g_ascii_isspace (*c))
+				c++;
+			if (*c != ':') {
+				*error = g_strdup_printf (_("Object %u: ':' was expected after '%s'"), records->len, name);
+				g_free (name);
+				break;
+			}
+			c++;
+			while (g_ascii_isspace (*c))
+				c++;
+
+			if (*c == '"') {
+				value = __ca_cli_input_json_string (&c);
+			} else {
+				// Numbers, booleans and null. Nested values are not allowed
+				for (token = c; *c && ! strchr (",} \t\r\n", *c); c++)
+					if (strchr ("{[\"", *c))
+						break;
+				value = (c > token && strchr ("{[\"", *c) == NULL ? g_strndup (token, c - token) : NULL);
+			}
+			if (! value) {
+				*error = g_strdup_printf (_("Object %u: invalid value for '%s'"), records->len, name);
+				g_free (name);
+				break;
+			}
+
+			if (strcmp (value, "null")) {
+				g_hash_table_replace (record, g_ascii_strdown (name, -1), value);
+			} else {
+				g_free (value);
+			}
+			g_free (name);
+
+			while (g_ascii_isspace (*c))
+				c++;
+			if (*c == ',') {
+				c++;
+			} else if (*c != '}') {
+				*error = g_strdup_printf (_("Object %u: ',' or '}' was expected"), records->len);
+				break;
+			}
+		}
+	}
+
+	if (*error) {
+		g_ptr_array_free (records, TRUE);
+		return NULL;
+	}
+
+	return records;
+}
+
+static void __ca_cli_callback_batchcsr_progress (guint saved, guint failed, guint total, gpointer user_data)
+{
+	printf (_("\r%u of %u CSRs saved, %u failed"), saved, total, failed);
+	fflush (stdout);
+}
+
+int ca_cli_callback_batchcsr (int argc, char **argv)
+{
+	static const gchar *fields[] = {"c", "st", "l", "o", "ou", "cn", "emailaddress", NULL};
+	gchar *filename = argv[1];
+	gboolean json;
+	guint64 ca_id = 0;
+	gint key_type = 0;
+	gint key_bitlength = -1;
+	gint threads = CSR_CREATION_BATCH_THREADS;
+	TlsCert *ca_cert = NULL;
+	const CaPolicy *policy = NULL;
+	gchar *contents = NULL;
+	gchar *password = NULL;
+	gchar *error = NULL;
+	gchar **errors = NULL;
+	gchar *message;
+	GPtrArray *records;
+	GPtrArray *creation_data;
+	GHashTable *record;
+	GHashTableIter iter;
+	gpointer name;
+	TlsCreationData *cd;
+	gchar *aux;
+	guint saved;
+	guint i, j;
+
+	json = (g_str_has_suffix (filename, ".json") || g_str_has_suffix (filename, ".jsonl"));
+
+	for (i = 2; i < argc; i++) {
+		aux = strchr (argv[i], '=');
+		aux = (aux ? aux + 1 : "");
+
+		if (! strcmp (argv[i], "--format=csv")) {
+			json = FALSE;
+		} else if (! strcmp (argv[i], "--format=json") || ! strcmp (argv[i], "--format=jsonl")) {
+			json = TRUE;
+		} else if (g_str_has_prefix (argv[i], "--ca=")) {
+			ca_id = atoll (aux);
+			if (! ca_file_check_if_is_ca_id (ca_id)) {
+				dialog_error (_("The given CA id. is not valid"));
+				return -1;
+			}
+		} else if (g_str_has_prefix (argv[i], "--key=")) {
+			key_type = tls_key_type_from_name (aux);
+			if (key_type < 0) {
+				dialog_error (_("The key type must be 'rsa', 'dsa', 'ecdsa' or 'ed25519'"));
+				return -1;
+			}
+		} else if (g_str_has_prefix (argv[i], "--bits=")) {
+			key_bitlength = atoi (aux);
+		} else if (g_str_has_prefix (argv[i], "--threads=")) {
+			threads = atoi (aux);
+			if (threads <= 0) {
+				dialog_error (_("The number of threads must be a positive number"));
+				return -1;
+			}
+		} else {
+			dialog_error (_("Unrecognized option. Try 'help' for getting the list of valid options"));
+			return -1;
+		}
+	}
+
+	// Elliptic curve keys are 256 bits by default
+	if (key_bitlength < 0)
+		key_bitlength = (key_type == TLS_KEY_TYPE_RSA || key_type == TLS_KEY_TYPE_DSA ? 2048 : 256);
+	if (! tls_key_type_check_bitlength (key_type, key_bitlength)) {
+		dialog_error (_("Invalid bit-length for this key type. RSA and DSA ones must be whole multiples of 1024, "
+				"up to 10240 (RSA) or 3072 (DSA). ECDSA ones are 256 or 384, and Ed25519 ones, 256"));
+		return -1;
+	}
+
+	if (! g_file_get_contents (filename, &contents, NULL, NULL)) {
+		dialog_error (_("Couldn't read the given file"));
+		return 1;
+	}
+
+	records = (json ? __ca_cli_input_json_records (contents, &error) : __ca_cli_input_csv_records (contents, &error));
+	g_free (contents);
+	if (! records) {
+		dialog_error (error);
+		g_free (error);
+		return 1;
+	}
+
+	if (ca_id) {
+		gchar *pem = ca_file_get_public_pem_from_id (CA_FILE_ELEMENT_TYPE_CERT, ca_id);
+		ca_cert = tls_parse_cert_pem (pem);
+		policy = ca_file_policy_get_all (ca_id);
+		g_free (pem);
+	}
+
+	creation_data = g_ptr_array_new_with_free_func ((GDestroyNotify) tls_creation_data_free);
+	for (i = 0; i < records->len && ! error; i++) {
+		record = g_ptr_array_index (records, i);
+
+		g_hash_table_iter_init (&iter, record);
+		while (g_hash_table_iter_next (&iter, &name, NULL)) {
+			for (j = 0; fields[j] && strcmp (fields[j], name); j++)
+				;
+			if (! fields[j]) {
+				error = g_strdup_printf (_("Record %u: unknown field '%s'. Valid ones are C, ST, L, O, OU, CN and emailAddress"), 
+							 i + 1, (gchar *) name);
+				break;
+			}
+		}
+		if (! error && ! g_hash_table_lookup (record, "cn"))
+			error = g_strdup_printf (_("Record %u has no CN"), i + 1);
+		if (error)
+			break;
+
+		cd = g_new0 (TlsCreationData, 1);
+		cd->country = g_strdup (g_hash_table_lookup (record, "c"));
+		cd->state = g_strdup (g_hash_table_lookup (record, "st"));
+		cd->city = g_strdup (g_hash_table_lookup (record, "l"));
+		cd->org = g_strdup (g_hash_table_lookup (record, "o"));
+		cd->ou = g_strdup (g_hash_table_lookup (record, "ou"));
+		cd->cn = g_strdup (g_hash_table_lookup (record, "cn"));
+		cd->emailAddress = g_strdup (g_hash_table_lookup (record, "emailaddress"));
+		cd->key_type = key_type;
+		cd->key_bitlength = key_bitlength;
+
+		// Fields inherited from the CA, as in addcsr
+		if (ca_cert) {
+			if (policy->c_inherit && (policy->c_force_same || ! cd->country)) {
+				g_free (cd->country);
+				cd->country = g_strdup (ca_cert->c);
+			}
+			if (policy->st_inherit && (policy->st_force_same || ! cd->state)) {
+				g_free (cd->state);
+				cd->state = g_strdup (ca_cert->st);
+			}
+			if (policy->l_inherit && (policy->l_force_same || ! cd->city)) {
+				g_free (cd->city);
+				cd->city = g_strdup (ca_cert->l);
+			}
+			if (policy->o_inherit && (policy->o_force_same || ! cd->org)) {
+				g_free (cd->org);
+				cd->org = g_strdup (ca_cert->o);
+			}
+			if (policy->ou_inherit && (policy->ou_force_same || ! cd->ou)) {
+				g_free (cd->ou);
+				cd->ou = g_strdup (ca_cert->ou);
+			}
+			cd->parent_ca_id_str = g_strdup_printf ("%"G_GUINT64_FORMAT, ca_id);
+		}
+
+		g_ptr_array_add (creation_data, cd);
+	}
+	g_ptr_array_free (records, TRUE);
+	if (ca_cert)
+		tls_cert_free (ca_cert);
+
+	if (error) {
+		dialog_error (error);
+		g_free (error);
+		g_ptr_array_free (creation_data, TRUE);
+		return 1;
+	}
+
+	message = g_strdup_printf (_("You are about to create %u Certificate Signing Requests, with %s keys of %d bits."), 
+				   creation_data->len, tls_key_type_name (key_type), key_bitlength);
+	if (! dialog_ask_for_confirmation (message, _("Are you sure? [Yes]/No "), TRUE)) {
+		printf (_("Operation cancelled.\n"));
+		g_free (message);
+		g_ptr_array_free (creation_data, TRUE);
+		return 0;
+	}
+	g_free (message);
+
+	if (ca_file_is_password_protected ()) {
+		password = pkey_manage_ask_password ();
+		if (! password) {
+			printf (_("Operation cancelled.\n"));
+			g_ptr_array_free (creation_data, TRUE);
+			return 0;
+		}
+		for (i = 0; i < creation_data->len; i++)
+			((TlsCreationData *) g_ptr_array_index (creation_data, i))->password = g_strdup (password);
+		g_free (password);
+	}
+
+	saved = csr_creation_batch (creation_data, threads, &errors, __ca_cli_callback_batchcsr_progress, NULL);
+	printf ("\n");
+
+	for (i = 0; i < creation_data->len; i++) {
+		if (errors[i]) {
+			cd = g_ptr_array_index (creation_data, i);
+			printf (_("Record %u (%s): %s\n"), i + 1, cd->cn, errors[i]);
+			g_free (errors[i]);
+		}
+	}
+	g_free (errors);
+
+	printf (_("%u CSRs created successfully.\n"), saved);
+
+	i = creation_data->len;
+	g_ptr_array_free (creation_data, TRUE);
+
+	return (saved == i ? 0 : 1);
+}
+
+
+
 int ca_cli_callback_addca (int argc, char **argv)
 {
 	gboolean change_data = FALSE;
@@ -522,25 +1896,7 @@ int ca_cli_callback_addca (int argc, char **argv)
 		ca_creation_data->cn = aux;
 		aux = NULL;
 
-		do {
-			if (aux)
-				g_free (aux);
-
-			aux = dialog_ask_for_string (_("Enter type of key you are going to create (RSA/DSA)"), (ca_creation_data->key_type ? "DSA" : "RSA"));
-		} while (g_ascii_strcasecmp (aux, "RSA") && g_ascii_strcasecmp (aux, "DSA"));
-		
-		if (! g_ascii_strcasecmp (aux, "RSA")) {
-			ca_creation_data->key_type = 0;
-		} else if (! g_ascii_strcasecmp (aux, "DSA")) {
-			ca_creation_data->key_type = 1;
-		}
-		g_free (aux);
-		aux = NULL;
-		
-		do {
-			ca_creation_data->key_bitlength = dialog_ask_for_number (_("Enter bitlength for the key (it must be a whole multiple of 1024)"),
-									     1024,10240,ca_creation_data->key_bitlength);
-		} while (ca_creation_data->key_bitlength % 1024);
+		__ca_cli_callback_ask_key (ca_creation_data);
 
 
 		ca_creation_data->key_months_before_expiration = dialog_ask_for_number (_("Introduce number of months before expiration of the new certification authority"),
@@ -582,7 +1938,7 @@ int ca_cli_callback_addca (int argc, char **argv)
 			printf ("CN=%s", ca_creation_data->cn);
 		printf ("\n");
 		printf (_("Key pair\n"));
-		printf (_("\tType: %s\n"), (ca_creation_data->key_type ? "DSA" : "RSA"));
+		printf (_("\tType: %s\n"), tls_key_type_name (ca_creation_data->key_type));
 		printf (_("\tKey bitlength: %d\n"), ca_creation_data->key_bitlength);
 		printf (_("Validity\n"));
 		printf (_("Validity:\n"));
@@ -688,17 +2044,18 @@ int ca_cli_callback_revoke (int argc, char **argv)
 
 	ca_cli_callback_showcert (argc, argv);
 
-	if (dialog_ask_for_confirmation (_("This certificate will be revoked."), _("Are you sure? Yes/[No] "),  FALSE)) {
+	if (dialog_confirm_action (_("This certificate will be revoked."), _("Are you sure? Yes/[No] "),  FALSE)) {
 		errmsg = ca_file_revoke_crt (id);
 		if (errmsg) {
 			dialog_error (_(errmsg));
-			
+			return 1;
 		} else {
 			printf (_("Certificate revoked.\n"));
 		}
 
 	} else {
 		printf (_("Operation cancelled.\n"));
+		return 1;
 	}
 
 
@@ -799,9 +2156,133 @@ void __ca_cli_callback_show_uses_and_purposes (TlsCertCreationData *cert_creatio
 }
 
 
+static guint __ca_cli_callback_policy_uses (const CaPolicy *policy)
+{
+	TlsCertCreationData allowed;
+
+	memset (&allowed, 0, sizeof (allowed));
+	allowed.ca = policy->ca;
+	allowed.crl_signing = policy->crl_sign;
+	allowed.digital_signature = policy->digital_signature;
+	allowed.data_encipherment = policy->data_encipherment;
+	allowed.key_encipherment = policy->key_encipherment;
+	allowed.non_repudiation = policy->non_repudiation;
+	allowed.key_agreement = policy->key_agreement;
+	allowed.email_protection = policy->email_protection;
+	allowed.code_signing = policy->code_signing;
+	allowed.web_client = policy->tls_web_client;
+	allowed.web_server = policy->tls_web_server;
+	allowed.time_stamping = policy->time_stamping;
+	allowed.ocsp_signing = policy->ocsp_signing;
+	allowed.any_purpose = policy->any_purpose;
+
+	return tls_cert_creation_data_get_uses (&allowed);
+}
+
+static gchar * __ca_cli_callback_uses_to_string (guint uses, const gchar *separator)
+{
+	GString *res = g_string_new ("");
+	gint i;
+
+	for (i = 0; ca_cli_cert_uses[i].name; i++) {
+		if (! (uses & ca_cli_cert_uses[i].use))
+			continue;
+		if (res->len)
+			g_string_append (res, separator);
+		g_string_append (res, ca_cli_cert_uses[i].name);
+	}
+
+	return g_string_free (res, FALSE);
+}
+
+static gboolean __ca_cli_callback_uses_parse (const gchar *list, guint *uses)
+{
+	gchar **items = g_strsplit (list, ",", -1);
+	gint i, j;
+
+	*uses = 0;
+	for (i = 0; items[i]; i++) {
+		if (! items[i][0])
+			continue;
+		for (j = 0; ca_cli_cert_uses[j].name; j++) {
+			if (! strcmp (items[i], ca_cli_cert_uses[j].name))
+				break;
+		}
+		if (! ca_cli_cert_uses[j].name) {
+			g_strfreev (items);
+			return FALSE;
+		}
+		*uses |= ca_cli_cert_uses[j].use;
+	}
+
+	g_strfreev (items);
+	return TRUE;
+}
+
+static int __ca_cli_callback_sign_with_profile (char **argv, const gchar *profile_name)
+{
+	TlsCertCreationData *cert_creation_data = NULL;
+	const CaFileProfile *profile;
+	const CaPolicy *policy;
+	guint64 csr_id = atoll(argv[1]);
+	guint64 ca_id = atoll(argv[2]);
+	const gchar *strerror;
+
+	profile = ca_file_profile_get (ca_id, profile_name);
+	if (! profile) {
+		dialog_error (_("The given CA has no issuance profile with that name"));
+		return -1;
+	}
+	if (! profile->extensions) {
+		dialog_error (_("The extensions of the issuance profile couldn't be generated"));
+		return -1;
+	}
+
+	/* The policy may have been restricted after the profile was defined */
+	policy = ca_file_policy_get_all (ca_id);
+	if (profile->uses & ~__ca_cli_callback_policy_uses (policy)) {
+		dialog_error (_("The issuance profile has uses or purposes that are now disabled by the CA policy"));
+		return -1;
+	}
+
+	cert_creation_data = g_new0 (TlsCertCreationData, 1);
+	cert_creation_data->key_months_before_expiration = MIN (profile->months_to_expire, policy->months_to_expire);
+	tls_cert_creation_data_set_uses (cert_creation_data, profile->uses);
+	cert_creation_data->extensions = profile->extensions;
+
+	printf (_("You are about to sign the following Certificate Signing Request:\n"));
+	ca_cli_callback_showcsr (2, argv);
+	printf (_("with the certificate corresponding to the next CA:\n"));
+	ca_cli_callback_showcert (2, &argv[1]);
+	printf (_("using the issuance profile '%s', valid for %d months.\n"), profile->name, 
+		cert_creation_data->key_months_before_expiration);
+
+	printf (_("The new certificate will be created with the following uses and purposes:\n"));
+	__ca_cli_callback_show_uses_and_purposes (cert_creation_data);
+
+	if (! dialog_ask_for_confirmation (NULL, _("Do you want to proceed with the signing? [Yes]/No "), TRUE)) {
+		g_free (cert_creation_data);
+		printf (_("Operation cancelled.\n"));
+		return 1;
+	}
+
+	strerror = new_cert_sign_csr (csr_id, ca_id, cert_creation_data);
+	g_free (cert_creation_data->crl_distribution_point);
+	g_free (cert_creation_data);
+
+	if (strerror) {
+		dialog_error ((gchar *) strerror);
+		return 1;
+	}
+
+	printf (_("Certificate signed.\n"));
+	return 0;
+}
+
 int ca_cli_callback_sign (int argc, char **argv)
 {
 	TlsCertCreationData *cert_creation_data = NULL;
+	const CaPolicy *policy = NULL;
 	
 	guint64 csr_id;
 	guint64 ca_id;
@@ -814,123 +2295,133 @@ int ca_cli_callback_sign (int argc, char **argv)
 		return -1;
 	}
 
+	if (argc > 3) {
+		if (! g_str_has_prefix (argv[3], "--profile=")) {
+			dialog_error (_("Unrecognized option. Valid option is --profile=<name>"));
+			return -1;
+		}
+		return __ca_cli_callback_sign_with_profile (argv, argv[3] + strlen ("--profile="));
+	}
+
 
 	cert_creation_data = g_new0 (TlsCertCreationData, 1);
+	policy = ca_file_policy_get_all (ca_id);
 
 	printf (_("You are about to sign the following Certificate Signing Request:\n"));
-	ca_cli_callback_showcsr (argc, argv);
+	ca_cli_callback_showcsr (2, argv);
 	printf (_("with the certificate corresponding to the next CA:\n"));
-	ca_cli_callback_showcert (argc - 1, &argv[1]);
+	ca_cli_callback_showcert (2, &argv[1]);
 
 	cert_creation_data->key_months_before_expiration = dialog_ask_for_number (_("Introduce number of months before expiration of the new certificate (0 to cancel)"),
 									      0,
-									      ca_file_policy_get_int (ca_id, "MONTHS_TO_EXPIRE"), 
-									      ca_file_policy_get_int (ca_id, "MONTHS_TO_EXPIRE"));
+									      policy->months_to_expire, 
+									      policy->months_to_expire);
 	
 	if (cert_creation_data->key_months_before_expiration == 0) {
 		g_free (cert_creation_data);
 		printf (_("Operation cancelled.\n"));
+		return 1;
 	}
 
-	cert_creation_data->ca = ca_file_policy_get_int (ca_id, "CA");
-	cert_creation_data->crl_signing = ca_file_policy_get_int (ca_id, "CRL_SIGN");
-	cert_creation_data->digital_signature = ca_file_policy_get_int (ca_id, "DIGITAL_SIGNATURE");
-	cert_creation_data->data_encipherment =  ca_file_policy_get_int (ca_id, "DATA_ENCIPHERMENT");
-	cert_creation_data->key_encipherment = ca_file_policy_get_int (ca_id, "KEY_ENCIPHERMENT");
-	cert_creation_data->non_repudiation = ca_file_policy_get_int (ca_id, "NON_REPUDIATION");
-	cert_creation_data->key_agreement = ca_file_policy_get_int (ca_id, "KEY_AGREEMENT");
-
-	cert_creation_data->email_protection = ca_file_policy_get_int (ca_id, "EMAIL_PROTECTION");
-	cert_creation_data->code_signing = ca_file_policy_get_int (ca_id, "CODE_SIGNING");
-	cert_creation_data->web_client =  ca_file_policy_get_int (ca_id, "TLS_WEB_CLIENT");
-	cert_creation_data->web_server = ca_file_policy_get_int (ca_id, "TLS_WEB_SERVER");
-	cert_creation_data->time_stamping = ca_file_policy_get_int (ca_id, "TIME_STAMPING");
-	cert_creation_data->ocsp_signing = ca_file_policy_get_int (ca_id, "OCSP_SIGNING");
-	cert_creation_data->any_purpose = ca_file_policy_get_int (ca_id, "ANY_PURPOSE");
+	cert_creation_data->ca = policy->ca;
+	cert_creation_data->crl_signing = policy->crl_sign;
+	cert_creation_data->digital_signature = policy->digital_signature;
+	cert_creation_data->data_encipherment =  policy->data_encipherment;
+	cert_creation_data->key_encipherment = policy->key_encipherment;
+	cert_creation_data->non_repudiation = policy->non_repudiation;
+	cert_creation_data->key_agreement = policy->key_agreement;
+
+	cert_creation_data->email_protection = policy->email_protection;
+	cert_creation_data->code_signing = policy->code_signing;
+	cert_creation_data->web_client =  policy->tls_web_client;
+	cert_creation_data->web_server = policy->tls_web_server;
+	cert_creation_data->time_stamping = policy->time_stamping;
+	cert_creation_data->ocsp_signing = policy->ocsp_signing;
+	cert_creation_data->any_purpose = policy->any_purpose;
 
 	printf (_("The new certificate will be created with the following uses and purposes:\n"));
 	__ca_cli_callback_show_uses_and_purposes (cert_creation_data);
 	
 	while (dialog_ask_for_confirmation (NULL, _("Do you want to change any property of the new certificate? Yes/[No] "), FALSE)) {
 
-		if (ca_file_policy_get_int (ca_id, "CA")) {
+		if (policy->ca) {
 			cert_creation_data->ca = dialog_ask_for_confirmation (NULL, _("* Enable Certification Authority use? [Yes]/No "), TRUE);
 		} else {
 			printf (_("* Certification Authority use disabled by policy\n"));
 		}
 
-		if (ca_file_policy_get_int (ca_id, "CRL_SIGN")) {
+		if (policy->crl_sign) {
 			cert_creation_data->crl_signing = dialog_ask_for_confirmation (NULL, _("* Enable CRL Signing? [Yes]/No "), TRUE);
 		} else {
 			printf (_("* CRL signing use disabled by policy\n"));
 		}
 
-		if (ca_file_policy_get_int (ca_id, "DIGITAL_SIGNATURE")) {
+		if (policy->digital_signature) {
 			cert_creation_data->digital_signature = dialog_ask_for_confirmation (NULL, _("* Enable Digital Signature use? [Yes]/No "), TRUE);
 		} else {
 			printf (_("* Digital Signature use disabled by policy\n"));
 		}
 
-		if (ca_file_policy_get_int (ca_id, "DATA_ENCIPHERMENT")) {
+		if (policy->data_encipherment) {
 			cert_creation_data->data_encipherment = dialog_ask_for_confirmation (NULL, _("Enable Data Encipherment use? [Yes]/No "), TRUE);
 		} else {
 			printf (_("* Data Encipherment use disabled by policy\n"));
 		}
 
-		if (ca_file_policy_get_int (ca_id, "KEY_ENCIPHERMENT")) {
+		if (policy->key_encipherment) {
 			cert_creation_data->key_encipherment = dialog_ask_for_confirmation (NULL, _("Enable Key Encipherment use? [Yes]/No "), TRUE);
 		} else {
 			printf (_("* Key Encipherment use disabled by policy\n"));
 		}
 
-		if (ca_file_policy_get_int (ca_id, "NON_REPUDIATION")) {
+		if (policy->non_repudiation) {
 			cert_creation_data->non_repudiation = dialog_ask_for_confirmation (NULL, _("Enable Non Repudiation use? [Yes]/No "), TRUE);
 		} else {
 			printf (_("* Non Repudiation use disabled by policy\n"));
 		}
 
-		if (ca_file_policy_get_int (ca_id, "KEY_AGREEMENT")) {
+		if (policy->key_agreement) {
 			cert_creation_data->key_agreement = dialog_ask_for_confirmation (NULL, _("Enable Key Agreement use? [Yes]/No "), TRUE);
 		} else {
 			printf (_("* Key Agreement use disabled by policy\n"));
 		}
 
-		if (ca_file_policy_get_int (ca_id, "EMAIL_PROTECTION")) {
+		if (policy->email_protection) {
 			cert_creation_data->email_protection = dialog_ask_for_confirmation (NULL, _("Enable Email Protection purpose? [Yes]/No "), TRUE);
 		} else {
 			printf (_("* Email Protection purpose disabled by policy\n"));
 		}
 
-		if (ca_file_policy_get_int (ca_id, "CODE_SIGNING")) {
+		if (policy->code_signing) {
 			cert_creation_data->code_signing = dialog_ask_for_confirmation (NULL, _("Enable Code Signing purpose? [Yes]/No "), TRUE);
 		} else {
 			printf (_("* Code Signing purpose disabled by policy\n"));
 		}
 
-		if (ca_file_policy_get_int (ca_id, "TLS_WEB_CLIENT")) {
+		if (policy->tls_web_client) {
 			cert_creation_data->web_client = dialog_ask_for_confirmation (NULL, _("Enable TLS Web Client purpose? [Yes]/No "), TRUE);
 		} else {
 			printf (_("* TLS Web Client purpose disabled by policy\n"));
 		}
 
-		if (ca_file_policy_get_int (ca_id, "TLS_WEB_SERVER")) {
+		if (policy->tls_web_server) {
 			cert_creation_data->web_server = dialog_ask_for_confirmation (NULL, _("Enable TLS Web Server purpose? [Yes]/No "), TRUE);
 		} else {
 			printf (_("* TLS Web Server purpose disabled by policy\n"));
 		}
 
-		if (ca_file_policy_get_int (ca_id, "TIME_STAMPING")) {
+		if (policy->time_stamping) {
 			cert_creation_data->time_stamping = dialog_ask_for_confirmation (NULL, _("Enable Time Stamping purpose? [Yes]/No "), TRUE);
 		} else {
 			printf (_("* Time Stamping purpose disabled by policy\n"));
 		}
 
-		if (ca_file_policy_get_int (ca_id, "OCSP_SIGNING")) {
+		if (policy->ocsp_signing) {
 			cert_creation_data->ocsp_signing = dialog_ask_for_confirmation (NULL, _("Enable OCSP Signing purpose? [Yes]/No "), TRUE);		} else {
 			printf (_("* OCSP Signing purpose disabled by policy\n"));
 		}
 
-		if (ca_file_policy_get_int (ca_id, "ANY_PURPOSE")) {
+		if (policy->any_purpose) {
 			cert_creation_data->any_purpose = dialog_ask_for_confirmation (NULL, _("Enable any purpose? [Yes]/No "), TRUE);
 		} else {
 			printf (_("* Any purpose disabled by policy\n"));
@@ -944,13 +2435,15 @@ int ca_cli_callback_sign (int argc, char **argv)
 	if (dialog_ask_for_confirmation (_("All the mandatory data for the certificate generation has been gathered."), _("Do you want to proceed with the signing? [Yes]/No "), TRUE)) {
 
 		const gchar * strerror = new_cert_sign_csr (csr_id, ca_id, cert_creation_data);
-		if (strerror)
+		if (strerror) {
 			dialog_error ((gchar *) strerror);
-		else
+			return 1;
+		} else
 			printf (_("Certificate signed.\n"));
 
 	} else {
 		printf (_("Operation cancelled.\n"));
+		return 1;
 	}
 
 
@@ -969,17 +2462,18 @@ int ca_cli_callback_delete (int argc, char **argv)
 
 	ca_cli_callback_showcsr (argc, argv);
 
-	if (dialog_ask_for_confirmation (_("This Certificate Signing Request will be deleted."), _("This operation cannot be undone. Are you sure? Yes/[No] "),  FALSE)) {
+	if (dialog_confirm_action (_("This Certificate Signing Request will be deleted."), _("This operation cannot be undone. Are you sure? Yes/[No] "),  FALSE)) {
 		errmsg = ca_file_remove_csr (id);
 		if (errmsg) {
 			dialog_error (_(errmsg));
-			
+			return 1;
 		} else {
 			printf (_("Certificate Signing Request deleted.\n"));
 		}
 
 	} else {
 		printf (_("Operation cancelled.\n"));
+		return 1;
 	}
 
 
@@ -1000,7 +2494,7 @@ int ca_cli_callback_crlgen (int argc, char **argv)
 	error = crl_generate (id_ca, g_strdup(filename));
 
 	if (! error) {
-		printf (_("CRL generated successfully into file '%s'\n"), filename);
+		fprintf (__ca_cli_out (), _("CRL generated successfully into file '%s'\n"), filename);
 	} else {
 		dialog_error (error);
 		return 1;
@@ -1009,19 +2503,109 @@ int ca_cli_callback_crlgen (int argc, char **argv)
 	return 0;
 }
 
+static void __ca_cli_callback_crlpublish_report (guint64 ca_id, const gchar *filename, gint crl_version, 
+						 gboolean is_new, const gchar *error, gpointer user_data)
+{
+	// The id is formatted apart, as xgettext can't extract messages containing G_GUINT64_FORMAT
+	gchar *ca = g_strdup_printf ("%"G_GUINT64_FORMAT, ca_id);
+
+	if (error)
+		fprintf (__ca_cli_out (), _("CA %s: %s\n"), ca, error);
+	else if (is_new)
+		fprintf (__ca_cli_out (), _("CA %s: new CRL #%d saved into file '%s'\n"), ca, crl_version, filename);
+	else
+		fprintf (__ca_cli_out (), _("CA %s: CRL #%d still valid, kept in file '%s'\n"), ca, crl_version, filename);
+
+	g_free (ca);
+}
+
+int ca_cli_callback_crlpublish (int argc, char **argv)
+{
+	const gchar *filename_pattern = argv[1];
+	gint margin_hours = -1;
+	gint threads = 4;
+	gint every_minutes = 0;
+	gchar *password;
+	guint errors;
+	gint i;
+
+	for (i = 2; i < argc; i++) {
+		if (g_str_has_prefix (argv[i], "--margin=")) {
+			margin_hours = atoi (argv[i] + strlen ("--margin="));
+			if (margin_hours < 0) {
+				dialog_error (_("The margin must be a number of hours"));
+				return -1;
+			}
+		} else if (g_str_has_prefix (argv[i], "--threads=")) {
+			threads = atoi (argv[i] + strlen ("--threads="));
+		} else if (g_str_has_prefix (argv[i], "--every=")) {
+			every_minutes = atoi (argv[i] + strlen ("--every="));
+		} else {
+			dialog_error (_("Unrecognized option. Valid options are --margin=<hours>, --threads=<n> and --every=<minutes>"));
+			return -1;
+		}
+	}
+
+	if (! strstr (filename_pattern, "{ca}")) {
+		dialog_error (_("The filename must contain {ca}, which is replaced with the id of each CA"));
+		return -1;
+	}
+
+	if (threads < 1 || every_minutes < 0) {
+		dialog_error (_("The number of threads and the minutes between runs must be positive numbers"));
+		return -1;
+	}
+
+	/* The password is asked only once, instead of once for each CA */
+	if (ca_file_is_password_protected () && ! ca_file_get_unlocked_password ()) {
+		password = pkey_manage_ask_password ();
+		if (! password)
+			return 1;
+		ca_file_set_unlocked_password (password);
+		memset (password, 0, strlen (password));
+		g_free (password);
+	}
+
+	while (TRUE) {
+		errors = crl_publish_all (filename_pattern, margin_hours, threads, __ca_cli_callback_crlpublish_report, NULL);
+		fflush (__ca_cli_out ());
+
+		if (! every_minutes)
+			break;
+
+		g_usleep ((gulong) every_minutes * 60 * G_USEC_PER_SEC);
+	}
+
+	return (errors ? 1 : 0);
+}
+
 int ca_cli_callback_dhgen (int argc, char **argv)
 {
 	gint primebitlength = atoi (argv[1]);
 	gchar *filename = argv[2];
+	gboolean well_known = FALSE;
 	
 	gchar *error = NULL;
 
+	if (argc == 4) {
+		if (strcmp (argv[3], "--rfc7919")) {
+			dialog_error (_("Unrecognized option. Try 'help' for getting the list of valid options"));
+			return 1;
+		}
+		well_known = TRUE;
+	}
+
 	if (primebitlength == 0 || primebitlength % 1024) {
 		dialog_error (_("The bit-length of the prime number must be whole multiple of 1024"));
 		return 1;
 	}
 
-	error = export_dh_param (primebitlength, filename);
+	// The CLI doesn't refill the cache by itself, as it would exit before the generation ends
+	if (! well_known && dh_cache_is_standard_size (primebitlength) && ! dh_cache_is_available (primebitlength))
+		printf (_("There are no pre-generated parameters of %d bits, so they are generated now: it can take several minutes. "
+			  "Run 'dhcache fill <sets>' beforehand to keep several sets ready.\n"), primebitlength);
+
+	error = export_dh_param (primebitlength, well_known, filename);
 
 	if (error)
 		dialog_error (error);
@@ -1030,6 +2614,155 @@ int ca_cli_callback_dhgen (int argc, char **argv)
 	return 0;
 }
 
+int ca_cli_callback_dhcache (int argc, char **argv)
+{
+	gint sets = 1;
+	guint i;
+
+	if (argc >= 2 && strcmp (argv[1], "fill")) {
+		dialog_error (_("Unrecognized option. Try 'help' for getting the list of valid options"));
+		return 1;
+	}
+
+	if (argc == 3) {
+		sets = atoi (argv[2]);
+		if (sets <= 0) {
+			dialog_error (_("The number of sets must be a positive number"));
+			return 1;
+		}
+	}
+
+	if (argc >= 2) {
+		printf (_("Generating the missing Diffie-Hellman parameters. This can take several minutes...\n"));
+		if (! dh_cache_fill (sets)) {
+			dialog_error (_("There was an error while generating Diffie-Hellman parameters."));
+			return 1;
+		}
+	}
+
+	printf (_("Bits\tAvailable sets\n"));
+	for (i = 0; i < DH_CACHE_STANDARD_SIZES_NUMBER; i++)
+		printf ("%u\t%u\n", dh_cache_standard_sizes[i], dh_cache_count (dh_cache_standard_sizes[i]));
+
+	return 0;
+}
+
+int __ca_cli_callback_keypool_aux (void *pArg, int argc, char **argv, char **columnNames)
+{
+	printf ("%s\t\t%s\t%s\t%s\n", tls_key_type_name (atoi (argv[0])), argv[1], argv[2], argv[3]);
+
+	return 0;
+}
+
+int ca_cli_callback_keypool (int argc, char **argv)
+{
+	gint key_type;
+	gint key_bitlength;
+	gint size;
+	gchar *password = NULL;
+
+	if (argc == 1) {
+		printf (_("Key type\tBits\tSize\tAvailable\n"));
+		ca_file_foreach_key_pool_size (__ca_cli_callback_keypool_aux, NULL);
+		return 0;
+	}
+
+	if (argc != 4) {
+		dialog_error (_("Unrecognized option. Try 'help' for getting the list of valid options"));
+		return -1;
+	}
+
+	key_type = tls_key_type_from_name (argv[1]);
+	if (key_type < 0) {
+		dialog_error (_("The key type must be 'rsa', 'dsa', 'ecdsa' or 'ed25519'"));
+		return -1;
+	}
+
+	key_bitlength = atoi (argv[2]);
+	if (! tls_key_type_check_bitlength (key_type, key_bitlength)) {
+		dialog_error (_("Invalid bit-length for this key type"));
+		return -1;
+	}
+
+	size = atoi (argv[3]);
+	if (size < 0) {
+		dialog_error (_("The size must be a positive number"));
+		return -1;
+	}
+
+	if (! ca_file_set_key_pool_size (key_type, key_bitlength, size)) {
+		dialog_error (_("Error while saving the key pool size"));
+		return 1;
+	}
+
+	if (! size) {
+		printf (_("No pre-generated %s keys of %d bits will be kept.\n"), tls_key_type_name (key_type), key_bitlength);
+		return 0;
+	}
+
+	printf (_("%d pre-generated %s keys of %d bits will be kept for new CSRs. They are generated in background.\n"), 
+		size, tls_key_type_name (key_type), key_bitlength);
+
+	// The new keys are ciphered with the database password
+	if (ca_file_is_password_protected ()) {
+		password = pkey_manage_ask_password ();
+		if (! password)
+			return 0;
+	} else {
+		printf (_("The database is not password-protected, so the pre-generated keys are kept in clear.\n"));
+	}
+
+	key_pool_refill (password);
+	g_free (password);
+
+	return 0;
+}
+
+int ca_cli_callback_stats (int argc, char **argv)
+{
+	CaCliOutputFormat format = CA_CLI_OUTPUT_TEXT;
+	gboolean reset = FALSE;
+	StatsCounter counter;
+	gchar *values[CA_CLI_STATS_FIELD_NUMBER];
+	guint i, j;
+
+	for (i = 1; i < argc; i++) {
+		if (! strcmp (argv[i], "--reset")) {
+			reset = TRUE;
+		} else if (! __ca_cli_output_parse_format (argv[i], &format)) {
+			dialog_error (_("Unrecognized option. Valid options are --reset and --format=text|jsonl|csv"));
+			return -1;
+		}
+	}
+
+	if (format == CA_CLI_OUTPUT_TEXT) {
+		stats_dump (__ca_cli_out ());
+	} else {
+		__ca_cli_output_header (format, ca_cli_stats_fields, CA_CLI_STATS_FIELD_NUMBER);
+
+		for (i = 0; i < STATS_OPERATION_NUMBER; i++) {
+			stats_get (i, &counter);
+			values[0] = g_strdup (stats_operation_name (i));
+			values[1] = g_strdup_printf ("%"G_GUINT64_FORMAT, counter.count);
+			values[2] = g_strdup_printf ("%"G_GINT64_FORMAT, counter.total);
+			values[3] = g_strdup_printf ("%"G_GINT64_FORMAT, (counter.count ? counter.total / (gint64) counter.count : 0));
+			values[4] = g_strdup_printf ("%"G_GINT64_FORMAT, counter.max);
+			for (j = 0; j < STATS_HISTOGRAM_BUCKETS; j++)
+				values[5 + j] = g_strdup_printf ("%"G_GUINT64_FORMAT, counter.histogram[j]);
+
+			__ca_cli_output_row (format, ca_cli_stats_fields, CA_CLI_STATS_FIELD_NUMBER, (const gchar **) values);
+
+			for (j = 0; j < CA_CLI_STATS_FIELD_NUMBER; j++)
+				g_free (values[j]);
+		}
+	}
+
+	if (reset)
+		stats_reset ();
+
+	return 0;
+}
+
 int ca_cli_callback_changepassword (int argc, char **argv)
 {
 	gchar *current_pwd = NULL;
@@ -1187,6 +2920,12 @@ int ca_cli_callback_showcert (int argc, char **argv)
 	UInt160 *serial_number;
 
 	gint i;
+	CaCliOutputFormat format = CA_CLI_OUTPUT_TEXT;
+
+	if (argc > 2 && ! __ca_cli_output_parse_format (argv[2], &format)) {
+		dialog_error (_("Unrecognized option. Valid option is --format=text|jsonl|csv"));
+		return -1;
+	}
 
 	if (! ca_file_check_if_is_cert_id (cert_id)) {
 		dialog_error (_("The given certificate id. is not valid"));
@@ -1196,6 +2935,43 @@ int ca_cli_callback_showcert (int argc, char **argv)
 	certificate_pem = ca_file_get_public_pem_from_id(CA_FILE_ELEMENT_TYPE_CERT, cert_id);
 
 	cert = tls_parse_cert_pem (certificate_pem);
+
+	if (format != CA_CLI_OUTPUT_TEXT) {
+		const gchar *values[CA_CLI_CERT_FIELD_NUMBER];
+		gchar *activation = g_strdup_printf ("%ld", (long) cert->activation_time);
+		gchar *expiration = g_strdup_printf ("%ld", (long) cert->expiration_time);
+		GString *uses = g_string_new ("");
+
+		for (i = g_list_length(cert->uses) - 1; i >= 0; i--) {
+			g_string_append (uses, (gchar *) g_list_nth_data (cert->uses, i));
+			if (i)
+				g_string_append_c (uses, '\n');
+		}
+		aux = uint160_strdup_printf (&cert->serial_number);
+
+		values[0] = argv[1];
+		values[1] = aux;
+		values[2] = cert->dn;
+		values[3] = cert->subject_key_id;
+		values[4] = cert->i_dn;
+		values[5] = cert->issuer_key_id;
+		values[6] = activation;
+		values[7] = expiration;
+		values[8] = cert->sha1;
+		values[9] = cert->md5;
+		values[10] = cert->sha256;
+		values[11] = (uses->len ? uses->str : NULL);
+
+		__ca_cli_output_header (format, ca_cli_cert_fields, CA_CLI_CERT_FIELD_NUMBER);
+		__ca_cli_output_row (format, ca_cli_cert_fields, CA_CLI_CERT_FIELD_NUMBER, values);
+
+		g_free (aux);
+		g_free (activation);
+		g_free (expiration);
+		g_string_free (uses, TRUE);
+		tls_cert_free (cert);
+		return 0;
+	}
 	
 	printf (_("Certificate:\n"));
 
@@ -1254,6 +3030,12 @@ int ca_cli_callback_showcsr (int argc, char **argv)
 	gchar * csr_pem;
 	
 	TlsCsr * csr = NULL;
+	CaCliOutputFormat format = CA_CLI_OUTPUT_TEXT;
+
+	if (argc > 2 && ! __ca_cli_output_parse_format (argv[2], &format)) {
+		dialog_error (_("Unrecognized option. Valid option is --format=text|jsonl|csv"));
+		return -1;
+	}
 
 	if (! ca_file_check_if_is_csr_id (csr_id)) {
 		dialog_error (_("The given CSR id. is not valid"));
@@ -1264,6 +3046,20 @@ int ca_cli_callback_showcsr (int argc, char **argv)
 	csr_pem = ca_file_get_public_pem_from_id(CA_FILE_ELEMENT_TYPE_CSR, csr_id);
 
 	csr = tls_parse_csr_pem (csr_pem);
+
+	if (format != CA_CLI_OUTPUT_TEXT) {
+		const gchar *values[CA_CLI_CSR_FIELD_NUMBER];
+
+		values[0] = argv[1];
+		values[1] = csr->dn;
+		values[2] = csr->key_id;
+
+		__ca_cli_output_header (format, ca_cli_csr_fields, CA_CLI_CSR_FIELD_NUMBER);
+		__ca_cli_output_row (format, ca_cli_csr_fields, CA_CLI_CSR_FIELD_NUMBER, values);
+
+		tls_csr_free (csr);
+		return 0;
+	}
 	
 	printf (_("Certificate Signing Request:\n"));
 
@@ -1373,12 +3169,37 @@ int ca_cli_callback_showpolicy (int argc, char **argv)
 {
 	guint64 ca_id = atoll(argv[1]);
 	gint i;
+	CaCliOutputFormat format = CA_CLI_OUTPUT_TEXT;
 
+	if (argc > 2 && ! __ca_cli_output_parse_format (argv[2], &format)) {
+		dialog_error (_("Unrecognized option. Valid option is --format=text|jsonl|csv"));
+		return -1;
+	}
 
 	if (! ca_file_check_if_is_ca_id (ca_id)) {
 		dialog_error (_("The given CA id. is not valid"));
 		return -1;
 	}
+
+	if (format != CA_CLI_OUTPUT_TEXT) {
+		const gchar *values[CA_CLI_POLICY_FIELD_NUMBER];
+		gchar policy_id[8];
+
+		__ca_cli_output_header (format, ca_cli_policy_fields, CA_CLI_POLICY_FIELD_NUMBER);
+		for (i = 0; i < CA_CLI_CALLBACK_POLICY_NUMBER; i++) {
+			gchar *value = ca_file_policy_get (ca_id, CaCallbackPolicyName[i]);
+
+			g_snprintf (policy_id, sizeof (policy_id), "%d", i);
+			values[0] = argv[1];
+			values[1] = policy_id;
+			values[2] = CaCallbackPolicyName[i];
+			values[3] = value;
+
+			__ca_cli_output_row (format, ca_cli_policy_fields, CA_CLI_POLICY_FIELD_NUMBER, values);
+			g_free (value);
+		}
+		return 0;
+	}
 	
 	printf (_("Showing policies of the following certificate:\n"));
 	ca_cli_callback_showcert (argc, argv);
@@ -1443,12 +3264,143 @@ int ca_cli_callback_setpolicy (int argc, char **argv)
 	return 0;
 }
 
+int __ca_cli_callback_showprofiles_aux (void *pArg, int argc, char **argv, char **columnNames)
+{
+	CaCliOutputFormat format = *((CaCliOutputFormat *) pArg);
+	const gchar *values[CA_CLI_PROFILE_FIELD_NUMBER];
+	gchar *uses;
+	gint i;
+
+	if (format == CA_CLI_OUTPUT_TEXT) {
+		uses = __ca_cli_callback_uses_to_string (strtoul (argv[CA_FILE_PROFILE_COLUMN_USES], NULL, 10), ",");
+		printf ("%s\t%s\t%s\t%s\n", argv[CA_FILE_PROFILE_COLUMN_NAME], argv[CA_FILE_PROFILE_COLUMN_MONTHS_TO_EXPIRE], 
+			uses, (argv[CA_FILE_PROFILE_COLUMN_CRL_DISTRIBUTION_POINT] ? argv[CA_FILE_PROFILE_COLUMN_CRL_DISTRIBUTION_POINT] : ""));
+		g_free (uses);
+		return 0;
+	}
+
+	uses = __ca_cli_callback_uses_to_string (strtoul (argv[CA_FILE_PROFILE_COLUMN_USES], NULL, 10), "\n");
+	for (i = 0; i < CA_CLI_PROFILE_FIELD_NUMBER; i++)
+		values[i] = argv[i];
+	values[CA_FILE_PROFILE_COLUMN_USES] = uses;
+
+	__ca_cli_output_row (format, ca_cli_profile_fields, CA_CLI_PROFILE_FIELD_NUMBER, values);
+	g_free (uses);
+
+	return 0;
+}
+
+int ca_cli_callback_showprofiles (int argc, char **argv)
+{
+	guint64 ca_id = atoll(argv[1]);
+	CaCliOutputFormat format = CA_CLI_OUTPUT_TEXT;
+
+	if (argc > 2 && ! __ca_cli_output_parse_format (argv[2], &format)) {
+		dialog_error (_("Unrecognized option. Valid option is --format=text|jsonl|csv"));
+		return -1;
+	}
+
+	if (! ca_file_check_if_is_ca_id (ca_id)) {
+		dialog_error (_("The given CA id. is not valid"));
+		return -1;
+	}
+
+	if (format == CA_CLI_OUTPUT_TEXT)
+		printf (_("Name\tMonths\tUses and purposes\tCRL distribution point\n"));
+	else
+		__ca_cli_output_header (format, ca_cli_profile_fields, CA_CLI_PROFILE_FIELD_NUMBER);
+
+	return (ca_file_foreach_profile (__ca_cli_callback_showprofiles_aux, ca_id, &format) ? 0 : 1);
+}
+
+int ca_cli_callback_setprofile (int argc, char **argv)
+{
+	guint64 ca_id = atoll(argv[1]);
+	const gchar *name = argv[2];
+	const CaPolicy *policy;
+	gint months_to_expire;
+	guint uses;
+	const gchar *crl_distribution_point;
+	gchar *uses_str;
+	gchar *message;
+	gint i;
+
+	if (! ca_file_check_if_is_ca_id (ca_id)) {
+		dialog_error (_("The given CA id. is not valid"));
+		return -1;
+	}
+
+	if (argc == 4 && ! strcmp (argv[3], "--delete")) {
+		if (! ca_file_profile_delete (ca_id, name)) {
+			dialog_error (_("The given CA has no issuance profile with that name"));
+			return 1;
+		}
+		printf (_("Issuance profile '%s' deleted.\n"), name);
+		return 0;
+	}
+
+	/* By default, the profile takes everything the CA policy allows */
+	policy = ca_file_policy_get_all (ca_id);
+	months_to_expire = policy->months_to_expire;
+	uses = __ca_cli_callback_policy_uses (policy);
+	crl_distribution_point = policy->crl_distribution_point;
+
+	for (i = 3; i < argc; i++) {
+		if (g_str_has_prefix (argv[i], "--months=")) {
+			months_to_expire = atoi (argv[i] + strlen ("--months="));
+		} else if (g_str_has_prefix (argv[i], "--uses=")) {
+			if (! __ca_cli_callback_uses_parse (argv[i] + strlen ("--uses="), &uses)) {
+				uses_str = __ca_cli_callback_uses_to_string (~0, ", ");
+				message = g_strdup_printf (_("Unrecognized use or purpose. Valid ones are: %s"), uses_str);
+				dialog_error (message);
+				g_free (message);
+				g_free (uses_str);
+				return -1;
+			}
+		} else if (g_str_has_prefix (argv[i], "--crl-distribution-point=")) {
+			crl_distribution_point = argv[i] + strlen ("--crl-distribution-point=");
+		} else {
+			dialog_error (_("Unrecognized option. Try 'help' for getting the list of valid options"));
+			return -1;
+		}
+	}
+
+	if (months_to_expire <= 0 || months_to_expire > policy->months_to_expire) {
+		message = g_strdup_printf (_("The number of months must be between 1 and %d, according to the CA policy"), 
+					   policy->months_to_expire);
+		dialog_error (message);
+		g_free (message);
+		return -1;
+	}
+
+	if (uses & ~__ca_cli_callback_policy_uses (policy)) {
+		uses_str = __ca_cli_callback_uses_to_string (uses & ~__ca_cli_callback_policy_uses (policy), ", ");
+		message = g_strdup_printf (_("The following uses or purposes are disabled by the CA policy: %s"), uses_str);
+		dialog_error (message);
+		g_free (message);
+		g_free (uses_str);
+		return -1;
+	}
+
+	if (! ca_file_profile_set (ca_id, name, months_to_expire, uses, crl_distribution_point)) {
+		dialog_error (_("Error while saving the issuance profile"));
+		return 1;
+	}
+
+	uses_str = __ca_cli_callback_uses_to_string (uses, ", ");
+	printf (_("Issuance profile '%s' saved: %d months, %s.\n"), name, months_to_expire, uses_str);
+	g_free (uses_str);
+
+	return 0;
+}
+
 int ca_cli_callback_showpreferences (int argc, char **argv)
 {
 	printf (_("gnoMint-cli current preferences:\n"));
 
 	printf (_("Id.\tName\t\t\tValue\n"));
 	printf (_("0\tGnome keyring support\t%d\n"), preferences_get_gnome_keyring_export());
+	printf (_("1\tSlow query threshold\t%d\n"), preferences_get_slow_query_threshold());
 	
 	return 0;
 }
@@ -1459,7 +3411,7 @@ int ca_cli_callback_setpreference (int argc, char **argv)
 	gint value = atoi (argv[2]);
 	gchar *message = NULL;
 
-	if (preference_id != 0) {
+	if (preference_id != 0 && preference_id != 1) {
 		dialog_error (_("The given preference id is not valid"));
 		return -1;
 	}
@@ -1468,6 +3420,13 @@ int ca_cli_callback_setpreference (int argc, char **argv)
 	case 0:
 		message = g_strdup_printf (_("You are about to assign to the preference 'Gnome keyring support' the new value '%d'."), value);
 		break;
+	case 1:
+		if (value < 0) {
+			dialog_error (_("The slow query threshold must be a number of milliseconds (0 = disabled)"));
+			return -1;
+		}
+		message = g_strdup_printf (_("You are about to assign to the preference 'Slow query threshold' the new value '%d'."), value);
+		break;
 	}
 
 	if (dialog_ask_for_confirmation (message, _("Are you sure? Yes/[No] : "), FALSE)) {
@@ -1475,6 +3434,10 @@ int ca_cli_callback_setpreference (int argc, char **argv)
 		case 0:
 			preferences_set_gnome_keyring_export (value);
 			break;
+		case 1:
+			preferences_set_slow_query_threshold (value);
+			ca_file_set_slow_query_threshold (value);
+			break;
 		}
 
 	} else {
@@ -20,10 +20,18 @@
 int ca_cli_callback_newdb (int argc, char **argv);
 int ca_cli_callback_opendb (int argc, char **argv);
 int ca_cli_callback_savedbas (int argc, char **argv);
+int ca_cli_callback_attachdb (int argc, char **argv);
+int ca_cli_callback_detachdb (int argc, char **argv);
+int ca_cli_callback_listdb (int argc, char **argv);
+int ca_cli_callback_foreachdb (int argc, char **argv);
 int ca_cli_callback_status (int argc, char **argv);
 int ca_cli_callback_listcert (int argc, char **argv);
 int ca_cli_callback_listcsr (int argc, char **argv);
+int ca_cli_callback_search (int argc, char **argv);
+int ca_cli_callback_expiring (int argc, char **argv);
+int ca_cli_callback_archive (int argc, char **argv);
 int ca_cli_callback_addcsr (int argc, char **argv);
+int ca_cli_callback_batchcsr (int argc, char **argv);
 int ca_cli_callback_addca (int argc, char **argv);
 int ca_cli_callback_extractcertpkey (int argc, char **argv);
 int ca_cli_callback_extractcsrpkey (int argc, char **argv);
@@ -31,7 +39,11 @@ int ca_cli_callback_revoke (int argc, char **argv);
 int ca_cli_callback_sign (int argc, char **argv);
 int ca_cli_callback_delete (int argc, char **argv);
 int ca_cli_callback_crlgen (int argc, char **argv);
+int ca_cli_callback_crlpublish (int argc, char **argv);
 int ca_cli_callback_dhgen (int argc, char **argv);
+int ca_cli_callback_dhcache (int argc, char **argv);
+int ca_cli_callback_keypool (int argc, char **argv);
+int ca_cli_callback_stats (int argc, char **argv);
 int ca_cli_callback_changepassword (int argc, char **argv);
 int ca_cli_callback_importfile (int argc, char **argv);
 int ca_cli_callback_importdir (int argc, char **argv);
@@ -39,6 +51,8 @@ int ca_cli_callback_showcert (int argc, char **argv);
 int ca_cli_callback_showcsr (int argc, char **argv);
 int ca_cli_callback_showpolicy (int argc, char **argv);
 int ca_cli_callback_setpolicy (int argc, char **argv);
+int ca_cli_callback_showprofiles (int argc, char **argv);
+int ca_cli_callback_setprofile (int argc, char **argv);
 int ca_cli_callback_showpreferences (int argc, char **argv);
 int ca_cli_callback_setpreference (int argc, char **argv);
 int ca_cli_callback_about (int argc, char **argv);
@@ -24,6 +24,7 @@
 #include <glib-object.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <readline/readline.h>
 #include <readline/history.h>
 #include <unistd.h>
@@ -37,48 +38,92 @@ CaCommand ca_commands[] = {
 	{"newdb", 1, 1, N_("newdb <filename>"), N_("Close current file and create a new database with given filename"), ca_cli_callback_newdb}, // 0
 	{"opendb", 1, 1, N_("opendb <filename>"), N_("Close current file and open the file with given filename"), ca_cli_callback_opendb}, // 1
 	{"savedbas", 1, 1, N_("savedbas <filename>"), N_("Save the current file with a different filename"), ca_cli_callback_savedbas}, // 2
-	{"status", 0, 0, "status", N_("Get current status (opened file, no. of certificates, etc...)"), ca_cli_callback_status}, // 3
-	{"listcert", 0, 1, "listcert [--see-revoked]", N_("List the certificates in database. With option --see-revoked, "
-							 "lists also the revoked ones"), ca_cli_callback_listcert}, // 4
-	{"listcsr", 0, 0, "listcsr", N_("List the CSRs in database"), ca_cli_callback_listcsr}, // 5
-	{"addcsr", 0, 1, N_("addcsr [ca-id-for-inherit-fields]"), N_("Start a new CSR creation process"), ca_cli_callback_addcsr}, // 6
-	{"addca", 0, 0, "addca", N_("Start a new self-signed CA creation process"), ca_cli_callback_addca}, //7
+	{"attachdb", 1, 1, N_("attachdb <filename>"), N_("Open another database, besides the current one, for running commands over all of them with 'foreachdb'"), 
+	 ca_cli_callback_attachdb}, // 3
+	{"detachdb", 1, 1, N_("detachdb <filename>"), N_("Close the given attached database"), ca_cli_callback_detachdb}, // 4
+	{"listdb", 0, 0, "listdb", N_("List the opened database and the attached ones"), ca_cli_callback_listdb}, // 5
+	{"foreachdb", 1, 6, N_("foreachdb status|expiring|crlgen [<arguments>]"), 
+	 N_("Run the given command over the opened database and all the attached ones, in parallel. Results are shown "
+	    "database after database. In the arguments, {db} is replaced with the name of each database"), ca_cli_callback_foreachdb}, // 6
+	{"status", 0, 0, "status", N_("Get current status (opened file, no. of certificates, etc...)"), ca_cli_callback_status}, // 7
+	{"listcert", 0, 9, N_("listcert [--see-revoked|--revoked] [--ca=<ca-id>] [--expiring-before=<date>] [--expiring-after=<date>] "
+			  "[--subject=<prefix>] [--after=<cert-id>] [--limit=<n>] [--format=text|jsonl|csv]"), 
+	 N_("List the certificates in database. With option --see-revoked, lists also the revoked ones. "
+	    "The rest of options filter the listing, sorted by id, and allow getting it page by page"), ca_cli_callback_listcert}, // 8
+	{"listcsr", 0, 1, "listcsr [--format=text|jsonl|csv]", N_("List the CSRs in database"), ca_cli_callback_listcsr}, // 9
+	{"search", 1, 4, N_("search <text> [--see-revoked] [--limit=<n>] [--format=text|jsonl|csv]"), 
+	 N_("Look for certificates whose subject, DN, issuer DN, serial number or fingerprint contain words "
+	    "starting with the given text. Best matches are shown first"), ca_cli_callback_search}, // 10
+	{"expiring", 0, 5, N_("expiring [--days=<n>] [--ca=<ca-id>] [--include-expired] [--see-revoked] [--format=text|jsonl|csv]"), 
+	 N_("List the certificates expiring in the next <n> days (30 by default), grouped by CA. "
+	    "With --include-expired, lists also the already expired ones"), ca_cli_callback_expiring}, // 11
+	{"archive", 0, 2, N_("archive [--grace=<days>] [--auto=<days>|--auto=off]"), 
+	 N_("Move the expired certificates (and the revoked ones already listed as expired in a CRL) to the archive file. "
+	    "With --grace, only those expired more than <days> days ago. With --auto, they are archived each time "
+	    "the database is opened"), ca_cli_callback_archive}, // 12
+	{"addcsr", 0, 1, N_("addcsr [ca-id-for-inherit-fields]"), N_("Start a new CSR creation process"), ca_cli_callback_addcsr}, // 13
+	{"batchcsr", 1, 6, N_("batchcsr <filename> [--format=csv|json] [--ca=<ca-id>] [--key=rsa|dsa|ecdsa|ed25519] [--bits=<n>] [--threads=<n>]"), 
+	 N_("Create a CSR for each subject (C, ST, L, O, OU, CN, emailAddress) in the given CSV or JSON file, "
+	    "generating the keys in parallel"), ca_cli_callback_batchcsr}, // 14
+	{"addca", 0, 0, "addca", N_("Start a new self-signed CA creation process"), ca_cli_callback_addca}, // 15
 	{"extractcertpkey", 2, 2, N_("extractcertpkey <cert-id> <filename>"), N_("Extract the private key of the certificate with the given " 
 									       "internal id and saves it into the given file"),  
-	 ca_cli_callback_extractcertpkey}, // 8
+	 ca_cli_callback_extractcertpkey}, // 16
 	{"extractcsrpkey", 2, 2, N_("extractcsrpkey <csr-id> <filename>"), N_("Extract the private key of the CSR with the given " 
 									    "internal id and saves it into the given file"), 
-	 ca_cli_callback_extractcsrpkey}, // 9
-	{"revoke", 1, 1, N_("revoke <cert-id>"), N_("Revoke the certificate with the given internal ID"), ca_cli_callback_revoke}, // 10
-	{"sign", 2, 2, N_("sign <csr-id> <ca-cert-id>"), N_("Generate a certificate signing the given CSR with the given CA"), ca_cli_callback_sign}, // 11
-	{"delete", 1, 1, N_("delete <csr-id>"), N_("Delete the given CSR from the database"), ca_cli_callback_delete}, // 12
-	{"crlgen", 2, 2, N_("crlgen <ca-id> <filename>"), N_("Generate a new CRL for the given CA, saving it into the file <filename>"), ca_cli_callback_crlgen}, // 13
-	{"dhgen", 2, 2, N_("dhgen <prime-bitlength> <filename>"), N_("Generate a new DH-parameter set, saving it into the file <filename>"), ca_cli_callback_dhgen}, // 14
-	{"changepassword", 0, 0, "changepassword", N_("Change password for the current database"), ca_cli_callback_changepassword}, // 15
-	{"importfile", 1, 1, N_("importfile <filename>"), N_("Import the file with the given name <filename>"), ca_cli_callback_importfile}, // 16
-	{"importdir", 1, 1, N_("importdir <dirname>"), N_("Import the given directory, as a OpenSSL-CA directory"), ca_cli_callback_importdir}, // 17
-	{"showcert", 1, 1, N_("showcert <cert-id>"), N_("Show properties of the given certificate"), ca_cli_callback_showcert}, // 18
-	{"showcsr", 1, 1, N_("showcsr <csr-id>"), N_("Show properties of the given CSR"), ca_cli_callback_showcsr}, // 19
-	{"showpolicy", 1, 1, N_("showpolicy <ca-id>"), N_("Show CA policy"), ca_cli_callback_showpolicy}, // 20
-	{"setpolicy", 3, 3, N_("setpolicy <ca-id> <policy-id> <value>"), N_("Change the given CA policy"), ca_cli_callback_setpolicy}, // 21
-	{"showpreferences", 0, 0, "showpreferences", N_("Show program preferences"), ca_cli_callback_showpreferences}, // 22
-	{"setpreference", 2, 2, N_("setpreference <preference-id> <value>"), N_("Set the given program preference"), ca_cli_callback_setpreference}, // 23
-	{"about", 0, 0, "about", N_("Show about message"), ca_cli_callback_about}, // 24
-	{"warranty", 0, 0, "warranty", N_("Show warranty information"), ca_cli_callback_warranty}, // 25
-	{"distribution", 0, 0, "distribution", N_("Show distribution information"), ca_cli_callback_distribution}, // 26
-	{"version", 0, 0, "version", N_("Show version information"), ca_cli_callback_version}, // 27
-	{"help", 0, 0, "help", N_("Show (this) help message"),  ca_cli_callback_help}, // 28
-	{"quit", 0, 0, "quit", N_("Close database and exit program"), ca_cli_callback_exit}, // 29
-	{"exit", 0, 0, "exit", N_("Close database and exit program"), ca_cli_callback_exit}, // 30
-	{"bye", 0, 0, "bye", N_("Close database and exit program"), ca_cli_callback_exit} // 31
+	 ca_cli_callback_extractcsrpkey}, // 17
+	{"revoke", 1, 1, N_("revoke <cert-id>"), N_("Revoke the certificate with the given internal ID"), ca_cli_callback_revoke}, // 18
+	{"sign", 2, 3, N_("sign <csr-id> <ca-cert-id> [--profile=<name>]"), N_("Generate a certificate signing the given CSR with the given CA, "
+									   "optionally with one of its issuance profiles"), ca_cli_callback_sign}, // 19
+	{"delete", 1, 1, N_("delete <csr-id>"), N_("Delete the given CSR from the database"), ca_cli_callback_delete}, // 20
+	{"crlgen", 2, 2, N_("crlgen <ca-id> <filename>"), N_("Generate a new CRL for the given CA, saving it into the file <filename>"), ca_cli_callback_crlgen}, // 21
+	{"crlpublish", 1, 4, N_("crlpublish <filename> [--margin=<hours>] [--threads=<n>] [--every=<minutes>]"), 
+	 N_("Save the CRL of every CA into <filename>, where {ca} is replaced with the CA id. A new CRL is only signed if "
+	    "something changed or the last one expires within the margin (by default, half of its validity)"), 
+	 ca_cli_callback_crlpublish}, // 22
+	{"dhgen", 2, 3, N_("dhgen <prime-bitlength> <filename> [--rfc7919]"), N_("Generate a new DH-parameter set, saving it into the file <filename>. "
+										"With --rfc7919, the well-known group of that size is saved instead"), ca_cli_callback_dhgen}, // 23
+	{"dhcache", 0, 2, N_("dhcache [fill [<sets>]]"), N_("Show the pre-generated DH-parameter sets, or generate the missing ones "
+							    "with 'fill', until there are <sets> of each size (1 by default)"), 
+	 ca_cli_callback_dhcache}, // 24
+	{"keypool", 0, 3, N_("keypool [rsa|dsa|ecdsa|ed25519 <bitlength> <size>]"), N_("Show or set how many pre-generated key pairs of the given type "
+								   "are kept for new CSRs (size 0 = none)"), ca_cli_callback_keypool}, // 25
+	{"stats", 0, 2, N_("stats [--reset] [--format=text|jsonl|csv]"), 
+	 N_("Show how many times each operation was done and how long it took since the program started (or the last --reset)"), 
+	 ca_cli_callback_stats}, // 26
+	{"changepassword", 0, 0, "changepassword", N_("Change password for the current database"), ca_cli_callback_changepassword}, // 27
+	{"importfile", 1, 1, N_("importfile <filename>"), N_("Import the file with the given name <filename>"), ca_cli_callback_importfile}, // 28
+	{"importdir", 1, 1, N_("importdir <dirname>"), N_("Import the given directory, as a OpenSSL-CA directory"), ca_cli_callback_importdir}, // 29
+	{"showcert", 1, 2, N_("showcert <cert-id> [--format=text|jsonl|csv]"), N_("Show properties of the given certificate"), ca_cli_callback_showcert}, // 30
+	{"showcsr", 1, 2, N_("showcsr <csr-id> [--format=text|jsonl|csv]"), N_("Show properties of the given CSR"), ca_cli_callback_showcsr}, // 31
+	{"showpolicy", 1, 2, N_("showpolicy <ca-id> [--format=text|jsonl|csv]"), N_("Show CA policy"), ca_cli_callback_showpolicy}, // 32
+	{"setpolicy", 3, 3, N_("setpolicy <ca-id> <policy-id> <value>"), N_("Change the given CA policy"), ca_cli_callback_setpolicy}, // 33
+	{"showprofiles", 1, 2, N_("showprofiles <ca-id> [--format=text|jsonl|csv]"), N_("Show the issuance profiles of the given CA"), 
+	 ca_cli_callback_showprofiles}, // 34
+	{"setprofile", 2, 5, N_("setprofile <ca-id> <name> [--months=<n>] [--uses=<use>,...] [--crl-distribution-point=<uri>] | --delete"), 
+	 N_("Create or replace (or delete) an issuance profile of the given CA. By default it takes everything allowed by the CA policy"), 
+	 ca_cli_callback_setprofile}, // 35
+	{"showpreferences", 0, 0, "showpreferences", N_("Show program preferences"), ca_cli_callback_showpreferences}, // 36
+	{"setpreference", 2, 2, N_("setpreference <preference-id> <value>"), N_("Set the given program preference"), ca_cli_callback_setpreference}, // 37
+	{"about", 0, 0, "about", N_("Show about message"), ca_cli_callback_about}, // 38
+	{"warranty", 0, 0, "warranty", N_("Show warranty information"), ca_cli_callback_warranty}, // 39
+	{"distribution", 0, 0, "distribution", N_("Show distribution information"), ca_cli_callback_distribution}, // 40
+	{"version", 0, 0, "version", N_("Show version information"), ca_cli_callback_version}, // 41
+	{"help", 0, 0, "help", N_("Show (this) help message"),  ca_cli_callback_help}, // 42
+	{"quit", 0, 0, "quit", N_("Close database and exit program"), ca_cli_callback_exit}, // 43
+	{"exit", 0, 0, "exit", N_("Close database and exit program"), ca_cli_callback_exit}, // 44
+	{"bye", 0, 0, "bye", N_("Close database and exit program"), ca_cli_callback_exit} // 45
 };
-#define CA_COMMAND_NUMBER 32
+#define CA_COMMAND_NUMBER 46
 
 
 
 
 GHashTable *ca_command_table = NULL;
 
+// Databases attached besides the opened one (CaFile *), in the order they were attached
+GList *ca_attached_dbs = NULL;
+
 
 gboolean ca_refresh_model (void)
 {
@@ -103,6 +148,37 @@ gboolean ca_open (gchar *filename, gboolean create)
 	return result;
 }
 
+gboolean ca_attach (const gchar *filename)
+{
+        CaFile *ca_file;
+        GList *list;
+
+        for (list = ca_attached_dbs; list; list = list->next) {
+                if (! strcmp (ca_file_get_filename (list->data), filename)) {
+                        fprintf (stderr, _("Database %s is already attached\n"), filename);
+                        return FALSE;
+                }
+        }
+
+        if (ca_file_get_current () && ! strcmp (ca_file_get_filename (ca_file_get_current ()), filename)) {
+                fprintf (stderr, _("Database %s is already opened\n"), filename);
+                return FALSE;
+        }
+
+        fprintf (stderr, _("Attaching database %s..."), filename);
+        ca_file = ca_file_handle_open (filename, FALSE);
+
+        if (! ca_file) {
+                fprintf (stderr, _(" Error.\n"));
+                return FALSE;
+        }
+
+        fprintf (stderr, _(" OK.\n"));
+        ca_attached_dbs = g_list_append (ca_attached_dbs, ca_file);
+
+        return TRUE;
+}
+
 
 
 
@@ -116,14 +192,146 @@ void __ca_add_commands (GHashTable *table)
 
 }
 
-void ca_command_line()
+static void __ca_init_command_table (void)
 {
-        const gchar *prompt = "gnoMint > ";
-        gchar *line = NULL;
+	if (ca_command_table)
+		return;
 
 	ca_command_table = g_hash_table_new (g_str_hash, g_str_equal);
 
 	__ca_add_commands (ca_command_table);
+}
+
+static gchar ** __ca_parse_command_line (const gchar *line, gint *argc_out)
+{
+        gint i,j,k;
+        gint argc = 0;
+        gchar *oldaux = NULL;
+        gchar **aux = NULL;
+        GSList *arglist = NULL;
+        gchar **argv = NULL;
+
+        // Parse line
+        aux = g_strsplit (line, "\"", -1 );
+
+	// Detect \" combinations, and discard them as a quote
+        for (i = 0; i < (g_strv_length(aux) - 1); i++) {
+                if (aux[i][strlen(aux[i]) - 1] == '\\') {
+                        oldaux = aux[i];
+			aux[i][strlen(aux[i]) - 1] = '\0';
+                        aux[i] = g_strdup_printf ("%s\"%s", aux[i], aux[i+1]);
+                        g_free (oldaux);
+                        for (j = i+1; j < g_strv_length(aux); j++) {
+                                aux[j] = aux[j+1];
+                        }
+                }
+        }
+
+        if (g_strv_length(aux) % 2 == 0) {
+                // Unpaired quotes
+                fprintf (stderr, _("Unpaired quotes\n"));
+        } else {
+		// For each tuple not in quotes, detect spaces
+                gchar **aux2[g_strv_length(aux)];
+                for (i=0; i < g_strv_length(aux); i++) {
+			// Only in not-quoted terms (that is: even terms)
+                        if (i % 2 == 0) {
+                                aux2[i] = g_strsplit (aux[i], " ", -1);
+
+				if (*aux2[i]) {
+
+					// Detect "\ " combinations, and discard them as a quote
+					for (j = 0; j < (g_strv_length(aux2[i]) - 1); j++) {
+						if (aux2[i][j] && aux2[i][j][strlen(aux2[i][j]) - 1] == '\\') {
+							oldaux = aux2[i][j];
+							aux2[i][j][strlen(aux2[i][j]) - 1] = '\0';
+							aux2[i][j] = g_strdup_printf ("%s %s", aux2[i][j], aux2[i][j+1]);
+							g_free (oldaux);
+							for (k = j+1; k < g_strv_length(aux2[i]); k++) {
+								aux2[i][k] = aux2[i][k+1];
+							}
+						}
+						
+					}
+					
+					// If this is a post-quote term, and begins with an empty element
+					if (aux2[i][0][0]=='\0' && i > 0) {
+						argc++;
+						arglist = g_slist_append (arglist, g_strdup (aux[i-1]));
+					}
+					for (j=0; j < g_strv_length(aux2[i]); j++) {
+						if (j < g_strv_length(aux2[i]) - 1 || i == g_strv_length(aux) - 1) {
+							if (strlen(aux2[i][j])) {
+								argc++;		
+								if (j==0 && i > 0) {
+									arglist = g_slist_append (arglist, g_strdup_printf ("%s%s",aux[i-1],aux2[i][j]));
+								} else {
+									arglist = g_slist_append (arglist, g_strdup (aux2[i][j]));
+								}
+							
+							}											
+						}
+					}
+					
+				} else {
+					if (i > 0) {
+						argc++;
+						arglist = g_slist_append (arglist, g_strdup (aux[i-1]));
+					}
+				}
+                        } else {
+				if (*aux2[i-1]) {
+					oldaux = aux[i];
+					aux[i] = g_strdup_printf("%s%s", aux2[i-1][g_strv_length(aux2[i-1]) - 1], aux[i]);
+					g_free (oldaux);
+				}
+			}
+                }
+		for (i=0; i < g_strv_length(aux); i=i+2)
+			g_strfreev (aux2[i]);
+        }
+        g_strfreev (aux);
+
+        // fprintf (stderr, "Argc: %d\n", argc);
+
+	argv = g_new (gchar*, argc + 1);
+	argv[argc] = NULL;
+	for (i=0; i < argc; i++) {
+		argv[i] = (gchar *) g_slist_nth_data (arglist,  i);
+		// fprintf (stderr, "%d: «%s»\n", i, (gchar *) g_slist_nth_data (arglist,  i));
+	}
+	g_slist_free (arglist);
+
+        *argc_out = argc;
+        return argv;
+}
+
+static gint __ca_execute_command (gint argc, gchar **argv)
+{
+        CaCommand *command_entry = ((CaCommand *) g_hash_table_lookup (ca_command_table, argv[0]));
+
+        if (!command_entry) {
+                fprintf (stderr, _("Invalid command. Try 'help' for getting a list of recognized commands.\n"));
+                return -1;
+        } 
+
+        // Check for parameter number
+        if (argc - 1 < command_entry->mandatory_params || argc - 1 > command_entry->optional_params) {
+                fprintf (stderr, _("Incorrect number of parameters.\n"));
+                fprintf (stderr, _("Syntax: %s\n"), _(command_entry->syntax));
+                return -1;
+        } 
+
+        // Call it
+        return command_entry->callback (argc, argv);
+}
+
+void ca_command_line()
+{
+        const gchar *prompt = "gnoMint > ";
+        gchar *line = NULL;
+
+	__ca_init_command_table ();
 
         printf (_("\n\n%s version %s\n%s\n\n"), PACKAGE_NAME, PACKAGE_VERSION, PACKAGE_COPYRIGHT); 
         printf (_("This program comes with ABSOLUTELY NO WARRANTY;\nfor details type 'warranty'.\n"));
@@ -142,127 +350,22 @@ void ca_command_line()
 
                 // Check for empty commands
                 if (strlen (line) != 0) {
-                        gint i,j,k;
+                        gint i;
                         gint argc = 0;
-                        gchar *oldaux = NULL;
-                        gchar **aux = NULL;
-			GSList *arglist = NULL;
                         gchar **argv = NULL;
 
                         add_history (line);
 
-                        // Parse line
-                        aux = g_strsplit (line, "\"", -1 );
-
-			// Detect \" combinations, and discard them as a quote
-                        for (i = 0; i < (g_strv_length(aux) - 1); i++) {
-                                if (aux[i][strlen(aux[i]) - 1] == '\\') {
-                                        oldaux = aux[i];
-					aux[i][strlen(aux[i]) - 1] = '\0';
-                                        aux[i] = g_strdup_printf ("%s\"%s", aux[i], aux[i+1]);
-                                        g_free (oldaux);
-                                        for (j = i+1; j < g_strv_length(aux); j++) {
-                                                aux[j] = aux[j+1];
-                                        }
-                                }
-                        }
-
-                        if (g_strv_length(aux) % 2 == 0) {
-                                // Unpaired quotes
-                                fprintf (stderr, _("Unpaired quotes\n"));
-                        } else {
-				// For each tuple not in quotes, detect spaces
-                                gchar **aux2[g_strv_length(aux)];
-                                for (i=0; i < g_strv_length(aux); i++) {
-					// Only in not-quoted terms (that is: even terms)
-                                        if (i % 2 == 0) {
-                                                aux2[i] = g_strsplit (aux[i], " ", -1);
-
-						if (*aux2[i]) {
-
-							// Detect "\ " combinations, and discard them as a quote
-							for (j = 0; j < (g_strv_length(aux2[i]) - 1); j++) {
-								if (aux2[i][j] && aux2[i][j][strlen(aux2[i][j]) - 1] == '\\') {
-									oldaux = aux2[i][j];
-									aux2[i][j][strlen(aux2[i][j]) - 1] = '\0';
-									aux2[i][j] = g_strdup_printf ("%s %s", aux2[i][j], aux2[i][j+1]);
-									g_free (oldaux);
-									for (k = j+1; k < g_strv_length(aux2[i]); k++) {
-										aux2[i][k] = aux2[i][k+1];
-									}
-								}
-								
-							}
-							
-							// If this is a post-quote term, and begins with an empty element
-							if (aux2[i][0][0]=='\0' && i > 0) {
-								argc++;
-								arglist = g_slist_append (arglist, g_strdup (aux[i-1]));
-							}
-							for (j=0; j < g_strv_length(aux2[i]); j++) {
-								if (j < g_strv_length(aux2[i]) - 1 || i == g_strv_length(aux) - 1) {
-									if (strlen(aux2[i][j])) {
-										argc++;		
-										if (j==0 && i > 0) {
-											arglist = g_slist_append (arglist, g_strdup_printf ("%s%s",aux[i-1],aux2[i][j]));
-										} else {
-											arglist = g_slist_append (arglist, g_strdup (aux2[i][j]));
-										}
-									
-									}											
-								}
-							}
-							
-						} else {
-							if (i > 0) {
-								argc++;
-								arglist = g_slist_append (arglist, g_strdup (aux[i-1]));
-							}
-						}
-                                        } else {
-						if (*aux2[i-1]) {
-							oldaux = aux[i];
-							aux[i] = g_strdup_printf("%s%s", aux2[i-1][g_strv_length(aux2[i-1]) - 1], aux[i]);
-							g_free (oldaux);
-						}
-					}
-                                }
-				for (i=0; i < g_strv_length(aux); i=i+2)
-					g_strfreev (aux2[i]);
-                        }
-                        g_strfreev (aux);
-
-                        // fprintf (stderr, "Argc: %d\n", argc);
-
-			argv = g_new (gchar*, argc + 1);
-			argv[argc] = NULL;
-			for (i=0; i < argc; i++) {
-				argv[i] = (gchar *) g_slist_nth_data (arglist,  i);
-				// fprintf (stderr, "%d: «%s»\n", i, (gchar *) g_slist_nth_data (arglist,  i));
-			}
-			g_slist_free (arglist);
+                        argv = __ca_parse_command_line (line, &argc);
 
                         // If the given command is defined
-                        if (argc > 0) {
-                                CaCommand *command_entry = ((CaCommand *) g_hash_table_lookup (ca_command_table, argv[0]));
-
-                                if (!command_entry) {
-                                        fprintf (stderr, _("Invalid command. Try 'help' for getting a list of recognized commands.\n"));
-                                } else {
-					// Check for parameter number
-					if (argc - 1 < command_entry->mandatory_params || argc - 1 > command_entry->optional_params) {
-						fprintf (stderr, _("Incorrect number of parameters.\n"));
-						fprintf (stderr, _("Syntax: %s\n"), _(command_entry->syntax));
-					} else {
-						// Call it
-						command_entry->callback (argc, argv);
-					}
-                                }
-                        }                
+                        if (argc > 0)
+                                __ca_execute_command (argc, argv);
 
                         if (argv) {
 				for (i=0; i < argc; i++)
 					g_free (argv[i]);
+				g_free (argv);
 			}
 
                 }
@@ -272,3 +375,82 @@ void ca_command_line()
         } 
         
 }
+
+gint ca_command_batch (const gchar *script_filename, gboolean stop_on_error)
+{
+        GIOChannel *channel = NULL;
+        GError *error = NULL;
+        gchar *line = NULL;
+        guint line_number = 0;
+        guint failed = 0;
+        gboolean finished = FALSE;
+
+	__ca_init_command_table ();
+
+        if (script_filename && strcmp (script_filename, "-"))
+                channel = g_io_channel_new_file (script_filename, "r", &error);
+        else
+                channel = g_io_channel_unix_new (fileno (stdin));
+
+        if (! channel) {
+                fprintf (stderr, _("Couldn't open script file '%s': %s\n"), script_filename, error->message);
+                g_error_free (error);
+                return 1;
+        }
+
+        while (! finished && g_io_channel_read_line (channel, &line, NULL, NULL, &error) == G_IO_STATUS_NORMAL) {
+                gint i;
+                gint argc = 0;
+                gint status;
+                gchar **argv = NULL;
+
+                line_number ++;
+                g_strstrip (line);
+
+                // Empty lines and comments are skipped
+                if (line[0] == '\0' || line[0] == '#') {
+                        g_free (line);
+                        continue;
+                }
+
+                argv = __ca_parse_command_line (line, &argc);
+
+                if (argc > 0) {
+                        CaCommand *command_entry = ((CaCommand *) g_hash_table_lookup (ca_command_table, argv[0]));
+
+                        if (command_entry && command_entry->callback == ca_cli_callback_exit) {
+                                // Don't let "quit" exit the process hiding the status of the previous commands
+                                finished = TRUE;
+                                status = 0;
+                        } else {
+                                status = __ca_execute_command (argc, argv);
+                        }
+
+                        fflush (stdout);
+                        fprintf (stderr, "[%u] %s: %d\n", line_number, argv[0], status);
+
+                        if (status) {
+                                failed ++;
+                                if (stop_on_error)
+                                        finished = TRUE;
+                        }
+                }
+
+                if (argv) {
+                        for (i=0; i < argc; i++)
+                                g_free (argv[i]);
+                        g_free (argv);
+                }
+                g_free (line);
+        }
+
+        if (error) {
+                fprintf (stderr, _("Error reading script: %s\n"), error->message);
+                g_error_free (error);
+                failed ++;
+        }
+
+        g_io_channel_unref (channel);
+
+        return (failed ? 1 : 0);
+}
@@ -38,9 +38,13 @@ gboolean ca_refresh_model (void);
 
 gboolean ca_open (gchar *filename, gboolean create);
 
+gboolean ca_attach (const gchar *filename);
+
 
 void ca_command_line ();
 
+gint ca_command_batch (const gchar *script_filename, gboolean stop_on_error);
+
 
 
 #endif
@@ -33,6 +33,7 @@
 
 #include "ca.h"
 #include "ca_file.h"
+#include "ca_model.h"
 #include "certificate_properties.h"
 #include "crl.h"
 #include "csr_properties.h"
@@ -49,23 +50,9 @@
 
 #define GNOMINT_MIME_TYPE "application/x-gnomint"
 
+/* Databases with more certificates than this are shown collapsed */
+#define CA_EXPAND_ALL_LIMIT 1000
 
-enum {CA_MODEL_COLUMN_ID=0,
-      CA_MODEL_COLUMN_IS_CA=1,
-      CA_MODEL_COLUMN_SERIAL=2,
-      CA_MODEL_COLUMN_SUBJECT=3,
-      CA_MODEL_COLUMN_ACTIVATION=4,
-      CA_MODEL_COLUMN_EXPIRATION=5,
-      CA_MODEL_COLUMN_REVOCATION=6,
-      CA_MODEL_COLUMN_PRIVATE_KEY_IN_DB=7,
-      CA_MODEL_COLUMN_PEM=8,
-      CA_MODEL_COLUMN_DN=9,
-      CA_MODEL_COLUMN_PARENT_DN=10,
-      CA_MODEL_COLUMN_PARENT_ROUTE=11,
-      CA_MODEL_COLUMN_ITEM_TYPE=12,
-      CA_MODEL_COLUMN_PARENT_ID=13, /* Only for CSRs */
-      CA_MODEL_COLUMN_NUMBER=14}
-        CaModelColumns;
 
 enum {CSR_MODEL_COLUMN_ID=0,
       CSR_MODEL_COLUMN_SUBJECT=1,
@@ -83,20 +70,13 @@ extern GtkBuilder * cert_popup_menu_gtkb;
 extern GtkBuilder * csr_popup_menu_gtkb;
 
 
-static GtkTreeStore * ca_model = NULL;
-static gboolean cert_title_inserted = FALSE;
-static GtkTreeIter * cert_parent_iter = NULL;
-static GtkTreeIter * last_parent_iter = NULL;
-static GtkTreeIter * last_cert_iter = NULL;
-static gboolean csr_title_inserted=FALSE;
-static GtkTreeIter * csr_parent_iter = NULL;
+static CaModel * ca_model = NULL;
 
 static gboolean view_csr = TRUE;
 static gboolean view_rcrt = TRUE;
+static gchar * ca_search_text = NULL;
 
 
-int __ca_refresh_model_add_certificate (void *pArg, int argc, char **argv, char **columnNames);
-int __ca_refresh_model_add_csr (void *pArg, int argc, char **argv, char **columnNames);
 void __ca_tree_view_date_datafunc (GtkTreeViewColumn *tree_column,
 				   GtkCellRenderer *cell,
 				   GtkTreeModel *tree_model,
@@ -128,182 +108,12 @@ void __ca_export_public_pem (GtkTreeIter *iter, gint type);
 gchar * __ca_export_private_pkcs8 (GtkTreeIter *iter, gint type);
 void __ca_export_private_pem (GtkTreeIter *iter, gint type);
 void __ca_export_pkcs12 (GtkTreeIter *iter, gint type);
+void __ca_update_status_bar (void);
 
 void __disable_widget (gchar *widget_name);
 void __enable_widget (gchar *widget_name);
 
 
-int __ca_refresh_model_add_certificate (void *pArg, int argc, char **argv, char **columnNames)
-{
-	GtkTreeIter iter;
-	GtkTreeStore * new_model = GTK_TREE_STORE (pArg);
-	GValue *last_id_value = g_new0 (GValue, 1);
-	GValue *last_parent_route_value = g_new0 (GValue, 1);
-        guint64 uint64_value;
-	const gchar * string_value;
-	gchar * last_node_route = NULL;
-	
-	if (cert_title_inserted == FALSE) {
-		gtk_tree_store_append (new_model, &iter, NULL);
-		gtk_tree_store_set (new_model, &iter,
-				    3, _("<b>Certificates</b>"),
-				    -1);
-		cert_parent_iter = gtk_tree_iter_copy (&iter);
-		cert_title_inserted = TRUE;
-	}
-
-	if (! last_cert_iter || (! strcmp (argv[CA_FILE_CERT_COLUMN_PARENT_ROUTE],":"))) {
-		if (last_parent_iter)
-			gtk_tree_iter_free (last_parent_iter);
-		last_parent_iter = NULL;
-	} else {
-		// If not, then we must find the parent of the current node
-		gtk_tree_model_get_value (GTK_TREE_MODEL(new_model), last_cert_iter, CA_MODEL_COLUMN_ID, last_id_value);
-		gtk_tree_model_get_value (GTK_TREE_MODEL(new_model), last_cert_iter, CA_MODEL_COLUMN_PARENT_ROUTE, 
-					  last_parent_route_value);
-		
-		uint64_value = g_value_get_uint64 (last_id_value);
-		string_value = g_value_get_string (last_parent_route_value);
-                g_assert (string_value);
-
-		last_node_route = g_strdup_printf ("%s%"G_GUINT64_FORMAT":", string_value, uint64_value);
-
-		if (! strcmp (argv[CA_FILE_CERT_COLUMN_PARENT_ROUTE], last_node_route)) {
-			// Last node is parent of the current node
-			if (last_parent_iter)
-				gtk_tree_iter_free (last_parent_iter);
-			last_parent_iter = gtk_tree_iter_copy (last_cert_iter);
-			g_free (last_node_route);
-			last_node_route = NULL;
-		} else {
-			// We go back in the hierarchical tree, starting in the current parent, until we find the parent of the
-			// current certificate.
-			
-			if (last_parent_iter)
-                                gtk_tree_iter_free (last_parent_iter);
-                        last_parent_iter = gtk_tree_iter_copy (last_cert_iter);
-
-			while (last_node_route && 
-			       strcmp (argv[CA_FILE_CERT_COLUMN_PARENT_ROUTE], last_node_route)) {
-				
-				g_free (last_node_route);
-				last_node_route = NULL;
-
-				if (! gtk_tree_model_iter_parent(GTK_TREE_MODEL(new_model), &iter, last_parent_iter)) {
-					// Last ca iter is a top_level
-					if (last_parent_iter)
-						gtk_tree_iter_free (last_parent_iter);
-					last_parent_iter = NULL;
-				} else {
-					if (last_parent_iter)
-						gtk_tree_iter_free (last_parent_iter);
-					last_parent_iter = gtk_tree_iter_copy (&iter);
-
-					g_value_unset (last_parent_route_value);
-					g_value_unset (last_id_value);
-					
-					gtk_tree_model_get_value (GTK_TREE_MODEL(new_model), last_parent_iter, CA_MODEL_COLUMN_ID, last_id_value);
-					gtk_tree_model_get_value (GTK_TREE_MODEL(new_model), last_parent_iter, CA_MODEL_COLUMN_PARENT_ROUTE, 
-								  last_parent_route_value);
-					
-					uint64_value = g_value_get_uint64 (last_id_value);
-					string_value = g_value_get_string (last_parent_route_value);
-					if (string_value != NULL)
-						last_node_route = g_strdup_printf ("%s%"G_GUINT64_FORMAT":", string_value, uint64_value);
-					else 
-						last_node_route = NULL;
-				}
-
-			}
-
-			if (last_node_route)
-				g_free (last_node_route);
-		}
-	
-	}
-	
-	gtk_tree_store_append (new_model, &iter, (last_parent_iter ? last_parent_iter: cert_parent_iter));
-
-        if (! argv[CA_FILE_CERT_COLUMN_REVOCATION])        
-                gtk_tree_store_set (new_model, &iter,
-                                    CA_MODEL_COLUMN_ID, atoll(argv[CA_FILE_CERT_COLUMN_ID]),
-                                    CA_MODEL_COLUMN_IS_CA, atoi(argv[CA_FILE_CERT_COLUMN_IS_CA]),
-                                    CA_MODEL_COLUMN_SERIAL, argv[CA_FILE_CERT_COLUMN_SERIAL],
-                                    CA_MODEL_COLUMN_SUBJECT, argv[CA_FILE_CERT_COLUMN_SUBJECT],
-                                    CA_MODEL_COLUMN_ACTIVATION, atoi(argv[CA_FILE_CERT_COLUMN_ACTIVATION]),
-                                    CA_MODEL_COLUMN_EXPIRATION, atoi(argv[CA_FILE_CERT_COLUMN_EXPIRATION]),
-                                    CA_MODEL_COLUMN_REVOCATION, 0,
-                                    CA_MODEL_COLUMN_PRIVATE_KEY_IN_DB, atoi(argv[CA_FILE_CERT_COLUMN_PRIVATE_KEY_IN_DB]),
-                                    CA_MODEL_COLUMN_PEM, argv[CA_FILE_CERT_COLUMN_PEM],
-				    CA_MODEL_COLUMN_DN, argv[CA_FILE_CERT_COLUMN_DN],
-				    CA_MODEL_COLUMN_PARENT_DN, argv[CA_FILE_CERT_COLUMN_PARENT_DN],
-				    CA_MODEL_COLUMN_PARENT_ROUTE, argv[CA_FILE_CERT_COLUMN_PARENT_ROUTE],
-                                    CA_MODEL_COLUMN_ITEM_TYPE, 0,
-                                    -1);
-        else {
-                gchar * revoked_subject = g_markup_printf_escaped ("<s>%s</s>", 
-                                                                   argv[CA_FILE_CERT_COLUMN_SUBJECT]);
-
-                gtk_tree_store_set (new_model, &iter,
-                                    CA_MODEL_COLUMN_ID, atoll(argv[CA_FILE_CERT_COLUMN_ID]),
-                                    CA_MODEL_COLUMN_IS_CA, atoi(argv[CA_FILE_CERT_COLUMN_IS_CA]),
-                                    CA_MODEL_COLUMN_SERIAL, argv[CA_FILE_CERT_COLUMN_SERIAL],
-                                    CA_MODEL_COLUMN_SUBJECT, revoked_subject,
-                                    CA_MODEL_COLUMN_ACTIVATION, atoi(argv[CA_FILE_CERT_COLUMN_ACTIVATION]),
-                                    CA_MODEL_COLUMN_EXPIRATION, atoi(argv[CA_FILE_CERT_COLUMN_EXPIRATION]),
-                                    CA_MODEL_COLUMN_REVOCATION, atoi(argv[CA_FILE_CERT_COLUMN_REVOCATION]),
-                                    CA_MODEL_COLUMN_PRIVATE_KEY_IN_DB, atoi(argv[CA_FILE_CERT_COLUMN_PRIVATE_KEY_IN_DB]),
-                                    CA_MODEL_COLUMN_PEM, argv[CA_FILE_CERT_COLUMN_PEM],
-				    CA_MODEL_COLUMN_DN, argv[CA_FILE_CERT_COLUMN_DN],
-				    CA_MODEL_COLUMN_PARENT_DN, argv[CA_FILE_CERT_COLUMN_PARENT_DN],
-				    CA_MODEL_COLUMN_PARENT_ROUTE, argv[CA_FILE_CERT_COLUMN_PARENT_ROUTE],
-                                    CA_MODEL_COLUMN_ITEM_TYPE, 0,
-                                    -1);
-
-                g_free (revoked_subject);
-        }
-
-
-	if (last_cert_iter)
-		gtk_tree_iter_free (last_cert_iter);
-	last_cert_iter = gtk_tree_iter_copy (&iter);
- 
-	g_free (last_id_value);
-	g_free (last_parent_route_value);      	
-
-	return 0;
-}
-
-
-
-int __ca_refresh_model_add_csr (void *pArg, int argc, char **argv, char **columnNames)
-{
-	GtkTreeIter iter;
-	GtkTreeStore * new_model = GTK_TREE_STORE(pArg);
-
-	if (csr_title_inserted == 0) {
-		gtk_tree_store_append (new_model, &iter, NULL);
-		gtk_tree_store_set (new_model, &iter,
-				    3, _("<b>Certificate Signing Requests</b>"),
-				    -1);		
-		csr_parent_iter = gtk_tree_iter_copy (&iter);
-		csr_title_inserted = TRUE;
-	}
-
-	
-	gtk_tree_store_append (new_model, &iter, csr_parent_iter);
-
-        gtk_tree_store_set (new_model, &iter,
-                            CA_MODEL_COLUMN_ID, atoll(argv[CA_FILE_CSR_COLUMN_ID]),
-                            CA_MODEL_COLUMN_SUBJECT, argv[CA_FILE_CSR_COLUMN_SUBJECT],
-                            CA_MODEL_COLUMN_PRIVATE_KEY_IN_DB, atoi(argv[CA_FILE_CSR_COLUMN_PRIVATE_KEY_IN_DB]),
-                            CA_MODEL_COLUMN_PEM, argv[CA_FILE_CSR_COLUMN_PEM],
-                            CA_MODEL_COLUMN_PARENT_ID, argv[CA_FILE_CSR_COLUMN_PARENT_ID],
-                            CA_MODEL_COLUMN_ITEM_TYPE, 1,
-                            -1);
-	return 0;
-}
-
 void __ca_tree_view_date_datafunc (GtkTreeViewColumn *tree_column,
 				   GtkCellRenderer *cell,
 				   GtkTreeModel *tree_model,
@@ -413,14 +223,36 @@ void __ca_tree_view_private_key_in_db_datafunc (GtkTreeViewColumn *tree_column,
 
 
 
+void __ca_update_status_bar (void)
+{
+	GtkStatusbar *statusbar = GTK_STATUSBAR(gtk_builder_get_object (main_window_gtkb, "ca_statusbar"));
+	guint context_id = gtk_statusbar_get_context_id (statusbar, "database counters");
+	gchar *message;
+
+	/* All of them are read from the counters table, so it doesn't
+	   depend on the size of the database */
+	message = g_strdup_printf (_("%d certificates (%d revoked), %d CSRs, %d archived certificates"),
+				   ca_file_get_number_of_certs (), ca_file_get_number_of_revoked_certs (),
+				   ca_file_get_number_of_csrs (), ca_file_get_number_of_archived_certs ());
+
+	gtk_statusbar_pop (statusbar, context_id);
+	gtk_statusbar_push (statusbar, context_id, message);
+
+	g_free (message);
+}
+
 gboolean ca_refresh_model_callback () 
 {
-	GtkTreeStore * new_model = NULL;
+	CaModel * new_model = NULL;
 	GtkTreeView * treeview = NULL;
 	GtkCellRenderer * renderer = NULL;
         GtkTreeViewColumn * column = NULL;
+	GtkTreePath * path = NULL;
+	GList * cursor;
+	GList * column_list;
                  
         guint columns_number;
+	gint i;
 
 	/* Models have these columns: 
            - Id
@@ -437,28 +269,19 @@ gboolean ca_refresh_model_callback ()
            - Parent route
            - Item type
            - Parent ID (only for CSR)
-	*/
 
-	new_model = gtk_tree_store_new (CA_MODEL_COLUMN_NUMBER, G_TYPE_UINT64, G_TYPE_BOOLEAN, G_TYPE_STRING, G_TYPE_STRING, 
-					G_TYPE_INT, G_TYPE_INT, G_TYPE_INT, G_TYPE_BOOLEAN, G_TYPE_STRING, 
-					G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_INT, G_TYPE_STRING);
-
-	cert_title_inserted = FALSE;
-	cert_parent_iter = NULL;
-	last_parent_iter = NULL;
-	last_cert_iter = NULL;
-	csr_title_inserted=FALSE;
-	csr_parent_iter = NULL;
+	   The model reads the rows from the database as they are shown,
+	   so nothing is loaded here.
+	*/
 
-	ca_file_foreach_crt (__ca_refresh_model_add_certificate, view_rcrt, new_model);
-          
-        if (view_csr)
-		ca_file_foreach_csr (__ca_refresh_model_add_csr, new_model);
+	if (ca_search_text)
+		new_model = ca_model_new_from_search (ca_search_text, view_rcrt);
+	else
+		new_model = ca_model_new (view_rcrt, view_csr);
 
 	treeview = GTK_TREE_VIEW(gtk_builder_get_object (main_window_gtkb, "ca_treeview"));
 
 	if (ca_model) {
-                GList * column_list;
 		g_object_unref (ca_model);		
 
                 // Remove revocation column
@@ -536,6 +359,19 @@ gboolean ca_refresh_model_callback ()
                                                                              GINT_TO_POINTER(CA_MODEL_COLUMN_REVOCATION), 
                                                                              g_free);
                 
+		/* With fixed row heights, the tree view doesn't need to read every
+		   row of the model for measuring it, but only the visible ones */
+		column_list = gtk_tree_view_get_columns (treeview);
+		for (cursor = column_list; cursor; cursor = cursor->next) {
+			column = GTK_TREE_VIEW_COLUMN (cursor->data);
+			gtk_tree_view_column_set_sizing (column, GTK_TREE_VIEW_COLUMN_FIXED);
+			gtk_tree_view_column_set_resizable (column, TRUE);
+			gtk_tree_view_column_set_fixed_width (column, (cursor == column_list ? 300 : 
+								       (cursor->prev == column_list || cursor->prev->prev == column_list ? 
+									24 : 150)));
+		}
+		g_list_free (column_list);
+		gtk_tree_view_set_fixed_height_mode (treeview, TRUE);
 
 	}
 
@@ -546,7 +382,19 @@ gboolean ca_refresh_model_callback ()
 	gtk_tree_view_set_model (treeview, GTK_TREE_MODEL(new_model));
 	ca_model = new_model;
 
-	gtk_tree_view_expand_all (treeview);
+	__ca_update_status_bar ();
+
+	if (ca_file_get_number_of_certs () <= CA_EXPAND_ALL_LIMIT) {
+		gtk_tree_view_expand_all (treeview);
+	} else {
+		/* Expanding everything would read the whole database. Only
+		   the top level is shown, and the rest is read on demand */
+		for (i = 0; i < gtk_tree_model_iter_n_children (GTK_TREE_MODEL(new_model), NULL); i++) {
+			path = gtk_tree_path_new_from_indices (i, -1);
+			gtk_tree_view_expand_row (treeview, path, FALSE);
+			gtk_tree_path_free (path);
+		}
+	}
 
 	return TRUE;
 }
@@ -606,7 +454,7 @@ G_MODULE_EXPORT gboolean ca_treeview_row_activated (GtkTreeView *tree_view,
 				    gpointer user_data)
 {
 
-        GtkTreePath *parent = NULL;
+        GtkTreeIter iter;
 	
         if (tree_view == NULL) {
                 GtkTreeSelection *selection;
@@ -624,18 +472,19 @@ G_MODULE_EXPORT gboolean ca_treeview_row_activated (GtkTreeView *tree_view,
 			
 	}
 	
-	parent = gtk_tree_model_get_path (gtk_tree_view_get_model(tree_view), cert_parent_iter);
-	if (gtk_tree_path_is_ancestor (parent, path) && gtk_tree_path_compare (parent, path)) {
+	if (! gtk_tree_model_get_iter (gtk_tree_view_get_model(tree_view), &iter, path))
+		return FALSE;
+
+	switch (ca_model_get_item_type (ca_model, &iter)) {
+	case CA_FILE_ELEMENT_TYPE_CERT:
 		__ca_certificate_activated (tree_view, path, column, user_data);
-	} else {
-		gtk_tree_path_free (parent);
-		
-		parent = gtk_tree_model_get_path (gtk_tree_view_get_model(tree_view), csr_parent_iter);
-		if (gtk_tree_path_is_ancestor (parent, path) && gtk_tree_path_compare (parent, path)) {
-			__ca_csr_activated (tree_view, path, column, user_data);
-		}
+		break;
+	case CA_FILE_ELEMENT_TYPE_CSR:
+		__ca_csr_activated (tree_view, path, column, user_data);
+		break;
+	default:
+		break;
 	}
-	gtk_tree_path_free (parent);
 	
 	return FALSE;
 	
@@ -753,8 +602,6 @@ gint __ca_selection_type (GtkTreeView *tree_view, GtkTreeIter **iter) {
 
 	GtkTreeSelection *selection = gtk_tree_view_get_selection (tree_view);
 	GtkTreeIter selection_iter;
-	GtkTreePath *parent = NULL;
-	GtkTreePath *selection_path = NULL;
 
 	if (gtk_tree_selection_count_selected_rows (selection) != 1)
 		return -1;
@@ -763,25 +610,16 @@ gint __ca_selection_type (GtkTreeView *tree_view, GtkTreeIter **iter) {
 	if (iter)
 		(*iter) = gtk_tree_iter_copy (&selection_iter);
 
-	selection_path = gtk_tree_model_get_path (gtk_tree_view_get_model(tree_view), &selection_iter);
-	
-	parent = gtk_tree_model_get_path (gtk_tree_view_get_model(tree_view), cert_parent_iter);
-	if (gtk_tree_path_is_ancestor (parent, selection_path) && gtk_tree_path_compare (parent, selection_path)) {
-		gtk_tree_path_free (parent);
-		/* It's a certificate */
-		return CA_FILE_ELEMENT_TYPE_CERT;
-	}
-
-	gtk_tree_path_free (parent);
-	parent = gtk_tree_model_get_path (gtk_tree_view_get_model(tree_view), csr_parent_iter);
-	if (gtk_tree_path_is_ancestor (parent, selection_path) && gtk_tree_path_compare (parent, selection_path)) {
-		gtk_tree_path_free (parent);
-		/* It's a CSR */
-		return CA_FILE_ELEMENT_TYPE_CSR;
-	}
+	return ca_model_get_item_type (ca_model, &selection_iter);
+}
 
-	gtk_tree_path_free (parent);
-	return -1;
+G_MODULE_EXPORT void ca_treeview_row_collapsed (GtkTreeView *tree_view,
+						GtkTreeIter *iter,
+						GtkTreePath *path,
+						gpointer user_data)
+{
+	if (ca_model)
+		ca_model_collapse (ca_model, iter);
 }
 
 G_MODULE_EXPORT gboolean ca_treeview_selection_change (GtkTreeView *tree_view,
@@ -1320,6 +1158,10 @@ gboolean ca_open (gchar *filename, gboolean create)
 	if (! ca_file_open (filename, create))
 		return FALSE;
 
+	g_free (ca_search_text);
+	ca_search_text = NULL;
+	gtk_entry_set_text (GTK_ENTRY(gtk_builder_get_object (main_window_gtkb, "ca_search_entry")), "");
+
 	__enable_widget ("new_certificate1");
 	__enable_widget ("save_as1");
 	__enable_widget ("preferences1");
@@ -1379,6 +1221,22 @@ void ca_update_revoked_view (gboolean new_value, gboolean refresh)
                 dialog_refresh_list();
 }
 
+G_MODULE_EXPORT void ca_search_entry_activate (GtkEntry *entry, gpointer user_data)
+{
+	gchar *text = g_strstrip (g_strdup (gtk_entry_get_text (entry)));
+
+	g_free (ca_search_text);
+	ca_search_text = NULL;
+
+	/* An empty search gets back to the whole CA tree */
+	if (text[0])
+		ca_search_text = text;
+	else
+		g_free (text);
+
+	dialog_refresh_list ();
+}
+
 G_MODULE_EXPORT gboolean ca_rcrt_view_toggled (GtkCheckMenuItem *button, gpointer user_data)
 {
         ca_update_revoked_view (gtk_check_menu_item_get_active (button), TRUE);
@@ -1751,6 +1609,7 @@ G_MODULE_EXPORT void ca_generate_dh_param_show (GtkWidget *menuitem, gpointer us
 	gchar *filename;
 	gint response = 0;
 	guint dh_size;
+	gboolean well_known;
 	gchar *strerror;
 
 	dialog_gtkb = gtk_builder_new();
@@ -1771,6 +1630,7 @@ G_MODULE_EXPORT void ca_generate_dh_param_show (GtkWidget *menuitem, gpointer us
 
 	widget = gtk_builder_get_object (dialog_gtkb, "dh_prime_size_spinbutton");
 	dh_size = gtk_spin_button_get_value (GTK_SPIN_BUTTON(widget));
+	well_known = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON(gtk_builder_get_object (dialog_gtkb, "dh_rfc7919_checkbutton")));
 
 	dialog2 = GTK_DIALOG (gtk_file_chooser_dialog_new (_("Save Diffie-Hellman parameters"),
 							  GTK_WINDOW(widget),
@@ -1784,7 +1644,7 @@ G_MODULE_EXPORT void ca_generate_dh_param_show (GtkWidget *menuitem, gpointer us
 
 		filename = gtk_file_chooser_get_filename (GTK_FILE_CHOOSER (dialog2));
 
-		strerror = export_dh_param (dh_size, filename);
+		strerror = export_dh_param (dh_size, well_known, filename);
 
 		if (strerror) {
 			gtk_widget_destroy (GTK_WIDGET(dialog2));
@@ -33,6 +33,10 @@ gboolean ca_treeview_row_activated (GtkTreeView *tree_view,
 				    gpointer user_data);
 gboolean ca_treeview_selection_change (GtkTreeView *tree_view,
 				       gpointer user_data);
+void ca_treeview_row_collapsed (GtkTreeView *tree_view,
+				GtkTreeIter *iter,
+				GtkTreePath *path,
+				gpointer user_data);
 void ca_on_export1_activate (GtkMenuItem *menuitem, gpointer user_data);
 void ca_on_extractprivatekey1_activate (GtkMenuItem *menuitem, gpointer user_data);
 void ca_on_revoke_activate (GtkMenuItem *menuitem, gpointer user_data);
@@ -45,6 +49,7 @@ void ca_update_csr_view (gboolean new_value, gboolean refresh);
 gboolean ca_csr_view_toggled (GtkCheckMenuItem *button, gpointer user_data);
 void ca_update_revoked_view (gboolean new_value, gboolean refresh);
 gboolean ca_rcrt_view_toggled (GtkCheckMenuItem *button, gpointer user_data);
+void ca_search_entry_activate (GtkEntry *entry, gpointer user_data);
 void ca_generate_crl (GtkCheckMenuItem *button, gpointer user_data);
 gboolean ca_treeview_popup_timeout_program_cb (gpointer data);
 void ca_treeview_popup_timeout_program (GdkEventButton *event);
@@ -47,54 +47,37 @@ gpointer ca_creation_thread (gpointer data)
 	gchar * error_message = NULL;
 	
 
+	g_mutex_lock(&ca_creation_thread_status_mutex);
 	switch (creation_data->key_type){
-	case 0: /* RSA */
-		g_mutex_lock(&ca_creation_thread_status_mutex);
+	case TLS_KEY_TYPE_DSA:
+		ca_creation_message =  _("Generating new DSA key pair");
+		break;
+	case TLS_KEY_TYPE_ECDSA:
+		ca_creation_message =  _("Generating new ECDSA key pair");
+		break;
+	case TLS_KEY_TYPE_ED25519:
+		ca_creation_message =  _("Generating new Ed25519 key pair");
+		break;
+	default:
 		ca_creation_message =  _("Generating new RSA key pair");
-		g_mutex_unlock (&ca_creation_thread_status_mutex);
-
-		error_message = tls_generate_rsa_keys (creation_data, &private_key, &ca_key);		
-		if (error_message) {
-			printf ("%s\n\n", error_message);
-
-			g_mutex_lock(&ca_creation_thread_status_mutex);
-
-			ca_creation_message = g_strdup_printf ("%s:\n%s",_("Key generation failed"), error_message); 
-			ca_creation_thread_status = -1;
-
-			g_mutex_unlock (&ca_creation_thread_status_mutex);
-
-			tls_creation_data_free (creation_data);
-			return ca_creation_message;
-			// return error_message;
-		}
-
 		break;
+	}
+	g_mutex_unlock (&ca_creation_thread_status_mutex);
 
-	case 1: /* DSA */
-		g_mutex_lock(&ca_creation_thread_status_mutex);
-		ca_creation_message =  _("Generating new DSA key pair");
-		g_mutex_unlock (&ca_creation_thread_status_mutex);
-
- 		error_message = tls_generate_dsa_keys (creation_data, &private_key, &ca_key);
-
-		if (error_message) { 
-			printf ("%s\n\n", error_message);
-
- 			g_mutex_lock(&ca_creation_thread_status_mutex); 
-
-			ca_creation_message = g_strdup_printf ("%s:\n%s",_("Key generation failed"), error_message); 
- 			ca_creation_thread_status = -1; 
+	error_message = tls_generate_keys (creation_data, &private_key, &ca_key);
+	if (error_message) {
+		printf ("%s\n\n", error_message);
 
- 			g_mutex_unlock (&ca_creation_thread_status_mutex); 
+		g_mutex_lock(&ca_creation_thread_status_mutex);
 
+		ca_creation_message = g_strdup_printf ("%s:\n%s",_("Key generation failed"), error_message); 
+		ca_creation_thread_status = -1;
 
- 			//return error_message; 
-			tls_creation_data_free (creation_data);
-			return ca_creation_message;
- 		} 
+		g_mutex_unlock (&ca_creation_thread_status_mutex);
 
-		break;
+		tls_creation_data_free (creation_data);
+		return ca_creation_message;
+		// return error_message;
 	}
 
 	g_mutex_lock(&ca_creation_thread_status_mutex);
@@ -187,8 +170,13 @@ gchar * ca_creation_database_save (TlsCreationData * creation_data,
 				   gchar * private_key, 
 				   gchar * root_certificate)
 {
-	return ca_file_insert_self_signed_ca (private_key,
-					      root_certificate);
+	gchar *error = ca_file_insert_self_signed_ca (private_key,
+						      root_certificate);
+
+	// This runs in the creation thread, which is done with the database
+	ca_file_release_thread_connection ();
+
+	return error;
 }
 
 
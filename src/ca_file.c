@@ -33,6 +33,8 @@
 #include "tls.h"
 #include "ca_file.h"
 #include "pkey_manage.h"
+#include "key_pool.h"
+#include "stats.h"
 
 #include <glib/gi18n.h>
 
@@ -45,14 +47,128 @@
 
 extern gchar * gnomint_current_opened_file;
 
-sqlite3 * ca_db = NULL;
-
+/* Each thread works with its own connection to a CaFile: the thread that
+   opened the file uses the one it was opened with, and any other thread gets
+   one from the pool the first time it calls a ca_file_* function. SQLite runs
+   the readers in parallel (the file is in WAL mode), and lets a single writer
+   at a time: write transactions are BEGIN IMMEDIATE, waiting for the lock */
+typedef struct {
+	sqlite3 *db;
+
+	/* Expired certificates can be moved to an archive database, attached
+	   to the main one, and read together through the all_certificates view */
+	gboolean archive_attached;
+
+	/* Policies of each CA, read once and kept until any of them is changed */
+	GHashTable *policy_cache;
+	gint policy_generation;
+
+	/* Issuance profiles already used, with their extensions encoded. Profiles are never
+	   updated in place, so they are only dropped when the connection is closed */
+	GHashTable *profile_cache;
+
+	/* Rows returned by each running statement (sqlite3_stmt * -> count), for the
+	   slow-query log, and whether its EXPLAIN QUERY PLAN is being run */
+	GHashTable *trace_rows;
+	gboolean trace_explaining;
+
+	/* Whether the rows are being followed: only while slow queries are logged,
+	   as their callback runs for each row of each statement */
+	gboolean trace_rows_enabled;
+} CaFileConnection;
+
+struct _CaFile {
+	gchar *filename;
+	GThread *owner;
+	CaFileConnection *owner_connection;
+
+	GMutex pool_mutex;
+	GHashTable *pool;              // GThread * -> CaFileConnection *
+
+	gint policy_generation;        // Incremented each time a policy is changed
+
+	gchar *password;               // Database password, once given for this handle
+};
+
+static CaFile *ca_file_default = NULL;
+static GPrivate ca_file_current = G_PRIVATE_INIT (NULL);
+
+#define CA_FILE_BUSY_TIMEOUT_MS 30000
+
+// Statements that take longer are logged (0 = never). -1 until GNOMINT_SLOW_QUERY_MS is read
+static gint ca_file_slow_query_threshold = -1;
+#define CA_FILE_SLOW_QUERY_MAX_SQL 512
+
+/* Connection of the calling thread to its current CaFile */
+#define ca_db __ca_file_db ()
+
+static const struct {
+	const gchar *name;
+	glong offset;
+} ca_file_policy_fields[] = {
+	{"MONTHS_TO_EXPIRE", G_STRUCT_OFFSET (CaPolicy, months_to_expire)},
+	{"HOURS_BETWEEN_CRL_UPDATES", G_STRUCT_OFFSET (CaPolicy, hours_between_crl_updates)},
+	{"C_INHERIT", G_STRUCT_OFFSET (CaPolicy, c_inherit)},
+	{"C_FORCE_SAME", G_STRUCT_OFFSET (CaPolicy, c_force_same)},
+	{"ST_INHERIT", G_STRUCT_OFFSET (CaPolicy, st_inherit)},
+	{"ST_FORCE_SAME", G_STRUCT_OFFSET (CaPolicy, st_force_same)},
+	{"L_INHERIT", G_STRUCT_OFFSET (CaPolicy, l_inherit)},
+	{"L_FORCE_SAME", G_STRUCT_OFFSET (CaPolicy, l_force_same)},
+	{"O_INHERIT", G_STRUCT_OFFSET (CaPolicy, o_inherit)},
+	{"O_FORCE_SAME", G_STRUCT_OFFSET (CaPolicy, o_force_same)},
+	{"OU_INHERIT", G_STRUCT_OFFSET (CaPolicy, ou_inherit)},
+	{"OU_FORCE_SAME", G_STRUCT_OFFSET (CaPolicy, ou_force_same)},
+	{"CA", G_STRUCT_OFFSET (CaPolicy, ca)},
+	{"CRL_SIGN", G_STRUCT_OFFSET (CaPolicy, crl_sign)},
+	{"NON_REPUDIATION", G_STRUCT_OFFSET (CaPolicy, non_repudiation)},
+	{"DIGITAL_SIGNATURE", G_STRUCT_OFFSET (CaPolicy, digital_signature)},
+	{"KEY_ENCIPHERMENT", G_STRUCT_OFFSET (CaPolicy, key_encipherment)},
+	{"KEY_AGREEMENT", G_STRUCT_OFFSET (CaPolicy, key_agreement)},
+	{"DATA_ENCIPHERMENT", G_STRUCT_OFFSET (CaPolicy, data_encipherment)},
+	{"TLS_WEB_SERVER", G_STRUCT_OFFSET (CaPolicy, tls_web_server)},
+	{"TLS_WEB_CLIENT", G_STRUCT_OFFSET (CaPolicy, tls_web_client)},
+	{"TIME_STAMPING", G_STRUCT_OFFSET (CaPolicy, time_stamping)},
+	{"CODE_SIGNING", G_STRUCT_OFFSET (CaPolicy, code_signing)},
+	{"EMAIL_PROTECTION", G_STRUCT_OFFSET (CaPolicy, email_protection)},
+	{"OCSP_SIGNING", G_STRUCT_OFFSET (CaPolicy, ocsp_signing)},
+	{"ANY_PURPOSE", G_STRUCT_OFFSET (CaPolicy, any_purpose)},
+	{NULL, 0}
+};
+
+#define CA_FILE_CERT_FIELDS "id, is_ca, serial, subject, activation, expiration, revocation, pem, private_key_in_db, " \
+	"private_key, dn, parent_dn, parent_id, parent_route, expired_already_in_crl, subject_key_id, issuer_key_id, serial_bin"
+
+
+#define CURRENT_GNOMINT_DB_VERSION 21
+
+/* Upgrade steps that parse every certificate or CSR read them in chunks of this size,
+   parsed by a pool of threads, and save each chunk in its own transaction */
+#define CA_FILE_UPGRADE_CHUNK_ROWS 1000
+#define CA_FILE_UPGRADE_THREADS 4
+
+typedef struct {
+	guint64 id;
+	gchar *pem;
+	gchar *extra;          // Third column of the query, if any
+	gpointer parsed;       // Result of parsing pem, or NULL if it couldn't be parsed
+} CaFileUpgradeRow;
+
+typedef struct {
+	const gchar *name;                // Name of the step, used as the progress marker
+	const gchar *table;
+	const gchar *extra_column;        // Also read besides id and pem (may be NULL)
+	gpointer (* parse) (const gchar *pem);            // Called from the worker threads
+	GDestroyNotify free;
+	gchar * (* write) (sqlite3 *db, const CaFileUpgradeRow *row);
+} CaFileUpgradeStep;
 
-#define CURRENT_GNOMINT_DB_VERSION 12
+static CaFileUpgradeProgressFunc ca_file_upgrade_progress_func = NULL;
+static gpointer ca_file_upgrade_progress_data = NULL;
 
 void __ca_file_concat_string (sqlite3_context *context, int argc, sqlite3_value **argv);
 void __ca_file_zeropad (sqlite3_context *context, int argc, sqlite3_value **argv);
 void __ca_file_zeropad_route (sqlite3_context *context, int argc, sqlite3_value **argv);
+void __ca_file_serial_blob (sqlite3_context *context, int argc, sqlite3_value **argv);
 int __ca_file_get_single_row_cb (void *pArg, int argc, char **argv, char **columnNames);
 gchar ** __ca_file_get_single_row (sqlite3 *db, const gchar *query, ...);
 int __ca_file_get_revoked_certs_add_certificate (void *pArg, int argc, char **argv, char **columnNames);
@@ -62,6 +178,53 @@ int  __ca_file_password_protect_cb (void *pArg, int argc, char **argv, char **co
 int  __ca_file_password_change_cb (void *pArg, int argc, char **argv, char **columnNames);
 gchar * __ca_file_get_field_from_id (CaFileElementType type, guint64 db_id, const gchar *field);
 gchar * __ca_file_check_and_update_version (sqlite3 * ca_checking_db);
+gchar * __ca_file_set_user_version (sqlite3 *db);
+gboolean __ca_file_upgrade_step_started (sqlite3 *db, const gchar *name);
+gchar * __ca_file_upgrade_step_begin (sqlite3 *db, const gchar *name);
+gchar * __ca_file_upgrade_step_end (sqlite3 *db, const gchar *name);
+void __ca_file_upgrade_parse_row (gpointer data, gpointer user_data);
+void __ca_file_upgrade_row_free (CaFileUpgradeRow *row, const CaFileUpgradeStep *step);
+gchar * __ca_file_upgrade_rows (sqlite3 *db, const CaFileUpgradeStep *step);
+gchar * __ca_file_upgrade_write_crt_dn (sqlite3 *db, const CaFileUpgradeRow *row);
+gchar * __ca_file_upgrade_write_csr_dn (sqlite3 *db, const CaFileUpgradeRow *row);
+gchar * __ca_file_upgrade_write_subject_key_id (sqlite3 *db, const CaFileUpgradeRow *row);
+gchar * __ca_file_upgrade_write_issuer_key_id (sqlite3 *db, const CaFileUpgradeRow *row);
+gchar * __ca_file_upgrade_write_search_index (sqlite3 *db, const CaFileUpgradeRow *row);
+int __ca_file_append_id (void *pArg, int argc, char **argv, char **columnNames);
+gint __ca_file_compare_ids (gconstpointer a, gconstpointer b);
+gchar * __ca_file_id_list (const guint64 *ids, guint ids_number);
+gchar * __ca_file_search_terms (const gchar *hex_string);
+gchar * __ca_file_search_index_crt (sqlite3 *db, guint64 id, const gchar *serial, const TlsCert *cert);
+gchar * __ca_file_search_sql (const gchar *columns, const gchar *text, gboolean view_revoked, guint limit);
+gchar * __ca_file_get_archive_filename (const gchar *file_name);
+gchar * __ca_file_upgrade_archive (void);
+gchar * __ca_file_count_archived (void);
+gchar * __ca_file_attach_archive (gboolean create);
+gboolean __ca_file_has_crts_to_archive (time_t expired_before);
+gchar * __ca_file_create_counters (sqlite3 *db);
+gchar * __ca_file_insert_csr_row (const gchar *pem_csr_private_key, const gchar *pem_csr, const gchar *parent_ca_id_str);
+gchar * __ca_file_insert_cert_row (gboolean is_ca, gboolean own_serial, gboolean private_key_in_db, const gchar *private_key_info, 
+				   const gchar *pem_certificate, time_t revocation);
+void __ca_file_policy_free (gpointer data);
+int __ca_file_policy_load_cb (void *pArg, int argc, char **argv, char **columnNames);
+void __ca_file_policy_invalidate (void);
+void __ca_file_profile_free (gpointer data);
+gint __ca_file_get_slow_query_threshold (void);
+gchar * __ca_file_trace_strip_literals (const gchar *sql);
+#if SQLITE_VERSION_NUMBER >= 3014000
+void __ca_file_trace_explain (CaFileConnection *connection, sqlite3_stmt *stmt);
+void __ca_file_trace_slow_query (CaFileConnection *connection, sqlite3_stmt *stmt, sqlite3_int64 elapsed);
+int __ca_file_trace_cb (unsigned int type, void *context, void *statement, void *elapsed);
+#else
+void __ca_file_profile_cb (void *context, const char *sql, sqlite3_uint64 elapsed);
+#endif
+void __ca_file_connection_update_trace (CaFileConnection *connection);
+CaFileConnection * __ca_file_connection_new (sqlite3 *db);
+void __ca_file_connection_free (gpointer data);
+CaFileConnection * __ca_file_get_connection (void);
+sqlite3 * __ca_file_db (void);
+CaFile * __ca_file_new (const gchar *filename, sqlite3 *db);
+void __ca_file_free (CaFile *ca_file);
 
 
 
@@ -147,6 +310,25 @@ void __ca_file_zeropad_route (sqlite3_context *context, int argc, sqlite3_value
         
 }
 
+/* Binary form of a serial, as written by uint160_strdup_printf ("01:A2:..."), for serial_bin */
+void __ca_file_serial_blob (sqlite3_context *context, int argc, sqlite3_value **argv)
+{
+        const gchar *value = (const gchar *) sqlite3_value_text (argv[0]);
+        guchar *result;
+        gsize size = UINT160_SIZE;
+        UInt160 serial;
+
+        if (! value || ! uint160_read_hex (&serial, value, strlen (value))) {
+                sqlite3_result_null (context);
+                return;
+        }
+
+        result = g_new (guchar, UINT160_SIZE);
+        uint160_write (&serial, result, &size);
+
+        sqlite3_result_blob (context, result, UINT160_SIZE, g_free);
+}
+
 
 
 int __ca_file_get_single_row_cb (void *pArg, int argc, char **argv, char **columnNames)
@@ -221,7 +403,37 @@ gchar * ca_file_create (const gchar *filename)
                           "CREATE TABLE certificates (id INTEGER PRIMARY KEY, is_ca BOOLEAN, serial TEXT, subject TEXT, "
 			  "activation TIMESTAMP, expiration TIMESTAMP, revocation TIMESTAMP, pem TEXT, private_key_in_db BOOLEAN, "
 			  "private_key TEXT, dn TEXT, parent_dn TEXT, parent_id INTEGER DEFAULT 0, parent_route TEXT, "
-                          "expired_already_in_crl INTEGER, subject_key_id TEXT, issuer_key_id TEXT);",
+                          "expired_already_in_crl INTEGER, subject_key_id TEXT, issuer_key_id TEXT, serial_bin BLOB);",
+                          NULL, NULL, &error)) {
+		return error;
+	}
+	if (sqlite3_exec (ca_new_db,
+                          "CREATE INDEX certificates_parent_id_idx ON certificates (parent_id, id);",
+                          NULL, NULL, &error)) {
+		return error;
+	}
+	if (sqlite3_exec (ca_new_db,
+                          "CREATE INDEX certificates_subject_idx ON certificates (subject);",
+                          NULL, NULL, &error)) {
+		return error;
+	}
+	if (sqlite3_exec (ca_new_db,
+                          "CREATE INDEX certificates_parent_route_idx ON certificates (parent_route, revocation, id);",
+                          NULL, NULL, &error)) {
+		return error;
+	}
+	if (sqlite3_exec (ca_new_db,
+                          "CREATE INDEX certificates_expiration_idx ON certificates (expiration);",
+                          NULL, NULL, &error)) {
+		return error;
+	}
+	if (sqlite3_exec (ca_new_db,
+                          "CREATE INDEX certificates_serial_idx ON certificates (parent_id, serial_bin);",
+                          NULL, NULL, &error)) {
+		return error;
+	}
+	if (sqlite3_exec (ca_new_db,
+                          "CREATE VIRTUAL TABLE certificates_search USING fts5 (subject, dn, parent_dn, serial, fingerprints);",
                           NULL, NULL, &error)) {
 		return error;
 	}
@@ -238,20 +450,48 @@ gchar * ca_file_create (const gchar *filename)
 		return error;
 	}
 
+	if (sqlite3_exec (ca_new_db,
+                          "CREATE TABLE ca_profiles (id INTEGER PRIMARY KEY AUTOINCREMENT, ca_id INTEGER, name TEXT, "
+                          "months_to_expire INTEGER, uses INTEGER, crl_distribution_point TEXT, UNIQUE (ca_id, name));",
+                          NULL, NULL, &error)) {
+		return error;
+	}
+
 	if (sqlite3_exec (ca_new_db,
                           "CREATE TABLE ca_crl (id INTEGER PRIMARY KEY, ca_id INTEGER, crl_version INTEGER, "
-                          "date TIMESTAMP, UNIQUE (ca_id, crl_version));",
+                          "date TIMESTAMP, next_update TIMESTAMP, input_digest TEXT, pem TEXT, "
+                          "UNIQUE (ca_id, crl_version));",
                           NULL, NULL, &error)) {
                 fprintf (stderr, "%s\n", error);
 		return error;
 	}
 
+	if (sqlite3_exec (ca_new_db,
+                          "CREATE TABLE key_pool (id INTEGER PRIMARY KEY, key_type INTEGER, key_bitlength INTEGER, "
+                          "private_key TEXT);",
+                          NULL, NULL, &error)) {
+		return error;
+	}
+
+	if (sqlite3_exec (ca_new_db,
+                          "CREATE TABLE key_pool_sizes (key_type INTEGER, key_bitlength INTEGER, size INTEGER, "
+                          "PRIMARY KEY (key_type, key_bitlength));",
+                          NULL, NULL, &error)) {
+		return error;
+	}
+
 	
+	if ((error = __ca_file_create_counters (ca_new_db)))
+		return error;
+
 	sql = sqlite3_mprintf ("INSERT INTO db_properties (id, name, value) VALUES (NULL, 'ca_db_version', %d);", CURRENT_GNOMINT_DB_VERSION);
 	if (sqlite3_exec (ca_new_db, sql, NULL, NULL, &error))
 		return error;
 	sqlite3_free (sql);
 
+	if ((error = __ca_file_set_user_version (ca_new_db)))
+		return error;
+
 
         sql = sqlite3_mprintf ("INSERT INTO db_properties (id, name, value) VALUES (NULL, 'is_password_protected', '0');");
         
@@ -277,6 +517,315 @@ gchar * ca_file_create (const gchar *filename)
         return NULL;
 }
 
+gchar * __ca_file_create_counters (sqlite3 *db)
+{
+	gchar *error = NULL;
+
+	/* Counters are kept per issuer CA (0 for self-signed and orphan
+	   certificates, and for CSRs without a CA) by these triggers, so
+	   the totals never need a scan of the certificates table */
+	if (sqlite3_exec (db,
+			  "CREATE TABLE ca_counters (ca_id INTEGER PRIMARY KEY, certs INTEGER DEFAULT 0, "
+			  "revoked INTEGER DEFAULT 0, cas INTEGER DEFAULT 0, csrs INTEGER DEFAULT 0, archived INTEGER DEFAULT 0);"
+
+			  "CREATE TRIGGER ca_counters_cert_insert AFTER INSERT ON certificates BEGIN "
+			  "INSERT OR IGNORE INTO ca_counters (ca_id) VALUES (NEW.parent_id); "
+			  "UPDATE ca_counters SET certs = certs + 1, revoked = revoked + (NEW.revocation IS NOT NULL), "
+			  "cas = cas + (NEW.is_ca <> 0) WHERE ca_id = NEW.parent_id; "
+			  "END;"
+
+			  "CREATE TRIGGER ca_counters_cert_delete AFTER DELETE ON certificates BEGIN "
+			  "UPDATE ca_counters SET certs = certs - 1, revoked = revoked - (OLD.revocation IS NOT NULL), "
+			  "cas = cas - (OLD.is_ca <> 0) WHERE ca_id = OLD.parent_id; "
+			  "END;"
+
+			  "CREATE TRIGGER ca_counters_cert_update AFTER UPDATE OF revocation, parent_id, is_ca ON certificates BEGIN "
+			  "UPDATE ca_counters SET certs = certs - 1, revoked = revoked - (OLD.revocation IS NOT NULL), "
+			  "cas = cas - (OLD.is_ca <> 0) WHERE ca_id = OLD.parent_id; "
+			  "INSERT OR IGNORE INTO ca_counters (ca_id) VALUES (NEW.parent_id); "
+			  "UPDATE ca_counters SET certs = certs + 1, revoked = revoked + (NEW.revocation IS NOT NULL), "
+			  "cas = cas + (NEW.is_ca <> 0) WHERE ca_id = NEW.parent_id; "
+			  "END;"
+
+			  "CREATE TRIGGER ca_counters_csr_insert AFTER INSERT ON cert_requests BEGIN "
+			  "INSERT OR IGNORE INTO ca_counters (ca_id) VALUES (IFNULL(NEW.parent_ca, 0)); "
+			  "UPDATE ca_counters SET csrs = csrs + 1 WHERE ca_id = IFNULL(NEW.parent_ca, 0); "
+			  "END;"
+
+			  "CREATE TRIGGER ca_counters_csr_delete AFTER DELETE ON cert_requests BEGIN "
+			  "UPDATE ca_counters SET csrs = csrs - 1 WHERE ca_id = IFNULL(OLD.parent_ca, 0); "
+			  "END;"
+
+			  "INSERT INTO ca_counters (ca_id) SELECT DISTINCT parent_id FROM certificates; "
+			  "INSERT OR IGNORE INTO ca_counters (ca_id) SELECT DISTINCT IFNULL(parent_ca, 0) FROM cert_requests; "
+			  "UPDATE ca_counters SET "
+			  "certs = (SELECT COUNT(*) FROM certificates WHERE parent_id = ca_counters.ca_id), "
+			  "revoked = (SELECT COUNT(*) FROM certificates WHERE parent_id = ca_counters.ca_id AND revocation IS NOT NULL), "
+			  "cas = (SELECT COUNT(*) FROM certificates WHERE parent_id = ca_counters.ca_id AND is_ca <> 0), "
+			  "csrs = (SELECT COUNT(*) FROM cert_requests WHERE IFNULL(parent_ca, 0) = ca_counters.ca_id);",
+			  NULL, NULL, &error)) {
+		return error;
+	}
+
+	return NULL;
+}
+
+static const CaFileUpgradeStep ca_file_upgrade_crt_dn = 
+	{"certificates_dn", "certificates", NULL, (gpointer (*) (const gchar *)) tls_parse_cert_pem, 
+	 (GDestroyNotify) tls_cert_free, __ca_file_upgrade_write_crt_dn};
+static const CaFileUpgradeStep ca_file_upgrade_csr_dn = 
+	{"cert_requests_dn", "cert_requests", NULL, (gpointer (*) (const gchar *)) tls_parse_csr_pem, 
+	 (GDestroyNotify) tls_csr_free, __ca_file_upgrade_write_csr_dn};
+static const CaFileUpgradeStep ca_file_upgrade_subject_key_id = 
+	{"subject_key_id", "certificates", NULL, (gpointer (*) (const gchar *)) tls_parse_cert_pem, 
+	 (GDestroyNotify) tls_cert_free, __ca_file_upgrade_write_subject_key_id};
+static const CaFileUpgradeStep ca_file_upgrade_issuer_key_id = 
+	{"issuer_key_id", "certificates", NULL, (gpointer (*) (const gchar *)) tls_parse_cert_pem, 
+	 (GDestroyNotify) tls_cert_free, __ca_file_upgrade_write_issuer_key_id};
+static const CaFileUpgradeStep ca_file_upgrade_search_index = 
+	{"certificates_search", "certificates", "serial", (gpointer (*) (const gchar *)) tls_parse_cert_pem, 
+	 (GDestroyNotify) tls_cert_free, __ca_file_upgrade_write_search_index};
+
+void ca_file_set_upgrade_progress_func (CaFileUpgradeProgressFunc func, gpointer user_data)
+{
+	ca_file_upgrade_progress_func = func;
+	ca_file_upgrade_progress_data = user_data;
+}
+
+/* Steps are marked as started in the same transaction that changes the schema, so an interrupted
+   upgrade doesn't change it again, and goes on with the rows after the last saved one */
+gboolean __ca_file_upgrade_step_started (sqlite3 *db, const gchar *name)
+{
+	gchar **row;
+	gboolean result;
+
+	sqlite3_exec (db, "CREATE TABLE IF NOT EXISTS upgrade_progress (step TEXT PRIMARY KEY, last_id INTEGER);", NULL, NULL, NULL);
+
+	row = __ca_file_get_single_row (db, "SELECT COUNT(*) FROM upgrade_progress WHERE step='%q';", name);
+	result = (row && atoi (row[0]));
+	g_strfreev (row);
+
+	return result;
+}
+
+gchar * __ca_file_upgrade_step_begin (sqlite3 *db, const gchar *name)
+{
+	gchar *error = NULL;
+	gchar *sql = sqlite3_mprintf ("INSERT OR REPLACE INTO upgrade_progress VALUES ('%q', 0);", name);
+
+	sqlite3_exec (db, sql, NULL, NULL, &error);
+	sqlite3_free (sql);
+
+	return error;
+}
+
+gchar * __ca_file_upgrade_step_end (sqlite3 *db, const gchar *name)
+{
+	gchar *error = NULL;
+	gchar *sql = sqlite3_mprintf ("DELETE FROM upgrade_progress WHERE step='%q';", name);
+
+	sqlite3_exec (db, sql, NULL, NULL, &error);
+	sqlite3_free (sql);
+
+	return error;
+}
+
+void __ca_file_upgrade_parse_row (gpointer data, gpointer user_data)
+{
+	CaFileUpgradeRow *row = (CaFileUpgradeRow *) data;
+	const CaFileUpgradeStep *step = (const CaFileUpgradeStep *) user_data;
+
+	if (row->pem)
+		row->parsed = step->parse (row->pem);
+}
+
+void __ca_file_upgrade_row_free (CaFileUpgradeRow *row, const CaFileUpgradeStep *step)
+{
+	if (row->parsed)
+		step->free (row->parsed);
+	g_free (row->pem);
+	g_free (row->extra);
+	g_free (row);
+}
+
+gchar * __ca_file_upgrade_rows (sqlite3 *db, const CaFileUpgradeStep *step)
+{
+	sqlite3_stmt *stmt = NULL;
+	GPtrArray *rows;
+	GThreadPool *pool;
+	CaFileUpgradeRow *row;
+	gchar **aux;
+	gchar *sql;
+	gchar *error = NULL;
+	guint64 last_id = 0;
+	guint64 done = 0;
+	guint64 total = 0;
+	guint i;
+
+	aux = __ca_file_get_single_row (db, "SELECT last_id FROM upgrade_progress WHERE step='%q';", step->name);
+	if (aux && aux[0])
+		last_id = atoll (aux[0]);
+	g_strfreev (aux);
+
+	aux = __ca_file_get_single_row (db, "SELECT COUNT(*) FROM %s WHERE id > %"GNOMINT_GUINT64_FORMAT";", step->table, last_id);
+	if (aux && aux[0])
+		total = atoll (aux[0]);
+	g_strfreev (aux);
+
+	sql = sqlite3_mprintf ("SELECT id, pem%s%s FROM %s WHERE id > ?1 ORDER BY id LIMIT %d;", 
+			       (step->extra_column ? ", " : ""), (step->extra_column ? step->extra_column : ""),
+			       step->table, CA_FILE_UPGRADE_CHUNK_ROWS);
+	if (sqlite3_prepare_v2 (db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+		sqlite3_free (sql);
+		return sqlite3_mprintf ("%s", sqlite3_errmsg (db));
+	}
+	sqlite3_free (sql);
+
+	rows = g_ptr_array_new ();
+
+	while (TRUE) {
+		sqlite3_bind_int64 (stmt, 1, last_id);
+		while (sqlite3_step (stmt) == SQLITE_ROW) {
+			row = g_new0 (CaFileUpgradeRow, 1);
+			row->id = sqlite3_column_int64 (stmt, 0);
+			row->pem = g_strdup ((const gchar *) sqlite3_column_text (stmt, 1));
+			if (step->extra_column)
+				row->extra = g_strdup ((const gchar *) sqlite3_column_text (stmt, 2));
+			g_ptr_array_add (rows, row);
+		}
+		sqlite3_reset (stmt);
+
+		if (rows->len == 0)
+			break;
+
+		pool = g_thread_pool_new (__ca_file_upgrade_parse_row, (gpointer) step, CA_FILE_UPGRADE_THREADS, FALSE, NULL);
+		for (i = 0; i < rows->len; i++)
+			g_thread_pool_push (pool, g_ptr_array_index (rows, i), NULL);
+		g_thread_pool_free (pool, FALSE, TRUE);
+
+		last_id = ((CaFileUpgradeRow *) g_ptr_array_index (rows, rows->len - 1))->id;
+
+		if (! sqlite3_exec (db, "BEGIN TRANSACTION;", NULL, NULL, &error)) {
+			for (i = 0; i < rows->len && ! error; i++) {
+				row = g_ptr_array_index (rows, i);
+				if (row->parsed)
+					error = step->write (db, row);
+			}
+
+			if (! error) {
+				sql = sqlite3_mprintf ("UPDATE upgrade_progress SET last_id=%"GNOMINT_GUINT64_FORMAT" WHERE step='%q';", 
+						       last_id, step->name);
+				if (! sqlite3_exec (db, sql, NULL, NULL, &error))
+					sqlite3_exec (db, "COMMIT;", NULL, NULL, &error);
+				sqlite3_free (sql);
+			}
+
+			if (error)
+				sqlite3_exec (db, "ROLLBACK;", NULL, NULL, NULL);
+		}
+
+		done += rows->len;
+		for (i = 0; i < rows->len; i++)
+			__ca_file_upgrade_row_free (g_ptr_array_index (rows, i), step);
+		g_ptr_array_set_size (rows, 0);
+
+		if (error)
+			break;
+
+		if (ca_file_upgrade_progress_func)
+			ca_file_upgrade_progress_func (step->name, done, total, ca_file_upgrade_progress_data);
+		else
+			fprintf (stderr, "Upgrading database (%s): %"GNOMINT_GUINT64_FORMAT"/%"GNOMINT_GUINT64_FORMAT"\r", 
+				 step->name, done, total);
+	}
+
+	if (done && ! ca_file_upgrade_progress_func)
+		fprintf (stderr, "\n");
+
+	g_ptr_array_free (rows, TRUE);
+	sqlite3_finalize (stmt);
+
+	return error;
+}
+
+gchar * __ca_file_upgrade_write_crt_dn (sqlite3 *db, const CaFileUpgradeRow *row)
+{
+	TlsCert *tls_cert = (TlsCert *) row->parsed;
+	gchar *error = NULL;
+	gchar *sql = sqlite3_mprintf ("UPDATE certificates SET dn='%q', parent_dn='%q' WHERE id=%"GNOMINT_GUINT64_FORMAT";",
+				      tls_cert->dn, tls_cert->i_dn, row->id);
+
+	sqlite3_exec (db, sql, NULL, NULL, &error);
+	sqlite3_free (sql);
+
+	return error;
+}
+
+gchar * __ca_file_upgrade_write_csr_dn (sqlite3 *db, const CaFileUpgradeRow *row)
+{
+	TlsCsr *tls_csr = (TlsCsr *) row->parsed;
+	gchar *error = NULL;
+	gchar *sql = sqlite3_mprintf ("UPDATE cert_requests SET dn='%q' WHERE id=%"GNOMINT_GUINT64_FORMAT";",
+				      tls_csr->dn, row->id);
+
+	sqlite3_exec (db, sql, NULL, NULL, &error);
+	sqlite3_free (sql);
+
+	return error;
+}
+
+gchar * __ca_file_upgrade_write_subject_key_id (sqlite3 *db, const CaFileUpgradeRow *row)
+{
+	TlsCert *tls_cert = (TlsCert *) row->parsed;
+	gchar *error = NULL;
+	gchar *sql;
+
+	if (! tls_cert->subject_key_id)
+		return NULL;
+
+	sql = sqlite3_mprintf ("UPDATE certificates SET subject_key_id='%q' WHERE id=%"GNOMINT_GUINT64_FORMAT";",
+			       tls_cert->subject_key_id, row->id);
+	sqlite3_exec (db, sql, NULL, NULL, &error);
+	sqlite3_free (sql);
+
+	return error;
+}
+
+gchar * __ca_file_upgrade_write_issuer_key_id (sqlite3 *db, const CaFileUpgradeRow *row)
+{
+	TlsCert *tls_cert = (TlsCert *) row->parsed;
+	gchar *error = NULL;
+	gchar *sql;
+
+	if (! tls_cert->issuer_key_id)
+		return NULL;
+
+	sql = sqlite3_mprintf ("UPDATE certificates SET issuer_key_id='%q' WHERE id=%"GNOMINT_GUINT64_FORMAT";",
+			       tls_cert->issuer_key_id, row->id);
+	sqlite3_exec (db, sql, NULL, NULL, &error);
+	sqlite3_free (sql);
+
+	return error;
+}
+
+gchar * __ca_file_upgrade_write_search_index (sqlite3 *db, const CaFileUpgradeRow *row)
+{
+	return __ca_file_search_index_crt (db, row->id, (row->extra ? row->extra : ""), (TlsCert *) row->parsed);
+}
+
+/* The version is also kept in the database header, so an up-to-date
+   database is recognized without reading any table */
+gchar * __ca_file_set_user_version (sqlite3 *db)
+{
+	gchar *error = NULL;
+	gchar *sql = sqlite3_mprintf ("PRAGMA user_version = %d;", CURRENT_GNOMINT_DB_VERSION);
+
+	sqlite3_exec (db, sql, NULL, NULL, &error);
+	sqlite3_free (sql);
+
+	return error;
+}
+
 gchar * __ca_file_check_and_update_version (sqlite3 * ca_checking_db)
 {
 	gchar ** result = NULL;
@@ -284,11 +833,19 @@ gchar * __ca_file_check_and_update_version (sqlite3 * ca_checking_db)
 	gchar * sql = NULL;
 	gchar * error = NULL;
 
+	result = __ca_file_get_single_row (ca_checking_db, "PRAGMA user_version;");
+	if (result && result[0] && atoi(result[0]) == CURRENT_GNOMINT_DB_VERSION) {
+		g_strfreev (result);
+		return NULL;
+	}
+	g_strfreev (result);
+
+	// Databases created before the version was kept in the header
 	result = __ca_file_get_single_row (ca_checking_db, "SELECT value FROM ca_properties WHERE name = 'ca_db_version';");
 
 	if (result && result[0] && atoi(result[0]) == CURRENT_GNOMINT_DB_VERSION) {
 		g_strfreev (result);
-		return NULL;
+		return __ca_file_set_user_version (ca_checking_db);
 	}
 
 	if (!result || !result[0]) {
@@ -332,103 +889,71 @@ gchar * __ca_file_check_and_update_version (sqlite3 * ca_checking_db)
 		}
 
 	case 2:
-		if (sqlite3_exec (ca_checking_db, "BEGIN TRANSACTION;", NULL, NULL, &error)){
-			return error;
-		}
-
-		if (sqlite3_exec (ca_checking_db,
-				  "ALTER TABLE certificates ADD dn TEXT; ALTER TABLE certificates ADD parent_dn TEXT;",
-				  NULL, NULL, &error)){
-			return error;
-		}
-
-		{
-			gchar **cert_table;
-			gint rows, cols;
-			gint i;
-			if (sqlite3_get_table (ca_checking_db, 
-					       "SELECT id, pem FROM certificates;",
-					       &cert_table,
-					       &rows,
-					       &cols,
-					       &error)) {
+		if (! __ca_file_upgrade_step_started (ca_checking_db, ca_file_upgrade_crt_dn.name)) {
+			if (sqlite3_exec (ca_checking_db, "BEGIN TRANSACTION;", NULL, NULL, &error)){
 				return error;
 			}
-			for (i = 0; i < rows; i++) {
-				TlsCert * tls_cert = tls_parse_cert_pem (cert_table[(i*2)+3]);			       				
-				sql = sqlite3_mprintf ("UPDATE certificates SET dn='%q', parent_dn='%q' WHERE id=%s;",
-						       tls_cert->dn, tls_cert->i_dn, cert_table[(i*2)+2]);
-
-				if (sqlite3_exec (ca_checking_db, sql, NULL, NULL, &error)){
-					return error;
-				}
 
-				tls_cert_free (tls_cert);
-				tls_cert = NULL;
+			if (sqlite3_exec (ca_checking_db,
+					  "ALTER TABLE certificates ADD dn TEXT; ALTER TABLE certificates ADD parent_dn TEXT;",
+					  NULL, NULL, &error)){
+				return error;
 			}
 
-			sqlite3_free_table (cert_table);
-
-		}
-
-		if (sqlite3_exec (ca_checking_db,
-				  "CREATE TABLE cert_requests_new (id INTEGER PRIMARY KEY, subject TEXT, pem TEXT, private_key_in_db BOOLEAN, private_key TEXT, dn TEXT UNIQUE);",
-				  NULL, NULL, &error)){
-			return error;
-		}
+			if (sqlite3_exec (ca_checking_db,
+					  "CREATE TABLE cert_requests_new (id INTEGER PRIMARY KEY, subject TEXT, pem TEXT, private_key_in_db BOOLEAN, private_key TEXT, dn TEXT UNIQUE);",
+					  NULL, NULL, &error)){
+				return error;
+			}
 		
-		if (sqlite3_exec (ca_checking_db,
-				  "INSERT OR REPLACE INTO cert_requests_new SELECT *, NULL FROM cert_requests;",
-				  NULL, NULL, &error)){
-			return error;
-		}
+			if (sqlite3_exec (ca_checking_db,
+					  "INSERT OR REPLACE INTO cert_requests_new SELECT *, NULL FROM cert_requests;",
+					  NULL, NULL, &error)){
+				return error;
+			}
 		
-		if (sqlite3_exec (ca_checking_db,
-				  "DROP TABLE cert_requests;",
-				  NULL, NULL, &error)){
-			return error;
-		}
-
-		if (sqlite3_exec (ca_checking_db,
-				  "ALTER TABLE cert_requests_new RENAME TO cert_requests;",
-				  NULL, NULL, &error)){
-			return error;
-		}
+			if (sqlite3_exec (ca_checking_db,
+					  "DROP TABLE cert_requests;",
+					  NULL, NULL, &error)){
+				return error;
+			}
 
-		{
-			gchar **csr_table;
-			gint rows, cols;
-			gint i;
-			if (sqlite3_get_table (ca_checking_db, 
-					       "SELECT id, pem FROM cert_requests;",
-					       &csr_table,
-					       &rows,
-					       &cols,
-					       &error)) {
+			if (sqlite3_exec (ca_checking_db,
+					  "ALTER TABLE cert_requests_new RENAME TO cert_requests;",
+					  NULL, NULL, &error)){
 				return error;
 			}
-			for (i = 0; i < rows; i++) {
-				TlsCsr * tls_csr = tls_parse_csr_pem (csr_table[(i*2)+3]);			       				
-				sql = sqlite3_mprintf ("UPDATE cert_requests SET dn='%q' WHERE id=%s;",
-						       tls_csr->dn, csr_table[(i*2)+2]);
 
-				if (sqlite3_exec (ca_checking_db, sql, NULL, NULL, &error)){
-					return error;
-				}
+			if ((error = __ca_file_upgrade_step_begin (ca_checking_db, ca_file_upgrade_crt_dn.name)))
+				return error;
+			if ((error = __ca_file_upgrade_step_begin (ca_checking_db, ca_file_upgrade_csr_dn.name)))
+				return error;
 
-				tls_csr_free (tls_csr);
-				tls_csr = NULL;
+			if (sqlite3_exec (ca_checking_db, "COMMIT;", NULL, NULL, &error)){
+				return error;
 			}
+		}
+
+		if ((error = __ca_file_upgrade_rows (ca_checking_db, &ca_file_upgrade_crt_dn)))
+			return error;
 
-			sqlite3_free_table (csr_table);
+		if ((error = __ca_file_upgrade_rows (ca_checking_db, &ca_file_upgrade_csr_dn)))
+			return error;
 
+		if (sqlite3_exec (ca_checking_db, "BEGIN TRANSACTION;", NULL, NULL, &error)){
+			return error;
 		}
-		
+
 		sql = sqlite3_mprintf ("UPDATE ca_properties SET value=%d WHERE name='ca_db_version';", 3);
 		if (sqlite3_exec (ca_checking_db, sql, NULL, NULL, &error)){
 			return error;
 		}
 		sqlite3_free (sql);
+
+		if ((error = __ca_file_upgrade_step_end (ca_checking_db, ca_file_upgrade_crt_dn.name)))
+			return error;
+		if ((error = __ca_file_upgrade_step_end (ca_checking_db, ca_file_upgrade_csr_dn.name)))
+			return error;
 		
 		if (sqlite3_exec (ca_checking_db, "COMMIT;", NULL, NULL, &error)){
 			return error;
@@ -728,44 +1253,27 @@ gchar * __ca_file_check_and_update_version (sqlite3 * ca_checking_db)
 
 
         case 8:
-		if (sqlite3_exec (ca_checking_db, "BEGIN TRANSACTION;", NULL, NULL, &error)) {
-			return error;
-		}
-
-                
-		if (sqlite3_exec (ca_checking_db, "ALTER TABLE certificates ADD COLUMN subject_key_id TEXT DEFAULT NULL;", NULL, NULL, &error)) {
-			return error;
-		}
-
-		{
-			gchar **cert_table;
-			gint rows, cols;
-			gint i;
-			if (sqlite3_get_table (ca_checking_db, 
-					       "SELECT id, pem FROM certificates;",
-					       &cert_table,
-					       &rows,
-					       &cols,
-					       &error)) {
+		if (! __ca_file_upgrade_step_started (ca_checking_db, ca_file_upgrade_subject_key_id.name)) {
+			if (sqlite3_exec (ca_checking_db, "BEGIN TRANSACTION;", NULL, NULL, &error)) {
 				return error;
 			}
-			for (i = 0; i < rows; i++) {
-                                TlsCert *tls_cert = tls_parse_cert_pem (cert_table[(i*2)+3]);
-                                if (tls_cert->subject_key_id) {
-                                        sql = sqlite3_mprintf ("UPDATE certificates SET subject_key_id='%q' WHERE id='%q';",
-                                                               tls_cert->subject_key_id, cert_table[(i*2)+2]);
-                                        
-                                        if (sqlite3_exec (ca_checking_db, sql, NULL, NULL, &error)){
-                                                return error;
-                                        }
-                                        sqlite3_free (sql);
-                                }
-                                tls_cert_free(tls_cert);
-                                        
+
+			if (sqlite3_exec (ca_checking_db, "ALTER TABLE certificates ADD COLUMN subject_key_id TEXT DEFAULT NULL;", NULL, NULL, &error)) {
+				return error;
 			}
 
-			sqlite3_free_table (cert_table);
+			if ((error = __ca_file_upgrade_step_begin (ca_checking_db, ca_file_upgrade_subject_key_id.name)))
+				return error;
+
+			if (sqlite3_exec (ca_checking_db, "COMMIT;", NULL, NULL, &error))
+				return error;
+		}
+
+		if ((error = __ca_file_upgrade_rows (ca_checking_db, &ca_file_upgrade_subject_key_id)))
+			return error;
 
+		if (sqlite3_exec (ca_checking_db, "BEGIN TRANSACTION;", NULL, NULL, &error)) {
+			return error;
 		}
 
 		sql = sqlite3_mprintf ("UPDATE ca_properties SET value=%d WHERE name='ca_db_version' AND ca_id=0;", 9);
@@ -774,49 +1282,35 @@ gchar * __ca_file_check_and_update_version (sqlite3 * ca_checking_db)
 		}
 		sqlite3_free (sql);
 
+		if ((error = __ca_file_upgrade_step_end (ca_checking_db, ca_file_upgrade_subject_key_id.name)))
+			return error;
 
 		if (sqlite3_exec (ca_checking_db, "COMMIT;", NULL, NULL, &error))
 			return error;
 
 
         case 9:
-		if (sqlite3_exec (ca_checking_db, "BEGIN TRANSACTION;", NULL, NULL, &error)) {
-			return error;
-		}
-
-                
-		if (sqlite3_exec (ca_checking_db, "ALTER TABLE certificates ADD COLUMN issuer_key_id TEXT DEFAULT NULL;", NULL, NULL, &error)) {
-			return error;
-		}
-
-		{
-			gchar **cert_table;
-			gint rows, cols;
-			gint i;
-			if (sqlite3_get_table (ca_checking_db, 
-					       "SELECT id, pem FROM certificates;",
-					       &cert_table,
-					       &rows,
-					       &cols,
-					       &error)) {
+		if (! __ca_file_upgrade_step_started (ca_checking_db, ca_file_upgrade_issuer_key_id.name)) {
+			if (sqlite3_exec (ca_checking_db, "BEGIN TRANSACTION;", NULL, NULL, &error)) {
 				return error;
 			}
-			for (i = 0; i < rows; i++) {
-                                TlsCert *tls_cert = tls_parse_cert_pem (cert_table[(i*2)+3]);
-                                if (tls_cert->issuer_key_id) {
-                                        sql = sqlite3_mprintf ("UPDATE certificates SET issuer_key_id='%q' WHERE id='%q';",
-                                                               tls_cert->issuer_key_id, cert_table[(i*2)+2]);
-                                        
-                                        if (sqlite3_exec (ca_checking_db, sql, NULL, NULL, &error)){
-                                                return error;
-                                        }
-                                        sqlite3_free (sql);
-                                }
-                                tls_cert_free(tls_cert);
+
+			if (sqlite3_exec (ca_checking_db, "ALTER TABLE certificates ADD COLUMN issuer_key_id TEXT DEFAULT NULL;", NULL, NULL, &error)) {
+				return error;
 			}
 
-			sqlite3_free_table (cert_table);
+			if ((error = __ca_file_upgrade_step_begin (ca_checking_db, ca_file_upgrade_issuer_key_id.name)))
+				return error;
+
+			if (sqlite3_exec (ca_checking_db, "COMMIT;", NULL, NULL, &error))
+				return error;
+		}
+
+		if ((error = __ca_file_upgrade_rows (ca_checking_db, &ca_file_upgrade_issuer_key_id)))
+			return error;
 
+		if (sqlite3_exec (ca_checking_db, "BEGIN TRANSACTION;", NULL, NULL, &error)) {
+			return error;
 		}
 
 		sql = sqlite3_mprintf ("UPDATE ca_properties SET value=%d WHERE name='ca_db_version' AND ca_id=0;", 10);
@@ -825,6 +1319,8 @@ gchar * __ca_file_check_and_update_version (sqlite3 * ca_checking_db)
 		}
 		sqlite3_free (sql);
 
+		if ((error = __ca_file_upgrade_step_end (ca_checking_db, ca_file_upgrade_issuer_key_id.name)))
+			return error;
 
 		if (sqlite3_exec (ca_checking_db, "COMMIT;", NULL, NULL, &error))
 			return error;
@@ -989,144 +1485,1142 @@ gchar * __ca_file_check_and_update_version (sqlite3 * ca_checking_db)
 
 
 	case 12:
+		if (sqlite3_exec (ca_checking_db, "BEGIN TRANSACTION;", NULL, NULL, &error))
+			return error;
+
+		if (sqlite3_exec (ca_checking_db,
+				  "CREATE INDEX certificates_parent_id_idx ON certificates (parent_id, id);",
+				  NULL, NULL, &error)) {
+			return error;
+		}
+
+		if (sqlite3_exec (ca_checking_db,
+				  "CREATE INDEX certificates_subject_idx ON certificates (subject);",
+				  NULL, NULL, &error)) {
+			return error;
+		}
+
+		sql = sqlite3_mprintf ("UPDATE db_properties SET value=%d WHERE name='ca_db_version';", 13);
+		if (sqlite3_exec (ca_checking_db, sql, NULL, NULL, &error)){
+			return error;
+		}
+		sqlite3_free (sql);
+
+		if (sqlite3_exec (ca_checking_db, "COMMIT;", NULL, NULL, &error))
+			return error;
+
+	case 13:
+		if (sqlite3_exec (ca_checking_db, "BEGIN TRANSACTION;", NULL, NULL, &error))
+			return error;
+
+		if (sqlite3_exec (ca_checking_db,
+				  "CREATE INDEX certificates_parent_route_idx ON certificates (parent_route, revocation, id);",
+				  NULL, NULL, &error)) {
+			return error;
+		}
+
+		sql = sqlite3_mprintf ("UPDATE db_properties SET value=%d WHERE name='ca_db_version';", 14);
+		if (sqlite3_exec (ca_checking_db, sql, NULL, NULL, &error)){
+			return error;
+		}
+		sqlite3_free (sql);
+
+		if (sqlite3_exec (ca_checking_db, "COMMIT;", NULL, NULL, &error))
+			return error;
+
+	case 14:
+		if (! __ca_file_upgrade_step_started (ca_checking_db, ca_file_upgrade_search_index.name)) {
+			if (sqlite3_exec (ca_checking_db, "BEGIN TRANSACTION;", NULL, NULL, &error))
+				return error;
+
+			if (sqlite3_exec (ca_checking_db,
+					  "CREATE VIRTUAL TABLE certificates_search USING fts5 (subject, dn, parent_dn, serial, fingerprints);",
+					  NULL, NULL, &error)) {
+				return error;
+			}
+
+			if ((error = __ca_file_upgrade_step_begin (ca_checking_db, ca_file_upgrade_search_index.name)))
+				return error;
+
+			if (sqlite3_exec (ca_checking_db, "COMMIT;", NULL, NULL, &error))
+				return error;
+		}
+
+		// Fingerprints are not stored in the database, so every certificate must be parsed
+		if ((error = __ca_file_upgrade_rows (ca_checking_db, &ca_file_upgrade_search_index)))
+			return error;
+
+		if (sqlite3_exec (ca_checking_db, "BEGIN TRANSACTION;", NULL, NULL, &error))
+			return error;
+
+		sql = sqlite3_mprintf ("UPDATE db_properties SET value=%d WHERE name='ca_db_version';", 15);
+		if (sqlite3_exec (ca_checking_db, sql, NULL, NULL, &error)){
+			return error;
+		}
+		sqlite3_free (sql);
+
+		if ((error = __ca_file_upgrade_step_end (ca_checking_db, ca_file_upgrade_search_index.name)))
+			return error;
+
+		if (sqlite3_exec (ca_checking_db, "COMMIT;", NULL, NULL, &error))
+			return error;
+
+	case 15:
+		if (sqlite3_exec (ca_checking_db, "BEGIN TRANSACTION;", NULL, NULL, &error))
+			return error;
+
+		if (sqlite3_exec (ca_checking_db,
+				  "CREATE INDEX certificates_expiration_idx ON certificates (expiration);",
+				  NULL, NULL, &error)) {
+			return error;
+		}
+
+		sql = sqlite3_mprintf ("UPDATE db_properties SET value=%d WHERE name='ca_db_version';", 16);
+		if (sqlite3_exec (ca_checking_db, sql, NULL, NULL, &error)){
+			return error;
+		}
+		sqlite3_free (sql);
+
+		if (sqlite3_exec (ca_checking_db, "COMMIT;", NULL, NULL, &error))
+			return error;
+
+	case 16:
+		if (sqlite3_exec (ca_checking_db, "BEGIN TRANSACTION;", NULL, NULL, &error))
+			return error;
+
+		if ((error = __ca_file_create_counters (ca_checking_db)))
+			return error;
+
+		sql = sqlite3_mprintf ("UPDATE db_properties SET value=%d WHERE name='ca_db_version';", 17);
+		if (sqlite3_exec (ca_checking_db, sql, NULL, NULL, &error)){
+			return error;
+		}
+		sqlite3_free (sql);
+
+		if (sqlite3_exec (ca_checking_db, "COMMIT;", NULL, NULL, &error))
+			return error;
+
+	case 17:
+		if (sqlite3_exec (ca_checking_db, "BEGIN TRANSACTION;", NULL, NULL, &error))
+			return error;
+
+		if (sqlite3_exec (ca_checking_db,
+				  "CREATE TABLE ca_profiles (id INTEGER PRIMARY KEY AUTOINCREMENT, ca_id INTEGER, name TEXT, "
+				  "months_to_expire INTEGER, uses INTEGER, crl_distribution_point TEXT, UNIQUE (ca_id, name));",
+				  NULL, NULL, &error)) {
+			return error;
+		}
+
+		sql = sqlite3_mprintf ("UPDATE db_properties SET value=%d WHERE name='ca_db_version';", 18);
+		if (sqlite3_exec (ca_checking_db, sql, NULL, NULL, &error)){
+			return error;
+		}
+		sqlite3_free (sql);
+
+		if (sqlite3_exec (ca_checking_db, "COMMIT;", NULL, NULL, &error))
+			return error;
+
+	case 18:
+		if (sqlite3_exec (ca_checking_db, "BEGIN TRANSACTION;", NULL, NULL, &error))
+			return error;
+
+		// Serials are also kept in binary form, for comparing and indexing them
+		sqlite3_create_function (ca_checking_db, "serial_blob", 1, SQLITE_ANY, NULL, __ca_file_serial_blob, NULL, NULL);
+
+		if (sqlite3_exec (ca_checking_db,
+				  "ALTER TABLE certificates ADD COLUMN serial_bin BLOB; "
+				  "UPDATE certificates SET serial_bin = serial_blob (serial); "
+				  "CREATE INDEX certificates_serial_idx ON certificates (parent_id, serial_bin);",
+				  NULL, NULL, &error)) {
+			return error;
+		}
+
+		sql = sqlite3_mprintf ("UPDATE db_properties SET value=%d WHERE name='ca_db_version';", 19);
+		if (sqlite3_exec (ca_checking_db, sql, NULL, NULL, &error)){
+			return error;
+		}
+		sqlite3_free (sql);
+
+		if (sqlite3_exec (ca_checking_db, "COMMIT;", NULL, NULL, &error))
+			return error;
+
+	case 19:
+		if (sqlite3_exec (ca_checking_db, "BEGIN TRANSACTION;", NULL, NULL, &error))
+			return error;
+
+		// Pre-generated key pairs for new CSRs
+		if (sqlite3_exec (ca_checking_db,
+				  "CREATE TABLE key_pool (id INTEGER PRIMARY KEY, key_type INTEGER, key_bitlength INTEGER, "
+				  "private_key TEXT); "
+				  "CREATE TABLE key_pool_sizes (key_type INTEGER, key_bitlength INTEGER, size INTEGER, "
+				  "PRIMARY KEY (key_type, key_bitlength));",
+				  NULL, NULL, &error)) {
+			return error;
+		}
+
+		sql = sqlite3_mprintf ("UPDATE db_properties SET value=%d WHERE name='ca_db_version';", 20);
+		if (sqlite3_exec (ca_checking_db, sql, NULL, NULL, &error)){
+			return error;
+		}
+		sqlite3_free (sql);
+
+		if (sqlite3_exec (ca_checking_db, "COMMIT;", NULL, NULL, &error))
+			return error;
+
+	case 20:
+		if (sqlite3_exec (ca_checking_db, "BEGIN TRANSACTION;", NULL, NULL, &error))
+			return error;
+
+		// The last CRL of each CA is kept, to reuse it while nothing changes
+		if (sqlite3_exec (ca_checking_db,
+				  "ALTER TABLE ca_crl ADD COLUMN next_update TIMESTAMP; "
+				  "ALTER TABLE ca_crl ADD COLUMN input_digest TEXT; "
+				  "ALTER TABLE ca_crl ADD COLUMN pem TEXT;",
+				  NULL, NULL, &error)) {
+			return error;
+		}
+
+		sql = sqlite3_mprintf ("UPDATE db_properties SET value=%d WHERE name='ca_db_version';", 21);
+		if (sqlite3_exec (ca_checking_db, sql, NULL, NULL, &error)){
+			return error;
+		}
+		sqlite3_free (sql);
+
+		if (sqlite3_exec (ca_checking_db, "COMMIT;", NULL, NULL, &error))
+			return error;
+
+	case 21:
 		/* Nothing must be done, as this is the current gnoMint db version */
 		break;
 	}
+
+	sqlite3_exec (ca_checking_db, "DROP TABLE IF EXISTS upgrade_progress;", NULL, NULL, NULL);
 	
-	return NULL;
+	return __ca_file_set_user_version (ca_checking_db);
 }
 
-gboolean ca_file_open (gchar *file_name, gboolean create)
+gint __ca_file_get_slow_query_threshold ()
 {
-        gchar *dirname = NULL;
-        gchar *error = NULL;
-        sqlite3 * ca_opening_db = NULL;
+	gint threshold = g_atomic_int_get (&ca_file_slow_query_threshold);
+	const gchar *env;
 
+	if (threshold < 0) {
+		env = g_getenv ("GNOMINT_SLOW_QUERY_MS");
+		threshold = (env ? MAX (atoi (env), 0) : 0);
+		g_atomic_int_set (&ca_file_slow_query_threshold, threshold);
+	}
 
-        dirname = g_path_get_dirname (file_name);
+	return threshold;
+}
 
-        if (! g_file_test(dirname, G_FILE_TEST_IS_DIR)) {
-                if (! create) {
-                        g_free (dirname);
-                        return FALSE;
-                } else {
-                        if (g_mkdir_with_parents (dirname, 0700) == -1) {
-                                g_free (dirname);
-                                return FALSE;
-                        }
-                }
-        }
-        g_free (dirname);
+void ca_file_set_slow_query_threshold (gint threshold_ms)
+{
+	if (g_getenv ("GNOMINT_SLOW_QUERY_MS"))
+		return;
 
+	g_atomic_int_set (&ca_file_slow_query_threshold, MAX (threshold_ms, 0));
 
-	if (! g_file_test(file_name, G_FILE_TEST_EXISTS)) {
-                if (! create)
-                        return FALSE;
-                else
-                        ca_file_create (file_name);
-        }
+	// The other connections follow it the next time they are used
+	if (ca_file_get_current ())
+		__ca_file_connection_update_trace (__ca_file_get_connection ());
+}
 
-	if (sqlite3_open(file_name, &ca_opening_db)) {
-		g_printerr ("%s\n\n", sqlite3_errmsg(ca_opening_db));
-		return FALSE;
-	} else {
-                error = __ca_file_check_and_update_version (ca_opening_db); 
-		if (error) {
-                        fprintf (stderr, "Error while updating version: %s\n", error);
-                        //g_free (error); It mustn't be freed: it is always constant
-                        sqlite3_close (ca_opening_db);
-                        ca_opening_db = NULL;
-                        return FALSE;
-                }
-	}
+/* Each statement run through any connection is recorded as a STATS_DB_QUERY, and the
+   ones slower than the threshold are written to stderr */
 
-        gnomint_current_opened_file = file_name;
-        if (ca_db) {
-                sqlite3_close (ca_db);
-                ca_db = NULL;
-        }
+/* Statements are written without their string literals, as they can hold private keys
+   or passwords: each of them is shown as '?'. The result is cut at CA_FILE_SLOW_QUERY_MAX_SQL */
+gchar * __ca_file_trace_strip_literals (const gchar *sql)
+{
+	GString *res = g_string_sized_new (MIN (strlen (sql), CA_FILE_SLOW_QUERY_MAX_SQL) + 4);
+	const gchar *c = sql;
+
+	while (*c && res->len < CA_FILE_SLOW_QUERY_MAX_SQL) {
+		if (*c != '\'') {
+			g_string_append_c (res, *c);
+			c++;
+			continue;
+		}
 
-        ca_db = ca_opening_db;
+		// Quotes inside a literal are written twice, so they just start another one
+		do {
+			c++;
+			while (*c && *c != '\'')
+				c++;
+			if (*c)
+				c++;
+		} while (*c == '\'');
 
-        sqlite3_create_function (ca_db, "concat", -1, SQLITE_ANY, NULL, __ca_file_concat_string, NULL, NULL);
-        sqlite3_create_function (ca_db, "zeropad", 2, SQLITE_ANY, NULL, __ca_file_zeropad, NULL, NULL);
-        sqlite3_create_function (ca_db, "zeropad_route", 2, SQLITE_ANY, NULL, __ca_file_zeropad_route, NULL, NULL);
+		g_string_append (res, "'?'");
+	}
 
-        return TRUE;
+	if (*c)
+		g_string_append (res, "...");
+
+	return g_string_free (res, FALSE);
 }
 
-void ca_file_close ()
+#if SQLITE_VERSION_NUMBER >= 3014000
+void __ca_file_trace_explain (CaFileConnection *connection, sqlite3_stmt *stmt)
 {
-	sqlite3_close (ca_db);
-	ca_db = NULL;
+	sqlite3_stmt *explain_stmt = NULL;
+	gchar *sql = sqlite3_mprintf ("EXPLAIN QUERY PLAN %s", sqlite3_sql (stmt));
+
+	// The plan is read through the same connection, so its own trace is ignored
+	connection->trace_explaining = TRUE;
+	if (sqlite3_prepare_v2 (connection->db, sql, -1, &explain_stmt, NULL) == SQLITE_OK) {
+		while (sqlite3_step (explain_stmt) == SQLITE_ROW)
+			fprintf (stderr, "    %s\n", sqlite3_column_text (explain_stmt, 3));
+	}
+	sqlite3_finalize (explain_stmt);
+	connection->trace_explaining = FALSE;
+
+	sqlite3_free (sql);
+}
+
+void __ca_file_trace_slow_query (CaFileConnection *connection, sqlite3_stmt *stmt, sqlite3_int64 elapsed)
+{
+	gchar *sql = __ca_file_trace_strip_literals (sqlite3_sql (stmt));
+	guint rows = GPOINTER_TO_UINT (g_hash_table_lookup (connection->trace_rows, stmt));
+	gint full_scan_steps = sqlite3_stmt_status (stmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, 0);
+	gint sorts = sqlite3_stmt_status (stmt, SQLITE_STMTSTATUS_SORT, 0);
+	gint autoindexes = sqlite3_stmt_status (stmt, SQLITE_STMTSTATUS_AUTOINDEX, 0);
+
+	fprintf (stderr, _("Slow query (%.3f ms, %u rows, %d full scan steps): %s\n"),
+		 elapsed / 1000000.0, rows, full_scan_steps, sql);
+	g_free (sql);
+
+	if (full_scan_steps || sorts || autoindexes)
+		__ca_file_trace_explain (connection, stmt);
+}
+
+int __ca_file_trace_cb (unsigned int type, void *context, void *statement, void *elapsed)
+{
+	CaFileConnection *connection = (CaFileConnection *) context;
+	sqlite3_stmt *stmt = (sqlite3_stmt *) statement;
+	gint threshold;
+	guint rows;
+
+	if (connection->trace_explaining)
+		return 0;
+
+	threshold = __ca_file_get_slow_query_threshold ();
+
+	if (type == SQLITE_TRACE_ROW) {
+		if (threshold) {
+			rows = GPOINTER_TO_UINT (g_hash_table_lookup (connection->trace_rows, stmt));
+			g_hash_table_insert (connection->trace_rows, stmt, GUINT_TO_POINTER (rows + 1));
+		}
+		return 0;
+	}
+
+	if (type == SQLITE_TRACE_PROFILE) {
+		stats_record_elapsed (STATS_DB_QUERY, *((sqlite3_int64 *) elapsed) / 1000);
+
+		if (threshold && *((sqlite3_int64 *) elapsed) >= (sqlite3_int64) threshold * 1000000)
+			__ca_file_trace_slow_query (connection, stmt, *((sqlite3_int64 *) elapsed));
+
+		// The scan counters are kept by prepared statement, so they are cleared after each run
+		if (threshold) {
+			sqlite3_stmt_status (stmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, 1);
+			sqlite3_stmt_status (stmt, SQLITE_STMTSTATUS_SORT, 1);
+			sqlite3_stmt_status (stmt, SQLITE_STMTSTATUS_AUTOINDEX, 1);
+		}
+		if (threshold)
+			g_hash_table_remove (connection->trace_rows, stmt);
+	}
+
+	return 0;
+}
+#else
+// Older SQLite versions give neither the rows nor the statement to explain
+void __ca_file_profile_cb (void *context, const char *sql, sqlite3_uint64 elapsed)
+{
+	gint threshold = __ca_file_get_slow_query_threshold ();
+	gchar *stripped;
+
+	stats_record_elapsed (STATS_DB_QUERY, elapsed / 1000);
+
+	if (threshold && elapsed >= (sqlite3_uint64) threshold * 1000000) {
+		stripped = __ca_file_trace_strip_literals (sql);
+		fprintf (stderr, _("Slow query (%.3f ms): %s\n"), elapsed / 1000000.0, stripped);
+		g_free (stripped);
+	}
+}
+#endif
+
+/* Statements are always timed once they finish (SQLITE_TRACE_PROFILE), for the
+   statistics. Their rows are only followed while the slow-query log is on, so
+   each connection starts or stops it the next time it is used by its thread */
+void __ca_file_connection_update_trace (CaFileConnection *connection)
+{
+#if SQLITE_VERSION_NUMBER >= 3014000
+	gboolean rows = (__ca_file_get_slow_query_threshold () > 0);
+
+	if (rows == connection->trace_rows_enabled)
+		return;
+
+	sqlite3_trace_v2 (connection->db, SQLITE_TRACE_PROFILE | (rows ? SQLITE_TRACE_ROW : 0),
+			  __ca_file_trace_cb, connection);
+	connection->trace_rows_enabled = rows;
+	if (! rows)
+		g_hash_table_remove_all (connection->trace_rows);
+#endif
+}
+
+CaFileConnection * __ca_file_connection_new (sqlite3 *db)
+{
+	CaFileConnection *connection = g_new0 (CaFileConnection, 1);
+
+	connection->db = db;
+	connection->policy_cache = g_hash_table_new_full (g_int64_hash, g_int64_equal, g_free, __ca_file_policy_free);
+	connection->profile_cache = g_hash_table_new_full (g_int64_hash, g_int64_equal, g_free, __ca_file_profile_free);
+	connection->trace_rows = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+	sqlite3_busy_timeout (db, CA_FILE_BUSY_TIMEOUT_MS);
+
+        sqlite3_create_function (db, "concat", -1, SQLITE_ANY, NULL, __ca_file_concat_string, NULL, NULL);
+        sqlite3_create_function (db, "zeropad", 2, SQLITE_ANY, NULL, __ca_file_zeropad, NULL, NULL);
+        sqlite3_create_function (db, "zeropad_route", 2, SQLITE_ANY, NULL, __ca_file_zeropad_route, NULL, NULL);
+        sqlite3_create_function (db, "serial_blob", 1, SQLITE_ANY, NULL, __ca_file_serial_blob, NULL, NULL);
+
+#if SQLITE_VERSION_NUMBER >= 3014000
+	sqlite3_trace_v2 (db, SQLITE_TRACE_PROFILE, __ca_file_trace_cb, connection);
+#else
+	sqlite3_profile (db, __ca_file_profile_cb, connection);
+#endif
+	__ca_file_connection_update_trace (connection);
+
+	return connection;
+}
+
+void __ca_file_connection_free (gpointer data)
+{
+	CaFileConnection *connection = (CaFileConnection *) data;
+
+	g_hash_table_destroy (connection->policy_cache);
+	g_hash_table_destroy (connection->profile_cache);
+	sqlite3_close (connection->db);
+	g_hash_table_destroy (connection->trace_rows);
+	g_free (connection);
+}
+
+CaFile * __ca_file_new (const gchar *filename, sqlite3 *db)
+{
+	CaFile *ca_file = g_new0 (CaFile, 1);
+
+	ca_file->filename = g_strdup (filename);
+	ca_file->owner = g_thread_self ();
+	ca_file->owner_connection = __ca_file_connection_new (db);
+
+	g_mutex_init (&ca_file->pool_mutex);
+	ca_file->pool = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, __ca_file_connection_free);
+
+	/* Readers in other threads mustn't block the writer, nor the other way round.
+	   The archive is set in the same mode when attached (__ca_file_attach_archive) */
+	sqlite3_exec (db, "PRAGMA journal_mode=WAL;", NULL, NULL, NULL);
+
+	return ca_file;
+}
+
+void __ca_file_free (CaFile *ca_file)
+{
+	if (g_private_get (&ca_file_current) == ca_file)
+		g_private_set (&ca_file_current, NULL);
+
+	g_hash_table_destroy (ca_file->pool);
+	g_mutex_clear (&ca_file->pool_mutex);
+	__ca_file_connection_free (ca_file->owner_connection);
+	if (ca_file->password) {
+		memset (ca_file->password, 0, strlen (ca_file->password));
+		g_free (ca_file->password);
+	}
+	g_free (ca_file->filename);
+	g_free (ca_file);
+}
+
+CaFileConnection * __ca_file_get_connection ()
+{
+	CaFile *ca_file = ca_file_get_current ();
+	CaFileConnection *connection;
+	sqlite3 *db = NULL;
+	gchar *error;
+
+	if (! ca_file)
+		return NULL;
+
+	if (g_thread_self () == ca_file->owner) {
+		__ca_file_connection_update_trace (ca_file->owner_connection);
+		return ca_file->owner_connection;
+	}
+
+	g_mutex_lock (&ca_file->pool_mutex);
+	connection = g_hash_table_lookup (ca_file->pool, g_thread_self ());
+	g_mutex_unlock (&ca_file->pool_mutex);
+
+	if (connection) {
+		__ca_file_connection_update_trace (connection);
+		return connection;
+	}
+
+	if (sqlite3_open (ca_file->filename, &db)) {
+		g_printerr ("%s\n\n", sqlite3_errmsg (db));
+		sqlite3_close (db);
+		return NULL;
+	}
+
+	connection = __ca_file_connection_new (db);
+
+	g_mutex_lock (&ca_file->pool_mutex);
+	g_hash_table_insert (ca_file->pool, g_thread_self (), connection);
+	g_mutex_unlock (&ca_file->pool_mutex);
+
+	// Now that it is the connection of this thread, it can be prepared as the first one
+	error = __ca_file_attach_archive (FALSE);
+	if (error) {
+		fprintf (stderr, "Error while opening the archive: %s\n", error);
+		sqlite3_free (error);
+	}
+
+	return connection;
+}
+
+sqlite3 * __ca_file_db ()
+{
+	CaFileConnection *connection = __ca_file_get_connection ();
+
+	return (connection ? connection->db : NULL);
+}
+
+CaFile * ca_file_get_current ()
+{
+	CaFile *ca_file = g_private_get (&ca_file_current);
+
+	return (ca_file ? ca_file : ca_file_default);
+}
+
+void ca_file_set_current (CaFile *ca_file)
+{
+	g_private_set (&ca_file_current, ca_file);
+}
+
+void ca_file_release_thread_connection ()
+{
+	CaFile *ca_file = ca_file_get_current ();
+
+	if (! ca_file || g_thread_self () == ca_file->owner)
+		return;
+
+	g_mutex_lock (&ca_file->pool_mutex);
+	g_hash_table_remove (ca_file->pool, g_thread_self ());
+	g_mutex_unlock (&ca_file->pool_mutex);
+}
+
+const gchar * ca_file_get_filename (CaFile *ca_file)
+{
+	return (ca_file ? ca_file->filename : NULL);
+}
+
+void ca_file_set_unlocked_password (const gchar *password)
+{
+	CaFile *ca_file = ca_file_get_current ();
+
+	if (! ca_file)
+		return;
+
+	if (ca_file->password) {
+		memset (ca_file->password, 0, strlen (ca_file->password));
+		g_free (ca_file->password);
+	}
+	ca_file->password = g_strdup (password);
+}
+
+const gchar * ca_file_get_unlocked_password ()
+{
+	CaFile *ca_file = ca_file_get_current ();
+
+	return (ca_file ? ca_file->password : NULL);
+}
+
+CaFile * ca_file_handle_open (const gchar *file_name, gboolean create)
+{
+        gchar *dirname = NULL;
+        gchar *error = NULL;
+        sqlite3 * ca_opening_db = NULL;
+        gint archive_after_days;
+        CaFile *ca_file = NULL;
+        CaFile *previous = NULL;
+
+
+        dirname = g_path_get_dirname (file_name);
+
+        if (! g_file_test(dirname, G_FILE_TEST_IS_DIR)) {
+                if (! create) {
+                        g_free (dirname);
+                        return NULL;
+                } else {
+                        if (g_mkdir_with_parents (dirname, 0700) == -1) {
+                                g_free (dirname);
+                                return NULL;
+                        }
+                }
+        }
+        g_free (dirname);
+
+
+	if (! g_file_test(file_name, G_FILE_TEST_EXISTS)) {
+                if (! create)
+                        return NULL;
+                else
+                        ca_file_create (file_name);
+        }
+
+	if (sqlite3_open(file_name, &ca_opening_db)) {
+		g_printerr ("%s\n\n", sqlite3_errmsg(ca_opening_db));
+		return NULL;
+	} else {
+                error = __ca_file_check_and_update_version (ca_opening_db); 
+		if (error) {
+                        fprintf (stderr, "Error while updating version: %s\n", error);
+                        //g_free (error); It mustn't be freed: it is always constant
+                        sqlite3_close (ca_opening_db);
+                        ca_opening_db = NULL;
+                        return NULL;
+                }
+	}
+
+        ca_file = __ca_file_new (file_name, ca_opening_db);
+
+        // The new handle is made current while it is prepared, whichever is the current one
+        previous = g_private_get (&ca_file_current);
+        g_private_set (&ca_file_current, ca_file);
+
+        error = __ca_file_attach_archive (FALSE);
+        if (error) {
+                fprintf (stderr, "Error while opening the archive: %s\n", error);
+                g_private_set (&ca_file_current, previous);
+                __ca_file_free (ca_file);
+                return NULL;
+        }
+
+        // Automatic archiving only writes (and creates the archive) when some certificate is due
+        archive_after_days = ca_file_get_archive_policy ();
+        if (archive_after_days > 0) {
+                if (ca_file_archive_crts (time (NULL) - (time_t) archive_after_days * 24 * 60 * 60, &error) < 0) {
+                        fprintf (stderr, "Error while archiving expired certificates: %s\n", error);
+                        sqlite3_free (error);
+                }
+        }
+
+        g_private_set (&ca_file_current, previous);
+
+        return ca_file;
+}
+
+void ca_file_handle_close (CaFile *ca_file)
+{
+	if (ca_file && ca_file != ca_file_default) {
+		key_pool_stop (ca_file);
+		__ca_file_free (ca_file);
+	}
+}
+
+gboolean ca_file_open (gchar *file_name, gboolean create)
+{
+        CaFile *ca_file = ca_file_handle_open (file_name, create);
+
+        if (! ca_file)
+                return FALSE;
+
+        gnomint_current_opened_file = file_name;
+        if (ca_file_default) {
+                key_pool_stop (ca_file_default);
+                __ca_file_free (ca_file_default);
+        }
+
+        ca_file_default = ca_file;
+
+        return TRUE;
+}
+
+void ca_file_close ()
+{
+	if (ca_file_default) {
+		key_pool_stop (ca_file_default);
+		__ca_file_free (ca_file_default);
+		ca_file_default = NULL;
+	}
 	if (gnomint_current_opened_file) {
 		g_free (gnomint_current_opened_file);
 		gnomint_current_opened_file = NULL;
 	}
-	       
+	       
+}
+
+gboolean ca_file_save_as (gchar *new_file_name)
+{
+	gchar * initial_file = g_strdup(gnomint_current_opened_file);
+	gchar * initial_archive = NULL;
+	gchar * new_archive = NULL;
+	GMappedFile *map = NULL;
+
+	ca_file_close ();
+
+	if (! (map = g_mapped_file_new (initial_file, FALSE, NULL))) {
+                ca_file_open (gnomint_current_opened_file, FALSE);
+		return FALSE;
+        }
+
+	if (! g_file_set_contents (new_file_name, 
+				   g_mapped_file_get_contents (map),
+				   g_mapped_file_get_length (map),
+				   NULL)) {
+		g_mapped_file_unref(map);
+                ca_file_open (gnomint_current_opened_file, FALSE);
+		return FALSE;
+	}
+
+	g_mapped_file_unref(map);
+
+	// The archive goes with the database
+	initial_archive = __ca_file_get_archive_filename (initial_file);
+	if (g_file_test (initial_archive, G_FILE_TEST_EXISTS)) {
+		new_archive = __ca_file_get_archive_filename (new_file_name);
+		map = g_mapped_file_new (initial_archive, FALSE, NULL);
+		if (! map || ! g_file_set_contents (new_archive, g_mapped_file_get_contents (map), 
+						    g_mapped_file_get_length (map), NULL)) {
+			if (map)
+				g_mapped_file_unref (map);
+			g_free (initial_archive);
+			g_free (new_archive);
+			ca_file_open (initial_file, FALSE);
+			return FALSE;
+		}
+		g_mapped_file_unref (map);
+		g_free (new_archive);
+	}
+	g_free (initial_archive);
+
+	g_free (initial_file);
+
+	return ca_file_open (new_file_name, FALSE);
+
+}
+
+gint ca_file_get_number_of_certs ()
+{
+	gint result;
+	gchar **aux;
+
+	aux = __ca_file_get_single_row (ca_db, "SELECT IFNULL(SUM(certs), 0) FROM ca_counters");
+	result = atoi (aux[0]);
+	g_strfreev (aux);
+
+	return result;
+
+}
+
+gint ca_file_get_number_of_csrs ()
+{
+	gint result;
+	gchar **aux;
+
+	aux = __ca_file_get_single_row (ca_db, "SELECT IFNULL(SUM(csrs), 0) FROM ca_counters");
+	result = atoi (aux[0]);
+	g_strfreev (aux);
+
+	return result;
+
+
+}
+
+
+
+gint ca_file_get_number_of_archived_certs ()
+{
+	gint result;
+	gchar **aux;
+
+	aux = __ca_file_get_single_row (ca_db, "SELECT IFNULL(SUM(archived), 0) FROM ca_counters");
+	result = atoi (aux[0]);
+	g_strfreev (aux);
+
+	return result;
+}
+
+gint ca_file_get_number_of_revoked_certs ()
+{
+	gint result;
+	gchar **aux;
+
+	aux = __ca_file_get_single_row (ca_db, "SELECT IFNULL(SUM(revoked), 0) FROM ca_counters");
+	result = atoi (aux[0]);
+	g_strfreev (aux);
+
+	return result;
+}
+
+gboolean ca_file_foreach_counters (CaFileCallbackFunc func, gpointer userdata)
+{
+	gchar *error_str = NULL;
+
+	/* Expiration cannot be followed by triggers, so expired certificates
+	   are counted with the expiration index: only the expired, not revoked
+	   ones are read, and archiving keeps them few */
+	sqlite3_exec (ca_db, 
+		      "SELECT ca_counters.ca_id, ca.subject, certs, revoked, IFNULL(expired.number, 0), cas, csrs, archived "
+		      "FROM ca_counters LEFT JOIN certificates ca ON ca.id = ca_counters.ca_id "
+		      "LEFT JOIN (SELECT parent_id, COUNT(*) AS number FROM certificates "
+		      "           WHERE expiration < strftime('%s','now') AND revocation IS NULL GROUP BY parent_id) expired "
+		      "ON expired.parent_id = ca_counters.ca_id "
+		      "WHERE certs > 0 OR csrs > 0 OR archived > 0 ORDER BY ca_counters.ca_id;",
+		      func, userdata, &error_str);
+
+	return (! error_str);
+}
+
+gchar * __ca_file_get_archive_filename (const gchar *file_name)
+{
+	return g_strdup_printf ("%s.archive", file_name);
+}
+
+/* Archives created before serial_bin get it as the main file did (v18 -> v19),
+   in a transaction that only writes into the archive */
+gchar * __ca_file_upgrade_archive ()
+{
+	sqlite3_stmt *stmt = NULL;
+	gchar *error = NULL;
+
+	if (sqlite3_prepare_v2 (ca_db, "SELECT serial_bin FROM archive.certificates LIMIT 0;", -1, &stmt, NULL) == SQLITE_OK) {
+		sqlite3_finalize (stmt);
+		return (sqlite3_exec (ca_db, "CREATE INDEX IF NOT EXISTS archive.certificates_serial_idx "
+				      "ON certificates (parent_id, serial_bin);", NULL, NULL, &error) ? error : NULL);
+	}
+	sqlite3_finalize (stmt);
+
+	if (sqlite3_exec (ca_db,
+			  "BEGIN IMMEDIATE TRANSACTION; "
+			  "ALTER TABLE archive.certificates ADD COLUMN serial_bin BLOB; "
+			  "UPDATE archive.certificates SET serial_bin = serial_blob (serial); "
+			  "CREATE INDEX IF NOT EXISTS archive.certificates_serial_idx ON certificates (parent_id, serial_bin); "
+			  "COMMIT;",
+			  NULL, NULL, &error)) {
+		sqlite3_exec (ca_db, "ROLLBACK;", NULL, NULL, NULL);
+		return error;
+	}
+
+	return NULL;
+}
+
+/* Files upgraded from version 16 got their archived counters as 0, whatever was
+   in the archive: they are counted once, the first time the archive is attached.
+   Rows still in the main file are left out, as a move in progress counts them */
+gchar * __ca_file_count_archived ()
+{
+	gchar **aux;
+	gchar *error = NULL;
+
+	aux = __ca_file_get_single_row (ca_db, "SELECT value FROM db_properties WHERE name='archived_counted';");
+	if (aux) {
+		g_strfreev (aux);
+		return NULL;
+	}
+
+	if (sqlite3_exec (ca_db, "BEGIN IMMEDIATE TRANSACTION;", NULL, NULL, &error))
+		return error;
+
+	if (sqlite3_exec (ca_db,
+			  "INSERT OR IGNORE INTO ca_counters (ca_id) SELECT DISTINCT parent_id FROM archive.certificates; "
+			  "UPDATE ca_counters SET archived = (SELECT COUNT(*) FROM archive.certificates a "
+			  "WHERE a.parent_id = ca_counters.ca_id AND a.id NOT IN (SELECT id FROM main.certificates)); "
+			  "INSERT OR REPLACE INTO db_properties (name, value) VALUES ('archived_counted', '1'); "
+			  "COMMIT;",
+			  NULL, NULL, &error)) {
+		sqlite3_exec (ca_db, "ROLLBACK;", NULL, NULL, NULL);
+		return error;
+	}
+
+	return NULL;
+}
+
+gchar * __ca_file_attach_archive (gboolean create)
+{
+	CaFileConnection *connection = __ca_file_get_connection ();
+	gchar *archive_file = NULL;
+	gchar *sql = NULL;
+	gchar *error = NULL;
+
+	if (! connection->archive_attached) {
+		archive_file = __ca_file_get_archive_filename (ca_file_get_current ()->filename);
+
+		if (create || g_file_test (archive_file, G_FILE_TEST_EXISTS)) {
+			// Same permissions than the main file: it can contain private keys
+			close (open (archive_file, O_CREAT, 0600));
+
+			sql = sqlite3_mprintf ("ATTACH DATABASE '%q' AS archive;", archive_file);
+			if (sqlite3_exec (ca_db, sql, NULL, NULL, &error)) {
+				sqlite3_free (sql);
+				g_free (archive_file);
+				return error;
+			}
+			sqlite3_free (sql);
+
+			/* The archive is in WAL mode too, but then SQLite commits a transaction
+			   over both files in each one separately: transactions writing into the
+			   archive don't write into the main file (see ca_file_archive_crts and
+			   __ca_file_archive_password_update) */
+			sqlite3_exec (ca_db, "PRAGMA archive.journal_mode=WAL;", NULL, NULL, NULL);
+
+			if (sqlite3_exec (ca_db,
+					  "CREATE TABLE IF NOT EXISTS archive.archive_properties (name TEXT PRIMARY KEY, value TEXT); "
+					  "CREATE TABLE IF NOT EXISTS archive.certificates (id INTEGER PRIMARY KEY, is_ca BOOLEAN, serial TEXT, "
+					  "subject TEXT, activation TIMESTAMP, expiration TIMESTAMP, revocation TIMESTAMP, pem TEXT, "
+					  "private_key_in_db BOOLEAN, private_key TEXT, dn TEXT, parent_dn TEXT, parent_id INTEGER DEFAULT 0, "
+					  "parent_route TEXT, expired_already_in_crl INTEGER, subject_key_id TEXT, issuer_key_id TEXT, "
+					  "serial_bin BLOB);",
+					  NULL, NULL, &error)) {
+				g_free (archive_file);
+				return error;
+			}
+
+			error = __ca_file_upgrade_archive ();
+			if (error) {
+				g_free (archive_file);
+				return error;
+			}
+
+			connection->archive_attached = TRUE;
+
+			error = __ca_file_count_archived ();
+			if (error) {
+				g_free (archive_file);
+				return error;
+			}
+		}
+
+		g_free (archive_file);
+	}
+
+	/* Views in the main database cannot refer to attached ones, so the
+	   view is a temporary one, created each time the file is opened */
+	if (sqlite3_exec (ca_db, "DROP VIEW IF EXISTS temp.all_certificates;", NULL, NULL, &error))
+		return error;
+
+	if (connection->archive_attached)
+		sql = sqlite3_mprintf ("CREATE TEMP VIEW all_certificates AS "
+				       "SELECT %s, 0 AS archived FROM main.certificates UNION ALL "
+				       "SELECT %s, 1 AS archived FROM archive.certificates;", 
+				       CA_FILE_CERT_FIELDS, CA_FILE_CERT_FIELDS);
+	else
+		sql = sqlite3_mprintf ("CREATE TEMP VIEW all_certificates AS SELECT %s, 0 AS archived FROM main.certificates;", 
+				       CA_FILE_CERT_FIELDS);
+
+	sqlite3_exec (ca_db, sql, NULL, NULL, &error);
+	sqlite3_free (sql);
+
+	return error;
+}
+
+gboolean __ca_file_has_crts_to_archive (time_t expired_before)
+{
+	gchar **aux;
+
+	aux = __ca_file_get_single_row (ca_db, "SELECT 1 FROM main.certificates c "
+					"WHERE c.expiration < %ld AND (c.revocation IS NULL OR c.expired_already_in_crl = 1) "
+					"AND NOT EXISTS (SELECT 1 FROM main.certificates d WHERE d.parent_id = c.id) LIMIT 1;",
+					(long) expired_before);
+	if (! aux)
+		return FALSE;
+
+	g_strfreev (aux);
+	return TRUE;
+}
+
+gint ca_file_archive_crts (time_t expired_before, gchar **error)
+{
+	gchar *sql = NULL;
+	gint archived = 0;
+	gint moved;
+
+	*error = NULL;
+
+	// Nothing is written, nor the archive created, if there is nothing to move
+	if (! __ca_file_has_crts_to_archive (expired_before))
+		return 0;
+
+	*error = __ca_file_attach_archive (TRUE);
+	if (*error)
+		return -1;
+
+	if (sqlite3_exec (ca_db, "CREATE TEMP TABLE IF NOT EXISTS archiving_ids (id INTEGER PRIMARY KEY);", NULL, NULL, error))
+		return -1;
+
+	/* Only certificates that are out of use are archived: expired ones,
+	   and revoked ones only once a CRL has listed them after their
+	   expiration. Certificates with children still in the main table
+	   are kept there, so the CA tree is never broken: each pass
+	   archives the leaves, until no more certificates can be moved.
+
+	   SQLite commits a transaction over two WAL files in each file
+	   separately, so each pass is made of two transactions, each one
+	   writing a single file: the rows are copied into the archive, and
+	   then deleted from the main file only if they are in the archive.
+	   If the second one is lost, the next pass copies them again (the
+	   copy ignores the rows already there) and deletes them */
+	do {
+		if (sqlite3_exec (ca_db, "BEGIN IMMEDIATE TRANSACTION;", NULL, NULL, error))
+			return -1;
+
+		sql = sqlite3_mprintf ("DELETE FROM archiving_ids; "
+				       "INSERT INTO archiving_ids SELECT c.id FROM main.certificates c "
+				       "WHERE c.expiration < %ld AND (c.revocation IS NULL OR c.expired_already_in_crl = 1) "
+				       "AND NOT EXISTS (SELECT 1 FROM main.certificates d WHERE d.parent_id = c.id);",
+				       (long) expired_before);
+		if (sqlite3_exec (ca_db, sql, NULL, NULL, error)) {
+			sqlite3_free (sql);
+			sqlite3_exec (ca_db, "ROLLBACK;", NULL, NULL, NULL);
+			return -1;
+		}
+		sqlite3_free (sql);
+
+		moved = sqlite3_changes (ca_db);
+		if (moved == 0) {
+			sqlite3_exec (ca_db, "ROLLBACK;", NULL, NULL, NULL);
+			break;
+		}
+
+		sql = sqlite3_mprintf ("INSERT OR IGNORE INTO archive.certificates (%s) SELECT %s FROM main.certificates "
+				       "WHERE id IN (SELECT id FROM archiving_ids);",
+				       CA_FILE_CERT_FIELDS, CA_FILE_CERT_FIELDS);
+		if (sqlite3_exec (ca_db, sql, NULL, NULL, error) || sqlite3_exec (ca_db, "COMMIT;", NULL, NULL, error)) {
+			sqlite3_free (sql);
+			sqlite3_exec (ca_db, "ROLLBACK;", NULL, NULL, NULL);
+			return -1;
+		}
+		sqlite3_free (sql);
+
+		if (sqlite3_exec (ca_db, "BEGIN IMMEDIATE TRANSACTION;", NULL, NULL, error))
+			return -1;
+
+		// Deleted certificates are discounted by the triggers, but they must be counted as archived
+		if (sqlite3_exec (ca_db, 
+				  "DELETE FROM archiving_ids WHERE id NOT IN (SELECT id FROM archive.certificates); "
+				  "UPDATE ca_counters SET archived = archived + "
+				  "(SELECT COUNT(*) FROM main.certificates c JOIN archiving_ids a ON c.id = a.id "
+				  "WHERE c.parent_id = ca_counters.ca_id) "
+				  "WHERE ca_id IN (SELECT c.parent_id FROM main.certificates c JOIN archiving_ids a ON c.id = a.id); "
+				  "DELETE FROM main.certificates WHERE id IN (SELECT id FROM archiving_ids);",
+				  NULL, NULL, error) || sqlite3_exec (ca_db, "COMMIT;", NULL, NULL, error)) {
+			sqlite3_exec (ca_db, "ROLLBACK;", NULL, NULL, NULL);
+			return -1;
+		}
+
+		archived += moved;
+	} while (TRUE);
+
+	return archived;
+}
+
+gint ca_file_get_archive_policy ()
+{
+	gchar **aux;
+	gint result = 0;
+
+	aux = __ca_file_get_single_row (ca_db, "SELECT value FROM db_properties WHERE name='archive_after_days';");
+	if (aux) {
+		result = atoi (aux[0]);
+		g_strfreev (aux);
+	}
+
+	return result;
 }
 
-gboolean ca_file_save_as (gchar *new_file_name)
+gboolean ca_file_set_archive_policy (gint days)
 {
-	gchar * initial_file = g_strdup(gnomint_current_opened_file);
-	GMappedFile *map = NULL;
+	gchar *sql;
+	gchar *error = NULL;
 
-	ca_file_close ();
+	sql = sqlite3_mprintf ("INSERT OR REPLACE INTO db_properties (name, value) VALUES ('archive_after_days', '%d');", days);
+	sqlite3_exec (ca_db, sql, NULL, NULL, &error);
+	sqlite3_free (sql);
 
-	if (! (map = g_mapped_file_new (initial_file, FALSE, NULL))) {
-                ca_file_open (gnomint_current_opened_file, FALSE);
-		return FALSE;
-        }
+	return (! error);
+}
 
-	if (! g_file_set_contents (new_file_name, 
-				   g_mapped_file_get_contents (map),
-				   g_mapped_file_get_length (map),
-				   NULL)) {
-		g_mapped_file_unref(map);
-                ca_file_open (gnomint_current_opened_file, FALSE);
-		return FALSE;
-	}
+gboolean ca_file_foreach_key_pool_size (CaFileCallbackFunc func, gpointer userdata)
+{
+	gchar *error = NULL;
 
-	g_mapped_file_unref(map);
+	sqlite3_exec (ca_db,
+		      "SELECT s.key_type, s.key_bitlength, s.size, "
+		      "(SELECT COUNT(*) FROM key_pool p WHERE p.key_type=s.key_type AND p.key_bitlength=s.key_bitlength) "
+		      "FROM key_pool_sizes s ORDER BY s.key_type, s.key_bitlength;",
+		      func, userdata, &error);
 
-	g_free (initial_file);
+	return (! error);
+}
 
-	return ca_file_open (new_file_name, FALSE);
+gboolean ca_file_set_key_pool_size (gint key_type, gint key_bitlength, gint size)
+{
+	gchar *sql;
+	gchar *error = NULL;
+
+	if (size > 0)
+		sql = sqlite3_mprintf ("INSERT OR REPLACE INTO key_pool_sizes (key_type, key_bitlength, size) VALUES (%d, %d, %d);",
+				       key_type, key_bitlength, size);
+	else
+		sql = sqlite3_mprintf ("DELETE FROM key_pool_sizes WHERE key_type=%d AND key_bitlength=%d; "
+				       "DELETE FROM key_pool WHERE key_type=%d AND key_bitlength=%d;",
+				       key_type, key_bitlength, key_type, key_bitlength);
+	sqlite3_exec (ca_db, sql, NULL, NULL, &error);
+	sqlite3_free (sql);
 
+	return (! error);
 }
 
-gint ca_file_get_number_of_certs ()
+gboolean ca_file_key_pool_add (gint key_type, gint key_bitlength, const gchar *private_key)
 {
-	gint result;
-	gchar **aux;
-
-	aux = __ca_file_get_single_row (ca_db, "SELECT COUNT(*) FROM certificates");
-	result = atoi (aux[0]);
-	g_strfreev (aux);
+	gchar *sql;
+	gchar *error = NULL;
 
-	return result;
+	sql = sqlite3_mprintf ("INSERT INTO key_pool (id, key_type, key_bitlength, private_key) VALUES (NULL, %d, %d, '%q');",
+			       key_type, key_bitlength, private_key);
+	sqlite3_exec (ca_db, sql, NULL, NULL, &error);
+	sqlite3_free (sql);
 
+	return (! error);
 }
 
-gint ca_file_get_number_of_csrs ()
+gchar * ca_file_key_pool_take (gint key_type, gint key_bitlength)
 {
-	gint result;
-	gchar **aux;
+	gchar **row;
+	gchar *sql;
+	gchar *res = NULL;
 
-	aux = __ca_file_get_single_row (ca_db, "SELECT COUNT(*) FROM cert_requests");
-	result = atoi (aux[0]);
-	g_strfreev (aux);
+	if (sqlite3_exec (ca_db, "BEGIN IMMEDIATE TRANSACTION;", NULL, NULL, NULL))
+		return NULL;
 
-	return result;
+	row = __ca_file_get_single_row (ca_db, "SELECT id, private_key FROM key_pool WHERE key_type=%d AND key_bitlength=%d "
+					"ORDER BY id LIMIT 1;", key_type, key_bitlength);
+	if (row) {
+		sql = sqlite3_mprintf ("DELETE FROM key_pool WHERE id=%s;", row[0]);
+		if (! sqlite3_exec (ca_db, sql, NULL, NULL, NULL))
+			res = g_strdup (row[1]);
+		sqlite3_free (sql);
+		g_strfreev (row);
+	}
 
+	if (res)
+		sqlite3_exec (ca_db, "COMMIT;", NULL, NULL, NULL);
+	else
+		sqlite3_exec (ca_db, "ROLLBACK;", NULL, NULL, NULL);
 
+	return res;
 }
 
-
-
 void ca_file_get_next_serial (UInt160 *serial, guint64 ca_id)
 {
-	gchar *serialstr = NULL;
+	gchar serialhex[UINT160_HEX_SIZE];
 	gchar **row = NULL;
 
 	row = __ca_file_get_single_row (ca_db, "SELECT value FROM ca_policies WHERE name='ca_last_assigned_serial' AND ca_id=%"
@@ -1147,10 +2641,9 @@ void ca_file_get_next_serial (UInt160 *serial, guint64 ca_id)
                         while (row) {
                                 uint160_inc (serial);
                                 g_strfreev (row);
-                                serialstr = uint160_strdup_printf (serial);
-                                row = __ca_file_get_single_row (ca_db, "SELECT id FROM certificates WHERE serial='%q' AND parent_id=%"GNOMINT_GUINT64_FORMAT";", 
-                                                              serialstr, ca_id);
-                                g_free (serialstr);                                
+                                uint160_write_hex (serial, serialhex);
+                                row = __ca_file_get_single_row (ca_db, "SELECT id FROM all_certificates WHERE parent_id=%"GNOMINT_GUINT64_FORMAT
+								" AND serial_bin=X'%s';", ca_id, serialhex);
                         }
                 } else {
                         uint160_inc (serial);
@@ -1198,6 +2691,7 @@ gchar * ca_file_insert_self_signed_ca (gchar *pem_ca_private_key,
         gsize size;
         UInt160 sn;
         gchar *serialstr;
+        gchar serialhex[UINT160_HEX_SIZE];
 
 	gchar **row;
 	gint64 rootca_rowid;
@@ -1211,6 +2705,7 @@ gchar * ca_file_insert_self_signed_ca (gchar *pem_ca_private_key,
 
         uint160_assign (&sn, 1);
         serialstr = uint160_strdup_printf(&sn);
+        uint160_write_hex (&sn, serialhex);
 
         sql_subject_key_id = (tls_cert->subject_key_id ? 
                               g_strdup_printf ("'%s'",tls_cert->subject_key_id) :
@@ -1219,13 +2714,13 @@ gchar * ca_file_insert_self_signed_ca (gchar *pem_ca_private_key,
                              g_strdup_printf ("'%s'",tls_cert->issuer_key_id) :
                              g_strdup_printf ("NULL"));
 
-	if (sqlite3_exec (ca_db, "BEGIN TRANSACTION;", NULL, NULL, &error))
+	if (sqlite3_exec (ca_db, "BEGIN IMMEDIATE TRANSACTION;", NULL, NULL, &error))
 		return error;
 
-	sql = sqlite3_mprintf ("INSERT INTO certificates (id, is_ca, serial, subject, activation, expiration, revocation, pem, private_key_in_db, "
+	sql = sqlite3_mprintf ("INSERT INTO certificates (id, is_ca, serial, serial_bin, subject, activation, expiration, revocation, pem, private_key_in_db, "
                                "private_key, dn, parent_dn, parent_id, parent_route, subject_key_id, issuer_key_id) "
-                               "VALUES (NULL, 1, '%q', '%q', '%ld', '%ld', NULL, '%q', 1, '%q','%q','%q', 0, ':', %s, %s);", 
-                               serialstr,
+                               "VALUES (NULL, 1, '%q', X'%s', '%q', '%ld', '%ld', NULL, '%q', 1, '%q','%q','%q', 0, ':', %s, %s);", 
+                               serialstr, serialhex,
 			       tls_cert->cn,
 			       tls_cert->activation_time,
 			       tls_cert->expiration_time,
@@ -1242,13 +2737,17 @@ gchar * ca_file_insert_self_signed_ca (gchar *pem_ca_private_key,
 	if (sqlite3_exec (ca_db, sql, NULL, NULL, &error))
 		return error;
 	sqlite3_free (sql);
-        g_free (serialstr);
         
 	rootca_rowid = sqlite3_last_insert_rowid (ca_db);
 	row = __ca_file_get_single_row (ca_db, "SELECT id FROM certificates WHERE ROWID=%"GNOMINT_GUINT64_FORMAT" ;",
 				      rootca_rowid);
 	rootca_id = atoll (row[0]);
 	g_strfreev (row);
+
+	error = __ca_file_search_index_crt (ca_db, rootca_id, serialstr, tls_cert);
+        g_free (serialstr);
+	if (error)
+		return error;
         
         size = 0;
         uint160_write_escaped (&sn, NULL, &size);
@@ -1288,17 +2787,24 @@ gchar * ca_file_insert_self_signed_ca (gchar *pem_ca_private_key,
 }
 
 
-gchar * ca_file_insert_cert (gboolean is_ca,
-                             gboolean private_key_in_db, 
-			     gchar *private_key_info,                             
-			     gchar *pem_certificate)
+gchar * __ca_file_insert_cert_row (gboolean is_ca,
+				   gboolean own_serial,
+				   gboolean private_key_in_db, 
+				   const gchar *private_key_info,
+				   const gchar *pem_certificate,
+				   time_t revocation)
 {
 	gchar *sql = NULL;
 	gchar *error = NULL;
 	gchar **row;        
 	UInt160 serial;
+	UInt160 last_serial;
         gchar *serialstr;
+        gchar serialhex[UINT160_HEX_SIZE];
+        guchar serial_bytes[UINT160_SIZE];
+        guchar last_bytes[UINT160_SIZE];
         gsize size;
+	gboolean is_last = TRUE;
 	gint64 cert_rowid;
 	guint64 cert_id;
 
@@ -1308,6 +2814,7 @@ gchar * ca_file_insert_cert (gboolean is_ca,
 
         gchar *sql_subject_key_id = NULL;
         gchar *sql_issuer_key_id = NULL;
+        gchar *sql_revocation = NULL;
 
 
 	TlsCert *tlscert = tls_parse_cert_pem (pem_certificate);
@@ -1319,11 +2826,17 @@ gchar * ca_file_insert_cert (gboolean is_ca,
                              g_strdup_printf ("'%s'",tlscert->issuer_key_id) :
                              g_strdup_printf ("NULL"));
 
-	if (sqlite3_exec (ca_db, "BEGIN TRANSACTION;", NULL, NULL, &error))
-		return error;
+	if (revocation)
+		sql_revocation = g_strdup_printf ("%ld", revocation);
+	else
+		sql_revocation = g_strdup ("NULL");
 
 	parent_idstr = __ca_file_get_single_row (ca_db, "SELECT id, parent_route FROM certificates WHERE subject_key_id='%q';", tlscert->issuer_key_id);
 	if (parent_idstr == NULL) {
+		tls_cert_free (tlscert);
+		g_free (sql_subject_key_id);
+		g_free (sql_issuer_key_id);
+		g_free (sql_revocation);
                 error = _("Cannot find parent CA in database");
                 return error;
 	} else {
@@ -1332,22 +2845,42 @@ gchar * ca_file_insert_cert (gboolean is_ca,
 		g_strfreev (parent_idstr);
 	}
 
-        uint160_assign (&serial, 0);
-	ca_file_get_next_serial (&serial, parent_id);
+	if (own_serial) {
+		// Certificates signed with serials assigned beforehand (see ca_file_insert_certs)
+		serial = tlscert->serial_number;
+
+		// ... which may come in any order, or with gaps: the last assigned one is the highest
+		row = __ca_file_get_single_row (ca_db, "SELECT value FROM ca_policies WHERE name='ca_last_assigned_serial' AND ca_id=%"
+						GNOMINT_GUINT64_FORMAT";", parent_id);
+		if (row) {
+			uint160_read_escaped (&last_serial, row[0], strlen (row[0]));
+			g_strfreev (row);
+			size = UINT160_SIZE;
+			uint160_write (&serial, serial_bytes, &size);
+			size = UINT160_SIZE;
+			uint160_write (&last_serial, last_bytes, &size);
+			is_last = (memcmp (serial_bytes, last_bytes, UINT160_SIZE) > 0);
+		}
+	} else {
+		uint160_assign (&serial, 0);
+		ca_file_get_next_serial (&serial, parent_id);
+	}
 
         serialstr = uint160_strdup_printf(&serial);
+        uint160_write_hex (&serial, serialhex);
 
 	if (private_key_info)
-		sql = sqlite3_mprintf ("INSERT INTO certificates (id, is_ca, serial, subject, activation, expiration, revocation, "
+		sql = sqlite3_mprintf ("INSERT INTO certificates (id, is_ca, serial, serial_bin, subject, activation, expiration, revocation, "
                                        "pem, private_key_in_db, private_key, dn, parent_dn, parent_id, parent_route, subject_key_id, "
                                        "issuer_key_id) "
-                                       "VALUES (NULL, %d, '%q', '%q', '%ld', '%ld', "
-				       "NULL, '%q', %d, '%q', '%q', '%q', %"GNOMINT_GUINT64_FORMAT", '%q', %s, %s);", 
+                                       "VALUES (NULL, %d, '%q', X'%s', '%q', '%ld', '%ld', "
+				       "%s, '%q', %d, '%q', '%q', '%q', %"GNOMINT_GUINT64_FORMAT", '%q', %s, %s);", 
                                        is_ca,
-				       serialstr,
+				       serialstr, serialhex,
 				       tlscert->cn,
 				       tlscert->activation_time,
 				       tlscert->expiration_time,
+				       sql_revocation,
 				       pem_certificate,
                                        private_key_in_db,
 				       private_key_info,
@@ -1358,16 +2891,17 @@ gchar * ca_file_insert_cert (gboolean is_ca,
                                        sql_subject_key_id,
                                        sql_issuer_key_id);
 	else
-		sql = sqlite3_mprintf ("INSERT INTO certificates (id, is_ca, serial, subject, activation, expiration, revocation, "
+		sql = sqlite3_mprintf ("INSERT INTO certificates (id, is_ca, serial, serial_bin, subject, activation, expiration, revocation, "
                                        "pem, private_key_in_db, private_key, dn, parent_dn, parent_id, parent_route, subject_key_id, "
                                        "issuer_key_id) "
-                                       "VALUES (NULL, %d, '%q', '%q', '%ld', '%ld', NULL, '%q', 0, NULL, '%q', '%q',"
+                                       "VALUES (NULL, %d, '%q', X'%s', '%q', '%ld', '%ld', %s, '%q', 0, NULL, '%q', '%q',"
 				       "%"GNOMINT_GUINT64_FORMAT", '%q', %s, %s);", 
                                        is_ca,
-				       serialstr,
+				       serialstr, serialhex,
 				       tlscert->cn,
 				       tlscert->activation_time,
 				       tlscert->expiration_time,
+				       sql_revocation,
 				       pem_certificate,
 				       tlscert->dn,
 				       tlscert->i_dn,
@@ -1376,16 +2910,17 @@ gchar * ca_file_insert_cert (gboolean is_ca,
                                        sql_subject_key_id,
                                        sql_issuer_key_id);
 
-        g_free (serialstr);
-	tls_cert_free (tlscert);
-	tlscert = NULL;
-
 	g_free (parent_route);
+	g_free (sql_subject_key_id);
+	g_free (sql_issuer_key_id);
+	g_free (sql_revocation);
 
+	// The statement can hold the private key, so only the DN is shown
 	if (sqlite3_exec (ca_db, sql, NULL, NULL, &error)) {
-		sqlite3_exec (ca_db, "ROLLBACK;", NULL, NULL, NULL);
-		fprintf (stderr, "%s\n", sql);
+		fprintf (stderr, "%s: %s\n", tlscert->dn, error);
 		sqlite3_free (sql);
+		g_free (serialstr);
+		tls_cert_free (tlscert);
 		return error;
 	}
 
@@ -1397,20 +2932,29 @@ gchar * ca_file_insert_cert (gboolean is_ca,
 	cert_id = atoll (row[0]);
 	g_strfreev (row);
 
-        size = 0;
-        uint160_write_escaped (&serial, NULL, &size);
-        serialstr = g_new0(gchar, size+1);
-        uint160_write_escaped (&serial, serialstr, &size);
-	sql = sqlite3_mprintf ("UPDATE ca_policies SET value='%q' WHERE name='ca_last_assigned_serial' and ca_id=%"GNOMINT_GUINT64_FORMAT";", 
-			       serialstr, parent_id);
-	if (sqlite3_exec (ca_db, sql, NULL, NULL, &error)) {
-		sqlite3_exec (ca_db, "ROLLBACK;", NULL, NULL, NULL);
-		fprintf (stderr, "%s\n", sql);
-		sqlite3_free (sql);
+	error = __ca_file_search_index_crt (ca_db, cert_id, serialstr, tlscert);
+        g_free (serialstr);
+	tls_cert_free (tlscert);
+	tlscert = NULL;
+	if (error) {
 		return error;
 	}
-        g_free (serialstr);
-	sqlite3_free (sql);
+
+	if (is_last) {
+		size = 0;
+		uint160_write_escaped (&serial, NULL, &size);
+		serialstr = g_new0(gchar, size+1);
+		uint160_write_escaped (&serial, serialstr, &size);
+		sql = sqlite3_mprintf ("UPDATE ca_policies SET value='%q' WHERE name='ca_last_assigned_serial' and ca_id=%"GNOMINT_GUINT64_FORMAT";", 
+				       serialstr, parent_id);
+		if (sqlite3_exec (ca_db, sql, NULL, NULL, &error)) {
+			fprintf (stderr, "%s\n", sql);
+			sqlite3_free (sql);
+			return error;
+		}
+		g_free (serialstr);
+		sqlite3_free (sql);
+	}
 
 	if (is_ca) {
                 size = 0;
@@ -1422,7 +2966,6 @@ gchar * ca_file_insert_cert (gboolean is_ca,
 				       "VALUES (NULL, %"GNOMINT_GUINT64_FORMAT", 'ca_last_assigned_serial', '%q');",
 				       cert_id, serialstr);
 		if (sqlite3_exec (ca_db, sql, NULL, NULL, &error)) {
-			sqlite3_exec (ca_db, "ROLLBACK;", NULL, NULL, NULL);
 			fprintf (stderr, "%s\n", sql);
 			sqlite3_free (sql);
 			return error;
@@ -1439,7 +2982,6 @@ gchar * ca_file_insert_cert (gboolean is_ca,
 		    ! ca_file_policy_set (cert_id, "TLS_WEB_SERVER", "1") ||
 		    ! ca_file_policy_set (cert_id, "TLS_WEB_CLIENT", "1") ||
 		    ! ca_file_policy_set (cert_id, "EMAIL_PROTECTION", "1")) {
-			sqlite3_exec (ca_db, "ROLLBACK;", NULL, NULL, NULL);
 			sqlite3_free (sql);
 			return g_strdup ("Error while establishing policies.");
 		}
@@ -1448,6 +2990,25 @@ gchar * ca_file_insert_cert (gboolean is_ca,
 	}
 	
 
+	return NULL;
+
+}
+
+gchar * ca_file_insert_cert (gboolean is_ca,
+                             gboolean private_key_in_db, 
+			     gchar *private_key_info,                             
+			     gchar *pem_certificate)
+{
+	gchar *error = NULL;
+
+	if (sqlite3_exec (ca_db, "BEGIN IMMEDIATE TRANSACTION;", NULL, NULL, &error))
+		return error;
+
+	if ((error = __ca_file_insert_cert_row (is_ca, FALSE, private_key_in_db, private_key_info, pem_certificate, 0))) {
+		sqlite3_exec (ca_db, "ROLLBACK;", NULL, NULL, NULL);
+		return error;
+	}
+
 	if (sqlite3_exec (ca_db, "COMMIT;", NULL, NULL, &error))
 		return error;
 
@@ -1455,6 +3016,59 @@ gchar * ca_file_insert_cert (gboolean is_ca,
 
 }
 
+gint ca_file_insert_certs (guint number,
+			   gboolean private_key_in_db,
+			   gchar **private_key_infos,
+			   gchar **pem_certificates,
+			   const time_t *revocations,
+			   gchar **errors)
+{
+	gchar *error = NULL;
+	gint inserted = 0;
+	guint i;
+
+	if (sqlite3_exec (ca_db, "BEGIN IMMEDIATE TRANSACTION;", NULL, NULL, &error)) {
+		for (i = 0; i < number; i++)
+			errors[i] = g_strdup (error);
+		sqlite3_free (error);
+		return -1;
+	}
+
+	/* As in ca_file_insert_csrs, a failed certificate (i.e. without its CA in the database) doesn't undo the others.
+	   Each one has its own savepoint, so a failure after its INSERT leaves nothing of it. The certificates
+	   keep the serial they were signed with */
+	for (i = 0; i < number; i++) {
+		if (sqlite3_exec (ca_db, "SAVEPOINT cert_row;", NULL, NULL, &error)) {
+			errors[i] = g_strdup (error);
+			sqlite3_free (error);
+			continue;
+		}
+
+		error = __ca_file_insert_cert_row (FALSE, TRUE, private_key_in_db, 
+						   private_key_infos ? private_key_infos[i] : NULL, 
+						   pem_certificates[i],
+						   revocations ? revocations[i] : 0);
+		errors[i] = (error ? g_strdup (error) : NULL);
+		if (errors[i])
+			sqlite3_exec (ca_db, "ROLLBACK TO cert_row;", NULL, NULL, NULL);
+		else
+			inserted ++;
+		sqlite3_exec (ca_db, "RELEASE cert_row;", NULL, NULL, NULL);
+	}
+
+	if (sqlite3_exec (ca_db, "COMMIT;", NULL, NULL, &error)) {
+		sqlite3_exec (ca_db, "ROLLBACK;", NULL, NULL, NULL);
+		for (i = 0; i < number; i++) {
+			g_free (errors[i]);
+			errors[i] = g_strdup (error);
+		}
+		sqlite3_free (error);
+		return -1;
+	}
+
+	return inserted;
+}
+
 gchar * ca_file_insert_imported_cert (gboolean is_ca,
                                       const UInt160 serial,
                                       const gchar *pem_certificate,
@@ -1465,6 +3079,7 @@ gchar * ca_file_insert_imported_cert (gboolean is_ca,
         gchar *parent_route = NULL;
         gchar *parent_pem = NULL;
 	gchar *serialstr = NULL;
+        gchar serialhex[UINT160_HEX_SIZE];
 
         gchar **issuer_res = NULL;
         gchar **orphan_res = NULL;
@@ -1516,7 +3131,7 @@ gchar * ca_file_insert_imported_cert (gboolean is_ca,
 	}
 	
 
-	if (sqlite3_exec (ca_db, "BEGIN TRANSACTION;", NULL, NULL, &error)) {
+	if (sqlite3_exec (ca_db, "BEGIN IMMEDIATE TRANSACTION;", NULL, NULL, &error)) {
 		g_free (sql_subject_key_id);
 		g_free (sql_issuer_key_id);
 		tls_cert_free (tlscert);
@@ -1563,13 +3178,14 @@ gchar * ca_file_insert_imported_cert (gboolean is_ca,
         // We insert the certificate, with the correct issuer, if this has been found
 
         serialstr = uint160_strdup_printf(&serial);
-        sql = sqlite3_mprintf ("INSERT INTO certificates (id, is_ca, serial, subject, activation, expiration, revocation, "
+        uint160_write_hex (&serial, serialhex);
+        sql = sqlite3_mprintf ("INSERT INTO certificates (id, is_ca, serial, serial_bin, subject, activation, expiration, revocation, "
                                "pem, private_key_in_db, private_key, dn, parent_dn, parent_id, parent_route, subject_key_id, "
                                "issuer_key_id) "
-                               "VALUES (NULL, %d, '%q', '%q', '%ld', '%ld', NULL, '%q', 0, NULL, '%q', '%q',"
+                               "VALUES (NULL, %d, '%q', X'%s', '%q', '%ld', '%ld', NULL, '%q', 0, NULL, '%q', '%q',"
                                "%"GNOMINT_GUINT64_FORMAT", '%q', %s, %s);",
                                is_ca,
-                               serialstr,
+                               serialstr, serialhex,
                                tlscert->cn,
                                tlscert->activation_time,
                                tlscert->expiration_time,
@@ -1580,12 +3196,12 @@ gchar * ca_file_insert_imported_cert (gboolean is_ca,
                                parent_route,
                                sql_subject_key_id,
                                sql_issuer_key_id);
-        g_free (serialstr);
 
 	if (sqlite3_exec (ca_db, sql, NULL, NULL, &error)) {
 		sqlite3_exec (ca_db, "ROLLBACK;", NULL, NULL, NULL);
 		fprintf (stderr, "%s\n", sql);
 		sqlite3_free (sql);
+		g_free (serialstr);
 		tls_cert_free (tlscert);
                 return error;
 	}
@@ -1593,6 +3209,14 @@ gchar * ca_file_insert_imported_cert (gboolean is_ca,
         sqlite3_free (sql);
 
         cert_id = sqlite3_last_insert_rowid(ca_db);
+
+        error = __ca_file_search_index_crt (ca_db, cert_id, serialstr, tlscert);
+        g_free (serialstr);
+        if (error) {
+		sqlite3_exec (ca_db, "ROLLBACK;", NULL, NULL, NULL);
+		tls_cert_free (tlscert);
+                return error;
+        }
         if (id)
                 *id = cert_id;
 
@@ -1646,6 +3270,16 @@ gchar * ca_file_insert_imported_cert (gboolean is_ca,
                                 }
 				sqlite3_free (sql);
 
+                                sql = sqlite3_mprintf ("UPDATE certificates_search SET parent_dn='%q' WHERE rowid=%s;",
+                                                       tlscert->dn, orphan_res[i*2]);
+                                if (sqlite3_exec (ca_db, sql, NULL, NULL, &error)) {
+                                        sqlite3_exec (ca_db, "ROLLBACK;", NULL, NULL, NULL);
+                                        sqlite3_free (sql);
+                                        tls_cert_free (tlscert);
+                                        return error;
+                                }
+				sqlite3_free (sql);
+
                                 sql = sqlite3_mprintf ("UPDATE certificates SET "
                                                        "parent_route=concat('%s%"GNOMINT_GUINT64_FORMAT"',parent_route)"
                                                        "WHERE parent_route LIKE ':%s:%%';",
@@ -1720,19 +3354,15 @@ gchar * ca_file_insert_imported_cert (gboolean is_ca,
 
 }
 
-gchar * ca_file_insert_csr (gchar *pem_csr_private_key,
-			    gchar *pem_csr,
-	                    gchar *parent_ca_id_str,
-                            guint64 *id)
+gchar * __ca_file_insert_csr_row (const gchar *pem_csr_private_key,
+				   const gchar *pem_csr,
+				   const gchar *parent_ca_id_str)
 {
 	gchar *sql = NULL;
 	gchar *error = NULL;
 
 	TlsCsr * tlscsr = tls_parse_csr_pem (pem_csr);
 
-	if (sqlite3_exec (ca_db, "BEGIN TRANSACTION;", NULL, NULL, &error))
-		return error;
-
 	if (pem_csr_private_key)
 		sql = sqlite3_mprintf ("INSERT INTO cert_requests (id, subject, pem, private_key_in_db, private_key, dn, parent_ca) "
                                        "VALUES (NULL, '%q', '%q', 1, '%q','%q', %s);", 
@@ -1751,16 +3381,32 @@ gchar * ca_file_insert_csr (gchar *pem_csr_private_key,
                                        (parent_ca_id_str ? parent_ca_id_str : "NULL")
                         );
 
+	// The statement holds the private key, so only the DN is shown
+	if (sqlite3_exec (ca_db, sql, NULL, NULL, &error))
+                fprintf (stderr, "%s: %s\n", tlscsr->dn, error);
+	sqlite3_free (sql);
+
 	tls_csr_free (tlscsr);
 	tlscsr = NULL;
 
-	if (sqlite3_exec (ca_db, sql, NULL, NULL, &error)) {
-                fprintf (stderr, "%s: %s\n", sql, error);
+	return error;
+}
+
+gchar * ca_file_insert_csr (gchar *pem_csr_private_key,
+			    gchar *pem_csr,
+	                    gchar *parent_ca_id_str,
+                            guint64 *id)
+{
+	gchar *error = NULL;
+
+	if (sqlite3_exec (ca_db, "BEGIN IMMEDIATE TRANSACTION;", NULL, NULL, &error))
+		return error;
+
+	if ((error = __ca_file_insert_csr_row (pem_csr_private_key, pem_csr, parent_ca_id_str))) {
 		sqlite3_exec (ca_db, "ROLLBACK;", NULL, NULL, NULL);
 		
 		return error;
 	}
-	sqlite3_free (sql);
 
         if (id)
                 *id = sqlite3_last_insert_rowid(ca_db);
@@ -1772,13 +3418,52 @@ gchar * ca_file_insert_csr (gchar *pem_csr_private_key,
 
 }
 
+gint ca_file_insert_csrs (guint number,
+			  gchar **pem_csr_private_keys,
+			  gchar **pem_csrs,
+			  gchar **parent_ca_id_strs,
+			  gchar **errors)
+{
+	gchar *error = NULL;
+	gint inserted = 0;
+	guint i;
+
+	if (sqlite3_exec (ca_db, "BEGIN IMMEDIATE TRANSACTION;", NULL, NULL, &error)) {
+		for (i = 0; i < number; i++)
+			errors[i] = g_strdup (error);
+		sqlite3_free (error);
+		return -1;
+	}
+
+	// A failed INSERT (i.e. a repeated DN) only undoes itself, not the whole transaction
+	for (i = 0; i < number; i++) {
+		error = __ca_file_insert_csr_row (pem_csr_private_keys[i], pem_csrs[i], parent_ca_id_strs[i]);
+		errors[i] = (error ? g_strdup (error) : NULL);
+		sqlite3_free (error);
+		if (! errors[i])
+			inserted ++;
+	}
+
+	if (sqlite3_exec (ca_db, "COMMIT;", NULL, NULL, &error)) {
+		sqlite3_exec (ca_db, "ROLLBACK;", NULL, NULL, NULL);
+		for (i = 0; i < number; i++) {
+			g_free (errors[i]);
+			errors[i] = g_strdup (error);
+		}
+		sqlite3_free (error);
+		return -1;
+	}
+
+	return inserted;
+}
+
 
 gchar * ca_file_remove_csr (guint64 id)
 {
 	gchar *sql = NULL;
 	gchar *error = NULL;
 
-	if (sqlite3_exec (ca_db, "BEGIN TRANSACTION;", NULL, NULL, &error))
+	if (sqlite3_exec (ca_db, "BEGIN IMMEDIATE TRANSACTION;", NULL, NULL, &error))
 		return error;
 
 	sql = sqlite3_mprintf ("DELETE FROM cert_requests WHERE id = %"GNOMINT_GUINT64_FORMAT" ;", 
@@ -1799,7 +3484,7 @@ gchar * ca_file_revoke_crt (guint64 id)
 	gchar *sql = NULL;
 	gchar *error = NULL;
 
-	if (sqlite3_exec (ca_db, "BEGIN TRANSACTION;", NULL, NULL, &error))
+	if (sqlite3_exec (ca_db, "BEGIN IMMEDIATE TRANSACTION;", NULL, NULL, &error))
 		return error;
 
 	sql = sqlite3_mprintf ("UPDATE certificates SET revocation=%ld WHERE id = %"GNOMINT_GUINT64_FORMAT" ;", 
@@ -1821,7 +3506,7 @@ gchar * ca_file_revoke_crt_with_date (guint64 id, time_t date)
 	gchar *sql = NULL;
 	gchar *error = NULL;
 
-	if (sqlite3_exec (ca_db, "BEGIN TRANSACTION;", NULL, NULL, &error))
+	if (sqlite3_exec (ca_db, "BEGIN IMMEDIATE TRANSACTION;", NULL, NULL, &error))
 		return error;
 
 	sql = sqlite3_mprintf ("UPDATE certificates SET revocation=%ld WHERE id = %"GNOMINT_GUINT64_FORMAT" ;", 
@@ -2015,7 +3700,7 @@ void __ca_file_mark_expired_and_revoked_certificates_as_already_shown_in_crl (gu
                 
                 sql = sqlite3_mprintf ("UPDATE certificates SET expired_already_in_crl=1, revocation=%ld "
                                        "WHERE parent_id=%"GNOMINT_GUINT64_FORMAT" AND revocation IS NOT NULL AND pem='%q' AND "
-                                       "expired_already_in_crl=0 AND expiration < strftime('%%s','now'));",
+                                       "expired_already_in_crl=0 AND expiration < strftime('%%s','now');",
                                        revocation, ca_id, certificate_pem);
 
 
@@ -2026,23 +3711,25 @@ void __ca_file_mark_expired_and_revoked_certificates_as_already_shown_in_crl (gu
         }
 }
 
-gint ca_file_begin_new_crl_transaction (guint64 ca_id, time_t timestamp)
+gint ca_file_new_crl_version (guint64 ca_id, time_t timestamp)
 {
         gchar * sql;
         gchar **last_crl;
         gint next_crl_version;
         gchar *error;
 
-        last_crl = __ca_file_get_single_row (ca_db, "SELECT crl_version FROM ca_crl WHERE ca_id=%"GNOMINT_GUINT64_FORMAT, ca_id);
+	if (sqlite3_exec (ca_db, "BEGIN IMMEDIATE TRANSACTION;", NULL, NULL, &error))
+		return 0;
+
+        // Read inside the transaction, so two writers never take the same version
+        last_crl = __ca_file_get_single_row (ca_db, "SELECT COALESCE(MAX(crl_version), 0) FROM ca_crl "
+                                             "WHERE ca_id=%"GNOMINT_GUINT64_FORMAT, ca_id);
         if (! last_crl)
                 next_crl_version = 1;
         else {
                 next_crl_version = atoi (last_crl[0]) + 1;
                 g_strfreev (last_crl);
         }
-        
-	if (sqlite3_exec (ca_db, "BEGIN TRANSACTION;", NULL, NULL, &error))
-		return 0;
 
         sql = sqlite3_mprintf ("INSERT INTO ca_crl (id, ca_id, crl_version, date) VALUES (NULL, %"GNOMINT_GUINT64_FORMAT", %u, %u);",
                                ca_id, next_crl_version, timestamp);
@@ -2050,29 +3737,105 @@ gint ca_file_begin_new_crl_transaction (guint64 ca_id, time_t timestamp)
 	if (sqlite3_exec (ca_db, sql, NULL, NULL, &error)){
                 sqlite3_free (sql);
                 fprintf (stderr, "%s\n", error);
+                sqlite3_exec (ca_db, "ROLLBACK;", NULL, NULL, NULL);
 		return 0;        
         }
 
         sqlite3_free (sql);
+
+	if (sqlite3_exec (ca_db, "COMMIT;", NULL, NULL, &error)) {
+                fprintf (stderr, "%s\n", error);
+                sqlite3_exec (ca_db, "ROLLBACK;", NULL, NULL, NULL);
+		return 0;
+	}
         
         return next_crl_version;
 
 }
 
-void ca_file_commit_new_crl_transaction (guint64 ca_id, const GList *revoked_certs)
+gboolean ca_file_store_crl (guint64 ca_id, gint crl_version, const GList *revoked_certs,
+			    const gchar *pem, const gchar *input_digest, time_t next_update)
 {
         gchar *error;
+        gchar *sql;
+        gchar **row;
+
+	if (sqlite3_exec (ca_db, "BEGIN IMMEDIATE TRANSACTION;", NULL, NULL, &error))
+		return FALSE;
+
+        // Another publisher may have stored a later version while this one was signed
+        row = __ca_file_get_single_row (ca_db, "SELECT crl_version FROM ca_crl WHERE ca_id=%"GNOMINT_GUINT64_FORMAT
+                                        " AND crl_version > %d AND pem IS NOT NULL LIMIT 1;", ca_id, crl_version);
+        if (row) {
+                g_strfreev (row);
+                sqlite3_exec (ca_db, "ROLLBACK;", NULL, NULL, NULL);
+                return FALSE;
+        }
 
         __ca_file_mark_expired_and_revoked_certificates_as_already_shown_in_crl (ca_id, revoked_certs);
-        sqlite3_exec (ca_db, "COMMIT;", NULL, NULL, &error);
 
+        // Only the last CRL of each CA is kept
+        sql = sqlite3_mprintf ("UPDATE ca_crl SET pem=NULL WHERE ca_id=%"GNOMINT_GUINT64_FORMAT" AND pem IS NOT NULL; "
+                               "UPDATE ca_crl SET pem=%Q, input_digest=%Q, next_update=%ld "
+                               "WHERE ca_id=%"GNOMINT_GUINT64_FORMAT" AND crl_version=%d;",
+                               ca_id, pem, input_digest, (long) next_update, ca_id, crl_version);
+        if (sqlite3_exec (ca_db, sql, NULL, NULL, &error)) {
+                fprintf (stderr, "%s\n", error);
+                sqlite3_free (sql);
+                sqlite3_exec (ca_db, "ROLLBACK;", NULL, NULL, NULL);
+                return FALSE;
+        }
+        sqlite3_free (sql);
+
+        if (sqlite3_exec (ca_db, "COMMIT;", NULL, NULL, &error)) {
+                sqlite3_exec (ca_db, "ROLLBACK;", NULL, NULL, NULL);
+                return FALSE;
+        }
+
+        return TRUE;
 }
 
-void ca_file_rollback_new_crl_transaction ()
+void ca_file_discard_crl_version (guint64 ca_id, gint crl_version)
 {
-        gchar *error;
+        gchar *sql;
+
+        sql = sqlite3_mprintf ("DELETE FROM ca_crl WHERE ca_id=%"GNOMINT_GUINT64_FORMAT" AND crl_version=%d;",
+                               ca_id, crl_version);
+        sqlite3_exec (ca_db, sql, NULL, NULL, NULL);
+        sqlite3_free (sql);
+}
 
-	sqlite3_exec (ca_db, "ROLLBACK;", NULL, NULL, &error);
+CaFileCrl * ca_file_get_last_crl (guint64 ca_id)
+{
+        CaFileCrl *crl;
+        gchar **row;
+
+        row = __ca_file_get_single_row (ca_db, "SELECT crl_version, date, COALESCE(next_update, 0), "
+                                        "COALESCE(input_digest, ''), pem FROM ca_crl "
+                                        "WHERE ca_id=%"GNOMINT_GUINT64_FORMAT" AND pem IS NOT NULL "
+                                        "ORDER BY crl_version DESC LIMIT 1;", ca_id);
+        if (! row)
+                return NULL;
+
+        crl = g_new0 (CaFileCrl, 1);
+        crl->crl_version = atoi (row[0]);
+        crl->date = atol (row[1]);
+        crl->next_update = atol (row[2]);
+        crl->input_digest = g_strdup (row[3]);
+        crl->pem = g_strdup (row[4]);
+        g_strfreev (row);
+
+        return crl;
+}
+
+void ca_file_crl_free (CaFileCrl *crl)
+{
+        if (! crl)
+                return;
+
+        g_free (crl->input_digest);
+        g_free (crl->pem);
+        g_free (crl);
 }
 
 gboolean ca_file_is_password_protected()
@@ -2104,18 +3867,80 @@ gboolean ca_file_check_password (const gchar *password)
 	if (! result)
 		return FALSE;	
 
-	res = pkey_manage_check_password (password, result[0]);
+	res = pkey_manage_check_password (password, result[0]);
+
+	g_strfreev (result);
+
+	return res;
+}
+
+typedef	struct {
+	const gchar *old_password;
+	const gchar *new_password;
+	const gchar *table;
+} CaFilePwdChange;
+
+/* Private keys in the archive are reciphered in a transaction of their own,
+   committed before the main file one. The archive records the password its
+   keys are ciphered with, so a change interrupted between both commits can
+   just be repeated: the archive is then skipped */
+gboolean __ca_file_archive_password_update (CaFilePwdChange *pwd_change, 
+					    int (*callback) (void *, int, char **, char **))
+{
+	gchar **aux;
+	gchar *hashed_pwd;
+	gchar *sql;
+	gchar *error = NULL;
+	gboolean done;
+	gboolean valid;
+
+	if (! __ca_file_get_connection ()->archive_attached)
+		return TRUE;
+
+	// Archives without the record are ciphered as the main file
+	aux = __ca_file_get_single_row (ca_db, "SELECT value FROM archive.archive_properties WHERE name='hashed_password';");
+	if (aux) {
+		if (pwd_change->new_password)
+			done = (aux[0][0] && pkey_manage_check_password (pwd_change->new_password, aux[0]));
+		else
+			done = (! aux[0][0]);
+		if (pwd_change->old_password)
+			valid = (aux[0][0] && pkey_manage_check_password (pwd_change->old_password, aux[0]));
+		else
+			valid = (! aux[0][0]);
+		g_strfreev (aux);
+
+		if (done)
+			return TRUE;
+		if (! valid) {
+			fprintf (stderr, "The archive is ciphered with another password\n");
+			return FALSE;
+		}
+	}
+
+	if (sqlite3_exec (ca_db, "BEGIN IMMEDIATE TRANSACTION;", NULL, NULL, &error))
+		return FALSE;
 
-	g_strfreev (result);
+	pwd_change->table = "archive.certificates";
+	if (sqlite3_exec (ca_db, "SELECT id, private_key_in_db, private_key, dn FROM archive.certificates",
+			  callback, pwd_change, &error)) {
+		sqlite3_exec (ca_db, "ROLLBACK;", NULL, NULL, &error);	
+		return FALSE;
+	}
 
-	return res;
-}
+	hashed_pwd = (pwd_change->new_password ? pkey_manage_encrypt_password (pwd_change->new_password) : g_strdup (""));
+	sql = sqlite3_mprintf ("INSERT OR REPLACE INTO archive.archive_properties (name, value) VALUES ('hashed_password', '%q');",
+			       hashed_pwd);
+	g_free (hashed_pwd);
+	if (sqlite3_exec (ca_db, sql, NULL, NULL, &error)) {
+		sqlite3_free (sql);
+		sqlite3_exec (ca_db, "ROLLBACK;", NULL, NULL, &error);	
+		return FALSE;
+	}
+	sqlite3_free (sql);
 
-typedef	struct {
-	const gchar *old_password;
-	const gchar *new_password;
-	const gchar *table;
-} CaFilePwdChange;
+	return (sqlite3_exec (ca_db, "COMMIT;", NULL, NULL, &error) == SQLITE_OK);
+}
 
 int  __ca_file_password_unprotect_cb (void *pArg, int argc, char **argv, char **columnNames)
 {
@@ -2142,7 +3967,7 @@ int  __ca_file_password_unprotect_cb (void *pArg, int argc, char **argv, char **
                                table, new_pkey, argv[0]);
 
 	if (sqlite3_exec (ca_db, sql, NULL, NULL, &error)) {
-		fprintf (stderr, "Error while executing: %s. %s", sql, error);
+		fprintf (stderr, "Error while updating the private key of %s: %s\n", argv[3], error);
 		sqlite3_exec (ca_db, "ROLLBACK;", NULL, NULL, &error);	
 		sqlite3_free (sql);
 		g_free (new_pkey);
@@ -2167,9 +3992,16 @@ gboolean ca_file_password_unprotect(const gchar *old_password)
 	if (! ca_file_check_password (old_password))
 		return FALSE;
 
-	sqlite3_exec (ca_db, "BEGIN TRANSACTION;", NULL, NULL, &error);	
-	
+	// Pooled keys are ciphered with the old password: they are just thrown away
+	key_pool_stop (ca_file_get_current ());
+
 	pwd_change.old_password = old_password;
+	pwd_change.new_password = NULL;
+	if (! __ca_file_archive_password_update (&pwd_change, __ca_file_password_unprotect_cb))
+		return FALSE;
+
+	sqlite3_exec (ca_db, "BEGIN IMMEDIATE TRANSACTION;", NULL, NULL, &error);	
+	sqlite3_exec (ca_db, "DELETE FROM key_pool;", NULL, NULL, &error);
 
 	pwd_change.table = "certificates";
 	if (sqlite3_exec (ca_db, "SELECT id, private_key_in_db, private_key, dn FROM certificates",
@@ -2222,7 +4054,7 @@ int  __ca_file_password_protect_cb (void *pArg, int argc, char **argv, char **co
                                table, new_pkey, argv[0]);
 
 	if (sqlite3_exec (ca_db, sql, NULL, NULL, &error)) {
-		fprintf (stderr, "Error while executing: %s. %s", sql, error);
+		fprintf (stderr, "Error while updating the private key of %s: %s\n", argv[3], error);
 		sqlite3_exec (ca_db, "ROLLBACK;", NULL, NULL, &error);	
 		sqlite3_free (sql);
 		g_free (new_pkey);
@@ -2246,9 +4078,16 @@ gboolean ca_file_password_protect(const gchar *new_password)
 	if (ca_file_is_password_protected ())
 		return FALSE;
 
-	sqlite3_exec (ca_db, "BEGIN TRANSACTION;", NULL, NULL, &error);	
-	
+	// Pooled keys are not ciphered yet: they are just thrown away
+	key_pool_stop (ca_file_get_current ());
+
+	pwd_change.old_password = NULL;
 	pwd_change.new_password = new_password;
+	if (! __ca_file_archive_password_update (&pwd_change, __ca_file_password_protect_cb))
+		return FALSE;
+
+	sqlite3_exec (ca_db, "BEGIN IMMEDIATE TRANSACTION;", NULL, NULL, &error);	
+	sqlite3_exec (ca_db, "DELETE FROM key_pool;", NULL, NULL, &error);
 
 	if (sqlite3_exec (ca_db, "UPDATE db_properties SET value='1' WHERE name='is_password_protected';", 
 			  NULL, NULL, &error)) {
@@ -2315,13 +4154,15 @@ int  __ca_file_password_change_cb (void *pArg, int argc, char **argv, char **col
 
 	new_pkey = pkey_manage_crypt_w_pwd (clear_pkey, argv[3], new_pwd);
 
+	if (clear_pkey)
+		memset (clear_pkey, 0, strlen (clear_pkey));
 	g_free (clear_pkey);
 
         sql = sqlite3_mprintf ("UPDATE %q SET private_key='%q' WHERE id='%q';",
                                table, new_pkey, argv[0]);
 
 	if (sqlite3_exec (ca_db, sql, NULL, NULL, &error)) {
-		fprintf (stderr, "Error while executing: %s. %s", sql, error);
+		fprintf (stderr, "Error while updating the private key of %s: %s\n", argv[3], error);
 		sqlite3_exec (ca_db, "ROLLBACK;", NULL, NULL, &error);	
 		sqlite3_free (sql);
 		g_free (new_pkey);
@@ -2348,10 +4189,16 @@ gboolean ca_file_password_change(const gchar *old_password, const gchar *new_pas
 	if (! ca_file_check_password (old_password))
 		return FALSE;
 
-	sqlite3_exec (ca_db, "BEGIN TRANSACTION;", NULL, NULL, &error);	
-	
+	// Pooled keys are ciphered with the old password: they are just thrown away
+	key_pool_stop (ca_file_get_current ());
+
 	pwd_change.new_password = new_password;
 	pwd_change.old_password = old_password;
+	if (! __ca_file_archive_password_update (&pwd_change, __ca_file_password_change_cb))
+		return FALSE;
+
+	sqlite3_exec (ca_db, "BEGIN IMMEDIATE TRANSACTION;", NULL, NULL, &error);	
+	sqlite3_exec (ca_db, "DELETE FROM key_pool;", NULL, NULL, &error);
 
 	pwd_change.table = "certificates";
 	if (sqlite3_exec (ca_db, "SELECT id, private_key_in_db, private_key, dn FROM certificates",
@@ -2463,6 +4310,315 @@ gboolean ca_file_foreach_crt (CaFileCallbackFunc func, gboolean view_revoked, gp
 	return  (! error_str);
 }
 
+gboolean ca_file_foreach_crt_filtered (CaFileCallbackFunc func, const CaFileCertFilter *filter, gpointer userdata)
+{
+	gchar *error_str = NULL;
+	GString *sql = g_string_new ("SELECT id, is_ca, serial, subject, activation, expiration, revocation, private_key_in_db, pem, "
+				     "dn, parent_dn, parent_route FROM certificates WHERE id > ");
+	gchar *aux;
+
+	/* All the conditions are index-friendly: rows are read in id
+	   order starting after the last id of the previous page, so
+	   getting a page doesn't depend on the size of the table */
+	g_string_append_printf (sql, "%"G_GUINT64_FORMAT, filter->after_id);
+
+	if (filter->ca_id)
+		g_string_append_printf (sql, " AND parent_id = %"G_GUINT64_FORMAT, filter->ca_id);
+
+	if (filter->expiring_before)
+		g_string_append_printf (sql, " AND expiration < %ld", (long) filter->expiring_before);
+
+	if (filter->expiring_after)
+		g_string_append_printf (sql, " AND expiration > %ld", (long) filter->expiring_after);
+
+	switch (filter->revoked) {
+	case CA_FILE_REVOKED_FILTER_NOT_REVOKED:
+		g_string_append (sql, " AND revocation IS NULL");
+		break;
+	case CA_FILE_REVOKED_FILTER_ONLY_REVOKED:
+		g_string_append (sql, " AND revocation IS NOT NULL");
+		break;
+	default:
+		break;
+	}
+
+	if (filter->subject_prefix && filter->subject_prefix[0]) {
+		/* A range instead of LIKE, so the subject index can be used. 
+		   0xFF never appears in UTF-8 strings. */
+		gchar *upper = g_strconcat (filter->subject_prefix, "\xff", NULL);
+		aux = sqlite3_mprintf (" AND subject >= %Q AND subject < %Q", filter->subject_prefix, upper);
+		g_string_append (sql, aux);
+		sqlite3_free (aux);
+		g_free (upper);
+	}
+
+	g_string_append (sql, " ORDER BY id");
+
+	if (filter->limit)
+		g_string_append_printf (sql, " LIMIT %u", filter->limit);
+
+	sqlite3_exec (ca_db, sql->str, func, userdata, &error_str);
+
+	g_string_free (sql, TRUE);
+
+	return  (! error_str);
+}
+
+gboolean ca_file_foreach_crt_expiring (CaFileCallbackFunc func, time_t from, time_t until, guint64 ca_id, 
+				       gboolean view_revoked, gpointer userdata)
+{
+	gchar *error_str = NULL;
+	GString *sql = g_string_new (NULL);
+
+	/* The expiration index gives only the certificates in the window,
+	   so just them have to be sorted for grouping them by CA */
+	g_string_printf (sql, "SELECT c.id, c.is_ca, c.serial, c.subject, c.activation, c.expiration, c.revocation, "
+			 "c.private_key_in_db, NULL, c.dn, c.parent_dn, c.parent_route, c.parent_id, ca.subject "
+			 "FROM certificates c LEFT JOIN certificates ca ON ca.id = c.parent_id "
+			 "WHERE c.expiration >= %ld AND c.expiration < %ld", (long) from, (long) until);
+
+	if (ca_id)
+		g_string_append_printf (sql, " AND c.parent_id = %"G_GUINT64_FORMAT, ca_id);
+
+	if (! view_revoked)
+		g_string_append (sql, " AND c.revocation IS NULL");
+
+	g_string_append (sql, " ORDER BY c.parent_id, c.expiration, c.id;");
+
+	sqlite3_exec (ca_db, sql->str, func, userdata, &error_str);
+
+	g_string_free (sql, TRUE);
+
+	return  (! error_str);
+}
+
+int __ca_file_append_id (void *pArg, int argc, char **argv, char **columnNames)
+{
+	GArray *ids = (GArray *) pArg;
+	guint64 id = atoll (argv[0]);
+
+	g_array_append_val (ids, id);
+
+	return 0;
+}
+
+gint __ca_file_compare_ids (gconstpointer a, gconstpointer b)
+{
+	guint64 id_a = *((guint64 *) a);
+	guint64 id_b = *((guint64 *) b);
+
+	return (id_a < id_b ? -1 : (id_a > id_b ? 1 : 0));
+}
+
+GArray * ca_file_get_crt_children_ids (const gchar *parent_route, gboolean view_revoked)
+{
+	gchar *error_str = NULL;
+	GArray *ids = g_array_new (FALSE, FALSE, sizeof (guint64));
+	gchar *sql;
+
+	/* Only the (parent_route, revocation, id) index is read. Ids are
+	   sorted here, as the index gives them sorted by revocation first */
+	if (view_revoked)
+		sql = sqlite3_mprintf ("SELECT id FROM certificates WHERE parent_route=%Q;", parent_route);
+	else
+		sql = sqlite3_mprintf ("SELECT id FROM certificates WHERE parent_route=%Q AND revocation IS NULL;", parent_route);
+
+	sqlite3_exec (ca_db, sql, __ca_file_append_id, ids, &error_str);
+	sqlite3_free (sql);
+
+	g_array_sort (ids, __ca_file_compare_ids);
+
+	return ids;
+}
+
+gboolean ca_file_crt_has_children (const gchar *parent_route, gboolean view_revoked)
+{
+	gchar **row;
+
+	if (view_revoked)
+		row = __ca_file_get_single_row (ca_db, "SELECT id FROM certificates WHERE parent_route='%q' LIMIT 1;", 
+						parent_route);
+	else
+		row = __ca_file_get_single_row (ca_db, "SELECT id FROM certificates WHERE parent_route='%q' "
+						"AND revocation IS NULL LIMIT 1;", parent_route);
+
+	if (! row)
+		return FALSE;
+
+	g_strfreev (row);
+	return TRUE;
+}
+
+GArray * ca_file_get_csr_ids (void)
+{
+	gchar *error_str = NULL;
+	GArray *ids = g_array_new (FALSE, FALSE, sizeof (guint64));
+
+	sqlite3_exec (ca_db, "SELECT id FROM cert_requests ORDER BY id;", __ca_file_append_id, ids, &error_str);
+
+	return ids;
+}
+
+gchar * __ca_file_id_list (const guint64 *ids, guint ids_number)
+{
+	GString *list = g_string_new ("");
+	guint i;
+
+	for (i = 0; i < ids_number; i++) {
+		if (i)
+			g_string_append_c (list, ',');
+		g_string_append_printf (list, "%"G_GUINT64_FORMAT, ids[i]);
+	}
+
+	return g_string_free (list, FALSE);
+}
+
+gboolean ca_file_foreach_crt_in_ids (CaFileCallbackFunc func, const guint64 *ids, guint ids_number, gpointer userdata)
+{
+	gchar *error_str = NULL;
+	gchar *list = __ca_file_id_list (ids, ids_number);
+	gchar *sql;
+
+	/* PEM column is left empty: it's by far the biggest one, and it
+	   can be read with ca_file_get_public_pem_from_id when needed */
+	sql = g_strdup_printf ("SELECT id, is_ca, serial, subject, activation, expiration, revocation, private_key_in_db, NULL, "
+			       "dn, parent_dn, parent_route FROM all_certificates WHERE id IN (%s);", list);
+
+	sqlite3_exec (ca_db, sql, func, userdata, &error_str);
+
+	g_free (sql);
+	g_free (list);
+
+	return (! error_str);
+}
+
+gboolean ca_file_foreach_csr_in_ids (CaFileCallbackFunc func, const guint64 *ids, guint ids_number, gpointer userdata)
+{
+	gchar *error_str = NULL;
+	gchar *list = __ca_file_id_list (ids, ids_number);
+	gchar *sql;
+
+	sql = g_strdup_printf ("SELECT id, subject, private_key_in_db, NULL, parent_ca FROM cert_requests WHERE id IN (%s);", list);
+
+	sqlite3_exec (ca_db, sql, func, userdata, &error_str);
+
+	g_free (sql);
+	g_free (list);
+
+	return (! error_str);
+}
+
+gchar * __ca_file_search_terms (const gchar *hex_string)
+{
+	gchar **bytes;
+	gchar *joined;
+	gchar *result;
+
+	if (! hex_string)
+		return g_strdup ("");
+
+	/* Both forms are indexed: "AB:CD:EF", that gives a token per byte,
+	   and "ABCDEF", so it can be looked for as pasted from other tools */
+	bytes = g_strsplit (hex_string, ":", -1);
+	joined = g_strjoinv ("", bytes);
+	result = g_strdup_printf ("%s %s", hex_string, joined);
+
+	g_free (joined);
+	g_strfreev (bytes);
+
+	return result;
+}
+
+gchar * __ca_file_search_index_crt (sqlite3 *db, guint64 id, const gchar *serial, const TlsCert *cert)
+{
+	gchar *error = NULL;
+	gchar *serial_terms = __ca_file_search_terms (serial);
+	gchar *sha1_terms = __ca_file_search_terms (cert->sha1);
+	gchar *sha256_terms = __ca_file_search_terms (cert->sha256);
+	gchar *sql;
+
+	sql = sqlite3_mprintf ("INSERT OR REPLACE INTO certificates_search (rowid, subject, dn, parent_dn, serial, fingerprints) "
+			       "VALUES (%"GNOMINT_GUINT64_FORMAT", %Q, %Q, %Q, '%q', '%q %q');",
+			       id, cert->cn, cert->dn, cert->i_dn, serial_terms, sha1_terms, sha256_terms);
+
+	sqlite3_exec (db, sql, NULL, NULL, &error);
+
+	sqlite3_free (sql);
+	g_free (serial_terms);
+	g_free (sha1_terms);
+	g_free (sha256_terms);
+
+	return error;
+}
+
+gchar * __ca_file_search_sql (const gchar *columns, const gchar *text, gboolean view_revoked, guint limit)
+{
+	GString *query = g_string_new ("");
+	gchar **words = g_strsplit_set (text, " \t\n", -1);
+	gchar **quoted;
+	gchar *escaped;
+	gchar *sql = NULL;
+	gint i;
+
+	/* Each word is looked for as a quoted prefix, so the text
+	   given by the user is never parsed as FTS5 query syntax */
+	for (i = 0; words[i]; i++) {
+		if (! words[i][0])
+			continue;
+
+		quoted = g_strsplit (words[i], "\"", -1);
+		escaped = g_strjoinv ("\"\"", quoted);
+		g_string_append_printf (query, "\"%s\"* ", escaped);
+		g_free (escaped);
+		g_strfreev (quoted);
+	}
+	g_strfreev (words);
+
+	if (query->len)
+		sql = sqlite3_mprintf ("SELECT %s FROM certificates_search "
+				       "JOIN all_certificates ON all_certificates.id = certificates_search.rowid "
+				       "WHERE certificates_search MATCH '%q' %s ORDER BY certificates_search.rank LIMIT %d;",
+				       columns, query->str, 
+				       (view_revoked ? "" : "AND all_certificates.revocation IS NULL"),
+				       (limit ? (gint) limit : -1));
+
+	g_string_free (query, TRUE);
+
+	return sql;
+}
+
+gboolean ca_file_search_crt (CaFileCallbackFunc func, const gchar *text, gboolean view_revoked, guint limit, gpointer userdata)
+{
+	gchar *error_str = NULL;
+	gchar *sql = __ca_file_search_sql ("all_certificates.id, is_ca, all_certificates.serial, all_certificates.subject, activation, "
+					   "expiration, revocation, private_key_in_db, NULL, all_certificates.dn, "
+					   "all_certificates.parent_dn, parent_route", 
+					   text, view_revoked, limit);
+
+	if (! sql)
+		return TRUE;
+
+	sqlite3_exec (ca_db, sql, func, userdata, &error_str);
+	sqlite3_free (sql);
+
+	return (! error_str);
+}
+
+GArray * ca_file_search_crt_ids (const gchar *text, gboolean view_revoked, guint limit)
+{
+	gchar *error_str = NULL;
+	GArray *ids = g_array_new (FALSE, FALSE, sizeof (guint64));
+	gchar *sql = __ca_file_search_sql ("all_certificates.id", text, view_revoked, limit);
+
+	if (! sql)
+		return ids;
+
+	sqlite3_exec (ca_db, sql, __ca_file_append_id, ids, &error_str);
+	sqlite3_free (sql);
+
+	return ids;
+}
+
 gboolean ca_file_foreach_csr (CaFileCallbackFunc func, gpointer userdata)
 {
 	gchar *error_str;
@@ -2490,15 +4646,131 @@ gboolean ca_file_foreach_policy (CaFileCallbackFunc func, guint64 ca_id, gpointe
 	
 }
 
+void __ca_file_profile_free (gpointer data)
+{
+	CaFileProfile *profile = (CaFileProfile *) data;
+
+	g_free (profile->name);
+	g_free (profile->crl_distribution_point);
+	tls_cert_template_free (profile->extensions);
+	g_free (profile);
+}
+
+gboolean ca_file_profile_set (guint64 ca_id, const gchar *name, gint months_to_expire, guint uses, 
+			      const gchar *crl_distribution_point)
+{
+	gchar *sql;
+	gchar *error = NULL;
+
+	// REPLACE gives a new id to the profile, so the template of the old one is not reused
+	sql = sqlite3_mprintf ("INSERT OR REPLACE INTO ca_profiles (ca_id, name, months_to_expire, uses, crl_distribution_point) "
+			       "VALUES (%"GNOMINT_GUINT64_FORMAT", '%q', %d, %u, %Q);",
+			       ca_id, name, months_to_expire, uses, crl_distribution_point);
+	sqlite3_exec (ca_db, sql, NULL, NULL, &error);
+	sqlite3_free (sql);
+
+	if (error) {
+		fprintf (stderr, "%s\n", error);
+		sqlite3_free (error);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+gboolean ca_file_profile_delete (guint64 ca_id, const gchar *name)
+{
+	gchar *sql;
+	gchar *error = NULL;
+
+	sql = sqlite3_mprintf ("DELETE FROM ca_profiles WHERE ca_id=%"GNOMINT_GUINT64_FORMAT" AND name='%q';", ca_id, name);
+	sqlite3_exec (ca_db, sql, NULL, NULL, &error);
+	sqlite3_free (sql);
+
+	if (error) {
+		fprintf (stderr, "%s\n", error);
+		sqlite3_free (error);
+		return FALSE;
+	}
+
+	return (sqlite3_changes (ca_db) > 0);
+}
+
+const CaFileProfile * ca_file_profile_get (guint64 ca_id, const gchar *name)
+{
+	CaFileProfile *profile;
+	TlsCertCreationData *creation_data;
+	guint64 *key;
+	gchar **row;
+	gchar *pem;
+
+	row = __ca_file_get_single_row (ca_db, "SELECT id, months_to_expire, uses, COALESCE(crl_distribution_point, '') "
+					"FROM ca_profiles WHERE ca_id=%"GNOMINT_GUINT64_FORMAT" AND name='%q';", ca_id, name);
+	if (! row)
+		return NULL;
+
+	key = g_new (guint64, 1);
+	*key = atoll (row[0]);
+
+	profile = g_hash_table_lookup (__ca_file_get_connection ()->profile_cache, key);
+	if (profile) {
+		g_free (key);
+		g_strfreev (row);
+		return profile;
+	}
+
+	profile = g_new0 (CaFileProfile, 1);
+	profile->id = *key;
+	profile->ca_id = ca_id;
+	profile->name = g_strdup (name);
+	profile->months_to_expire = atoi (row[1]);
+	profile->uses = strtoul (row[2], NULL, 10);
+	profile->crl_distribution_point = g_strdup (row[3]);
+	g_strfreev (row);
+
+	/* Encode the extensions now, once for all the certificates issued with this profile */
+	creation_data = g_new0 (TlsCertCreationData, 1);
+	tls_cert_creation_data_set_uses (creation_data, profile->uses);
+	creation_data->crl_distribution_point = profile->crl_distribution_point;
+
+	pem = ca_file_get_public_pem_from_id (CA_FILE_ELEMENT_TYPE_CERT, ca_id);
+	if (pem)
+		profile->extensions = tls_cert_template_new (creation_data, pem);
+	g_free (pem);
+	g_free (creation_data);
+
+	g_hash_table_insert (__ca_file_get_connection ()->profile_cache, key, profile);
+
+	return profile;
+}
+
+gboolean ca_file_foreach_profile (CaFileCallbackFunc func, guint64 ca_id, gpointer userdata)
+{
+	gchar *error_str = NULL;
+	gchar *sql = sqlite3_mprintf ("SELECT id, ca_id, name, months_to_expire, uses, crl_distribution_point "
+				      "FROM ca_profiles WHERE ca_id=%"GNOMINT_GUINT64_FORMAT" ORDER BY name;", ca_id);
+
+	sqlite3_exec (ca_db, sql, func, userdata, &error_str);
+	sqlite3_free (sql);
+
+	if (error_str) {
+		fprintf (stderr, "%s\n", error_str);
+		sqlite3_free (error_str);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
 gboolean ca_file_get_id_from_serial_issuer_id (const UInt160 *serial, const guint64 issuer_id, guint64 *db_id)
 {
         gchar **aux;
-        gchar *serial_str = uint160_strdup_printf(serial);
+        gchar serialhex[UINT160_HEX_SIZE];
 
-        aux = __ca_file_get_single_row (ca_db, "SELECT id FROM certificates WHERE parent_id=%"GNOMINT_GUINT64_FORMAT" AND serial='%q';", 
-                                        issuer_id, serial_str);
+        uint160_write_hex (serial, serialhex);
+        aux = __ca_file_get_single_row (ca_db, "SELECT id FROM all_certificates WHERE parent_id=%"GNOMINT_GUINT64_FORMAT" AND serial_bin=X'%s';", 
+                                        issuer_id, serialhex);
 	
-        g_free (serial_str);
         
 	if (! aux)
 		return FALSE;
@@ -2548,7 +4820,7 @@ gchar * __ca_file_get_field_from_id (CaFileElementType type, guint64 db_id, cons
 	gchar * res;
 
 	if (type == CA_FILE_ELEMENT_TYPE_CERT) {
-		aux = __ca_file_get_single_row (ca_db, "SELECT %s FROM certificates WHERE id=%" GNOMINT_GUINT64_FORMAT ";", field, db_id);
+		aux = __ca_file_get_single_row (ca_db, "SELECT %s FROM all_certificates WHERE id=%" GNOMINT_GUINT64_FORMAT ";", field, db_id);
 	} else {
 		aux = __ca_file_get_single_row (ca_db, "SELECT %s FROM cert_requests WHERE id=%" GNOMINT_GUINT64_FORMAT ";", field, db_id);
 	}
@@ -2638,6 +4910,91 @@ gboolean ca_file_mark_pkey_as_extracted_for_id (CaFileElementType type, const gc
 	return (! error);
 }
 
+void __ca_file_policy_free (gpointer data)
+{
+	CaPolicy *policy = (CaPolicy *) data;
+
+	g_free (policy->crl_distribution_point);
+	g_free (policy);
+}
+
+void __ca_file_policy_invalidate ()
+{
+	CaFile *ca_file = ca_file_get_current ();
+
+	// The caches of every connection are dropped the next time they are used
+	if (ca_file)
+		g_atomic_int_inc (&ca_file->policy_generation);
+}
+
+int __ca_file_policy_load_cb (void *pArg, int argc, char **argv, char **columnNames)
+{
+	CaPolicy *policy = (CaPolicy *) pArg;
+	gint i;
+
+	if (! strcmp (argv[0], "CRL_DISTRIBUTION_POINT")) {
+		g_free (policy->crl_distribution_point);
+		policy->crl_distribution_point = g_strdup (argv[1]);
+		return 0;
+	}
+
+	for (i = 0; ca_file_policy_fields[i].name; i++) {
+		if (! strcmp (argv[0], ca_file_policy_fields[i].name)) {
+			G_STRUCT_MEMBER (gint, policy, ca_file_policy_fields[i].offset) = (argv[1] ? atoi (argv[1]) : 0);
+			break;
+		}
+	}
+
+	return 0;
+}
+
+void ca_file_policy_flush_cache ()
+{
+	__ca_file_policy_invalidate ();
+}
+
+const CaPolicy * ca_file_policy_get_all (guint64 ca_id)
+{
+	static const CaPolicy no_policy;
+	CaFileConnection *connection = __ca_file_get_connection ();
+	CaPolicy *policy;
+	guint64 *key;
+	gchar *error_str = NULL;
+	gchar *sql;
+	gint generation;
+
+	if (! connection)
+		return &no_policy;
+
+	generation = g_atomic_int_get (&ca_file_get_current ()->policy_generation);
+	if (connection->policy_generation != generation) {
+		g_hash_table_remove_all (connection->policy_cache);
+		connection->policy_generation = generation;
+	}
+
+	policy = g_hash_table_lookup (connection->policy_cache, &ca_id);
+	if (policy)
+		return policy;
+
+	/* Policies not in the database are 0, as with ca_file_policy_get_int */
+	policy = g_new0 (CaPolicy, 1);
+
+	sql = sqlite3_mprintf ("SELECT name, value FROM ca_policies WHERE ca_id=%"GNOMINT_GUINT64_FORMAT";", ca_id);
+	sqlite3_exec (ca_db, sql, __ca_file_policy_load_cb, policy, &error_str);
+	sqlite3_free (sql);
+
+	if (error_str) {
+		fprintf (stderr, "%s\n", error_str);
+		sqlite3_free (error_str);
+	}
+
+	key = g_new (guint64, 1);
+	*key = ca_id;
+	g_hash_table_insert (connection->policy_cache, key, policy);
+
+	return policy;
+}
+
 gchar * ca_file_policy_get (guint64 ca_id, gchar *property_name)
 {
 	gchar **row = __ca_file_get_single_row (ca_db, "SELECT value FROM ca_policies WHERE name='%s' AND ca_id=%"GNOMINT_GUINT64_FORMAT" ;", 
@@ -2662,6 +5019,8 @@ gboolean ca_file_policy_set (guint64 ca_id, gchar *property_name, const gchar *
 	gchar *error = NULL;
 	gchar *sql = NULL;
 
+	__ca_file_policy_invalidate ();
+
 	aux = __ca_file_get_single_row (ca_db, "SELECT id, ca_id, name, value FROM ca_policies WHERE name='%s' AND ca_id=%"GNOMINT_GUINT64_FORMAT" ;", 
 				      property_name, ca_id);
 
@@ -2713,6 +5072,8 @@ gboolean ca_file_policy_set_int (guint64 ca_id, gchar *property_name, gint value
 	gchar *error = NULL;
 	gchar *sql = NULL;
 
+	__ca_file_policy_invalidate ();
+
 	aux = __ca_file_get_single_row (ca_db, "SELECT id, ca_id, name, value FROM ca_policies WHERE name='%s' AND ca_id=%"GNOMINT_GUINT64_FORMAT" ;", 
 				      property_name, ca_id);
 
@@ -2764,7 +5125,7 @@ gboolean ca_file_check_if_is_cert_id (guint64 cert_id)
 	gchar **aux;
 	gboolean res;
 
-	aux = __ca_file_get_single_row (ca_db, "SELECT COUNT(*) FROM certificates WHERE id=%"GNOMINT_GUINT64_FORMAT" ;",
+	aux = __ca_file_get_single_row (ca_db, "SELECT COUNT(*) FROM all_certificates WHERE id=%"GNOMINT_GUINT64_FORMAT" ;",
 					cert_id);
 
 	if (!aux) {
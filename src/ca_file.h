@@ -30,16 +30,73 @@ typedef enum {
 	CA_FILE_ELEMENT_TYPE_CSR=1 
 } CaFileElementType;
 
+// An opened CA database. Every thread gets its own connection to it the first time it calls
+// a ca_file_* function, so these can be used from worker threads too.
+typedef struct _CaFile CaFile;
+
 gchar * ca_file_create (const gchar *filename);
 
 gboolean ca_file_open (gchar *file_name, gboolean create);
 
+// Called while upgrading an old database, after each chunk of rows. If it isn't set, progress
+// is written to stderr
+typedef void (* CaFileUpgradeProgressFunc) (const gchar *step, guint64 done, guint64 total, gpointer user_data);
+void ca_file_set_upgrade_progress_func (CaFileUpgradeProgressFunc func, gpointer user_data);
+
+// SQL statements that take at least the given milliseconds are written to stderr, with the
+// rows they returned and, if they scanned a table, their query plan (0 = never). The
+// environment variable GNOMINT_SLOW_QUERY_MS, if set, takes precedence
+void ca_file_set_slow_query_threshold (gint threshold_ms);
+
 void ca_file_close (void);
 
+// Opens another database, without closing the current one nor making the new one current
+CaFile * ca_file_handle_open (const gchar *file_name, gboolean create);
+void ca_file_handle_close (CaFile *ca_file);
+const gchar * ca_file_get_filename (CaFile *ca_file);
+
+// The database used by the ca_file_* functions called from this thread (by default, the opened one)
+CaFile * ca_file_get_current (void);
+void ca_file_set_current (CaFile *ca_file);
+// To be called by worker threads when they are done with the database
+void ca_file_release_thread_connection (void);
+// Password already given for the current database, so it isn't asked again (NULL if none)
+void ca_file_set_unlocked_password (const gchar *password);
+const gchar * ca_file_get_unlocked_password (void);
+
 gboolean ca_file_save_as (gchar *new_file_name);
 
 gint ca_file_get_number_of_certs ();
 gint ca_file_get_number_of_csrs ();
+gint ca_file_get_number_of_revoked_certs ();
+gint ca_file_get_number_of_archived_certs ();
+
+// CaFileCountersColumns: one row per issuer CA (id 0 = no CA in the database)
+enum CaFileCountersColumns {CA_FILE_COUNTERS_COLUMN_CA_ID=0,
+      CA_FILE_COUNTERS_COLUMN_CA_SUBJECT=1,
+      CA_FILE_COUNTERS_COLUMN_CERTS=2,
+      CA_FILE_COUNTERS_COLUMN_REVOKED=3,
+      CA_FILE_COUNTERS_COLUMN_EXPIRED=4,     // Expired and not revoked
+      CA_FILE_COUNTERS_COLUMN_CAS=5,
+      CA_FILE_COUNTERS_COLUMN_CSRS=6,
+      CA_FILE_COUNTERS_COLUMN_ARCHIVED=7,
+      CA_FILE_COUNTERS_COLUMN_NUMBER=8};
+gboolean ca_file_foreach_counters (CaFileCallbackFunc func, gpointer userdata);
+
+// Moves the certificates expired before the given date (and, if revoked, already
+// shown as expired in a CRL) to the archive database. Returns how many were moved, or -1.
+gint ca_file_archive_crts (time_t expired_before, gchar **error);
+// Days after expiration for archiving certificates when the file is opened (0 = never)
+gint ca_file_get_archive_policy ();
+gboolean ca_file_set_archive_policy (gint days);
+
+// Pre-generated key pairs. Rows of ca_file_foreach_key_pool_size are: key type, bitlength,
+// wanted size and available keys. A size of 0 removes the pool for that key type and bitlength
+gboolean ca_file_foreach_key_pool_size (CaFileCallbackFunc func, gpointer userdata);
+gboolean ca_file_set_key_pool_size (gint key_type, gint key_bitlength, gint size);
+gboolean ca_file_key_pool_add (gint key_type, gint key_bitlength, const gchar *private_key);
+// Removes a key from the pool and returns it as stored (NULL if the pool is empty)
+gchar * ca_file_key_pool_take (gint key_type, gint key_bitlength);
 
 void ca_file_get_next_serial (UInt160 *serial, guint64 ca_id);
 gboolean ca_file_set_next_serial (UInt160 *serial, guint64 ca_id);
@@ -52,6 +109,19 @@ gchar * ca_file_insert_cert (gboolean is_ca,
 			     gchar *pem_private_key_info,
 			     gchar *pem_certificate);
 
+// Inserts several end-entity certificates in a single transaction. Each one is saved with the serial
+// it was signed with, which must have been taken from its CA beforehand (with ca_file_get_next_serial,
+// and the following ones), and the highest one becomes the last assigned serial of the CA. A failed
+// certificate leaves nothing in the database, and doesn't undo the others. revocations[i] is the revocation date of
+// the i-th one (0 if not revoked); revocations and private_key_infos can be NULL. errors[i] gets the
+// error of the i-th one. Returns the number of inserted certificates, or -1 if the transaction failed
+gint ca_file_insert_certs (guint number,
+			   gboolean private_key_in_db,
+			   gchar **private_key_infos,
+			   gchar **pem_certificates,
+			   const time_t *revocations,
+			   gchar **errors);
+
 gchar * ca_file_insert_imported_cert (gboolean is_ca,
                                       const UInt160 serial,
                                       const gchar *pem_certificate,
@@ -61,6 +131,13 @@ gchar * ca_file_insert_csr (gchar *pem_private_key,
 			    gchar *pem_csr,
 	                    gchar *parent_ca_id_str,
                             guint64 *id);
+// Inserts several CSRs in a single transaction. errors[i] gets the error of the i-th one (NULL if it
+// was inserted). Returns the number of inserted CSRs, or -1 if the transaction failed
+gint ca_file_insert_csrs (guint number,
+			  gchar **pem_csr_private_keys,
+			  gchar **pem_csrs,
+			  gchar **parent_ca_id_strs,
+			  gchar **errors);
 gchar * ca_file_insert_imported_privkey (const gchar *privkey_pem);
 
 gchar * ca_file_remove_csr (guint64 id);
@@ -102,11 +179,46 @@ enum CaFileCSRColumns {CA_FILE_CSR_COLUMN_ID=0,
       CA_FILE_CSR_COLUMN_NUMBER=5};
 
 
+typedef enum {
+	CA_FILE_REVOKED_FILTER_NOT_REVOKED=0,
+	CA_FILE_REVOKED_FILTER_ANY=1,
+	CA_FILE_REVOKED_FILTER_ONLY_REVOKED=2
+} CaFileRevokedFilter;
+
+typedef struct {
+	guint64 ca_id;                 // Only certificates issued by this CA (0 = any)
+	time_t expiring_before;        // 0 = no limit
+	time_t expiring_after;         // 0 = no limit
+	CaFileRevokedFilter revoked;
+	const gchar *subject_prefix;   // NULL = any subject
+	guint64 after_id;              // Keyset pagination: only ids greater than this one
+	guint limit;                   // 0 = no limit
+} CaFileCertFilter;
+
 gboolean ca_file_foreach_ca (CaFileCallbackFunc func, gpointer userdata);
 gboolean ca_file_foreach_crt (CaFileCallbackFunc func, gboolean view_revoked, gpointer userdata);
+gboolean ca_file_foreach_crt_filtered (CaFileCallbackFunc func, const CaFileCertFilter *filter, gpointer userdata);
+
+// Certificates expiring in [from, until), grouped by issuer and sorted by expiration. 
+// Rows have the CaFileCertColumns (without PEM) followed by these ones:
+enum CaFileExpiringColumns {CA_FILE_EXPIRING_COLUMN_CA_ID=12,
+      CA_FILE_EXPIRING_COLUMN_CA_SUBJECT=13,   // NULL if the issuer is not in the database
+      CA_FILE_EXPIRING_COLUMN_NUMBER=14};
+gboolean ca_file_foreach_crt_expiring (CaFileCallbackFunc func, time_t from, time_t until, guint64 ca_id, 
+				       gboolean view_revoked, gpointer userdata);
 gboolean ca_file_foreach_csr (CaFileCallbackFunc func, gpointer userdata);
+
+GArray * ca_file_get_crt_children_ids (const gchar *parent_route, gboolean view_revoked);
+gboolean ca_file_crt_has_children (const gchar *parent_route, gboolean view_revoked);
+GArray * ca_file_get_csr_ids (void);
+gboolean ca_file_foreach_crt_in_ids (CaFileCallbackFunc func, const guint64 *ids, guint ids_number, gpointer userdata);
+gboolean ca_file_foreach_csr_in_ids (CaFileCallbackFunc func, const guint64 *ids, guint ids_number, gpointer userdata);
 gboolean ca_file_foreach_policy (CaFileCallbackFunc func, guint64 ca_id, gpointer userdata);
 
+// Full-text search over subject, DN, issuer DN, serial and fingerprints, best matches first (limit 0 = no limit)
+gboolean ca_file_search_crt (CaFileCallbackFunc func, const gchar *text, gboolean view_revoked, guint limit, gpointer userdata);
+GArray * ca_file_search_crt_ids (const gchar *text, gboolean view_revoked, guint limit);
+
 gboolean ca_file_get_id_from_serial_issuer_id (const UInt160 *serial, const guint64 issuer_id, guint64 *db_id);
 gboolean ca_file_get_id_from_dn (CaFileElementType type, const gchar *dn, guint64 *db_id);
 gchar * ca_file_get_dn_from_id (CaFileElementType type, guint64 db_id);
@@ -117,15 +229,95 @@ gboolean ca_file_get_pkey_in_db_from_id (CaFileElementType type, guint64 db_id);
 gboolean ca_file_set_pkey_field_for_id (CaFileElementType type, const gchar *new_value, guint64 db_id);
 gboolean ca_file_mark_pkey_as_extracted_for_id (CaFileElementType type, const gchar *filename, guint64 db_id);
 
-gint ca_file_begin_new_crl_transaction (guint64 ca_id, time_t timestamp);
-void ca_file_commit_new_crl_transaction (guint64 ca_id, const GList *revoked_certs);
-void ca_file_rollback_new_crl_transaction (void);
+// A new CRL takes its version first, so it can be signed without keeping the database locked.
+// Then it is stored, with the digest of what it was generated from, as the last one of the CA,
+// or its version is discarded if it couldn't be signed. A CRL is not stored (and FALSE is
+// returned) if a later version of the same CA was already stored, e.g. by another publisher
+gint ca_file_new_crl_version (guint64 ca_id, time_t timestamp);
+gboolean ca_file_store_crl (guint64 ca_id, gint crl_version, const GList *revoked_certs,
+			    const gchar *pem, const gchar *input_digest, time_t next_update);
+void ca_file_discard_crl_version (guint64 ca_id, gint crl_version);
+
+typedef struct {
+	gint crl_version;
+	time_t date;
+	time_t next_update;
+	gchar *input_digest;
+	gchar *pem;
+} CaFileCrl;
+
+// Last CRL generated for the given CA (NULL if none was stored)
+CaFileCrl * ca_file_get_last_crl (guint64 ca_id);
+void ca_file_crl_free (CaFileCrl *crl);
+
+typedef struct {
+	gint months_to_expire;
+	gint hours_between_crl_updates;
+	gchar *crl_distribution_point;         // NULL if not set
+
+	gboolean c_inherit, c_force_same;
+	gboolean st_inherit, st_force_same;
+	gboolean l_inherit, l_force_same;
+	gboolean o_inherit, o_force_same;
+	gboolean ou_inherit, ou_force_same;
+
+	gboolean ca;
+	gboolean crl_sign;
+	gboolean non_repudiation;
+	gboolean digital_signature;
+	gboolean key_encipherment;
+	gboolean key_agreement;
+	gboolean data_encipherment;
+
+	gboolean tls_web_server;
+	gboolean tls_web_client;
+	gboolean time_stamping;
+	gboolean code_signing;
+	gboolean email_protection;
+	gboolean ocsp_signing;
+	gboolean any_purpose;
+} CaPolicy;
+
+// All the policies of a CA, read with a single query and cached. The returned structure belongs
+// to the cache of the calling thread: it is valid until any policy is changed, or the file is closed.
+const CaPolicy * ca_file_policy_get_all (guint64 ca_id);
+
+// Drops the cached policies of every thread, so they are read again (e.g. when other
+// programs can have changed them since)
+void ca_file_policy_flush_cache (void);
 
 gchar * ca_file_policy_get (guint64 ca_id, gchar *property_name);
 gboolean ca_file_policy_set (guint64 ca_id, gchar *property_name, const gchar *value);
 gint  ca_file_policy_get_int (guint64 ca_id, gchar *property_name);
 gboolean ca_file_policy_set_int (guint64 ca_id, gchar *property_name, gint value);
 
+// Named issuance profiles of a CA. Setting a profile again gives it a new id, so each
+// profile is encoded into an extension template only once while the file is open.
+typedef struct {
+	guint64 id;
+	guint64 ca_id;
+	gchar *name;
+	gint months_to_expire;
+	guint uses;                               // TlsCertUses flags
+	gchar *crl_distribution_point;            // Empty: copied from the CA certificate
+	struct __TlsCertTemplate *extensions;     // NULL if they couldn't be encoded
+} CaFileProfile;
+
+enum CaFileProfileColumns {CA_FILE_PROFILE_COLUMN_ID=0,
+      CA_FILE_PROFILE_COLUMN_CA_ID=1,
+      CA_FILE_PROFILE_COLUMN_NAME=2,
+      CA_FILE_PROFILE_COLUMN_MONTHS_TO_EXPIRE=3,
+      CA_FILE_PROFILE_COLUMN_USES=4,
+      CA_FILE_PROFILE_COLUMN_CRL_DISTRIBUTION_POINT=5,
+      CA_FILE_PROFILE_COLUMN_NUMBER=6};
+
+gboolean ca_file_profile_set (guint64 ca_id, const gchar *name, gint months_to_expire, guint uses, 
+			      const gchar *crl_distribution_point);
+gboolean ca_file_profile_delete (guint64 ca_id, const gchar *name);
+// The returned profile belongs to a cache, and is valid until the file is closed
+const CaFileProfile * ca_file_profile_get (guint64 ca_id, const gchar *name);
+gboolean ca_file_foreach_profile (CaFileCallbackFunc func, guint64 ca_id, gpointer userdata);
+
 gboolean ca_file_is_password_protected(void);
 gboolean ca_file_check_password (const gchar *password);
 gboolean ca_file_password_unprotect(const gchar *old_password);
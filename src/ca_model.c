@@ -0,0 +1,710 @@
+//  gnoMint: a graphical interface for managing a certification authority
+//  Copyright (C) 2006-2009 David Marín Carreño <davefx@gmail.com>
+//
+//  This file is part of gnoMint.
+//
+//  gnoMint is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 3 of the License, or   
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of 
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the  
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#include <glib.h>
+#include <glib-object.h>
+#include <glib/gi18n.h>
+#include <gtk/gtk.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ca_file.h"
+#include "ca_model.h"
+
+/* Rows are read from the database in blocks of this size, and at most
+   CA_MODEL_CACHE_SIZE rows of each kind are kept in memory. The children
+   of a node are only looked for when the node is expanded. */
+#define CA_MODEL_BLOCK_SIZE 128
+#define CA_MODEL_CACHE_SIZE 4096
+
+/* Search results are shown as a flat list with the best matches */
+#define CA_MODEL_SEARCH_LIMIT 1000
+
+typedef enum {
+	CA_MODEL_NODE_ROOT=0,
+	CA_MODEL_NODE_CERT_TITLE=1,
+	CA_MODEL_NODE_CSR_TITLE=2,
+	CA_MODEL_NODE_CERT=3,
+	CA_MODEL_NODE_CSR=4
+} CaModelNodeType;
+
+typedef struct _CaModelNode CaModelNode;
+
+struct _CaModelNode {
+	CaModelNodeType type;
+	guint64 id;
+	gchar *children_route;     // parent_route of the children certificates
+	CaModelNode *parent;
+	guint index;               // Position of the node in its parent
+	GArray *child_ids;         // NULL until the children are needed
+	GHashTable *child_nodes;   // Child index -> CaModelNode, created on demand
+	gint has_children;         // -1 if still unknown
+};
+
+typedef struct {
+	guint64 id;
+	gboolean is_ca;
+	gchar *serial;
+	gchar *subject;
+	gint activation;
+	gint expiration;
+	gint revocation;
+	gboolean private_key_in_db;
+	gchar *dn;
+	gchar *parent_dn;
+	gchar *parent_route;
+	gchar *parent_id;
+} CaModelRow;
+
+struct _CaModel {
+	GObject parent;
+
+	gint stamp;
+	gboolean view_revoked;
+	gboolean view_csr;
+	gboolean search_results;   // Flat list of certificates, instead of the CA tree
+
+	CaModelNode *root;
+	GPtrArray *titles;
+
+	GHashTable *cert_rows;      // id -> CaModelRow
+	GQueue *cert_row_ids;       // Loading order, for discarding the oldest rows
+	GHashTable *csr_rows;
+	GQueue *csr_row_ids;
+};
+
+static GType ca_model_column_types[CA_MODEL_COLUMN_NUMBER];
+
+void __ca_model_tree_model_init (GtkTreeModelIface *iface);
+void __ca_model_finalize (GObject *object);
+CaModelNode * __ca_model_node_new (CaModelNodeType type, CaModelNode *parent, guint index);
+void __ca_model_node_free (gpointer data);
+void __ca_model_row_free (gpointer data);
+guint __ca_model_node_n_children (CaModel *model, CaModelNode *node);
+CaModelNode * __ca_model_node_get_child (CaModel *model, CaModelNode *node, guint index);
+gboolean __ca_model_node_has_children (CaModel *model, CaModelNode *node);
+CaModelRow * __ca_model_get_row (CaModel *model, CaModelNode *parent, guint index);
+int __ca_model_add_cert_row (void *pArg, int argc, char **argv, char **columnNames);
+int __ca_model_add_csr_row (void *pArg, int argc, char **argv, char **columnNames);
+
+G_DEFINE_TYPE_WITH_CODE (CaModel, ca_model, G_TYPE_OBJECT,
+			 G_IMPLEMENT_INTERFACE (GTK_TYPE_TREE_MODEL, __ca_model_tree_model_init));
+
+
+
+CaModelNode * __ca_model_node_new (CaModelNodeType type, CaModelNode *parent, guint index)
+{
+	CaModelNode *node = g_new0 (CaModelNode, 1);
+
+	node->type = type;
+	node->parent = parent;
+	node->index = index;
+	node->has_children = -1;
+
+	return node;
+}
+
+void __ca_model_node_free (gpointer data)
+{
+	CaModelNode *node = (CaModelNode *) data;
+
+	if (node->child_nodes)
+		g_hash_table_destroy (node->child_nodes);
+	if (node->child_ids)
+		g_array_free (node->child_ids, TRUE);
+	g_free (node->children_route);
+	g_free (node);
+}
+
+void __ca_model_row_free (gpointer data)
+{
+	CaModelRow *row = (CaModelRow *) data;
+
+	g_free (row->serial);
+	g_free (row->subject);
+	g_free (row->dn);
+	g_free (row->parent_dn);
+	g_free (row->parent_route);
+	g_free (row->parent_id);
+	g_free (row);
+}
+
+
+
+int __ca_model_add_cert_row (void *pArg, int argc, char **argv, char **columnNames)
+{
+	CaModel *model = CA_MODEL (pArg);
+	CaModelRow *row = g_new0 (CaModelRow, 1);
+
+	row->id = atoll (argv[CA_FILE_CERT_COLUMN_ID]);
+	row->is_ca = atoi (argv[CA_FILE_CERT_COLUMN_IS_CA]);
+	row->serial = g_strdup (argv[CA_FILE_CERT_COLUMN_SERIAL]);
+	if (argv[CA_FILE_CERT_COLUMN_REVOCATION]) {
+		row->revocation = atoi (argv[CA_FILE_CERT_COLUMN_REVOCATION]);
+		row->subject = g_markup_printf_escaped ("<s>%s</s>", argv[CA_FILE_CERT_COLUMN_SUBJECT]);
+	} else {
+		row->subject = g_strdup (argv[CA_FILE_CERT_COLUMN_SUBJECT]);
+	}
+	row->activation = atoi (argv[CA_FILE_CERT_COLUMN_ACTIVATION]);
+	row->expiration = atoi (argv[CA_FILE_CERT_COLUMN_EXPIRATION]);
+	row->private_key_in_db = atoi (argv[CA_FILE_CERT_COLUMN_PRIVATE_KEY_IN_DB]);
+	row->dn = g_strdup (argv[CA_FILE_CERT_COLUMN_DN]);
+	row->parent_dn = g_strdup (argv[CA_FILE_CERT_COLUMN_PARENT_DN]);
+	row->parent_route = g_strdup (argv[CA_FILE_CERT_COLUMN_PARENT_ROUTE]);
+
+	// Rows already in the cache are kept, so every cached row is once in the queue
+	if (g_hash_table_lookup (model->cert_rows, &row->id)) {
+		__ca_model_row_free (row);
+		return 0;
+	}
+
+	g_hash_table_insert (model->cert_rows, &row->id, row);
+	g_queue_push_tail (model->cert_row_ids, row);
+
+	return 0;
+}
+
+int __ca_model_add_csr_row (void *pArg, int argc, char **argv, char **columnNames)
+{
+	CaModel *model = CA_MODEL (pArg);
+	CaModelRow *row = g_new0 (CaModelRow, 1);
+
+	row->id = atoll (argv[CA_FILE_CSR_COLUMN_ID]);
+	row->subject = g_strdup (argv[CA_FILE_CSR_COLUMN_SUBJECT]);
+	row->private_key_in_db = atoi (argv[CA_FILE_CSR_COLUMN_PRIVATE_KEY_IN_DB]);
+	row->parent_id = g_strdup (argv[CA_FILE_CSR_COLUMN_PARENT_ID]);
+
+	// Rows already in the cache are kept, so every cached row is once in the queue
+	if (g_hash_table_lookup (model->csr_rows, &row->id)) {
+		__ca_model_row_free (row);
+		return 0;
+	}
+
+	g_hash_table_insert (model->csr_rows, &row->id, row);
+	g_queue_push_tail (model->csr_row_ids, row);
+
+	return 0;
+}
+
+CaModelRow * __ca_model_get_row (CaModel *model, CaModelNode *parent, guint index)
+{
+	gboolean is_csr = (parent->type == CA_MODEL_NODE_CSR_TITLE);
+	GHashTable *rows = (is_csr ? model->csr_rows : model->cert_rows);
+	GQueue *row_queue = (is_csr ? model->csr_row_ids : model->cert_row_ids);
+	guint64 id = g_array_index (parent->child_ids, guint64, index);
+	CaModelRow *row = g_hash_table_lookup (rows, &id);
+	guint first, number;
+
+	if (row)
+		return row;
+
+	// The whole block of siblings is read at once, as the tree view asks for them row by row
+	first = index - (index % CA_MODEL_BLOCK_SIZE);
+	number = MIN (CA_MODEL_BLOCK_SIZE, parent->child_ids->len - first);
+
+	if (is_csr)
+		ca_file_foreach_csr_in_ids (__ca_model_add_csr_row, &g_array_index (parent->child_ids, guint64, first), 
+					    number, model);
+	else
+		ca_file_foreach_crt_in_ids (__ca_model_add_cert_row, &g_array_index (parent->child_ids, guint64, first), 
+					    number, model);
+
+	while (g_queue_get_length (row_queue) > CA_MODEL_CACHE_SIZE) {
+		CaModelRow *old_row = g_queue_pop_head (row_queue);
+		g_hash_table_remove (rows, &old_row->id);
+	}
+
+	return g_hash_table_lookup (rows, &id);
+}
+
+
+
+guint __ca_model_node_n_children (CaModel *model, CaModelNode *node)
+{
+	switch (node->type) {
+	case CA_MODEL_NODE_ROOT:
+		return model->titles->len;
+
+	case CA_MODEL_NODE_CERT:
+		if (model->search_results)
+			return 0;
+	case CA_MODEL_NODE_CERT_TITLE:
+		// Search results are given already read, without a route
+		if (node->child_ids)
+			return node->child_ids->len;
+		// Certificates whose row couldn't be read have no route, nor children
+		if (! node->children_route)
+			return 0;
+		node->child_ids = ca_file_get_crt_children_ids (node->children_route, model->view_revoked);
+		return node->child_ids->len;
+
+	case CA_MODEL_NODE_CSR_TITLE:
+		if (! node->child_ids)
+			node->child_ids = ca_file_get_csr_ids ();
+		return node->child_ids->len;
+
+	case CA_MODEL_NODE_CSR:
+	default:
+		return 0;
+	}
+}
+
+gboolean __ca_model_node_has_children (CaModel *model, CaModelNode *node)
+{
+	if (node->child_ids)
+		return (node->child_ids->len > 0);
+
+	if (node->has_children == -1) {
+		switch (node->type) {
+		case CA_MODEL_NODE_CERT:
+			node->has_children = (node->children_route &&
+					      ca_file_crt_has_children (node->children_route, model->view_revoked));
+			break;
+		case CA_MODEL_NODE_CSR:
+			node->has_children = FALSE;
+			break;
+		default:
+			node->has_children = (__ca_model_node_n_children (model, node) > 0);
+			break;
+		}
+	}
+
+	return node->has_children;
+}
+
+CaModelNode * __ca_model_node_get_child (CaModel *model, CaModelNode *node, guint index)
+{
+	CaModelNode *child;
+	CaModelRow *row;
+
+	if (node->type == CA_MODEL_NODE_ROOT)
+		return g_ptr_array_index (model->titles, index);
+
+	if (! node->child_nodes)
+		node->child_nodes = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, __ca_model_node_free);
+
+	child = g_hash_table_lookup (node->child_nodes, GUINT_TO_POINTER (index));
+	if (child)
+		return child;
+
+	if (node->type == CA_MODEL_NODE_CSR_TITLE) {
+		child = __ca_model_node_new (CA_MODEL_NODE_CSR, node, index);
+		child->id = g_array_index (node->child_ids, guint64, index);
+		child->has_children = FALSE;
+	} else {
+		child = __ca_model_node_new (CA_MODEL_NODE_CERT, node, index);
+		child->id = g_array_index (node->child_ids, guint64, index);
+
+		row = __ca_model_get_row (model, node, index);
+		if (row) {
+			child->children_route = g_strdup_printf ("%s%"G_GUINT64_FORMAT":", row->parent_route, row->id);
+			// Only CAs can have children
+			if (! row->is_ca || model->search_results)
+				child->has_children = FALSE;
+		} else {
+			child->has_children = FALSE;
+		}
+	}
+
+	g_hash_table_insert (node->child_nodes, GUINT_TO_POINTER (index), child);
+
+	return child;
+}
+
+
+
+/* Iters don't persist: the nodes below a collapsed row are freed (see ca_model_collapse) */
+static GtkTreeModelFlags __ca_model_get_flags (GtkTreeModel *tree_model)
+{
+	return 0;
+}
+
+static gint __ca_model_get_n_columns (GtkTreeModel *tree_model)
+{
+	return CA_MODEL_COLUMN_NUMBER;
+}
+
+static GType __ca_model_get_column_type (GtkTreeModel *tree_model, gint index)
+{
+	g_return_val_if_fail (index >= 0 && index < CA_MODEL_COLUMN_NUMBER, G_TYPE_INVALID);
+
+	return ca_model_column_types[index];
+}
+
+static gboolean __ca_model_get_iter (GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreePath *path)
+{
+	CaModel *model = CA_MODEL (tree_model);
+	CaModelNode *node = model->root;
+	gint *indices = gtk_tree_path_get_indices (path);
+	gint depth = gtk_tree_path_get_depth (path);
+	gint i;
+
+	for (i = 0; i < depth; i++) {
+		if (indices[i] < 0 || indices[i] >= __ca_model_node_n_children (model, node))
+			return FALSE;
+		if (i < depth - 1)
+			node = __ca_model_node_get_child (model, node, indices[i]);
+	}
+
+	iter->stamp = model->stamp;
+	iter->user_data = node;
+	iter->user_data2 = GUINT_TO_POINTER (indices[depth - 1]);
+
+	return TRUE;
+}
+
+static GtkTreePath * __ca_model_get_path (GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+	CaModelNode *node = (CaModelNode *) iter->user_data;
+	GtkTreePath *path = gtk_tree_path_new ();
+
+	g_return_val_if_fail (iter->stamp == CA_MODEL (tree_model)->stamp, NULL);
+
+	gtk_tree_path_prepend_index (path, GPOINTER_TO_UINT (iter->user_data2));
+
+	while (node->parent) {
+		gtk_tree_path_prepend_index (path, node->index);
+		node = node->parent;
+	}
+
+	return path;
+}
+
+static void __ca_model_get_value (GtkTreeModel *tree_model, GtkTreeIter *iter, gint column, GValue *value)
+{
+	CaModel *model = CA_MODEL (tree_model);
+	CaModelNode *parent = (CaModelNode *) iter->user_data;
+	guint index = GPOINTER_TO_UINT (iter->user_data2);
+	CaModelNode *title;
+	CaModelRow *row;
+	gboolean is_csr = (parent->type == CA_MODEL_NODE_CSR_TITLE);
+
+	g_return_if_fail (iter->stamp == model->stamp);
+
+	g_value_init (value, ca_model_column_types[column]);
+
+	if (parent->type == CA_MODEL_NODE_ROOT) {
+		title = g_ptr_array_index (model->titles, index);
+		if (column == CA_MODEL_COLUMN_SUBJECT && model->search_results)
+			g_value_set_string (value, _("<b>Search results</b>"));
+		else if (column == CA_MODEL_COLUMN_SUBJECT)
+			g_value_set_string (value, (title->type == CA_MODEL_NODE_CERT_TITLE ? 
+						    _("<b>Certificates</b>") : _("<b>Certificate Signing Requests</b>")));
+		else if (column == CA_MODEL_COLUMN_ITEM_TYPE)
+			g_value_set_int (value, -1);
+		return;
+	}
+
+	if (column == CA_MODEL_COLUMN_PEM) {
+		// Never cached, so memory doesn't depend on the number of rows shown
+		g_value_take_string (value, ca_file_get_public_pem_from_id ((is_csr ? CA_FILE_ELEMENT_TYPE_CSR : CA_FILE_ELEMENT_TYPE_CERT),
+									    g_array_index (parent->child_ids, guint64, index)));
+		return;
+	}
+
+	if (column == CA_MODEL_COLUMN_ITEM_TYPE) {
+		g_value_set_int (value, (is_csr ? 1 : 0));
+		return;
+	}
+
+	row = __ca_model_get_row (model, parent, index);
+	if (! row)
+		return;
+
+	switch (column) {
+	case CA_MODEL_COLUMN_ID:
+		g_value_set_uint64 (value, row->id);
+		break;
+	case CA_MODEL_COLUMN_IS_CA:
+		g_value_set_boolean (value, row->is_ca);
+		break;
+	case CA_MODEL_COLUMN_SERIAL:
+		g_value_set_string (value, row->serial);
+		break;
+	case CA_MODEL_COLUMN_SUBJECT:
+		g_value_set_string (value, row->subject);
+		break;
+	case CA_MODEL_COLUMN_ACTIVATION:
+		g_value_set_int (value, row->activation);
+		break;
+	case CA_MODEL_COLUMN_EXPIRATION:
+		g_value_set_int (value, row->expiration);
+		break;
+	case CA_MODEL_COLUMN_REVOCATION:
+		g_value_set_int (value, row->revocation);
+		break;
+	case CA_MODEL_COLUMN_PRIVATE_KEY_IN_DB:
+		g_value_set_boolean (value, row->private_key_in_db);
+		break;
+	case CA_MODEL_COLUMN_DN:
+		g_value_set_string (value, row->dn);
+		break;
+	case CA_MODEL_COLUMN_PARENT_DN:
+		g_value_set_string (value, row->parent_dn);
+		break;
+	case CA_MODEL_COLUMN_PARENT_ROUTE:
+		g_value_set_string (value, row->parent_route);
+		break;
+	case CA_MODEL_COLUMN_PARENT_ID:
+		g_value_set_string (value, row->parent_id);
+		break;
+	default:
+		break;
+	}
+}
+
+static gboolean __ca_model_iter_next (GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+	CaModel *model = CA_MODEL (tree_model);
+	CaModelNode *parent = (CaModelNode *) iter->user_data;
+	guint index = GPOINTER_TO_UINT (iter->user_data2) + 1;
+
+	if (index >= __ca_model_node_n_children (model, parent))
+		return FALSE;
+
+	iter->user_data2 = GUINT_TO_POINTER (index);
+	return TRUE;
+}
+
+static gboolean __ca_model_iter_nth_child (GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreeIter *parent, gint n)
+{
+	CaModel *model = CA_MODEL (tree_model);
+	CaModelNode *node = model->root;
+
+	if (parent)
+		node = __ca_model_node_get_child (model, (CaModelNode *) parent->user_data, 
+						  GPOINTER_TO_UINT (parent->user_data2));
+
+	if (n < 0 || n >= __ca_model_node_n_children (model, node))
+		return FALSE;
+
+	iter->stamp = model->stamp;
+	iter->user_data = node;
+	iter->user_data2 = GUINT_TO_POINTER (n);
+
+	return TRUE;
+}
+
+static gboolean __ca_model_iter_children (GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreeIter *parent)
+{
+	return __ca_model_iter_nth_child (tree_model, iter, parent, 0);
+}
+
+static gboolean __ca_model_iter_has_child (GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+	CaModel *model = CA_MODEL (tree_model);
+	CaModelNode *node = __ca_model_node_get_child (model, (CaModelNode *) iter->user_data, 
+						       GPOINTER_TO_UINT (iter->user_data2));
+
+	return __ca_model_node_has_children (model, node);
+}
+
+static gint __ca_model_iter_n_children (GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+	CaModel *model = CA_MODEL (tree_model);
+	CaModelNode *node = model->root;
+
+	if (iter)
+		node = __ca_model_node_get_child (model, (CaModelNode *) iter->user_data, 
+						  GPOINTER_TO_UINT (iter->user_data2));
+
+	return __ca_model_node_n_children (model, node);
+}
+
+static gboolean __ca_model_iter_parent (GtkTreeModel *tree_model, GtkTreeIter *iter, GtkTreeIter *child)
+{
+	CaModelNode *node = (CaModelNode *) child->user_data;
+
+	if (! node->parent)
+		return FALSE;
+
+	iter->stamp = CA_MODEL (tree_model)->stamp;
+	iter->user_data = node->parent;
+	iter->user_data2 = GUINT_TO_POINTER (node->index);
+
+	return TRUE;
+}
+
+void __ca_model_tree_model_init (GtkTreeModelIface *iface)
+{
+	iface->get_flags = __ca_model_get_flags;
+	iface->get_n_columns = __ca_model_get_n_columns;
+	iface->get_column_type = __ca_model_get_column_type;
+	iface->get_iter = __ca_model_get_iter;
+	iface->get_path = __ca_model_get_path;
+	iface->get_value = __ca_model_get_value;
+	iface->iter_next = __ca_model_iter_next;
+	iface->iter_children = __ca_model_iter_children;
+	iface->iter_has_child = __ca_model_iter_has_child;
+	iface->iter_n_children = __ca_model_iter_n_children;
+	iface->iter_nth_child = __ca_model_iter_nth_child;
+	iface->iter_parent = __ca_model_iter_parent;
+}
+
+
+
+static void ca_model_class_init (CaModelClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	object_class->finalize = __ca_model_finalize;
+
+	/* Same columns than the GtkTreeStore used before */
+	ca_model_column_types[CA_MODEL_COLUMN_ID] = G_TYPE_UINT64;
+	ca_model_column_types[CA_MODEL_COLUMN_IS_CA] = G_TYPE_BOOLEAN;
+	ca_model_column_types[CA_MODEL_COLUMN_SERIAL] = G_TYPE_STRING;
+	ca_model_column_types[CA_MODEL_COLUMN_SUBJECT] = G_TYPE_STRING;
+	ca_model_column_types[CA_MODEL_COLUMN_ACTIVATION] = G_TYPE_INT;
+	ca_model_column_types[CA_MODEL_COLUMN_EXPIRATION] = G_TYPE_INT;
+	ca_model_column_types[CA_MODEL_COLUMN_REVOCATION] = G_TYPE_INT;
+	ca_model_column_types[CA_MODEL_COLUMN_PRIVATE_KEY_IN_DB] = G_TYPE_BOOLEAN;
+	ca_model_column_types[CA_MODEL_COLUMN_PEM] = G_TYPE_STRING;
+	ca_model_column_types[CA_MODEL_COLUMN_DN] = G_TYPE_STRING;
+	ca_model_column_types[CA_MODEL_COLUMN_PARENT_DN] = G_TYPE_STRING;
+	ca_model_column_types[CA_MODEL_COLUMN_PARENT_ROUTE] = G_TYPE_STRING;
+	ca_model_column_types[CA_MODEL_COLUMN_ITEM_TYPE] = G_TYPE_INT;
+	ca_model_column_types[CA_MODEL_COLUMN_PARENT_ID] = G_TYPE_STRING;
+}
+
+static void ca_model_init (CaModel *model)
+{
+	do {
+		model->stamp = g_random_int ();
+	} while (model->stamp == 0);
+
+	model->root = __ca_model_node_new (CA_MODEL_NODE_ROOT, NULL, 0);
+	model->titles = g_ptr_array_new ();
+
+	model->cert_rows = g_hash_table_new_full (g_int64_hash, g_int64_equal, NULL, __ca_model_row_free);
+	model->cert_row_ids = g_queue_new ();
+	model->csr_rows = g_hash_table_new_full (g_int64_hash, g_int64_equal, NULL, __ca_model_row_free);
+	model->csr_row_ids = g_queue_new ();
+}
+
+void __ca_model_finalize (GObject *object)
+{
+	CaModel *model = CA_MODEL (object);
+	guint i;
+
+	for (i = 0; i < model->titles->len; i++)
+		__ca_model_node_free (g_ptr_array_index (model->titles, i));
+	g_ptr_array_free (model->titles, TRUE);
+	__ca_model_node_free (model->root);
+
+	g_hash_table_destroy (model->cert_rows);
+	g_queue_free (model->cert_row_ids);
+	g_hash_table_destroy (model->csr_rows);
+	g_queue_free (model->csr_row_ids);
+
+	G_OBJECT_CLASS (ca_model_parent_class)->finalize (object);
+}
+
+
+
+CaModel * ca_model_new (gboolean view_revoked, gboolean view_csr)
+{
+	CaModel *model = g_object_new (CA_TYPE_MODEL, NULL);
+	CaModelNode *title;
+
+	model->view_revoked = view_revoked;
+	model->view_csr = view_csr;
+
+	/* As before, titles are only shown if there is something below them */
+	title = __ca_model_node_new (CA_MODEL_NODE_CERT_TITLE, model->root, model->titles->len);
+	title->children_route = g_strdup (":");
+	if (ca_file_crt_has_children (title->children_route, view_revoked)) {
+		g_ptr_array_add (model->titles, title);
+	} else {
+		__ca_model_node_free (title);
+	}
+
+	if (view_csr) {
+		title = __ca_model_node_new (CA_MODEL_NODE_CSR_TITLE, model->root, model->titles->len);
+		if (ca_file_get_number_of_csrs () > 0) {
+			g_ptr_array_add (model->titles, title);
+		} else {
+			__ca_model_node_free (title);
+		}
+	}
+
+	return model;
+}
+
+CaModel * ca_model_new_from_search (const gchar *text, gboolean view_revoked)
+{
+	CaModel *model = g_object_new (CA_TYPE_MODEL, NULL);
+	CaModelNode *title;
+
+	model->view_revoked = view_revoked;
+	model->view_csr = FALSE;
+	model->search_results = TRUE;
+
+	title = __ca_model_node_new (CA_MODEL_NODE_CERT_TITLE, model->root, 0);
+	title->child_ids = ca_file_search_crt_ids (text, view_revoked, CA_MODEL_SEARCH_LIMIT);
+	g_ptr_array_add (model->titles, title);
+
+	return model;
+}
+
+gint ca_model_get_item_type (CaModel *model, GtkTreeIter *iter)
+{
+	CaModelNode *parent = (CaModelNode *) iter->user_data;
+
+	g_return_val_if_fail (iter->stamp == model->stamp, -1);
+
+	switch (parent->type) {
+	case CA_MODEL_NODE_CERT_TITLE:
+	case CA_MODEL_NODE_CERT:
+		return CA_FILE_ELEMENT_TYPE_CERT;
+	case CA_MODEL_NODE_CSR_TITLE:
+		return CA_FILE_ELEMENT_TYPE_CSR;
+	default:
+		return -1;
+	}
+}
+
+void ca_model_collapse (CaModel *model, GtkTreeIter *iter)
+{
+	CaModelNode *parent = (CaModelNode *) iter->user_data;
+	guint index = GPOINTER_TO_UINT (iter->user_data2);
+	CaModelNode *node;
+
+	g_return_if_fail (iter->stamp == model->stamp);
+
+	if (parent->type == CA_MODEL_NODE_ROOT)
+		node = g_ptr_array_index (model->titles, index);
+	else if (parent->child_nodes)
+		node = g_hash_table_lookup (parent->child_nodes, GUINT_TO_POINTER (index));
+	else
+		node = NULL;
+
+	// Search results are never read again, so they are kept
+	if (! node || model->search_results)
+		return;
+
+	if (node->child_ids) {
+		node->has_children = (node->child_ids->len > 0);
+		g_array_free (node->child_ids, TRUE);
+		node->child_ids = NULL;
+	}
+	if (node->child_nodes) {
+		g_hash_table_destroy (node->child_nodes);
+		node->child_nodes = NULL;
+	}
+}
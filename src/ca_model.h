@@ -0,0 +1,69 @@
+//  gnoMint: a graphical interface for managing a certification authority
+//  Copyright (C) 2006-2009 David Marín Carreño <davefx@gmail.com>
+//
+//  This file is part of gnoMint.
+//
+//  gnoMint is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 3 of the License, or   
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of 
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the  
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#ifndef _CA_MODEL_H_
+#define _CA_MODEL_H_
+
+#include <glib.h>
+#include <glib-object.h>
+#include <gtk/gtk.h>
+
+enum {CA_MODEL_COLUMN_ID=0,
+      CA_MODEL_COLUMN_IS_CA=1,
+      CA_MODEL_COLUMN_SERIAL=2,
+      CA_MODEL_COLUMN_SUBJECT=3,
+      CA_MODEL_COLUMN_ACTIVATION=4,
+      CA_MODEL_COLUMN_EXPIRATION=5,
+      CA_MODEL_COLUMN_REVOCATION=6,
+      CA_MODEL_COLUMN_PRIVATE_KEY_IN_DB=7,
+      CA_MODEL_COLUMN_PEM=8,
+      CA_MODEL_COLUMN_DN=9,
+      CA_MODEL_COLUMN_PARENT_DN=10,
+      CA_MODEL_COLUMN_PARENT_ROUTE=11,
+      CA_MODEL_COLUMN_ITEM_TYPE=12,
+      CA_MODEL_COLUMN_PARENT_ID=13, /* Only for CSRs */
+      CA_MODEL_COLUMN_NUMBER=14}
+        CaModelColumns;
+
+#define CA_TYPE_MODEL            (ca_model_get_type ())
+#define CA_MODEL(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), CA_TYPE_MODEL, CaModel))
+#define CA_MODEL_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), CA_TYPE_MODEL, CaModelClass))
+#define CA_IS_MODEL(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), CA_TYPE_MODEL))
+
+typedef struct _CaModel CaModel;
+typedef struct _CaModelClass CaModelClass;
+
+struct _CaModelClass {
+	GObjectClass parent_class;
+};
+
+GType ca_model_get_type (void);
+
+CaModel * ca_model_new (gboolean view_revoked, gboolean view_csr);
+
+// Flat list with the certificates matching the given text, best matches first
+CaModel * ca_model_new_from_search (const gchar *text, gboolean view_revoked);
+
+// Returns CA_FILE_ELEMENT_TYPE_CERT, CA_FILE_ELEMENT_TYPE_CSR, or -1 for title rows
+gint ca_model_get_item_type (CaModel *model, GtkTreeIter *iter);
+
+// Frees what was read for the children of the given row, when the tree view collapses it
+void ca_model_collapse (CaModel *model, GtkTreeIter *iter);
+
+#endif
@@ -41,172 +41,136 @@
 
 extern GtkBuilder * certificate_properties_window_gtkb;
 
-gint __ca_policy_populate_step (void *pArg, int argc, char **argv, char **columnNames);
-
-gint __ca_policy_populate_step (void *pArg, int argc, char **argv, char **columnNames)
-{
-	GHashTable * policy_table = (GHashTable *) pArg;
-
-	g_hash_table_insert (policy_table, g_strdup (argv[1]), g_strdup(argv[2]));
-
-	return 0;
-}
-
 void ca_policy_populate (guint64 ca_id) 
 {
 	GObject * widget;
 	gint value;
-	gchar * strvalue;
-	GHashTable *policy_table = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);	
+	CaPolicy policy;
 
-	ca_file_foreach_policy (__ca_policy_populate_step, ca_id, policy_table);
+	/* Setting the widgets fires the handlers below, which change (and so drop from the cache)
+	   the policies of this CA, so we work on a copy */
+	policy = *ca_file_policy_get_all (ca_id);
+	policy.crl_distribution_point = g_strdup (policy.crl_distribution_point);
 
-        strvalue = (gchar *) g_hash_table_lookup (policy_table, "C_INHERIT");
-	value = strvalue ? atoi(strvalue) : 0;
+	value = policy.c_inherit;
 	widget = gtk_builder_get_object (certificate_properties_window_gtkb, "country_inherited_check");
 	gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(widget), value);
         gtk_widget_set_sensitive (GTK_WIDGET(gtk_builder_get_object (certificate_properties_window_gtkb, "country_same_radiobutton")), value);
         gtk_widget_set_sensitive (GTK_WIDGET(gtk_builder_get_object (certificate_properties_window_gtkb, "country_differ_radiobutton")), value);
 
-        strvalue = (gchar *) g_hash_table_lookup (policy_table, "ST_INHERIT");
-	value = strvalue ? atoi(strvalue) : 0;
+	value = policy.st_inherit;
 	widget = gtk_builder_get_object (certificate_properties_window_gtkb, "state_inherited_check");
 	gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(widget), value);
         gtk_widget_set_sensitive (GTK_WIDGET(gtk_builder_get_object (certificate_properties_window_gtkb, "state_same_radiobutton")), value);
         gtk_widget_set_sensitive (GTK_WIDGET(gtk_builder_get_object (certificate_properties_window_gtkb, "state_differ_radiobutton")), value);
 
-        strvalue = (gchar *) g_hash_table_lookup (policy_table, "L_INHERIT");
-	value = strvalue ? atoi(strvalue) : 0;
+	value = policy.l_inherit;
 	widget = gtk_builder_get_object (certificate_properties_window_gtkb, "city_inherited_check");
 	gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(widget), value);
         gtk_widget_set_sensitive (GTK_WIDGET(gtk_builder_get_object (certificate_properties_window_gtkb, "city_same_radiobutton")), value);
         gtk_widget_set_sensitive (GTK_WIDGET(gtk_builder_get_object (certificate_properties_window_gtkb, "city_differ_radiobutton")), value);
 
-        strvalue = (gchar *) g_hash_table_lookup (policy_table, "O_INHERIT");
-	value = strvalue ? atoi(strvalue) : 0;
+	value = policy.o_inherit;
 	widget = gtk_builder_get_object (certificate_properties_window_gtkb, "organization_inherited_check");
 	gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(widget), value);
         gtk_widget_set_sensitive (GTK_WIDGET(gtk_builder_get_object (certificate_properties_window_gtkb, "organization_same_radiobutton")), value);
         gtk_widget_set_sensitive (GTK_WIDGET(gtk_builder_get_object (certificate_properties_window_gtkb, "organization_differ_radiobutton")), value);
 
-        strvalue = (gchar *) g_hash_table_lookup (policy_table, "OU_INHERIT");
-	value = strvalue ? atoi(strvalue) : 0;
+	value = policy.ou_inherit;
 	widget = gtk_builder_get_object (certificate_properties_window_gtkb, "ou_inherited_check");
 	gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(widget), value);
         gtk_widget_set_sensitive (GTK_WIDGET(gtk_builder_get_object (certificate_properties_window_gtkb, "ou_same_radiobutton")), value);
         gtk_widget_set_sensitive (GTK_WIDGET(gtk_builder_get_object (certificate_properties_window_gtkb, "ou_differ_radiobutton")), value);
 
-        strvalue = (gchar *) g_hash_table_lookup (policy_table, "C_FORCE_SAME");
-	value = strvalue ? atoi(strvalue) : 0;
+	value = policy.c_force_same;
 	widget = gtk_builder_get_object (certificate_properties_window_gtkb, "country_same_radiobutton");
 	gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(widget), value);
 
-        strvalue = (gchar *) g_hash_table_lookup (policy_table, "ST_FORCE_SAME");
-	value = strvalue ? atoi(strvalue) : 0;
+	value = policy.st_force_same;
 	widget = gtk_builder_get_object (certificate_properties_window_gtkb, "state_same_radiobutton");
 	gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(widget), value);
 
-        strvalue = (gchar *) g_hash_table_lookup (policy_table, "L_FORCE_SAME");
-	value = strvalue ? atoi(strvalue) : 0;
+	value = policy.l_force_same;
 	widget = gtk_builder_get_object (certificate_properties_window_gtkb, "city_same_radiobutton");
 	gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(widget), value);
 
-        strvalue = (gchar *) g_hash_table_lookup (policy_table, "O_FORCE_SAME");
-	value = strvalue ? atoi(strvalue) : 0;
+	value = policy.o_force_same;
 	widget = gtk_builder_get_object (certificate_properties_window_gtkb, "organization_same_radiobutton");
 	gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(widget), value);
 
-        strvalue = (gchar *) g_hash_table_lookup (policy_table, "OU_FORCE_SAME");
-	value = strvalue ? atoi(strvalue) : 0;
+	value = policy.ou_force_same;
 	widget = gtk_builder_get_object (certificate_properties_window_gtkb, "ou_same_radiobutton");
 	gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(widget), value);
 
-	strvalue = (gchar *) g_hash_table_lookup (policy_table, "HOURS_BETWEEN_CRL_UPDATES");
-	value = strvalue ? atoi(strvalue) : 0;
+	value = policy.hours_between_crl_updates;
 	widget = gtk_builder_get_object (certificate_properties_window_gtkb, "hours_between_crl_updates_spinbutton");
 	gtk_spin_button_set_value (GTK_SPIN_BUTTON(widget), value);
 
-	strvalue = ((gchar *) g_hash_table_lookup (policy_table, "CRL_DISTRIBUTION_POINT"));
 	widget = gtk_builder_get_object (certificate_properties_window_gtkb, "crl_distribution_point_entry");
-	if (strvalue)
-		gtk_entry_set_text (GTK_ENTRY(widget), strvalue);
+	if (policy.crl_distribution_point)
+		gtk_entry_set_text (GTK_ENTRY(widget), policy.crl_distribution_point);
 
-	strvalue = (gchar *) g_hash_table_lookup (policy_table, "MONTHS_TO_EXPIRE");
-	value = strvalue ? atoi(strvalue) : 0;
+	value = policy.months_to_expire;
 	widget = gtk_builder_get_object (certificate_properties_window_gtkb, "months_before_expiration_spinbutton2");
 	gtk_spin_button_set_value (GTK_SPIN_BUTTON(widget), value);
 
-	strvalue = (gchar *) g_hash_table_lookup (policy_table, "CA");
-	value = strvalue ? atoi(strvalue) : 0;
+	value = policy.ca;
 	widget = gtk_builder_get_object (certificate_properties_window_gtkb, "ca_check2");
 	gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(widget), value);
 
-	strvalue = (gchar *) g_hash_table_lookup (policy_table, "CRL_SIGN");
-	value = strvalue ? atoi(strvalue) : 0;
+	value = policy.crl_sign;
 	widget = gtk_builder_get_object (certificate_properties_window_gtkb, "crl_signing_check1");
 	gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(widget), value);
 
-	strvalue = (gchar *) g_hash_table_lookup (policy_table, "NON_REPUDIATION");
-	value = strvalue ? atoi(strvalue) : 0;
+	value = policy.non_repudiation;
 	widget = gtk_builder_get_object (certificate_properties_window_gtkb, "non_repudiation_check2");
 	gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(widget), value);
 
-	strvalue = (gchar *) g_hash_table_lookup (policy_table, "DIGITAL_SIGNATURE");
-	value = strvalue ? atoi(strvalue) : 0;
+	value = policy.digital_signature;
 	widget = gtk_builder_get_object (certificate_properties_window_gtkb, "digital_signature_check4");
 	gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(widget), value);
 
-	strvalue = (gchar *) g_hash_table_lookup (policy_table, "KEY_ENCIPHERMENT");
-	value = strvalue ? atoi(strvalue) : 0;
+	value = policy.key_encipherment;
 	widget = gtk_builder_get_object (certificate_properties_window_gtkb, "key_encipherment_check2");
 	gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(widget), value);
 
-	strvalue = (gchar *) g_hash_table_lookup (policy_table, "KEY_AGREEMENT");
-	value = strvalue ? atoi(strvalue) : 0;
+	value = policy.key_agreement;
 	widget = gtk_builder_get_object (certificate_properties_window_gtkb, "key_agreement_check2");
 	gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(widget), value);
 
-	strvalue = (gchar *) g_hash_table_lookup (policy_table, "DATA_ENCIPHERMENT");
-	value = strvalue ? atoi(strvalue) : 0;
+	value = policy.data_encipherment;
 	widget = gtk_builder_get_object (certificate_properties_window_gtkb, "data_encipherment_check2");
 	gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(widget), value);
 
-	strvalue = (gchar *) g_hash_table_lookup (policy_table, "TLS_WEB_SERVER");
-	value = strvalue ? atoi(strvalue) : 0;
+	value = policy.tls_web_server;
 	widget = gtk_builder_get_object (certificate_properties_window_gtkb, "webserver_check2");
 	gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(widget), value);
 
-	strvalue = (gchar *) g_hash_table_lookup (policy_table, "TLS_WEB_CLIENT");
-	value = strvalue ? atoi(strvalue) : 0;
+	value = policy.tls_web_client;
 	widget = gtk_builder_get_object (certificate_properties_window_gtkb, "webclient_check2");
 	gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(widget), value);
 
-	strvalue = (gchar *) g_hash_table_lookup (policy_table, "TIME_STAMPING");
-	value = strvalue ? atoi(strvalue) : 0;
+	value = policy.time_stamping;
 	widget = gtk_builder_get_object (certificate_properties_window_gtkb, "time_stamping_check2");
 	gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(widget), value);
 
-	strvalue = (gchar *) g_hash_table_lookup (policy_table, "CODE_SIGNING");
-	value = strvalue ? atoi(strvalue) : 0;
+	value = policy.code_signing;
 	widget = gtk_builder_get_object (certificate_properties_window_gtkb, "code_signing_check2");
 	gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(widget), value);
 
-	strvalue = (gchar *) g_hash_table_lookup (policy_table, "EMAIL_PROTECTION");
-	value = strvalue ? atoi(strvalue) : 0;
+	value = policy.email_protection;
 	widget = gtk_builder_get_object (certificate_properties_window_gtkb, "email_protection_check2");
 	gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(widget), value);
 	
-	strvalue = (gchar *) g_hash_table_lookup (policy_table, "OCSP_SIGNING");
-	value = strvalue ? atoi(strvalue) : 0;
+	value = policy.ocsp_signing;
 	widget = gtk_builder_get_object (certificate_properties_window_gtkb, "ocsp_signing_check2");
 	gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(widget), value);
 
-	strvalue = (gchar *) g_hash_table_lookup (policy_table, "ANY_PURPOSE");
-	value = strvalue ? atoi(strvalue) : 0;
+	value = policy.any_purpose;
 	widget = gtk_builder_get_object (certificate_properties_window_gtkb, "any_purpose_check2");
 	gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(widget), value);
 	
-        g_hash_table_destroy (policy_table);
+        g_free (policy.crl_distribution_point);
 }
 
 #endif
@@ -352,16 +316,16 @@ G_MODULE_EXPORT void ca_policy_toggle_button_toggled (gpointer button, gpointer
                         gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(gtk_builder_get_object (certificate_properties_window_gtkb, 
                                                                                               "time_stamping_check2")), FALSE);
                         // We must check if EMAIL_PROTECTION can be active
-                        if (! ca_file_policy_get (cert_id, "DIGITAL_SIGNATURE") &&
-                            ! ca_file_policy_get (cert_id, "KEY_ENCIPHERMENT") &&
-                            ! ca_file_policy_get (cert_id, "KEY_AGREEMENT")) {
+                        if (! ca_file_policy_get_all (cert_id)->digital_signature &&
+                            ! ca_file_policy_get_all (cert_id)->key_encipherment &&
+                            ! ca_file_policy_get_all (cert_id)->key_agreement) {
                                 // If none is active, we must deactivate EMAIL_PROTECTION
                                 gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(gtk_builder_get_object (certificate_properties_window_gtkb,
                                                                                                       "email_protection_check2")), FALSE);
                         }
 
                         // We must check if OCSP_SIGNING can be active
-                        if (! ca_file_policy_get (cert_id, "DIGITAL_SIGNATURE")) {
+                        if (! ca_file_policy_get_all (cert_id)->digital_signature) {
                                 // If is not active, we must deactivate OCSP_SIGNING
                                 gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(gtk_builder_get_object (certificate_properties_window_gtkb,
                                                                                                       "ocsp_signing_check2")), FALSE);
@@ -374,15 +338,15 @@ G_MODULE_EXPORT void ca_policy_toggle_button_toggled (gpointer button, gpointer
 	if (! strcmp(widget_name, "digital_signature_check4")) {
                 if (! is_active) {
                         // We must check if TLS_WEB_SERVER can be active
-                        if (! ca_file_policy_get (cert_id, "KEY_ENCIPHERMENT") &&
-                            ! ca_file_policy_get (cert_id, "KEY_AGREEMENT")) {
+                        if (! ca_file_policy_get_all (cert_id)->key_encipherment &&
+                            ! ca_file_policy_get_all (cert_id)->key_agreement) {
                                 // If none is active, we must deactivate TLS_WEB_SERVER
                                 gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(gtk_builder_get_object (certificate_properties_window_gtkb, 
                                                                                                       "webserver_check2")), FALSE);
                         }
 
                         // We must check if TLS_WEB_CLIENT can be active
-                        if (! ca_file_policy_get (cert_id, "KEY_AGREEMENT")) {
+                        if (! ca_file_policy_get_all (cert_id)->key_agreement) {
                                 // If none is active, we must deactivate TLS_WEB_CLIENT
                                 gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(gtk_builder_get_object (certificate_properties_window_gtkb, 
                                                                                                       "webclient_check2")), FALSE);
@@ -396,16 +360,16 @@ G_MODULE_EXPORT void ca_policy_toggle_button_toggled (gpointer button, gpointer
                                                                                              "code_signing_check2")), FALSE);
 
                         // We must check if EMAIL_PROTECTION can be active
-                        if (! ca_file_policy_get (cert_id, "NON_REPUDIATION") &&
-                            ! ca_file_policy_get (cert_id, "KEY_ENCIPHERMENT") &&
-                            ! ca_file_policy_get (cert_id, "KEY_AGREEMENT")) {
+                        if (! ca_file_policy_get_all (cert_id)->non_repudiation &&
+                            ! ca_file_policy_get_all (cert_id)->key_encipherment &&
+                            ! ca_file_policy_get_all (cert_id)->key_agreement) {
                                 // If none is active, we must deactivate EMAIL_PROTECTION
                                 gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(gtk_builder_get_object (certificate_properties_window_gtkb, 
                                                                                                       "email_protection_check2")), FALSE);
                         }
 
                         // We must check if OCSP_SIGNING can be active
-                        if (! ca_file_policy_get (cert_id, "NON_REPUDIATION")) {
+                        if (! ca_file_policy_get_all (cert_id)->non_repudiation) {
                                 // If none is active, we must deactivate OCSP_SIGNING
                                 gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(gtk_builder_get_object (certificate_properties_window_gtkb, 
                                                                                                       "ocsp_signing_check2")), FALSE);
@@ -419,17 +383,17 @@ G_MODULE_EXPORT void ca_policy_toggle_button_toggled (gpointer button, gpointer
 	if (! strcmp(widget_name, "key_encipherment_check2")) {
                 if (! is_active) {
                         // We must check if TLS_WEB_SERVER can be active
-                        if (! ca_file_policy_get (cert_id, "DIGITAL_SIGNATURE") &&
-                            ! ca_file_policy_get (cert_id, "KEY_AGREEMENT")) {
+                        if (! ca_file_policy_get_all (cert_id)->digital_signature &&
+                            ! ca_file_policy_get_all (cert_id)->key_agreement) {
                                 // If none is active, we must deactivate TLS_WEB_SERVER
                                 gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(gtk_builder_get_object (certificate_properties_window_gtkb, 
                                                                                                       "webserver_check2")), FALSE);
                         }
 
                         // We must check if EMAIL_PROTECTION can be active
-                        if (! ca_file_policy_get (cert_id, "DIGITAL_SIGNATURE") &&
-                            ! ca_file_policy_get (cert_id, "NON_REPUDIATION") &&
-                            ! ca_file_policy_get (cert_id, "KEY_AGREEMENT")) {
+                        if (! ca_file_policy_get_all (cert_id)->digital_signature &&
+                            ! ca_file_policy_get_all (cert_id)->non_repudiation &&
+                            ! ca_file_policy_get_all (cert_id)->key_agreement) {
                                 // If none is active, we must deactivate EMAIL_PROTECTION
                                 gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(gtk_builder_get_object (certificate_properties_window_gtkb, 
                                                                                                       "email_protection_check2")), FALSE);
@@ -443,23 +407,23 @@ G_MODULE_EXPORT void ca_policy_toggle_button_toggled (gpointer button, gpointer
 	if (! strcmp(widget_name, "key_agreement_check2")) {
                 if (! is_active) {
                         // We must check if TLS_WEB_SERVER can be active
-                        if (! ca_file_policy_get (cert_id, "DIGITAL_SIGNATURE") &&
-                            ! ca_file_policy_get (cert_id, "KEY_ENCIPHERMENT")) {
+                        if (! ca_file_policy_get_all (cert_id)->digital_signature &&
+                            ! ca_file_policy_get_all (cert_id)->key_encipherment) {
                                 // If none is active, we must deactivate TLS_WEB_SERVER
                                 gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(gtk_builder_get_object (certificate_properties_window_gtkb, 
                                                                                                       "webserver_check2")), FALSE);
                         }
                         // We must check if TLS_WEB_CLIENT can be active
-                        if (! ca_file_policy_get (cert_id, "DIGITAL_SIGNATURE")) {
+                        if (! ca_file_policy_get_all (cert_id)->digital_signature) {
                                 // If none is active, we must deactivate TLS_WEB_CLIENT
                                 gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(gtk_builder_get_object (certificate_properties_window_gtkb, 
                                                                                                       "webclient_check2")), FALSE);
                         }
 
                         // We must check if EMAIL_PROTECTION can be active
-                        if (! ca_file_policy_get (cert_id, "DIGITAL_SIGNATURE") &&
-                            ! ca_file_policy_get (cert_id, "NON_REPUDIATION") &&
-                            ! ca_file_policy_get (cert_id, "KEY_ENCIPHERMENT")) {
+                        if (! ca_file_policy_get_all (cert_id)->digital_signature &&
+                            ! ca_file_policy_get_all (cert_id)->non_repudiation &&
+                            ! ca_file_policy_get_all (cert_id)->key_encipherment) {
                                 // If none is active, we must deactivate EMAIL_PROTECTION
                                 gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(gtk_builder_get_object (certificate_properties_window_gtkb, 
                                                                                                       "email_protection_check2")), FALSE);
@@ -483,9 +447,9 @@ G_MODULE_EXPORT void ca_policy_toggle_button_toggled (gpointer button, gpointer
 	if (! strcmp(widget_name, "webserver_check2")) {
                 if (is_active) {
                         // We must check digitalSignature || keyEncipherment || keyAgreement
-                        if (!( ca_file_policy_get (cert_id, "DIGITAL_SIGNATURE") ||
-                               ca_file_policy_get (cert_id, "KEY_ENCIPHERMENT") ||
-                               ca_file_policy_get (cert_id, "KEY_AGREEMENT"))) {
+                        if (!( ca_file_policy_get_all (cert_id)->digital_signature ||
+                               ca_file_policy_get_all (cert_id)->key_encipherment ||
+                               ca_file_policy_get_all (cert_id)->key_agreement)) {
                                 // If none is active, we activate key encipherment
                                 gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(gtk_builder_get_object (certificate_properties_window_gtkb, 
                                                                                                       "key_encipherment_check2")), TRUE);
@@ -498,8 +462,8 @@ G_MODULE_EXPORT void ca_policy_toggle_button_toggled (gpointer button, gpointer
 	if (! strcmp(widget_name, "webclient_check2")) {
                 if (is_active) {
                         // We must check digitalSignature || keyEncipherment || keyAgreement
-                        if (!( ca_file_policy_get (cert_id, "DIGITAL_SIGNATURE") ||
-                               ca_file_policy_get (cert_id, "KEY_AGREEMENT"))) {
+                        if (!( ca_file_policy_get_all (cert_id)->digital_signature ||
+                               ca_file_policy_get_all (cert_id)->key_agreement)) {
                                 // If none is active, we activate digital signature
                                 gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(gtk_builder_get_object (certificate_properties_window_gtkb, 
                                                                                                       "digital_signature_check4")), TRUE);
@@ -512,8 +476,8 @@ G_MODULE_EXPORT void ca_policy_toggle_button_toggled (gpointer button, gpointer
 	if (! strcmp(widget_name, "time_stamping_check2")){
                 if (is_active) {
                         // We must check digitalSignature && nonRepudiation
-                        if (!( ca_file_policy_get (cert_id, "DIGITAL_SIGNATURE") &&
-                               ca_file_policy_get (cert_id, "NON_REPUDIATION"))) {
+                        if (!( ca_file_policy_get_all (cert_id)->digital_signature &&
+                               ca_file_policy_get_all (cert_id)->non_repudiation)) {
                                 // If none is active, we activate them both
                                 gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(gtk_builder_get_object (certificate_properties_window_gtkb, 
                                                                                                       "digital_signature_check4")), TRUE);
@@ -528,7 +492,7 @@ G_MODULE_EXPORT void ca_policy_toggle_button_toggled (gpointer button, gpointer
 	if (! strcmp(widget_name, "code_signing_check2")) {
                 if (is_active) {
                         // We must check digitalSignature
-                        if (!( ca_file_policy_get (cert_id, "DIGITAL_SIGNATURE"))) {
+                        if (!( ca_file_policy_get_all (cert_id)->digital_signature)) {
                                 // If it is not active, we activate it
                                 gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(gtk_builder_get_object (certificate_properties_window_gtkb, 
                                                                                                       "digital_signature_check4")), TRUE);
@@ -541,10 +505,10 @@ G_MODULE_EXPORT void ca_policy_toggle_button_toggled (gpointer button, gpointer
 	if (! strcmp(widget_name, "email_protection_check2")) {
                 if (is_active) {
                         // We must check digitalSignature || nonRepudiation || (keyEncipherment || keyAgreement)
-                        if (!( ca_file_policy_get (cert_id, "DIGITAL_SIGNATURE") ||
-                               ca_file_policy_get (cert_id, "NON_REPUDIATION") ||
-                               ca_file_policy_get (cert_id, "KEY_ENCIPHERMENT") ||
-                               ca_file_policy_get (cert_id, "KEY_AGREEMENT"))) {
+                        if (!( ca_file_policy_get_all (cert_id)->digital_signature ||
+                               ca_file_policy_get_all (cert_id)->non_repudiation ||
+                               ca_file_policy_get_all (cert_id)->key_encipherment ||
+                               ca_file_policy_get_all (cert_id)->key_agreement)) {
                                 // If none is active, we activate key encipherment
                                 gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(gtk_builder_get_object (certificate_properties_window_gtkb, 
                                                                                                       "digital_signature_check4")), TRUE);
@@ -559,8 +523,8 @@ G_MODULE_EXPORT void ca_policy_toggle_button_toggled (gpointer button, gpointer
 	if (! strcmp(widget_name, "ocsp_signing_check2")) {
                 if (is_active) {
                         // We must check digitalSignature || nonRepudiation
-                        if (!( ca_file_policy_get (cert_id, "DIGITAL_SIGNATURE") ||
-                               ca_file_policy_get (cert_id, "NON_REPUDIATION"))) {
+                        if (!( ca_file_policy_get_all (cert_id)->digital_signature ||
+                               ca_file_policy_get_all (cert_id)->non_repudiation)) {
                                 // If none is active, we activate digital signature
                                 gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(gtk_builder_get_object (certificate_properties_window_gtkb, 
                                                                                                       "digital_signature_check4")), TRUE);
@@ -652,6 +652,43 @@ void __certificate_properties_fill_cert_subjectPublicKeyInfo (GtkTreeStore *stor
 		gtk_tree_store_set(store, &k, CERTIFICATE_PROPERTIES_COL_NAME, _("DSA PublicKey"), CERTIFICATE_PROPERTIES_COL_VALUE, value, -1);
 		g_free(value);
 		break;
+#ifdef ECC_GNUTLS
+	case GNUTLS_PK_EC:
+	case GNUTLS_PK_EDDSA_ED25519: {
+		gnutls_ecc_curve_t curve;
+		gnutls_datum_t x, ecc_y;
+		gchar *aux;
+
+		// Ed25519 keys have only the x coordinate
+		result = gnutls_x509_crt_get_pk_ecc_raw(*certificate, &curve, &x, &ecc_y);
+		if (result < 0) {
+			fprintf(stderr, "Error: (%s,%d): %s\n", __FILE__, __LINE__, gnutls_strerror(result));
+			break;
+		}
+		gtk_tree_store_append(store, &l, &k);
+		gtk_tree_store_set(store, &l, CERTIFICATE_PROPERTIES_COL_NAME, _("Curve"),
+				   CERTIFICATE_PROPERTIES_COL_VALUE, gnutls_ecc_curve_get_name(curve), -1);
+
+		value = __certificate_properties_dump_raw_data(x.data, x.size);
+		gnutls_free(x.data);
+		if (ecc_y.size) {
+			aux = __certificate_properties_dump_raw_data(ecc_y.data, ecc_y.size);
+			gtk_tree_store_append(store, &k, &j);
+			gtk_tree_store_set(store, &k, CERTIFICATE_PROPERTIES_COL_NAME, _("EC PublicKey"), -1);
+			gtk_tree_store_append(store, &l, &k);
+			gtk_tree_store_set(store, &l, CERTIFICATE_PROPERTIES_COL_NAME, "x", CERTIFICATE_PROPERTIES_COL_VALUE, value, -1);
+			gtk_tree_store_append(store, &l, &k);
+			gtk_tree_store_set(store, &l, CERTIFICATE_PROPERTIES_COL_NAME, "y", CERTIFICATE_PROPERTIES_COL_VALUE, aux, -1);
+			g_free(aux);
+		} else {
+			gtk_tree_store_append(store, &k, &j);
+			gtk_tree_store_set(store, &k, CERTIFICATE_PROPERTIES_COL_NAME, _("Ed25519 PublicKey"), CERTIFICATE_PROPERTIES_COL_VALUE, value, -1);
+		}
+		gnutls_free(ecc_y.data);
+		g_free(value);
+		break;
+	}
+#endif
 	default:
 		gtk_tree_store_append(store, &l, &k);
 		gtk_tree_store_set(store, &l, CERTIFICATE_PROPERTIES_COL_NAME, _("Parameters"), CERTIFICATE_PROPERTIES_COL_VALUE, _("(unknown)"), -1);
@@ -20,6 +20,7 @@
 #include <glib/gi18n.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #ifndef GNOMINTCLI
 #include <glib-object.h>
@@ -35,6 +36,34 @@
 
 void __crl_gfree_gfunc (gpointer data, gpointer user_data);
 
+// CRL of a CA being generated
+typedef struct {
+	guint64 ca_id;
+	gchar *filename;
+	gchar *ca_pem;
+	GList *revoked_certs;
+	gchar *input_digest;
+	gint hours_between_crl_updates;
+	time_t timestamp;
+	time_t next_update;
+	gchar *private_key;        // Only while it has to be signed
+	gint crl_version;
+	gchar *pem;
+	gboolean is_new;           // FALSE if the stored CRL was reused
+	const gchar *error;
+} CrlJob;
+
+gchar * __crl_input_digest (const gchar *ca_pem, gint hours_between_crl_updates, const GList *revoked_certs);
+gboolean __crl_last_is_reusable (const CaFileCrl *last_crl, const gchar *input_digest, time_t timestamp, 
+				 gint margin_hours);
+CrlJob * __crl_job_new (guint64 ca_id, const gchar *filename, gint margin_hours);
+void __crl_job_sign (CrlJob *job);
+void __crl_job_write (CrlJob *job);
+void __crl_job_free (CrlJob *job);
+void __crl_publish_worker (gpointer data, gpointer user_data);
+int __crl_publish_add_ca (void *pArg, int argc, char **argv, char **columnNames);
+gchar * __crl_publish_filename (const gchar *filename_pattern, guint64 ca_id);
+
 #ifndef GNOMINTCLI
 GtkBuilder *crl_window_gtkb = NULL;
 GtkTreeStore * crl_ca_list_model = NULL;
@@ -280,102 +309,282 @@ G_MODULE_EXPORT void crl_ok_clicked_cb (GtkButton *button, gpointer userdata)
 
 #endif /*GNOMINTCLI*/
 
-gchar * crl_generate (guint64 ca_id, gchar *filename)
+gchar * __crl_input_digest (const gchar *ca_pem, gint hours_between_crl_updates, const GList *revoked_certs)
+{
+	GChecksum *checksum = g_checksum_new (G_CHECKSUM_SHA256);
+	gchar *hours = g_strdup_printf ("\n%d\n", hours_between_crl_updates);
+	gchar *result;
+	const GList *cursor;
+
+	g_checksum_update (checksum, (const guchar *) ca_pem, -1);
+	g_checksum_update (checksum, (const guchar *) hours, -1);
+	g_free (hours);
+
+	// The list alternates the PEM of each revoked certificate and its revocation time
+	for (cursor = revoked_certs; cursor; cursor = g_list_next (cursor)) {
+		g_checksum_update (checksum, (const guchar *) cursor->data, -1);
+		g_checksum_update (checksum, (const guchar *) "\n", 1);
+	}
+
+	result = g_strdup (g_checksum_get_string (checksum));
+	g_checksum_free (checksum);
+
+	return result;
+}
+
+gboolean __crl_last_is_reusable (const CaFileCrl *last_crl, const gchar *input_digest, time_t timestamp, 
+				 gint margin_hours)
+{
+	time_t margin;
+
+	if (! last_crl || strcmp (last_crl->input_digest, input_digest) || timestamp < last_crl->date)
+		return FALSE;
+
+	// By default, it is signed again once half of its validity period has passed
+	if (margin_hours < 0)
+		margin = (last_crl->next_update - last_crl->date) / 2;
+	else
+		margin = (time_t) margin_hours * 3600;
+
+	return (timestamp + margin < last_crl->next_update);
+}
+
+/* Reads everything the CRL of the CA is generated from, and reuses the stored CRL if it is
+   still valid. Otherwise, the CA private key is unciphered (which can ask for passwords),
+   so the job is ready to be signed, maybe in another thread */
+CrlJob * __crl_job_new (guint64 ca_id, const gchar *filename, gint margin_hours)
 {
-        time_t timestamp;
-        gint crl_version = 0;
-	gchar * dn = NULL;
-	gchar * ca_pem = NULL;
-	gchar * private_key = NULL;
-	PkeyManageData * crypted_pkey = NULL;
-	gchar * pem = NULL;
-        GList * revoked_certs = NULL;
-	GIOChannel * file = NULL;
-	GError * error = NULL;
+	CrlJob *job = g_new0 (CrlJob, 1);
+	CaFileCrl *last_crl = NULL;
+	gchar *dn = NULL;
+	PkeyManageData *crypted_pkey = NULL;
 	gchar *strerror = NULL;
 
-	file = g_io_channel_new_file (filename, "w", &error);
-	g_free (filename);
-	if (error) {
-		return (_("There was an error while exporting CRL."));
+	job->ca_id = ca_id;
+	job->filename = g_strdup (filename);
+	job->ca_pem = ca_file_get_public_pem_from_id (CA_FILE_ELEMENT_TYPE_CERT, ca_id);
+	if (! ca_id || ! job->ca_pem) {
+		job->error = _("There was an error while exporting CRL.");
+		return job;
 	}
-	
-	ca_pem = ca_file_get_public_pem_from_id (CA_FILE_ELEMENT_TYPE_CERT, ca_id);
+
+        job->timestamp = time (NULL);
+	job->hours_between_crl_updates = ca_file_policy_get_all (ca_id)->hours_between_crl_updates;
+	job->next_update = job->timestamp + (3600 * job->hours_between_crl_updates);
+
+        job->revoked_certs = ca_file_get_revoked_certs (ca_id, &strerror);
+	if (strerror) {
+		g_free (strerror);
+		job->error = _("There was an error while getting revoked certificates.");
+		return job;
+	}
+
+	job->input_digest = __crl_input_digest (job->ca_pem, job->hours_between_crl_updates, job->revoked_certs);
+
+	last_crl = ca_file_get_last_crl (ca_id);
+	if (__crl_last_is_reusable (last_crl, job->input_digest, job->timestamp, margin_hours)) {
+		job->pem = g_strdup (last_crl->pem);
+		job->crl_version = last_crl->crl_version;
+		ca_file_crl_free (last_crl);
+		return job;
+	}
+	ca_file_crl_free (last_crl);
+
 	crypted_pkey = pkey_manage_get_certificate_pkey (ca_id);
 	dn = ca_file_get_dn_from_id (CA_FILE_ELEMENT_TYPE_CERT, ca_id);
-        timestamp = time (NULL);
+	if (crypted_pkey && dn)
+		job->private_key = pkey_manage_uncrypt (crypted_pkey, dn);
+	pkey_manage_data_free (crypted_pkey);
+	g_free (dn);
 
-        revoked_certs = ca_file_get_revoked_certs (ca_id, &strerror);
-	
-	if (strerror) {
-		return (_("There was an error while getting revoked certificates."));
+	if (! job->private_key)
+		job->error = _("There was an error while generating CRL.");
+
+	return job;
+}
+
+// Signs a new CRL for the job, if the stored one couldn't be reused. Can be run in any thread
+void __crl_job_sign (CrlJob *job)
+{
+	CaFileCrl *last_crl;
+
+	if (job->error || job->pem)
+		return;
+
+        job->crl_version = ca_file_new_crl_version (job->ca_id, job->timestamp);
+	if (! job->crl_version) {
+		job->error = _("There was an error while generating CRL.");
+		return;
 	}
 
+	job->pem = tls_generate_crl (job->revoked_certs, (guchar *) job->ca_pem, (guchar *) job->private_key, 
+				     job->crl_version, job->timestamp, job->next_update);
 
-        crl_version = ca_file_begin_new_crl_transaction (1, timestamp);
-
-        if (ca_id && ca_pem && crypted_pkey && dn) {
-
-		private_key = pkey_manage_uncrypt (crypted_pkey, dn);
-                if (!private_key) {
-			g_free (ca_pem);
-			pkey_manage_data_free (crypted_pkey);
-			g_free (dn);
-                        g_list_foreach (revoked_certs, __crl_gfree_gfunc, NULL);
-                        g_list_free (revoked_certs);
-                        ca_file_rollback_new_crl_transaction ();
-                        return (_("There was an error while generating CRL."));
-                }
-
-                pem = tls_generate_crl (revoked_certs,
-                                        (guchar *) ca_pem,
-                                        (guchar *) private_key,
-                                        crl_version,
-                                        timestamp,
-                                        timestamp + (3600 * ca_file_policy_get_int (ca_id, "HOURS_BETWEEN_CRL_UPDATES")));
-                
-
-		g_free (ca_pem);
-		pkey_manage_data_free (crypted_pkey);
-		g_free (dn);
-
-                if (!pem) {
-                        g_list_foreach (revoked_certs, __crl_gfree_gfunc, NULL);
-                        g_list_free (revoked_certs);
-                        ca_file_rollback_new_crl_transaction ();
-                        return (_("There was an error while generating CRL."));
-                }
-                g_io_channel_write_chars (file, pem, strlen(pem), NULL, &error);
-
-                if (error) {
-                        g_list_foreach (revoked_certs, __crl_gfree_gfunc, NULL);
-                        g_list_free (revoked_certs);
-                        ca_file_rollback_new_crl_transaction ();
-                        return (_("There was an error while writing CRL."));
-                }
-                g_free (pem);
+	memset (job->private_key, 0, strlen (job->private_key));
+	g_free (job->private_key);
+	job->private_key = NULL;
 
-	} else {
-                        g_list_foreach (revoked_certs, __crl_gfree_gfunc, NULL);
-                        g_list_free (revoked_certs);
-                        ca_file_rollback_new_crl_transaction ();
-                        return (_("There was an error while exporting CRL."));
-        }
-        
-        ca_file_commit_new_crl_transaction (ca_id, revoked_certs);
-		
-        g_list_foreach (revoked_certs, __crl_gfree_gfunc, NULL);
-        g_list_free (revoked_certs);
-	
-	g_io_channel_shutdown (file, TRUE, &error);
-	if (error) {
-		g_io_channel_unref (file);
-		return (_("There was an error while exporting CRL."));
+	if (! job->pem) {
+		ca_file_discard_crl_version (job->ca_id, job->crl_version);
+		job->error = _("There was an error while generating CRL.");
+		return;
 	}
-	
-	g_io_channel_unref (file);
-	
-	return NULL;
+
+	if (! ca_file_store_crl (job->ca_id, job->crl_version, job->revoked_certs, job->pem, 
+				 job->input_digest, job->next_update)) {
+		g_free (job->pem);
+		job->pem = NULL;
+		ca_file_discard_crl_version (job->ca_id, job->crl_version);
+		last_crl = ca_file_get_last_crl (job->ca_id);
+		if (last_crl && last_crl->crl_version > job->crl_version)
+			job->error = _("A later CRL was published meanwhile.");
+		else
+			job->error = _("There was an error while generating CRL.");
+		ca_file_crl_free (last_crl);
+		return;
+	}
+
+	job->is_new = TRUE;
+}
+
+/* The file is replaced atomically, so it is never seen half written, and it is left
+   untouched if it already holds the same CRL */
+void __crl_job_write (CrlJob *job)
+{
+	gchar *contents = NULL;
+	gsize length = 0;
+
+	if (job->error)
+		return;
+
+	if (g_file_get_contents (job->filename, &contents, &length, NULL) && 
+	    length == strlen (job->pem) && ! memcmp (contents, job->pem, length)) {
+		g_free (contents);
+		return;
+	}
+	g_free (contents);
+
+	if (! g_file_set_contents (job->filename, job->pem, -1, NULL))
+		job->error = _("There was an error while writing CRL.");
+}
+
+void __crl_job_free (CrlJob *job)
+{
+	if (job->private_key) {
+		memset (job->private_key, 0, strlen (job->private_key));
+		g_free (job->private_key);
+	}
+	g_free (job->filename);
+	g_free (job->ca_pem);
+	g_free (job->input_digest);
+	g_free (job->pem);
+        g_list_foreach (job->revoked_certs, __crl_gfree_gfunc, NULL);
+        g_list_free (job->revoked_certs);
+	g_free (job);
+}
+
+/* The last CRL of each CA is stored with a digest of the CA, its revoked certificates and
+   the CRL period. While none of them changes, that CRL is written again instead of signing
+   a new one, so periodic publishing doesn't ask for the CA key nor bump the CRL number */
+gchar * crl_generate (guint64 ca_id, gchar *filename)
+{
+	CrlJob *job = __crl_job_new (ca_id, filename, -1);
+	const gchar *error;
+
+	g_free (filename);
+
+	__crl_job_sign (job);
+	__crl_job_write (job);
+
+	error = job->error;
+	__crl_job_free (job);
+
+	return (gchar *) error;
+}
+
+void __crl_publish_worker (gpointer data, gpointer user_data)
+{
+	CrlJob *job = (CrlJob *) data;
+
+	ca_file_set_current ((CaFile *) user_data);
+
+	__crl_job_sign (job);
+
+	// Pool threads can be reused for anything else
+	ca_file_release_thread_connection ();
+	ca_file_set_current (NULL);
+}
+
+int __crl_publish_add_ca (void *pArg, int argc, char **argv, char **columnNames)
+{
+	GArray *ca_ids = (GArray *) pArg;
+	guint64 ca_id = atoll (argv[0]);
+
+	g_array_append_val (ca_ids, ca_id);
+
+	return 0;
+}
+
+gchar * __crl_publish_filename (const gchar *filename_pattern, guint64 ca_id)
+{
+	gchar *id = g_strdup_printf ("%"G_GUINT64_FORMAT, ca_id);
+	gchar **parts = g_strsplit (filename_pattern, "{ca}", -1);
+	gchar *result = g_strjoinv (id, parts);
+
+	g_strfreev (parts);
+	g_free (id);
+
+	return result;
+}
+
+guint crl_publish_all (const gchar *filename_pattern, gint margin_hours, guint threads, 
+		       CrlPublishFunc func, gpointer user_data)
+{
+	GArray *ca_ids = g_array_new (FALSE, FALSE, sizeof (guint64));
+	GPtrArray *jobs = g_ptr_array_new ();
+	GThreadPool *pool;
+	CrlJob *job;
+	gchar *filename;
+	guint errors = 0;
+	guint i;
+
+	// Policies (as the CRL period) may have been changed by others since the last pass
+	ca_file_policy_flush_cache ();
+
+	ca_file_foreach_ca (__crl_publish_add_ca, ca_ids);
+
+	// CA keys are unciphered here, one after another, as it can ask for passwords
+	for (i = 0; i < ca_ids->len; i++) {
+		filename = __crl_publish_filename (filename_pattern, g_array_index (ca_ids, guint64, i));
+		g_ptr_array_add (jobs, __crl_job_new (g_array_index (ca_ids, guint64, i), filename, margin_hours));
+		g_free (filename);
+	}
+
+	// Only signing is done in parallel, as the CAs are independent
+	pool = g_thread_pool_new (__crl_publish_worker, ca_file_get_current (), MAX (threads, 1), TRUE, NULL);
+	for (i = 0; i < jobs->len; i++) {
+		job = g_ptr_array_index (jobs, i);
+		if (! job->error && ! job->pem)
+			g_thread_pool_push (pool, job, NULL);
+	}
+	g_thread_pool_free (pool, FALSE, TRUE);
+
+	for (i = 0; i < jobs->len; i++) {
+		job = g_ptr_array_index (jobs, i);
+		__crl_job_write (job);
+
+		if (job->error)
+			errors ++;
+		if (func)
+			func (job->ca_id, job->filename, job->crl_version, job->is_new, job->error, user_data);
+
+		__crl_job_free (job);
+	}
+
+	g_ptr_array_free (jobs, TRUE);
+	g_array_free (ca_ids, TRUE);
+
+	return errors;
 }
 
 void __crl_gfree_gfunc (gpointer data, gpointer user_data)
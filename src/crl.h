@@ -29,4 +29,15 @@ void crl_ok_clicked_cb (GtkButton *button, gpointer userdata);
 
 gchar * crl_generate (guint64 ca_id, gchar *filename);
 
+// Called for each CA by crl_publish_all. error is NULL if the CRL was published
+typedef void (* CrlPublishFunc) (guint64 ca_id, const gchar *filename, gint crl_version, gboolean is_new,
+				 const gchar *error, gpointer user_data);
+
+// Writes the CRL of every valid CA into filename_pattern, with {ca} replaced by the CA id. A new
+// CRL is only signed if something changed or the stored one expires in less than margin_hours
+// (-1 = half of its validity period). New CRLs are signed in the given number of threads.
+// Returns the number of CAs that failed
+guint crl_publish_all (const gchar *filename_pattern, gint margin_hours, guint threads, 
+		       CrlPublishFunc func, gpointer user_data);
+
 #endif
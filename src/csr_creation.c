@@ -21,8 +21,10 @@
 #include "ca_file.h"
 #include "tls.h"
 #include "pkey_manage.h"
+#include "key_pool.h"
 
 #include <stdio.h>
+#include <string.h>
 #include <gnutls/gnutls.h>
 
 #include <glib/gi18n.h>
@@ -37,6 +39,22 @@ gchar * csr_creation_database_save (TlsCreationData * creation_data,
 				   gchar * private_key, 
 				   gchar * root_certificate);
 
+typedef struct {
+	CaFile *ca_file;
+	GAsyncQueue *done;
+} CsrCreationBatch;
+
+typedef struct {
+	TlsCreationData *creation_data;
+	gchar *private_key;
+	gchar *csr;
+	gchar *error;
+} CsrCreationBatchItem;
+
+gchar * __csr_creation_generate (TlsCreationData *creation_data, gchar **pkey, gchar **certificate_sign_request);
+void __csr_creation_batch_worker (gpointer data, gpointer user_data);
+guint __csr_creation_batch_save (GPtrArray *group);
+
 gpointer csr_creation_thread (gpointer data)
 {
 	TlsCreationData *creation_data = (TlsCreationData *) data;
@@ -48,53 +66,60 @@ gpointer csr_creation_thread (gpointer data)
 	gchar * error_message = NULL;
 	TlsCsr *tlscsr;
 
-
-	switch (creation_data->key_type){
-	case 0: /* RSA */
+	private_key = key_pool_take (creation_data->key_type, creation_data->key_bitlength, creation_data->password);
+	if (private_key) {
 		g_mutex_lock (&csr_creation_thread_status_mutex);
-		csr_creation_message =  _("Generating new RSA key pair");
+		csr_creation_message =  _("Taking a pre-generated key pair");
 		g_mutex_unlock (&csr_creation_thread_status_mutex);
 
-		error_message = tls_generate_rsa_keys (creation_data, &private_key, &csr_key);		
+		error_message = tls_load_private_key (private_key, &csr_key);
 		if (error_message) {
+			// Generated as usual, instead
 			printf ("%s\n\n", error_message);
-
-			g_mutex_lock (&csr_creation_thread_status_mutex);
-
-			csr_creation_message = g_strdup_printf ("%s:\n%s",_("Key generation failed"), error_message); 
-			csr_creation_thread_status = -1;
-
-			g_mutex_unlock (&csr_creation_thread_status_mutex);
-
-			return NULL;
-			// return error_message;
+			g_free (error_message);
+			memset (private_key, 0, strlen (private_key));
+			g_free (private_key);
+			private_key = NULL;
+			if (csr_key) {
+				gnutls_x509_privkey_deinit ((* csr_key));
+				g_free (csr_key);
+				csr_key = NULL;
+			}
 		}
+	}
 
-		break;
-
-	case 1: /* DSA */
+	if (! private_key) {
 		g_mutex_lock (&csr_creation_thread_status_mutex);
-		csr_creation_message =  _("Generating new DSA key pair");
+		switch (creation_data->key_type){
+		case TLS_KEY_TYPE_DSA:
+			csr_creation_message =  _("Generating new DSA key pair");
+			break;
+		case TLS_KEY_TYPE_ECDSA:
+			csr_creation_message =  _("Generating new ECDSA key pair");
+			break;
+		case TLS_KEY_TYPE_ED25519:
+			csr_creation_message =  _("Generating new Ed25519 key pair");
+			break;
+		default:
+			csr_creation_message =  _("Generating new RSA key pair");
+			break;
+		}
 		g_mutex_unlock (&csr_creation_thread_status_mutex);
 
- 		error_message = tls_generate_dsa_keys (creation_data, &private_key, &csr_key);
-
-		if (error_message) { 
+		error_message = tls_generate_keys (creation_data, &private_key, &csr_key);
+		if (error_message) {
 			printf ("%s\n\n", error_message);
 
- 			g_mutex_lock (&csr_creation_thread_status_mutex); 
+			g_mutex_lock (&csr_creation_thread_status_mutex);
 
 			csr_creation_message = g_strdup_printf ("%s:\n%s",_("Key generation failed"), error_message); 
- 			csr_creation_thread_status = -1; 
-
- 			g_mutex_unlock (&csr_creation_thread_status_mutex); 
+			csr_creation_thread_status = -1;
 
+			g_mutex_unlock (&csr_creation_thread_status_mutex);
 
- 			//return error_message; 
 			return NULL;
- 		} 
-
-		break;
+			// return error_message;
+		}
 	}
 
 	g_mutex_lock (&csr_creation_thread_status_mutex);
@@ -156,6 +181,9 @@ gpointer csr_creation_thread (gpointer data)
 		g_free (csr_key);
 	}
 
+	key_pool_refill (creation_data->password);
+	ca_file_release_thread_connection ();
+
 	return NULL;
 	
 
@@ -193,8 +221,180 @@ gchar * csr_creation_database_save (TlsCreationData * creation_data,
 				    gchar * private_key, 
 				    gchar * certificate_sign_request)
 {
-	return ca_file_insert_csr (private_key,
-				   certificate_sign_request, 
-				   creation_data->parent_ca_id_str,
-				   NULL);
+	gchar *error = ca_file_insert_csr (private_key,
+					   certificate_sign_request, 
+					   creation_data->parent_ca_id_str,
+					   NULL);
+
+	// This runs in the creation thread, which is done with the database
+	ca_file_release_thread_connection ();
+
+	return error;
+}
+
+
+
+// Same steps as csr_creation_thread, without reporting the status
+gchar * __csr_creation_generate (TlsCreationData *creation_data, gchar **pkey, gchar **certificate_sign_request)
+{
+	gchar * private_key = NULL;
+	gnutls_x509_privkey_t * csr_key = NULL;
+	gchar * error_message = NULL;
+	TlsCsr *tlscsr;
+
+	private_key = key_pool_take (creation_data->key_type, creation_data->key_bitlength, creation_data->password);
+	if (private_key && (error_message = tls_load_private_key (private_key, &csr_key))) {
+		g_free (error_message);
+		memset (private_key, 0, strlen (private_key));
+		g_free (private_key);
+		private_key = NULL;
+		if (csr_key) {
+			gnutls_x509_privkey_deinit ((* csr_key));
+			g_free (csr_key);
+			csr_key = NULL;
+		}
+	}
+
+	if (! private_key) {
+		error_message = tls_generate_keys (creation_data, &private_key, &csr_key);
+		if (error_message) {
+			g_free (private_key);
+			if (csr_key) {
+				gnutls_x509_privkey_deinit ((* csr_key));
+				g_free (csr_key);
+			}
+			return error_message;
+		}
+	}
+
+	error_message = tls_generate_csr (creation_data, csr_key, certificate_sign_request);
+
+	gnutls_x509_privkey_deinit ((* csr_key));
+	g_free (csr_key);
+
+	if (! error_message) {
+		tlscsr = tls_parse_csr_pem (*certificate_sign_request);
+		*pkey = pkey_manage_crypt_w_pwd (private_key, tlscsr->dn, creation_data->password);
+		tls_csr_free (tlscsr);
+		if (! *pkey)
+			error_message = g_strdup (_("Error while ciphering the private key"));
+	}
+
+	memset (private_key, 0, strlen (private_key));
+	g_free (private_key);
+
+	return error_message;
+}
+
+void __csr_creation_batch_worker (gpointer data, gpointer user_data)
+{
+	CsrCreationBatchItem *item = (CsrCreationBatchItem *) data;
+	CsrCreationBatch *batch = (CsrCreationBatch *) user_data;
+
+	ca_file_set_current (batch->ca_file);
+
+	item->error = __csr_creation_generate (item->creation_data, &item->private_key, &item->csr);
+
+	// Pool threads can be reused for anything else
+	ca_file_release_thread_connection ();
+	ca_file_set_current (NULL);
+
+	g_async_queue_push (batch->done, item);
+}
+
+guint __csr_creation_batch_save (GPtrArray *group)
+{
+	gchar **pkeys = g_new0 (gchar *, group->len);
+	gchar **csrs = g_new0 (gchar *, group->len);
+	gchar **parent_ca_id_strs = g_new0 (gchar *, group->len);
+	gchar **errors = g_new0 (gchar *, group->len);
+	CsrCreationBatchItem *item;
+	gint inserted;
+	guint i;
+
+	for (i = 0; i < group->len; i++) {
+		item = g_ptr_array_index (group, i);
+		pkeys[i] = item->private_key;
+		csrs[i] = item->csr;
+		parent_ca_id_strs[i] = item->creation_data->parent_ca_id_str;
+	}
+
+	inserted = ca_file_insert_csrs (group->len, pkeys, csrs, parent_ca_id_strs, errors);
+
+	for (i = 0; i < group->len; i++) {
+		item = g_ptr_array_index (group, i);
+		item->error = errors[i];
+	}
+
+	g_free (pkeys);
+	g_free (csrs);
+	g_free (parent_ca_id_strs);
+	g_free (errors);
+
+	return (inserted > 0 ? inserted : 0);
+}
+
+guint csr_creation_batch (GPtrArray *creation_data, guint threads, gchar ***errors,
+			  CsrCreationBatchProgressFunc progress_func, gpointer user_data)
+{
+	CsrCreationBatch batch;
+	CsrCreationBatchItem *items;
+	CsrCreationBatchItem *item;
+	GThreadPool *pool;
+	GPtrArray *group;
+	guint saved = 0;
+	guint failed = 0;
+	guint i;
+
+	if (! creation_data->len)
+		return 0;
+
+	batch.ca_file = ca_file_get_current ();
+	batch.done = g_async_queue_new ();
+
+	items = g_new0 (CsrCreationBatchItem, creation_data->len);
+	pool = g_thread_pool_new (__csr_creation_batch_worker, &batch, MAX (threads, 1), TRUE, NULL);
+	for (i = 0; i < creation_data->len; i++) {
+		items[i].creation_data = g_ptr_array_index (creation_data, i);
+		g_thread_pool_push (pool, &items[i], NULL);
+	}
+
+	// The CSRs are saved in this thread, as they arrive
+	group = g_ptr_array_new ();
+	for (i = 0; i < creation_data->len; i++) {
+		item = g_async_queue_pop (batch.done);
+		if (item->error)
+			failed ++;
+		else
+			g_ptr_array_add (group, item);
+
+		if (group->len == CSR_CREATION_BATCH_GROUP_SIZE || (i + 1 == creation_data->len && group->len)) {
+			saved += __csr_creation_batch_save (group);
+			failed = i + 1 - saved;
+			g_ptr_array_set_size (group, 0);
+		}
+
+		if (progress_func)
+			progress_func (saved, failed, creation_data->len, user_data);
+	}
+	g_ptr_array_free (group, TRUE);
+
+	g_thread_pool_free (pool, FALSE, TRUE);
+	g_async_queue_unref (batch.done);
+
+	if (errors)
+		*errors = g_new0 (gchar *, creation_data->len);
+	for (i = 0; i < creation_data->len; i++) {
+		if (errors)
+			(*errors)[i] = items[i].error;
+		else
+			g_free (items[i].error);
+		g_free (items[i].private_key);
+		g_free (items[i].csr);
+	}
+	g_free (items);
+
+	key_pool_refill (((TlsCreationData *) g_ptr_array_index (creation_data, 0))->password);
+
+	return saved;
 }
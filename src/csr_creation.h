@@ -35,4 +35,16 @@ gint csr_creation_get_thread_status (void);
 
 gchar * csr_creation_get_thread_message(void);
 
+// CSRs of a batch are saved in transactions of this many ones
+#define CSR_CREATION_BATCH_GROUP_SIZE 100
+#define CSR_CREATION_BATCH_THREADS 4
+
+typedef void (* CsrCreationBatchProgressFunc) (guint saved, guint failed, guint total, gpointer user_data);
+
+// Creates a CSR for each TlsCreationData in the array, generating the keys in several threads.
+// Returns how many were saved. If errors is not NULL, it gets a new array with the error of
+// each CSR (NULL if it was saved)
+guint csr_creation_batch (GPtrArray *creation_data, guint threads, gchar ***errors,
+			  CsrCreationBatchProgressFunc progress_func, gpointer user_data);
+
 #endif
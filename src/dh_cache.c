@@ -0,0 +1,213 @@
+//  gnoMint: a graphical interface for managing a certification authority
+//  Copyright (C) 2006-2009 David Marín Carreño <davefx@gmail.com>
+//
+//  This file is part of gnoMint.
+//
+//  gnoMint is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 3 of the License, or   
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of 
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the  
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "dh_cache.h"
+#include "tls.h"
+
+const guint dh_cache_standard_sizes[DH_CACHE_STANDARD_SIZES_NUMBER] = {2048, 3072, 4096};
+
+static gint dh_cache_running = FALSE;
+
+gchar * __dh_cache_dirname (void);
+gboolean __dh_cache_is_set (const gchar *basename, guint bits);
+gchar * __dh_cache_find (guint bits);
+gboolean __dh_cache_fill (guint sets);
+gpointer __dh_cache_thread (gpointer data);
+
+
+gchar * __dh_cache_dirname ()
+{
+	return g_build_filename (g_get_user_cache_dir (), "gnomint", NULL);
+}
+
+/* Each set is kept in its own file, dh-<bits>-<random>.pem (or dh-<bits>.pem, as written
+   by older versions). Files being written or taken have other suffixes */
+gboolean __dh_cache_is_set (const gchar *basename, guint bits)
+{
+	gchar *prefix = g_strdup_printf ("dh-%u", bits);
+	gsize length = strlen (prefix);
+	gboolean res;
+
+	res = (! strncmp (basename, prefix, length) && g_str_has_suffix (basename, ".pem") &&
+	       (basename[length] == '-' || ! strcmp (basename + length, ".pem")));
+
+	g_free (prefix);
+
+	return res;
+}
+
+// Returns the file name of any cached set with the given prime size, or NULL
+gchar * __dh_cache_find (guint bits)
+{
+	gchar *dirname = __dh_cache_dirname ();
+	GDir *dir = g_dir_open (dirname, 0, NULL);
+	const gchar *basename;
+	gchar *res = NULL;
+
+	while (dir && ! res && (basename = g_dir_read_name (dir))) {
+		if (__dh_cache_is_set (basename, bits))
+			res = g_build_filename (dirname, basename, NULL);
+	}
+
+	if (dir)
+		g_dir_close (dir);
+	g_free (dirname);
+
+	return res;
+}
+
+gboolean __dh_cache_fill (guint sets)
+{
+	gchar *dirname = __dh_cache_dirname ();
+	gchar *basename;
+	gchar *filename;
+	gchar *pem;
+	gboolean res = TRUE;
+	guint i;
+
+	// The directory is only needed for writing into it
+	g_mkdir_with_parents (dirname, 0700);
+
+	for (i = 0; i < DH_CACHE_STANDARD_SIZES_NUMBER; i++) {
+		while (dh_cache_count (dh_cache_standard_sizes[i]) < sets) {
+			pem = tls_generate_dh_params (dh_cache_standard_sizes[i]);
+			if (! pem) {
+				res = FALSE;
+				break;
+			}
+
+			// g_file_set_contents writes a temporary file and renames it, so nobody takes
+			// half-written parameters, even if the program exits meanwhile
+			basename = g_strdup_printf ("dh-%u-%08x.pem", dh_cache_standard_sizes[i], g_random_int ());
+			filename = g_build_filename (dirname, basename, NULL);
+			if (! g_file_set_contents (filename, pem, -1, NULL))
+				res = FALSE;
+
+			g_free (basename);
+			g_free (filename);
+			g_free (pem);
+
+			if (! res)
+				break;
+		}
+	}
+
+	g_free (dirname);
+
+	return res;
+}
+
+gpointer __dh_cache_thread (gpointer data)
+{
+	__dh_cache_fill (1);
+
+	g_atomic_int_set (&dh_cache_running, FALSE);
+
+	return NULL;
+}
+
+
+gboolean dh_cache_is_standard_size (guint bits)
+{
+	guint i;
+
+	for (i = 0; i < DH_CACHE_STANDARD_SIZES_NUMBER; i++)
+		if (dh_cache_standard_sizes[i] == bits)
+			return TRUE;
+
+	return FALSE;
+}
+
+gchar * dh_cache_take (guint bits)
+{
+	gchar *filename;
+	gchar *taken;
+	gchar *res = NULL;
+	gboolean lost = TRUE;
+
+	// Renaming is atomic, so the same parameters aren't given to two programs at the same time.
+	// If another program took the set first, another one is looked for
+	while (! res && lost && (filename = __dh_cache_find (bits))) {
+		taken = g_strdup_printf ("%s.%08x", filename, g_random_int ());
+		if (g_rename (filename, taken) == 0) {
+			if (! g_file_get_contents (taken, &res, NULL, NULL))
+				res = NULL;
+			g_unlink (taken);
+			lost = FALSE;
+		} else {
+			lost = ! g_file_test (filename, G_FILE_TEST_EXISTS);
+		}
+
+		g_free (filename);
+		g_free (taken);
+	}
+
+	return res;
+}
+
+guint dh_cache_count (guint bits)
+{
+	gchar *dirname = __dh_cache_dirname ();
+	GDir *dir = g_dir_open (dirname, 0, NULL);
+	const gchar *basename;
+	guint res = 0;
+
+	while (dir && (basename = g_dir_read_name (dir))) {
+		if (__dh_cache_is_set (basename, bits))
+			res ++;
+	}
+
+	if (dir)
+		g_dir_close (dir);
+	g_free (dirname);
+
+	return res;
+}
+
+gboolean dh_cache_is_available (guint bits)
+{
+	gchar *filename = __dh_cache_find (bits);
+	gboolean res = (filename != NULL);
+
+	g_free (filename);
+
+	return res;
+}
+
+void dh_cache_refill ()
+{
+	GThread *thread;
+
+	if (! g_atomic_int_compare_and_exchange (&dh_cache_running, FALSE, TRUE))
+		return;
+
+	// Generation can't be interrupted, so the thread is never joined: at exit, it is just dropped
+	thread = g_thread_new ("dh_cache", __dh_cache_thread, NULL);
+	g_thread_unref (thread);
+}
+
+gboolean dh_cache_fill (guint sets)
+{
+	return __dh_cache_fill (sets);
+}
@@ -0,0 +1,49 @@
+//  gnoMint: a graphical interface for managing a certification authority
+//  Copyright (C) 2006-2009 David Marín Carreño <davefx@gmail.com>
+//
+//  This file is part of gnoMint.
+//
+//  gnoMint is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 3 of the License, or   
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of 
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the  
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#ifndef _DH_CACHE_H_
+#define _DH_CACHE_H_
+
+#include <glib.h>
+
+// Pre-generated Diffie-Hellman parameters are kept, for each of these prime sizes, in the user
+// cache directory (~/.cache/gnomint/dh-<bits>-*.pem), one file per set, so several sets can be
+// ready for a run of exports. They are not tied to any database.
+#define DH_CACHE_STANDARD_SIZES_NUMBER 3
+extern const guint dh_cache_standard_sizes[DH_CACHE_STANDARD_SIZES_NUMBER];
+
+gboolean dh_cache_is_standard_size (guint bits);
+
+// Takes a cached set with the given prime size, as a PKCS#3 PEM, so it is never given twice.
+// Returns NULL if there are none.
+gchar * dh_cache_take (guint bits);
+
+// Tells whether there are cached parameters with the given prime size, and how many sets
+gboolean dh_cache_is_available (guint bits);
+guint dh_cache_count (guint bits);
+
+// Generates, in a background thread, a set for each standard size that has none. The thread
+// is never joined, so programs that may exit meanwhile (as the CLI) must use dh_cache_fill.
+void dh_cache_refill (void);
+
+// Generates sets until there are the given number of each standard size, waiting for them.
+// Returns FALSE if any of them failed.
+gboolean dh_cache_fill (guint sets);
+
+#endif
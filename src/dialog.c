@@ -68,6 +68,23 @@ gboolean dialog_refresh_list (void)
 #include <readline/readline.h>
 #include <readline/history.h>
 
+static gboolean dialog_batch_mode = FALSE;
+static gboolean dialog_batch_assume_yes = FALSE;
+static gchar * dialog_batch_password = NULL;
+
+void dialog_set_batch_mode (gboolean assume_yes, const gchar *password)
+{
+	dialog_batch_mode = TRUE;
+	dialog_batch_assume_yes = assume_yes;
+
+	g_free (dialog_batch_password);
+	dialog_batch_password = g_strdup (password);
+}
+
+gboolean dialog_is_batch_mode (void)
+{
+	return dialog_batch_mode;
+}
 
 void dialog_info (gchar *message) {
         printf ("\nInfo: %s\n\n", message);
@@ -85,6 +102,9 @@ gchar * dialog_get_password (gchar *info_message,
         gchar * password = NULL;
 	gchar * password2 = NULL;
 
+	if (dialog_batch_mode)
+		return g_strdup (dialog_batch_password);
+
 	printf ("%s\n\n", info_message);
 
 	do {
@@ -130,6 +150,9 @@ gboolean dialog_ask_for_confirmation (gchar *message, gchar *prompt, gboolean de
 	gchar **aux;
 	gint i;
 
+	if (dialog_batch_mode)
+		return default_answer;
+
 	if (message)
 		printf ("%s\n", message);
 
@@ -177,6 +200,17 @@ gboolean dialog_ask_for_confirmation (gchar *message, gchar *prompt, gboolean de
 }
 
 
+gboolean dialog_confirm_action (gchar *message, gchar *prompt, gboolean default_answer)
+{
+	/* Confirmations of destructive actions (overwriting, revoking...) are
+	   only accepted in batch mode if the user asked so explicitly */
+	if (dialog_batch_mode)
+		return dialog_batch_assume_yes;
+
+	return dialog_ask_for_confirmation (message, prompt, default_answer);
+}
+
+
 gint dialog_ask_for_number (gchar *message, gint minimum, gint maximum, gint default_value)
 {
 	gchar *line;
@@ -190,6 +224,9 @@ gint dialog_ask_for_number (gchar *message, gint minimum, gint maximum, gint def
 	g_assert (minimum <= default_value);
 	g_assert (maximum >= default_value);
 
+	if (dialog_batch_mode)
+		return default_value;
+
 	if (maximum == default_value)
 		prompt = g_strdup_printf ("%s (%d - [%d]): ", message, minimum, maximum);
 	else if (minimum == default_value)
@@ -223,6 +260,8 @@ gchar * dialog_ask_for_password (gchar *message)
 	gchar *password;
 	gchar *aux = NULL;
 
+	if (dialog_batch_mode)
+		return g_strdup (dialog_batch_password);
 
 	aux = getpass (message);
 	
@@ -242,6 +281,9 @@ gchar * dialog_ask_for_string (gchar *message, gchar *default_answer)
 	gchar *result = NULL;
 	char *line;
 
+	if (dialog_batch_mode)
+		return g_strdup (default_answer);
+
 	printf ("%s\n", message);
 	
 	if (default_answer) {
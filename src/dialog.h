@@ -50,8 +50,14 @@ void dialog_password_entry_changed_cb (GtkEditable *password_entry, gpointer use
 char *getpass(const char *prompt);
 #endif
 
+void dialog_set_batch_mode (gboolean assume_yes, const gchar *password);
+
+gboolean dialog_is_batch_mode (void);
+
 gboolean dialog_ask_for_confirmation (gchar *message, gchar *prompt, gboolean default_answer);
 
+gboolean dialog_confirm_action (gchar *message, gchar *prompt, gboolean default_answer);
+
 gint dialog_ask_for_number (gchar *message, gint minimum, gint maximum, gint default_value);
 
 gchar * dialog_ask_for_password (gchar *message);
@@ -23,35 +23,56 @@
 
 
 #include "ca_file.h"
+#include "dh_cache.h"
 #include "dialog.h"
 #include "tls.h"
 #include "pkey_manage.h"
 
-gchar *export_dh_param (guint dh_size, gchar *filename)
+gchar *export_dh_param (guint dh_size, gboolean well_known, gchar *filename)
 {
 	GIOChannel * file = NULL;
 	gchar *pem = NULL;
 	GError * error = NULL;
 
-	pem = tls_generate_dh_params (dh_size);
+	if (well_known) {
+		pem = tls_get_dh_well_known_group (dh_size);
+		if (! pem)
+			return (_("There is no RFC 7919 group with the given prime size. Valid sizes are 2048, 3072, 4096, 6144 and 8192."));
+	} else {
+		pem = dh_cache_take (dh_size);
+		if (! pem)
+			pem = tls_generate_dh_params (dh_size);
+#ifndef GNOMINTCLI
+		// The GUI keeps running, so the taken parameters are replaced in background.
+		// The CLI would exit before: its cache is filled with "dhcache fill"
+		dh_cache_refill ();
+#endif
+		if (! pem)
+			return (_("There was an error while generating Diffie-Hellman parameters."));
+	}
 
 	file = g_io_channel_new_file (filename, "w", &error);
 	if (error) {
+		g_error_free (error);
+		g_free (pem);
 		return (_("There was an error while saving Diffie-Hellman parameters."));
 	} 
 
 	g_io_channel_write_chars (file, pem, strlen(pem), NULL, &error);
+	g_free (pem);
 	if (error) {
+		g_error_free (error);
+		g_io_channel_unref (file);
 		return (_("There was an error while saving Diffie-Hellman parameters."));
 	} 
 
 	g_io_channel_shutdown (file, TRUE, &error);
+	g_io_channel_unref (file);
 	if (error) {
+		g_error_free (error);
 		return (_("There was an error while saving Diffie-Hellman parameters."));
 	} 
 
-	g_io_channel_unref (file);
-
 	return NULL;
 }
 
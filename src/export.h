@@ -23,7 +23,8 @@
 #include <glib.h>
 #include <glib/gi18n.h>
 
-gchar *export_dh_param (guint dh_size, gchar *filename);
+// Takes the parameters from the DH cache if possible, or uses a RFC 7919 group if well_known
+gchar *export_dh_param (guint dh_size, gboolean well_known, gchar *filename);
 
 gchar * export_private_pkcs8 (guint64 id, gint type, gchar *filename);
 
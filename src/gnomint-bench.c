@@ -0,0 +1,514 @@
+//  gnoMint: a graphical interface for managing a certification authority
+//  Copyright (C) 2006-2009 David Marín Carreño <davefx@gmail.com>
+//
+//  This file is part of gnoMint.
+//
+//  gnoMint is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+// Benchmarks of the most used operations, against temporary databases of several sizes.
+// Results are written to standard output, one line per operation and database size, so
+// they can be compared between releases. Run it with "make bench".
+
+#include <glib.h>
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "tls.h"
+#include "ca_file.h"
+#include "dialog.h"
+#include "import.h"
+#include "preferences.h"
+
+#define BENCH_PASSWORD "gnomint-bench"
+#define BENCH_IMPORT_SERIAL_BASE 1000000000
+
+gchar * gnomint_current_opened_file = NULL;
+
+typedef struct {
+	const gchar *name;
+	guint db_size;
+	guint iterations;
+	gint64 total;
+	gint64 min;
+	gint64 max;
+} BenchResult;
+
+typedef struct {
+	gboolean csv;
+	gboolean header_written;
+} BenchOutput;
+
+typedef struct {
+	gchar *ca_pem;
+	gchar *ca_private_key;
+	guint64 ca_id;
+	gnutls_x509_privkey_t *leaf_key;
+	gchar *leaf_private_key;
+} BenchCa;
+
+void __bench_result_init (BenchResult *result, const gchar *name, guint db_size);
+void __bench_result_add (BenchResult *result, gint64 start);
+void __bench_result_write (BenchOutput *output, const BenchResult *result);
+gboolean __bench_refresh (void);
+int __bench_count_cb (void *pArg, int argc, char **argv, char **columnNames);
+int __bench_collect_ids_cb (void *pArg, int argc, char **argv, char **columnNames);
+void __bench_fill_creation_data (TlsCreationData *creation_data, const gchar *cn, gint key_bitlength, gint months);
+gchar * __bench_sign (BenchCa *ca, const gchar *cn, const UInt160 *serial, gint key_bitlength, gchar **certificate,
+		      BenchResult *result);
+gchar * __bench_create_ca (BenchCa *ca, gint key_bitlength);
+gchar * __bench_run (BenchOutput *output, const gchar *dirname, guint db_size, guint iterations,
+		     guint slow_iterations, gint key_bitlength, gboolean keep);
+
+
+void __bench_result_init (BenchResult *result, const gchar *name, guint db_size)
+{
+	result->name = name;
+	result->db_size = db_size;
+	result->iterations = 0;
+	result->total = 0;
+	result->min = G_MAXINT64;
+	result->max = 0;
+}
+
+void __bench_result_add (BenchResult *result, gint64 start)
+{
+	gint64 elapsed = g_get_monotonic_time () - start;
+
+	result->iterations ++;
+	result->total += elapsed;
+	if (elapsed < result->min)
+		result->min = elapsed;
+	if (elapsed > result->max)
+		result->max = elapsed;
+}
+
+void __bench_result_write (BenchOutput *output, const BenchResult *result)
+{
+	gint64 mean = result->iterations ? result->total / result->iterations : 0;
+	gint64 min = result->iterations ? result->min : 0;
+
+	if (output->csv) {
+		if (! output->header_written) {
+			printf ("version,benchmark,db_size,iterations,total_us,mean_us,min_us,max_us\n");
+			output->header_written = TRUE;
+		}
+		printf ("%s,%s,%u,%u,%"G_GINT64_FORMAT",%"G_GINT64_FORMAT",%"G_GINT64_FORMAT",%"G_GINT64_FORMAT"\n",
+			PACKAGE_VERSION, result->name, result->db_size, result->iterations,
+			result->total, mean, min, result->max);
+	} else {
+		printf ("{\"version\":\"%s\",\"benchmark\":\"%s\",\"db_size\":%u,\"iterations\":%u,"
+			"\"total_us\":%"G_GINT64_FORMAT",\"mean_us\":%"G_GINT64_FORMAT",\"min_us\":%"G_GINT64_FORMAT","
+			"\"max_us\":%"G_GINT64_FORMAT"}\n",
+			PACKAGE_VERSION, result->name, result->db_size, result->iterations,
+			result->total, mean, min, result->max);
+	}
+	fflush (stdout);
+}
+
+gboolean __bench_refresh ()
+{
+	return TRUE;
+}
+
+int __bench_count_cb (void *pArg, int argc, char **argv, char **columnNames)
+{
+	guint *count = (guint *) pArg;
+
+	(*count) ++;
+
+	return 0;
+}
+
+int __bench_collect_ids_cb (void *pArg, int argc, char **argv, char **columnNames)
+{
+	GArray *ids = (GArray *) pArg;
+	guint64 id;
+
+	// Columns are id, is_ca, ...
+	if (atoi (argv[1]))
+		return 0;
+
+	id = atoll (argv[0]);
+	g_array_append_val (ids, id);
+
+	return 0;
+}
+
+void __bench_fill_creation_data (TlsCreationData *creation_data, const gchar *cn, gint key_bitlength, gint months)
+{
+	memset (creation_data, 0, sizeof (TlsCreationData));
+
+	creation_data->country = "ES";
+	creation_data->org = "gnoMint benchmark";
+	creation_data->cn = (gchar *) cn;
+	creation_data->key_type = TLS_KEY_TYPE_RSA;
+	creation_data->key_bitlength = key_bitlength;
+	creation_data->key_months_before_expiration = months;
+	creation_data->activation = time (NULL);
+	creation_data->expiration = creation_data->activation + months * 31 * 24 * 3600;
+}
+
+// Creates a CSR for the common leaf key, and signs it with the CA. Only the signature is timed.
+gchar * __bench_sign (BenchCa *ca, const gchar *cn, const UInt160 *serial, gint key_bitlength, gchar **certificate,
+		      BenchResult *result)
+{
+	TlsCreationData creation_data;
+	TlsCertCreationData cert_creation_data;
+	gchar *csr = NULL;
+	gchar *error;
+	gint64 start;
+
+	__bench_fill_creation_data (&creation_data, cn, key_bitlength, 12);
+	error = tls_generate_csr (&creation_data, ca->leaf_key, &csr);
+	if (error)
+		return error;
+
+	memset (&cert_creation_data, 0, sizeof (TlsCertCreationData));
+	cert_creation_data.key_months_before_expiration = 12;
+	cert_creation_data.activation = creation_data.activation;
+	cert_creation_data.expiration = creation_data.expiration;
+	cert_creation_data.digital_signature = TRUE;
+	cert_creation_data.key_encipherment = TRUE;
+	cert_creation_data.web_server = TRUE;
+	cert_creation_data.serial = (* serial);
+
+	start = g_get_monotonic_time ();
+	error = tls_generate_certificate (&cert_creation_data, csr, ca->ca_pem, ca->ca_private_key, certificate);
+	if (result && ! error)
+		__bench_result_add (result, start);
+
+	g_free (csr);
+
+	return error;
+}
+
+gchar * __bench_create_ca (BenchCa *ca, gint key_bitlength)
+{
+	TlsCreationData creation_data;
+	gnutls_x509_privkey_t *ca_key = NULL;
+	TlsCert *cert;
+	gchar *error;
+
+	__bench_fill_creation_data (&creation_data, "gnoMint benchmark CA", key_bitlength, 120);
+
+	error = tls_generate_keys (&creation_data, &ca->ca_private_key, &ca_key);
+	if (error)
+		return error;
+
+	error = tls_generate_self_signed_certificate (&creation_data, ca_key, &ca->ca_pem);
+	gnutls_x509_privkey_deinit (* ca_key);
+	g_free (ca_key);
+	if (error)
+		return error;
+
+	error = ca_file_insert_self_signed_ca (ca->ca_private_key, ca->ca_pem);
+	if (error)
+		return g_strdup (error);
+
+	cert = tls_parse_cert_pem (ca->ca_pem);
+	if (! ca_file_get_id_from_dn (CA_FILE_ELEMENT_TYPE_CERT, cert->dn, &ca->ca_id))
+		error = g_strdup (_("Cannot find parent CA in database"));
+	tls_cert_free (cert);
+
+	return error;
+}
+
+gchar * __bench_run (BenchOutput *output, const gchar *dirname, guint db_size, guint iterations,
+		     guint slow_iterations, gint key_bitlength, gboolean keep)
+{
+	BenchResult result, insert_result;
+	BenchCa ca;
+	TlsCreationData creation_data;
+	TlsCert *cert;
+	UInt160 serial;
+	GArray *ids;
+	GList *revoked_certs;
+	gchar *filename;
+	gchar *basename;
+	gchar *certificate = NULL;
+	gchar *crl;
+	gchar *cn;
+	gchar *error = NULL;
+	gchar *import_filename;
+	gchar *dn;
+	guint64 id;
+	guint count;
+	guint i;
+	gint64 start;
+	time_t now;
+
+	basename = g_strdup_printf ("gnomint-bench-%u.gnomint", db_size);
+	filename = g_build_filename (dirname, basename, NULL);
+	g_free (basename);
+	g_unlink (filename);
+
+	if (! ca_file_open (g_strdup (filename), TRUE)) {
+		g_free (filename);
+		return g_strdup (_("Couldn't create the benchmark database"));
+	}
+
+	memset (&ca, 0, sizeof (BenchCa));
+	error = __bench_create_ca (&ca, key_bitlength);
+	if (error)
+		goto end;
+
+	__bench_fill_creation_data (&creation_data, "leaf", key_bitlength, 12);
+	error = tls_generate_keys (&creation_data, &ca.leaf_private_key, &ca.leaf_key);
+	if (error)
+		goto end;
+
+	// Populating the database measures signing and insertion of every certificate
+	__bench_result_init (&result, "tls_generate_certificate", db_size);
+	__bench_result_init (&insert_result, "ca_file_insert_cert", db_size);
+	for (i = 0; i < db_size; i++) {
+		ca_file_get_next_serial (&serial, ca.ca_id);
+		cn = g_strdup_printf ("bench-%u.example.com", i);
+		error = __bench_sign (&ca, cn, &serial, key_bitlength, &certificate, &result);
+		g_free (cn);
+		if (error)
+			goto end;
+
+		start = g_get_monotonic_time ();
+		error = ca_file_insert_cert (FALSE, TRUE, ca.leaf_private_key, certificate);
+		if (error) {
+			error = g_strdup (error);
+			goto end;
+		}
+		__bench_result_add (&insert_result, start);
+
+		g_free (certificate);
+		certificate = NULL;
+	}
+	__bench_result_write (output, &result);
+	__bench_result_write (output, &insert_result);
+
+	// Parsing
+	__bench_result_init (&result, "tls_parse_cert_pem", db_size);
+	for (i = 0; i < iterations; i++) {
+		start = g_get_monotonic_time ();
+		cert = tls_parse_cert_pem (ca.ca_pem);
+		__bench_result_add (&result, start);
+		tls_cert_free (cert);
+	}
+	__bench_result_write (output, &result);
+
+	// Full listing
+	__bench_result_init (&result, "ca_file_foreach_crt", db_size);
+	for (i = 0; i < iterations; i++) {
+		count = 0;
+		start = g_get_monotonic_time ();
+		ca_file_foreach_crt (__bench_count_cb, TRUE, &count);
+		__bench_result_add (&result, start);
+	}
+	__bench_result_write (output, &result);
+
+	// CRL with one of each ten certificates revoked
+	ids = g_array_new (FALSE, FALSE, sizeof (guint64));
+	ca_file_foreach_crt (__bench_collect_ids_cb, TRUE, ids);
+	for (i = 0; i < ids->len; i += 10) {
+		error = ca_file_revoke_crt (g_array_index (ids, guint64, i));
+		if (error) {
+			g_array_free (ids, TRUE);
+			error = g_strdup (error);
+			goto end;
+		}
+	}
+	g_array_free (ids, TRUE);
+
+	revoked_certs = ca_file_get_revoked_certs (ca.ca_id, &error);
+	if (error)
+		goto end;
+
+	__bench_result_init (&result, "tls_generate_crl", db_size);
+	for (i = 0; i < iterations; i++) {
+		now = time (NULL);
+		start = g_get_monotonic_time ();
+		crl = tls_generate_crl (revoked_certs, (guchar *) ca.ca_pem, (guchar *) ca.ca_private_key, i + 1, now, now + 3600);
+		__bench_result_add (&result, start);
+		g_free (crl);
+	}
+	__bench_result_write (output, &result);
+	g_list_foreach (revoked_certs, (GFunc) g_free, NULL);
+	g_list_free (revoked_certs);
+
+	// Importing certificates that are not in the database yet
+	__bench_result_init (&result, "import_single_file", db_size);
+	import_filename = g_build_filename (dirname, "gnomint-bench-import.pem", NULL);
+	for (i = 0; i < iterations; i++) {
+		cn = g_strdup_printf ("bench-import-%u.example.com", i);
+		uint160_assign (&serial, BENCH_IMPORT_SERIAL_BASE + i);
+		error = __bench_sign (&ca, cn, &serial, key_bitlength, &certificate, NULL);
+		g_free (cn);
+		if (error || ! g_file_set_contents (import_filename, certificate, -1, NULL)) {
+			if (! error)
+				error = g_strdup (_("Couldn't write the certificate to import"));
+			g_free (import_filename);
+			goto end;
+		}
+		g_free (certificate);
+		certificate = NULL;
+
+		dn = NULL;
+		start = g_get_monotonic_time ();
+		import_single_file (import_filename, &dn, &id);
+		__bench_result_add (&result, start);
+		g_free (dn);
+	}
+	g_unlink (import_filename);
+	g_free (import_filename);
+	__bench_result_write (output, &result);
+
+	// Ciphering every private key, and changing the password afterwards
+	__bench_result_init (&result, "ca_file_password_protect", db_size);
+	start = g_get_monotonic_time ();
+	if (! ca_file_password_protect (BENCH_PASSWORD)) {
+		error = g_strdup (_("Error while changing database password. The operation was cancelled."));
+		goto end;
+	}
+	__bench_result_add (&result, start);
+	__bench_result_write (output, &result);
+
+	__bench_result_init (&result, "ca_file_password_change", db_size);
+	for (i = 0; i < slow_iterations; i++) {
+		start = g_get_monotonic_time ();
+		if (! ca_file_password_change (i % 2 ? BENCH_PASSWORD "-new" : BENCH_PASSWORD,
+					       i % 2 ? BENCH_PASSWORD : BENCH_PASSWORD "-new")) {
+			error = g_strdup (_("Error while changing database password. The operation was cancelled."));
+			goto end;
+		}
+		__bench_result_add (&result, start);
+	}
+	__bench_result_write (output, &result);
+
+ end:
+	g_free (certificate);
+	g_free (ca.ca_pem);
+	g_free (ca.ca_private_key);
+	g_free (ca.leaf_private_key);
+	if (ca.leaf_key) {
+		gnutls_x509_privkey_deinit (* ca.leaf_key);
+		g_free (ca.leaf_key);
+	}
+
+	ca_file_close ();
+	if (! keep)
+		g_unlink (filename);
+	g_free (filename);
+
+	return error;
+}
+
+
+int main (int argc, char **argv)
+{
+	GOptionContext *ctx;
+	GError *err = NULL;
+	BenchOutput output;
+	BenchResult result;
+	TlsCreationData creation_data;
+	gnutls_x509_privkey_t *key;
+	gchar *private_key;
+	gchar *sizes_str = NULL;
+	gchar *format = NULL;
+	gchar *dirname = NULL;
+	gchar **sizes;
+	gchar *error;
+	gint iterations = 20;
+	gint slow_iterations = 3;
+	gint key_bitlength = 2048;
+	gboolean keep = FALSE;
+	gint64 start;
+	gint i;
+	GOptionEntry entries[] = {
+		{ "sizes", 'n', 0, G_OPTION_ARG_STRING, &sizes_str,
+		  N_("Comma-separated numbers of certificates of the benchmark databases (default: 100,1000)"), N_("N,...") },
+		{ "iterations", 'i', 0, G_OPTION_ARG_INT, &iterations,
+		  N_("Times each fast operation is repeated (default: 20)"), N_("N") },
+		{ "slow-iterations", 's', 0, G_OPTION_ARG_INT, &slow_iterations,
+		  N_("Times key generation and password change are repeated (default: 3)"), N_("N") },
+		{ "bits", 'b', 0, G_OPTION_ARG_INT, &key_bitlength,
+		  N_("Bit-length of the RSA keys (default: 2048)"), N_("N") },
+		{ "format", 'f', 0, G_OPTION_ARG_STRING, &format,
+		  N_("Output format: jsonl (default) or csv"), N_("FORMAT") },
+		{ "dir", 'd', 0, G_OPTION_ARG_FILENAME, &dirname,
+		  N_("Directory for the benchmark databases (default: the temporary directory)"), N_("DIR") },
+		{ "keep", 'k', 0, G_OPTION_ARG_NONE, &keep,
+		  N_("Don't remove the benchmark databases"), NULL },
+		{ NULL }
+	};
+
+	g_set_application_name (PACKAGE);
+	g_set_prgname ("gnomint-bench");
+
+	tls_init ();
+
+	preferences_init (argc, argv);
+
+	ctx = g_option_context_new (_("- Benchmark of gnoMint operations"));
+	g_option_context_add_main_entries (ctx, entries, GETTEXT_PACKAGE);
+	if (!g_option_context_parse (ctx, &argc, &argv, &err)) {
+		g_print (_("Failed to initialize: %s\n"), err->message);
+		g_error_free (err);
+		return 1;
+	}
+
+	if (format && strcmp (format, "jsonl") && strcmp (format, "csv")) {
+		fprintf (stderr, _("Unknown format '%s'. Valid formats are jsonl and csv.\n"), format);
+		return 1;
+	}
+
+	output.csv = (format && ! strcmp (format, "csv"));
+	output.header_written = FALSE;
+
+	dialog_set_batch_mode (TRUE, NULL);
+	dialog_establish_refresh_function (__bench_refresh);
+
+	// Key generation doesn't depend on the database, so it is measured only once
+	__bench_fill_creation_data (&creation_data, "keys", key_bitlength, 12);
+	__bench_result_init (&result, "tls_generate_keys", 0);
+	for (i = 0; i < slow_iterations; i++) {
+		private_key = NULL;
+		key = NULL;
+		start = g_get_monotonic_time ();
+		error = tls_generate_keys (&creation_data, &private_key, &key);
+		if (error) {
+			fprintf (stderr, "%s\n", error);
+			return 1;
+		}
+		__bench_result_add (&result, start);
+		gnutls_x509_privkey_deinit (* key);
+		g_free (key);
+		g_free (private_key);
+	}
+	__bench_result_write (&output, &result);
+
+	sizes = g_strsplit (sizes_str ? sizes_str : "100,1000", ",", -1);
+	for (i = 0; sizes[i]; i++) {
+		error = __bench_run (&output, dirname ? dirname : g_get_tmp_dir (), atoi (sizes[i]), iterations,
+				     slow_iterations, key_bitlength, keep);
+		if (error) {
+			fprintf (stderr, "%s\n", error);
+			g_strfreev (sizes);
+			return 1;
+		}
+	}
+	g_strfreev (sizes);
+
+	return 0;
+}
@@ -20,11 +20,15 @@
 #include <glib.h>
 #include <glib/gi18n.h>
 #include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
 
 #include "tls.h"
 #include "ca_file.h"
 #include "ca-cli.h"
+#include "dialog.h"
 #include "preferences.h"
+#include "stats.h"
 
 gchar * gnomint_current_opened_file = NULL;
 
@@ -33,7 +37,30 @@ int main (int argc, char **argv)
         gchar *defaultfile = NULL;
 	GOptionContext *ctx;
 	GError *err = NULL;
+	gboolean batch = FALSE;
+	gboolean assume_yes = FALSE;
+	gboolean stop_on_error = FALSE;
+	gboolean show_stats = FALSE;
+	gchar *script_filename = NULL;
+	gchar *password_filename = NULL;
+	gchar *password = NULL;
+	gchar **attached_filenames = NULL;
+	gint i;
 	GOptionEntry entries[] = {
+		{ "batch", 'b', 0, G_OPTION_ARG_NONE, &batch, 
+		  N_("Execute the commands read from standard input, without asking anything"), NULL },
+		{ "script", 's', 0, G_OPTION_ARG_FILENAME, &script_filename, 
+		  N_("Execute the commands in the given file, without asking anything"), N_("FILE") },
+		{ "yes", 'y', 0, G_OPTION_ARG_NONE, &assume_yes, 
+		  N_("In batch mode, confirm overwriting files and revoking certificates"), NULL },
+		{ "password-file", 'p', 0, G_OPTION_ARG_FILENAME, &password_filename, 
+		  N_("In batch mode, read the password from the first line of the given file"), N_("FILE") },
+		{ "stop-on-error", 'e', 0, G_OPTION_ARG_NONE, &stop_on_error, 
+		  N_("In batch mode, stop at the first command that fails"), NULL },
+		{ "attach", 'a', 0, G_OPTION_ARG_FILENAME_ARRAY, &attached_filenames, 
+		  N_("Attach the given database, for running commands over several ones with 'foreachdb'"), N_("FILE") },
+		{ "stats", 0, 0, G_OPTION_ARG_NONE, &show_stats, 
+		  N_("On exit, write to standard error how many times each operation was done and how long it took"), NULL },
 		{ NULL }
 	};
 	
@@ -52,6 +79,7 @@ int main (int argc, char **argv)
 	tls_init ();
 
         preferences_init (argc, argv);
+	ca_file_set_slow_query_threshold (preferences_get_slow_query_threshold ());
 
 	ctx = g_option_context_new (_("- A Certification Authority manager"));
 	g_option_context_add_main_entries (ctx, entries, GETTEXT_PACKAGE);
@@ -60,16 +88,50 @@ int main (int argc, char **argv)
 		g_error_free (err);
 		return 1;
 	}
+
+	stats_init ();
+	if (show_stats)
+		stats_set_dump_on_exit (TRUE);
 	
+	if (script_filename)
+		batch = TRUE;
+
+	if (batch) {
+		if (password_filename) {
+			if (! g_file_get_contents (password_filename, &password, NULL, &err)) {
+				fprintf (stderr, _("Couldn't read password file: %s\n"), err->message);
+				g_error_free (err);
+				return 1;
+			}
+			password[strcspn (password, "\r\n")] = '\0';
+		}
+		dialog_set_batch_mode (assume_yes, password);
+		if (password) {
+			memset (password, 0, strlen (password));
+			g_free (password);
+		}
+	}
         
 	if (argc >= 2 && ca_open (g_strdup(argv[1]), TRUE)) {
 
+        } else if (batch && argc >= 2) {
+                /* Don't run a script against a database different from the given one */
+                return 1;
         } else {
                 /* No arguments, or failure when opening file */
                 defaultfile = g_build_filename (g_get_home_dir(), ".gnomint", "default.gnomint", NULL);
                 ca_open (defaultfile, TRUE);
         }
 
+        for (i = 0; attached_filenames && attached_filenames[i]; i++) {
+                if (! ca_attach (attached_filenames[i]) && batch)
+                        return 1;
+        }
+        g_strfreev (attached_filenames);
+
+        if (batch)
+                return ca_command_batch (script_filename, stop_on_error);
+
         ca_command_line ();
 
 	return 0;
@@ -0,0 +1,585 @@
+//  gnoMint: a graphical interface for managing a certification authority
+//  Copyright (C) 2006-2009 David Marín Carreño <davefx@gmail.com>
+//
+//  This file is part of gnoMint.
+//
+//  gnoMint is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+// Generator of synthetic databases, for scale testing: a root CA, some intermediate CAs and
+// any number of end-entity certificates (some of them revoked or expired) and CSRs.
+// Certificates are signed in several threads and saved in groups, one transaction each.
+// Build it with "make gnomint-gendb" in src/.
+
+#include <glib.h>
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "tls.h"
+#include "ca_file.h"
+#include "dialog.h"
+#include "preferences.h"
+
+#define GENDB_GROUP_SIZE 1000
+#define GENDB_DAY (24 * 3600)
+
+gchar * gnomint_current_opened_file = NULL;
+
+typedef struct {
+	gchar *pem;
+	gchar *private_key;
+	guint64 id;
+	UInt160 next_serial;
+} GenDbCa;
+
+typedef struct {
+	gint key_type;
+	gint key_bitlength;
+	GPtrArray *keys;              // PEM private keys, shared by all the leaves
+	GPtrArray *key_filenames;     // With --external-keys, the files where they are saved
+	GenDbCa *issuers;
+	guint issuers_number;
+} GenDb;
+
+typedef struct {
+	GenDb *gen;
+	GAsyncQueue *done;
+	guint index;
+	gboolean is_csr;
+	GenDbCa *issuer;
+	UInt160 serial;
+	time_t activation;
+	time_t expiration;
+	time_t revocation;
+	guint key;
+	gchar *pem;
+	gchar *error;
+} GenDbJob;
+
+void __gendb_fill_creation_data (TlsCreationData *creation_data, gchar *cn, gint key_type, gint key_bitlength);
+gchar * __gendb_create_root (GenDbCa *root, gint key_type, gint key_bitlength);
+gchar * __gendb_create_intermediate (GenDbCa *ca, GenDbCa *root, guint number, gint key_type, gint key_bitlength);
+gchar * __gendb_create_keys (GenDb *gen, guint number, const gchar *external_dir);
+void __gendb_worker (gpointer data, gpointer user_data);
+GenDbJob * __gendb_group_launch (GenDb *gen, GThreadPool *pool, GRand *rand, guint first, guint number, gboolean is_csr,
+				 gdouble revoked_ratio, gdouble expired_ratio);
+gint __gendb_group_save (GenDb *gen, GenDbJob *jobs, guint number, gboolean is_csr, gboolean external_keys);
+gchar * __gendb_run (GenDb *gen, guint threads, GRand *rand, guint total, gboolean is_csr,
+		     gdouble revoked_ratio, gdouble expired_ratio, gboolean external_keys);
+
+
+void __gendb_fill_creation_data (TlsCreationData *creation_data, gchar *cn, gint key_type, gint key_bitlength)
+{
+	memset (creation_data, 0, sizeof (TlsCreationData));
+
+	creation_data->country = "ES";
+	creation_data->org = "gnoMint synthetic database";
+	creation_data->cn = cn;
+	creation_data->key_type = key_type;
+	creation_data->key_bitlength = key_bitlength;
+}
+
+gchar * __gendb_create_root (GenDbCa *root, gint key_type, gint key_bitlength)
+{
+	TlsCreationData creation_data;
+	gnutls_x509_privkey_t *key = NULL;
+	TlsCert *cert;
+	gchar *error;
+
+	__gendb_fill_creation_data (&creation_data, (gchar *) "gnoMint synthetic root CA", key_type, key_bitlength);
+	creation_data.key_months_before_expiration = 240;
+	creation_data.activation = time (NULL) - 5 * 365 * GENDB_DAY;
+	creation_data.expiration = creation_data.activation + 20 * 365 * GENDB_DAY;
+
+	error = tls_generate_keys (&creation_data, &root->private_key, &key);
+	if (error)
+		return error;
+
+	error = tls_generate_self_signed_certificate (&creation_data, key, &root->pem);
+	gnutls_x509_privkey_deinit (* key);
+	g_free (key);
+	if (error)
+		return error;
+
+	error = ca_file_insert_self_signed_ca (root->private_key, root->pem);
+	if (error)
+		return g_strdup (error);
+
+	cert = tls_parse_cert_pem (root->pem);
+	if (! ca_file_get_id_from_dn (CA_FILE_ELEMENT_TYPE_CERT, cert->dn, &root->id))
+		error = g_strdup (_("Cannot find parent CA in database"));
+	tls_cert_free (cert);
+
+	ca_file_get_next_serial (&root->next_serial, root->id);
+
+	return error;
+}
+
+gchar * __gendb_create_intermediate (GenDbCa *ca, GenDbCa *root, guint number, gint key_type, gint key_bitlength)
+{
+	TlsCreationData creation_data;
+	TlsCertCreationData cert_creation_data;
+	gnutls_x509_privkey_t *key = NULL;
+	TlsCert *cert;
+	gchar *csr = NULL;
+	gchar *cn;
+	gchar *error;
+
+	cn = g_strdup_printf ("gnoMint synthetic intermediate CA %u", number);
+	__gendb_fill_creation_data (&creation_data, cn, key_type, key_bitlength);
+
+	error = tls_generate_keys (&creation_data, &ca->private_key, &key);
+	if (! error)
+		error = tls_generate_csr (&creation_data, key, &csr);
+	g_free (cn);
+	if (key) {
+		gnutls_x509_privkey_deinit (* key);
+		g_free (key);
+	}
+	if (error)
+		return error;
+
+	memset (&cert_creation_data, 0, sizeof (TlsCertCreationData));
+	cert_creation_data.activation = time (NULL) - 4 * 365 * GENDB_DAY;
+	cert_creation_data.expiration = cert_creation_data.activation + 15 * 365 * GENDB_DAY;
+	cert_creation_data.ca = TRUE;
+	cert_creation_data.crl_signing = TRUE;
+	cert_creation_data.digital_signature = TRUE;
+	cert_creation_data.serial = root->next_serial;
+
+	error = tls_generate_certificate (&cert_creation_data, csr, root->pem, root->private_key, &ca->pem);
+	g_free (csr);
+	if (error)
+		return error;
+
+	error = ca_file_insert_cert (TRUE, TRUE, ca->private_key, ca->pem);
+	if (error)
+		return g_strdup (error);
+	uint160_inc (&root->next_serial);
+
+	cert = tls_parse_cert_pem (ca->pem);
+	if (! ca_file_get_id_from_dn (CA_FILE_ELEMENT_TYPE_CERT, cert->dn, &ca->id))
+		error = g_strdup (_("Cannot find parent CA in database"));
+	tls_cert_free (cert);
+
+	ca_file_get_next_serial (&ca->next_serial, ca->id);
+
+	return error;
+}
+
+// Leaves share a few keys, as generating a key for each one would take much longer than signing it
+gchar * __gendb_create_keys (GenDb *gen, guint number, const gchar *external_dir)
+{
+	TlsCreationData creation_data;
+	gnutls_x509_privkey_t *key;
+	gchar *private_key;
+	gchar *filename;
+	gchar *basename;
+	gchar *error;
+	guint i;
+
+	__gendb_fill_creation_data (&creation_data, NULL, gen->key_type, gen->key_bitlength);
+
+	if (external_dir && g_mkdir_with_parents (external_dir, 0700) == -1)
+		return g_strdup_printf (_("Couldn't create the directory %s"), external_dir);
+
+	for (i = 0; i < number; i++) {
+		private_key = NULL;
+		key = NULL;
+		error = tls_generate_keys (&creation_data, &private_key, &key);
+		if (error)
+			return error;
+		gnutls_x509_privkey_deinit (* key);
+		g_free (key);
+
+		g_ptr_array_add (gen->keys, private_key);
+
+		if (external_dir) {
+			basename = g_strdup_printf ("key-%u.pem", i);
+			filename = g_build_filename (external_dir, basename, NULL);
+			g_free (basename);
+			if (! g_file_set_contents (filename, private_key, -1, NULL)) {
+				error = g_strdup_printf (_("Couldn't write the file %s"), filename);
+				g_free (filename);
+				return error;
+			}
+			g_ptr_array_add (gen->key_filenames, filename);
+		}
+	}
+
+	return NULL;
+}
+
+void __gendb_worker (gpointer data, gpointer user_data)
+{
+	GenDbJob *job = (GenDbJob *) data;
+	TlsCreationData creation_data;
+	TlsCertCreationData cert_creation_data;
+	gnutls_x509_privkey_t *key = NULL;
+	gchar *cn;
+	gchar *csr = NULL;
+
+	cn = g_strdup_printf ("%s%u.synthetic.example.com", job->is_csr ? "csr" : "host", job->index);
+	__gendb_fill_creation_data (&creation_data, cn, job->gen->key_type, job->gen->key_bitlength);
+
+	job->error = tls_load_private_key (g_ptr_array_index (job->gen->keys, job->key), &key);
+	if (! job->error)
+		job->error = tls_generate_csr (&creation_data, key, &csr);
+	g_free (cn);
+	if (key) {
+		gnutls_x509_privkey_deinit (* key);
+		g_free (key);
+	}
+
+	if (job->error || job->is_csr) {
+		job->pem = csr;
+		g_async_queue_push (job->done, job);
+		return;
+	}
+
+	memset (&cert_creation_data, 0, sizeof (TlsCertCreationData));
+	cert_creation_data.activation = job->activation;
+	cert_creation_data.expiration = job->expiration;
+	cert_creation_data.digital_signature = TRUE;
+	cert_creation_data.key_encipherment = TRUE;
+	cert_creation_data.web_server = TRUE;
+	cert_creation_data.web_client = TRUE;
+	cert_creation_data.serial = job->serial;
+
+	job->error = tls_generate_certificate (&cert_creation_data, csr, job->issuer->pem, job->issuer->private_key, &job->pem);
+	g_free (csr);
+
+	g_async_queue_push (job->done, job);
+}
+
+// Decides the issuer, serial and dates of each certificate of the group, and starts signing them
+GenDbJob * __gendb_group_launch (GenDb *gen, GThreadPool *pool, GRand *rand, guint first, guint number, gboolean is_csr,
+				 gdouble revoked_ratio, gdouble expired_ratio)
+{
+	GenDbJob *jobs = g_new0 (GenDbJob, number);
+	GAsyncQueue *done = g_async_queue_new ();
+	time_t now = time (NULL);
+	time_t until;
+	guint i;
+
+	for (i = 0; i < number; i++) {
+		GenDbJob *job = &jobs[i];
+
+		job->gen = gen;
+		job->done = done;
+		job->index = first + i;
+		job->is_csr = is_csr;
+		job->key = job->index % gen->keys->len;
+
+		if (! is_csr) {
+			job->issuer = &gen->issuers[job->index % gen->issuers_number];
+			job->serial = job->issuer->next_serial;
+			uint160_inc (&job->issuer->next_serial);
+
+			if (g_rand_double (rand) < expired_ratio) {
+				job->expiration = now - g_rand_int_range (rand, 1, 3 * 365) * GENDB_DAY;
+				job->activation = job->expiration - 365 * GENDB_DAY;
+			} else {
+				job->activation = now - g_rand_int_range (rand, 0, 365) * GENDB_DAY;
+				job->expiration = job->activation + 2 * 365 * GENDB_DAY;
+			}
+
+			if (g_rand_double (rand) < revoked_ratio) {
+				until = MIN (now, job->expiration);
+				job->revocation = job->activation + g_rand_int_range (rand, 0, (until - job->activation) / GENDB_DAY + 1) * GENDB_DAY;
+			}
+		}
+
+		g_thread_pool_push (pool, job, NULL);
+	}
+
+	return jobs;
+}
+
+// Waits for the signatures of the group and saves it, in a single transaction
+gint __gendb_group_save (GenDb *gen, GenDbJob *jobs, guint number, gboolean is_csr, gboolean external_keys)
+{
+	GAsyncQueue *done = jobs[0].done;
+	gchar **pems = g_new0 (gchar *, number);
+	gchar **private_keys = g_new0 (gchar *, number);
+	gchar **parents = g_new0 (gchar *, number);
+	gchar **errors = g_new0 (gchar *, number);
+	time_t *revocations = g_new0 (time_t, number);
+	guint valid = 0;
+	gint saved;
+	guint i;
+
+	for (i = 0; i < number; i++)
+		g_async_queue_pop (done);
+	g_async_queue_unref (done);
+
+	// Failed jobs are reported and left out, without changing the order of the others
+	for (i = 0; i < number; i++) {
+		if (jobs[i].error) {
+			fprintf (stderr, "%u: %s\n", jobs[i].index, jobs[i].error);
+			continue;
+		}
+		pems[valid] = jobs[i].pem;
+		// External keys of CSRs are not recorded (ca_file_insert_csrs only saves keys in the database)
+		if (! external_keys)
+			private_keys[valid] = g_ptr_array_index (gen->keys, jobs[i].key);
+		else if (! is_csr)
+			private_keys[valid] = g_ptr_array_index (gen->key_filenames, jobs[i].key);
+		revocations[valid] = jobs[i].revocation;
+		valid ++;
+	}
+
+	if (is_csr)
+		saved = ca_file_insert_csrs (valid, private_keys, pems, parents, errors);
+	else
+		saved = ca_file_insert_certs (valid, ! external_keys, private_keys, pems, revocations, errors);
+
+	for (i = 0; i < valid; i++) {
+		if (errors[i] && saved >= 0)
+			fprintf (stderr, "%s\n", errors[i]);
+		g_free (errors[i]);
+	}
+	if (saved < 0 && valid)
+		fprintf (stderr, "%s\n", errors[0] ? errors[0] : "");
+
+	for (i = 0; i < number; i++) {
+		g_free (jobs[i].pem);
+		g_free (jobs[i].error);
+	}
+	g_free (jobs);
+	g_free (pems);
+	g_free (private_keys);
+	g_free (parents);
+	g_free (errors);
+	g_free (revocations);
+
+	return saved;
+}
+
+gchar * __gendb_run (GenDb *gen, guint threads, GRand *rand, guint total, gboolean is_csr,
+		     gdouble revoked_ratio, gdouble expired_ratio, gboolean external_keys)
+{
+	GThreadPool *pool;
+	GenDbJob *group, *next;
+	guint first = 0, number, next_number;
+	guint saved = 0;
+	gint res;
+
+	if (total == 0)
+		return NULL;
+
+	pool = g_thread_pool_new (__gendb_worker, NULL, threads, FALSE, NULL);
+
+	// While a group is being saved, the next one is already being signed
+	number = MIN (GENDB_GROUP_SIZE, total);
+	group = __gendb_group_launch (gen, pool, rand, first, number, is_csr, revoked_ratio, expired_ratio);
+
+	while (group) {
+		next = NULL;
+		next_number = MIN (GENDB_GROUP_SIZE, total - first - number);
+		if (next_number)
+			next = __gendb_group_launch (gen, pool, rand, first + number, next_number, is_csr,
+						     revoked_ratio, expired_ratio);
+
+		res = __gendb_group_save (gen, group, number, is_csr, external_keys);
+		if (res < 0) {
+			g_thread_pool_free (pool, FALSE, TRUE);
+			return g_strdup (_("Couldn't save the generated elements in the database"));
+		}
+		saved += res;
+		fprintf (stderr, is_csr ? _("\r%u of %u CSRs saved") : _("\r%u of %u certificates saved"), saved, total);
+
+		first += number;
+		number = next_number;
+		group = next;
+	}
+	fprintf (stderr, "\n");
+
+	g_thread_pool_free (pool, FALSE, TRUE);
+
+	return NULL;
+}
+
+
+int main (int argc, char **argv)
+{
+	GOptionContext *ctx;
+	GError *err = NULL;
+	GenDb gen;
+	GRand *rand;
+	gchar *filename;
+	gchar *external_dir = NULL;
+	gchar *key_type_name = NULL;
+	gchar *password = NULL;
+	gchar *error = NULL;
+	gint intermediates = 2;
+	gint certs = 1000;
+	gint csrs = 0;
+	gint keys = 16;
+	gint threads = 4;
+	gint seed = 0;
+	gint key_bitlength = -1;
+	gdouble revoked_ratio = 0.05;
+	gdouble expired_ratio = 0.1;
+	gboolean external_keys = FALSE;
+	gboolean force = FALSE;
+	gint64 start;
+	guint i;
+	GOptionEntry entries[] = {
+		{ "intermediates", 'i', 0, G_OPTION_ARG_INT, &intermediates,
+		  N_("Number of intermediate CAs, which sign all the certificates (default: 2; 0 = the root one)"), N_("N") },
+		{ "certs", 'c', 0, G_OPTION_ARG_INT, &certs,
+		  N_("Number of end-entity certificates (default: 1000)"), N_("N") },
+		{ "revoked", 'r', 0, G_OPTION_ARG_DOUBLE, &revoked_ratio,
+		  N_("Ratio of revoked certificates (default: 0.05)"), N_("RATIO") },
+		{ "expired", 'e', 0, G_OPTION_ARG_DOUBLE, &expired_ratio,
+		  N_("Ratio of expired certificates (default: 0.1)"), N_("RATIO") },
+		{ "csrs", 'q', 0, G_OPTION_ARG_INT, &csrs,
+		  N_("Number of CSRs (default: 0)"), N_("N") },
+		{ "key", 'k', 0, G_OPTION_ARG_STRING, &key_type_name,
+		  N_("Type of the keys: rsa, dsa, ecdsa or ed25519 (default: ecdsa if supported, rsa otherwise)"), N_("TYPE") },
+		{ "bits", 'b', 0, G_OPTION_ARG_INT, &key_bitlength,
+		  N_("Bit-length of the keys (default: 2048 for RSA and DSA, 256 for elliptic curves)"), N_("N") },
+		{ "keys", 'n', 0, G_OPTION_ARG_INT, &keys,
+		  N_("Number of different key pairs shared by the certificates and CSRs (default: 16)"), N_("N") },
+		{ "external-keys", 'x', 0, G_OPTION_ARG_NONE, &external_keys,
+		  N_("Keep the private keys in files next to the database, instead of inside it"), NULL },
+		{ "password", 'p', 0, G_OPTION_ARG_STRING, &password,
+		  N_("Protect the database with the given password"), N_("PASSWORD") },
+		{ "threads", 't', 0, G_OPTION_ARG_INT, &threads,
+		  N_("Number of signing threads (default: 4)"), N_("N") },
+		{ "seed", 's', 0, G_OPTION_ARG_INT, &seed,
+		  N_("Seed for choosing the revoked and expired certificates, for repeatable databases"), N_("N") },
+		{ "force", 'f', 0, G_OPTION_ARG_NONE, &force,
+		  N_("Overwrite the database file if it exists"), NULL },
+		{ NULL }
+	};
+
+	g_set_application_name (PACKAGE);
+	g_set_prgname ("gnomint-gendb");
+
+	tls_init ();
+
+	preferences_init (argc, argv);
+
+	ctx = g_option_context_new (_("<database> - Generate a synthetic gnoMint database"));
+	g_option_context_add_main_entries (ctx, entries, GETTEXT_PACKAGE);
+	if (!g_option_context_parse (ctx, &argc, &argv, &err)) {
+		g_print (_("Failed to initialize: %s\n"), err->message);
+		g_error_free (err);
+		return 1;
+	}
+
+	if (argc != 2 || intermediates < 0 || certs < 0 || csrs < 0 || keys < 1 || threads < 1 ||
+	    revoked_ratio < 0 || revoked_ratio > 1 || expired_ratio < 0 || expired_ratio > 1) {
+		gchar *help = g_option_context_get_help (ctx, TRUE, NULL);
+		fprintf (stderr, "%s", help);
+		g_free (help);
+		return 1;
+	}
+	filename = argv[1];
+
+	memset (&gen, 0, sizeof (GenDb));
+#ifdef ECC_GNUTLS
+	gen.key_type = TLS_KEY_TYPE_ECDSA;
+#else
+	gen.key_type = TLS_KEY_TYPE_RSA;
+#endif
+	if (key_type_name) {
+		gen.key_type = tls_key_type_from_name (key_type_name);
+		if (gen.key_type < 0) {
+			fprintf (stderr, "%s\n", _("The key type must be 'rsa', 'dsa', 'ecdsa' or 'ed25519'"));
+			return 1;
+		}
+	}
+	if (key_bitlength < 0)
+		key_bitlength = (gen.key_type == TLS_KEY_TYPE_RSA || gen.key_type == TLS_KEY_TYPE_DSA) ? 2048 : 256;
+	if (! tls_key_type_check_bitlength (gen.key_type, key_bitlength)) {
+		fprintf (stderr, "%s\n", _("The bit-length is not valid for the given key type"));
+		return 1;
+	}
+	gen.key_bitlength = key_bitlength;
+
+	if (g_file_test (filename, G_FILE_TEST_EXISTS)) {
+		if (! force) {
+			fprintf (stderr, _("The file %s already exists. Use --force for overwriting it.\n"), filename);
+			return 1;
+		}
+		g_unlink (filename);
+	}
+
+	dialog_set_batch_mode (TRUE, NULL);
+
+	if (! ca_file_open (g_strdup (filename), TRUE)) {
+		fprintf (stderr, _("Couldn't create the database %s\n"), filename);
+		return 1;
+	}
+
+	start = g_get_monotonic_time ();
+	rand = g_rand_new_with_seed (seed);
+
+	// The first issuers are the intermediate CAs, which sign all the certificates, and the last one
+	// is the root CA (which signs them if there are no intermediate ones)
+	gen.issuers_number = MAX (intermediates, 1);
+	gen.issuers = g_new0 (GenDbCa, intermediates + 1);
+	error = __gendb_create_root (&gen.issuers[intermediates], gen.key_type, gen.key_bitlength);
+	for (i = 0; ! error && i < (guint) intermediates; i++)
+		error = __gendb_create_intermediate (&gen.issuers[i], &gen.issuers[intermediates], i + 1,
+						     gen.key_type, gen.key_bitlength);
+
+	gen.keys = g_ptr_array_new_with_free_func (g_free);
+	gen.key_filenames = g_ptr_array_new_with_free_func (g_free);
+	if (! error) {
+		if (external_keys)
+			external_dir = g_strdup_printf ("%s.keys", filename);
+		error = __gendb_create_keys (&gen, MIN (keys, MAX (certs + csrs, 1)), external_dir);
+	}
+
+	if (! error)
+		error = __gendb_run (&gen, threads, rand, certs, FALSE, revoked_ratio, expired_ratio, external_keys);
+	if (! error)
+		error = __gendb_run (&gen, threads, rand, csrs, TRUE, 0, 0, external_keys);
+
+	if (! error && password) {
+		fprintf (stderr, "%s\n", _("Ciphering the private keys with the password..."));
+		if (! ca_file_password_protect (password))
+			error = g_strdup (_("Error while changing database password. The operation was cancelled."));
+	}
+
+	ca_file_close ();
+
+	for (i = 0; i <= (guint) intermediates; i++) {
+		g_free (gen.issuers[i].pem);
+		g_free (gen.issuers[i].private_key);
+	}
+	g_free (gen.issuers);
+	g_ptr_array_free (gen.keys, TRUE);
+	g_ptr_array_free (gen.key_filenames, TRUE);
+	g_free (external_dir);
+	g_rand_free (rand);
+
+	if (error) {
+		fprintf (stderr, "%s\n", error);
+		return 1;
+	}
+
+	fprintf (stderr, _("Database %s generated in %.1f seconds\n"), filename,
+		 (g_get_monotonic_time () - start) / 1000000.0);
+
+	return 0;
+}
@@ -0,0 +1,232 @@
+//  gnoMint: a graphical interface for managing a certification authority
+//  Copyright (C) 2006-2009 David Marín Carreño <davefx@gmail.com>
+//
+//  This file is part of gnoMint.
+//
+//  gnoMint is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 3 of the License, or   
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of 
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the  
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "key_pool.h"
+#include "ca_file.h"
+#include "tls.h"
+#include "pkey_manage.h"
+
+#include <glib/gi18n.h>
+
+// Pooled keys don't belong to any DN yet, so this one is used for ciphering them
+#define KEY_POOL_DN "gnoMintKeyPool"
+
+typedef struct {
+	gint key_type;
+	gint key_bitlength;
+	gint missing;
+} KeyPoolSize;
+
+// The refilling thread of a CaFile
+typedef struct {
+	CaFile *ca_file;
+	GThread *thread;
+	gint running;
+	gint cancelled;
+	gchar *password;
+} KeyPool;
+
+static GMutex key_pool_mutex;
+static GHashTable *key_pool_pools = NULL;    // CaFile * -> KeyPool *
+
+int __key_pool_missing_cb (void *pArg, int argc, char **argv, char **columnNames);
+gpointer __key_pool_thread (gpointer data);
+void __key_pool_join (KeyPool *pool);
+
+
+int __key_pool_missing_cb (void *pArg, int argc, char **argv, char **columnNames)
+{
+	GArray *missing = (GArray *) pArg;
+	KeyPoolSize size;
+
+	size.key_type = atoi (argv[0]);
+	size.key_bitlength = atoi (argv[1]);
+	size.missing = atoi (argv[2]) - atoi (argv[3]);
+
+	if (size.missing > 0)
+		g_array_append_val (missing, size);
+
+	return 0;
+}
+
+gpointer __key_pool_thread (gpointer data)
+{
+	TlsCreationData creation_data;
+	GArray *missing;
+	KeyPoolSize *size;
+	gnutls_x509_privkey_t *key;
+	gchar *private_key;
+	gchar *pkey;
+	gchar *error;
+	gboolean done = FALSE;
+	guint i;
+	KeyPool *pool = (KeyPool *) data;
+
+	ca_file_set_current (pool->ca_file);
+	memset (&creation_data, 0, sizeof (TlsCreationData));
+
+	while (! done && ! g_atomic_int_get (&pool->cancelled)) {
+		missing = g_array_new (FALSE, FALSE, sizeof (KeyPoolSize));
+		ca_file_foreach_key_pool_size (__key_pool_missing_cb, missing);
+		done = (missing->len == 0);
+
+		// One key for each pool in every round, so none of them waits for the others to be full
+		for (i = 0; i < missing->len && ! done && ! g_atomic_int_get (&pool->cancelled); i++) {
+			size = &g_array_index (missing, KeyPoolSize, i);
+			creation_data.key_type = size->key_type;
+			creation_data.key_bitlength = size->key_bitlength;
+			private_key = NULL;
+			key = NULL;
+
+			error = tls_generate_keys (&creation_data, &private_key, &key);
+			if (error) {
+				fprintf (stderr, "%s: %s\n", _("Key generation failed"), error);
+				g_free (error);
+				g_free (private_key);
+				g_free (key);
+				done = TRUE;
+				break;
+			}
+
+			gnutls_x509_privkey_deinit ((* key));
+			g_free (key);
+
+			pkey = pkey_manage_crypt_w_pwd (private_key, KEY_POOL_DN, pool->password);
+			memset (private_key, 0, strlen (private_key));
+			g_free (private_key);
+
+			if (! pkey || ! ca_file_key_pool_add (size->key_type, size->key_bitlength, pkey))
+				done = TRUE;
+			g_free (pkey);
+		}
+
+		g_array_free (missing, TRUE);
+	}
+
+	ca_file_release_thread_connection ();
+	g_atomic_int_set (&pool->running, FALSE);
+
+	return NULL;
+}
+
+void __key_pool_join (KeyPool *pool)
+{
+	if (pool->thread) {
+		g_thread_join (pool->thread);
+		pool->thread = NULL;
+	}
+
+	if (pool->password) {
+		memset (pool->password, 0, strlen (pool->password));
+		g_free (pool->password);
+		pool->password = NULL;
+	}
+}
+
+
+gchar * key_pool_take (gint key_type, gint key_bitlength, const gchar *password)
+{
+	PkeyManageData pkey;
+	gchar *stored;
+	gchar *res;
+
+	stored = ca_file_key_pool_take (key_type, key_bitlength);
+	if (! stored)
+		return NULL;
+
+	pkey.pkey_data = stored;
+	pkey.is_in_db = TRUE;
+	pkey.is_ciphered_with_db_pwd = ca_file_is_password_protected ();
+	pkey.external_file = NULL;
+
+	res = pkey_manage_uncrypt_w_pwd (&pkey, KEY_POOL_DN, password);
+
+	memset (stored, 0, strlen (stored));
+	g_free (stored);
+
+	return res;
+}
+
+void key_pool_refill (const gchar *password)
+{
+	CaFile *ca_file = ca_file_get_current ();
+	KeyPool *pool;
+
+	if (! ca_file)
+		return;
+
+	if (! password)
+		password = ca_file_get_unlocked_password ();
+
+	// Without the password, the new keys couldn't be ciphered
+	if (ca_file_is_password_protected () && ! password)
+		return;
+
+	g_mutex_lock (&key_pool_mutex);
+
+	if (! key_pool_pools)
+		key_pool_pools = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+	pool = g_hash_table_lookup (key_pool_pools, ca_file);
+	if (! pool) {
+		pool = g_new0 (KeyPool, 1);
+		pool->ca_file = ca_file;
+		g_hash_table_insert (key_pool_pools, ca_file, pool);
+	}
+
+	if (pool->thread && g_atomic_int_get (&pool->running)) {
+		g_mutex_unlock (&key_pool_mutex);
+		return;
+	}
+
+	__key_pool_join (pool);
+
+	pool->password = g_strdup (password);
+	g_atomic_int_set (&pool->cancelled, FALSE);
+	g_atomic_int_set (&pool->running, TRUE);
+	pool->thread = g_thread_new ("key_pool", __key_pool_thread, pool);
+
+	g_mutex_unlock (&key_pool_mutex);
+}
+
+void key_pool_stop (CaFile *ca_file)
+{
+	KeyPool *pool;
+
+	g_mutex_lock (&key_pool_mutex);
+
+	pool = (key_pool_pools ? g_hash_table_lookup (key_pool_pools, ca_file) : NULL);
+	if (pool) {
+		g_hash_table_remove (key_pool_pools, ca_file);
+		g_atomic_int_set (&pool->cancelled, TRUE);
+	}
+
+	g_mutex_unlock (&key_pool_mutex);
+
+	// The key being generated is waited for without the lock, so the pools of other files aren't stopped meanwhile
+	if (pool) {
+		__key_pool_join (pool);
+		g_free (pool);
+	}
+}
@@ -0,0 +1,42 @@
+//  gnoMint: a graphical interface for managing a certification authority
+//  Copyright (C) 2006-2009 David Marín Carreño <davefx@gmail.com>
+//
+//  This file is part of gnoMint.
+//
+//  gnoMint is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 3 of the License, or   
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of 
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the  
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#ifndef _KEY_POOL_H_
+#define _KEY_POOL_H_
+
+#include <glib.h>
+#include "ca_file.h"
+
+// The sizes of the pools are kept in each database (see ca_file_set_key_pool_size), and each
+// open database is refilled by its own thread. Pooled keys are ciphered with the database
+// password, if it is protected. Otherwise, they are kept in clear, as the private keys of
+// its certificates and CSRs are.
+
+// Takes a pre-generated key pair from the current database, as an unciphered PEM private key.
+// Returns NULL if there is none of this type and bitlength.
+gchar * key_pool_take (gint key_type, gint key_bitlength, const gchar *password);
+
+// Generates, in a background thread, the keys missing in the pools of the current database.
+// If password is NULL, the one given when opening the database is used.
+void key_pool_refill (const gchar *password);
+
+// Stops the background thread of the given database, once it finishes the key it is generating
+void key_pool_stop (CaFile *ca_file);
+
+#endif
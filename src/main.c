@@ -29,6 +29,7 @@
 #include "dialog.h"
 #include "tls.h"
 #include "ca_file.h"
+#include "stats.h"
 #include "preferences-gui.h"
 
 #define GNOMINT_MIME_TYPE "application/x-gnomint"
@@ -113,6 +114,7 @@ int main (int   argc,
 	g_set_prgname (PACKAGE);
 
 	tls_init ();
+	stats_init ();
 
 	gtk_init (&argc, &argv);
 	
@@ -120,6 +122,7 @@ int main (int   argc,
 	preferences_gui_set_revoked_visible_callback (ca_update_revoked_view);
 
         preferences_init (argc, argv);
+	ca_file_set_slow_query_threshold (preferences_get_slow_query_threshold ());
 
 	ctx = g_option_context_new (_("- A graphical Certification Authority manager"));
 	g_option_context_add_main_entries (ctx, entries, GETTEXT_PACKAGE);
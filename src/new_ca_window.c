@@ -35,6 +35,8 @@
 
 GtkBuilder * new_ca_window_gtkb = NULL;
 
+gint __new_ca_window_get_key_type (void);
+
 
 void new_ca_window_display()
 {
@@ -67,22 +69,54 @@ void new_ca_tab_activate (int tab_number)
 
 }
 
+gint __new_ca_window_get_key_type (void)
+{
+	if (gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON(gtk_builder_get_object (new_ca_window_gtkb, "dsa_radiobutton"))))
+		return TLS_KEY_TYPE_DSA;
+	if (gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON(gtk_builder_get_object (new_ca_window_gtkb, "ecdsa_radiobutton"))))
+		return TLS_KEY_TYPE_ECDSA;
+	if (gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON(gtk_builder_get_object (new_ca_window_gtkb, "ed25519_radiobutton"))))
+		return TLS_KEY_TYPE_ED25519;
+	return TLS_KEY_TYPE_RSA;
+}
+
 G_MODULE_EXPORT void on_new_ca_privkey_type_toggle (GtkToggleButton *button,
 						     gpointer        user_data)
 {
-	GtkToggleButton *rsatoggle = GTK_TOGGLE_BUTTON(gtk_builder_get_object (new_ca_window_gtkb, "rsa_radiobutton"));
 	GtkAdjustment *adj = GTK_ADJUSTMENT(gtk_builder_get_object (new_ca_window_gtkb, "adjustmentCAKeyLength"));
-	gdouble value = gtk_spin_button_get_value (GTK_SPIN_BUTTON(gtk_builder_get_object(new_ca_window_gtkb, "keylength_spinbutton")));
-
-	if (gtk_toggle_button_get_active(rsatoggle)) {
-		// RSA is active
-		gtk_adjustment_set_upper (adj, 10240);
-	} else {
-		// DSA is active
-		gtk_adjustment_set_upper (adj, 3072);
-		if (value > 3072)
-			gtk_spin_button_set_value (GTK_SPIN_BUTTON(gtk_builder_get_object(new_ca_window_gtkb, "keylength_spinbutton")), 
-						   3072);
+	GtkSpinButton *spin = GTK_SPIN_BUTTON(gtk_builder_get_object(new_ca_window_gtkb, "keylength_spinbutton"));
+	gdouble value = gtk_spin_button_get_value (spin);
+
+	// Called for the button being deactivated too
+	if (! gtk_toggle_button_get_active (button))
+		return;
+
+	switch (__new_ca_window_get_key_type ()) {
+	case TLS_KEY_TYPE_ECDSA:
+		// Curve size: P-256 or P-384
+		gtk_adjustment_set_lower (adj, 256);
+		gtk_adjustment_set_upper (adj, 384);
+		gtk_adjustment_set_step_increment (adj, 128);
+		gtk_adjustment_set_page_increment (adj, 128);
+		gtk_spin_button_set_value (spin, 256);
+		gtk_widget_set_sensitive (GTK_WIDGET(spin), TRUE);
+		break;
+	case TLS_KEY_TYPE_ED25519:
+		gtk_adjustment_set_lower (adj, 256);
+		gtk_adjustment_set_upper (adj, 256);
+		gtk_spin_button_set_value (spin, 256);
+		gtk_widget_set_sensitive (GTK_WIDGET(spin), FALSE);
+		break;
+	default:
+		gtk_adjustment_set_lower (adj, 1024);
+		gtk_adjustment_set_upper (adj, (__new_ca_window_get_key_type () == TLS_KEY_TYPE_DSA ? 3072 : 10240));
+		gtk_adjustment_set_step_increment (adj, 1024);
+		gtk_adjustment_set_page_increment (adj, 1024);
+		if (value < 1024)
+			value = 2048;
+		gtk_spin_button_set_value (spin, MIN (value, gtk_adjustment_get_upper (adj)));
+		gtk_widget_set_sensitive (GTK_WIDGET(spin), TRUE);
+		break;
 	}
 }
 
@@ -249,9 +283,7 @@ G_MODULE_EXPORT void on_new_ca_commit_clicked (GtkButton *widg,
 	else
 		ca_creation_data->cn = NULL;
 
-	widget = GTK_WIDGET(gtk_builder_get_object (new_ca_window_gtkb, "dsa_radiobutton"));
-	active = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON(widget));
-	ca_creation_data->key_type = active;
+	ca_creation_data->key_type = __new_ca_window_get_key_type ();
 
 	widget = GTK_WIDGET(gtk_builder_get_object (new_ca_window_gtkb, "keylength_spinbutton"));
 	active = gtk_spin_button_get_value_as_int (GTK_SPIN_BUTTON(widget));
@@ -302,6 +302,7 @@ G_MODULE_EXPORT void on_new_cert_next2_clicked (GtkButton *button,
 	guint i_value;
 	guint64 ca_id;
         const gchar *ca_pem;
+        const CaPolicy *policy = NULL;
         TlsCert *tls_ca_cert = NULL;
         TlsCsr * tls_csr = g_object_get_data (G_OBJECT(gtk_builder_get_object(new_cert_window_gtkb, "new_cert_window")), "csr_info");
 
@@ -315,33 +316,35 @@ G_MODULE_EXPORT void on_new_cert_next2_clicked (GtkButton *button,
         ca_pem = g_value_get_string(value);
         tls_ca_cert = tls_parse_cert_pem (ca_pem);
         g_free (value);
+
+        policy = ca_file_policy_get_all (ca_id);
 	
         /* Check for differences in fields that must be equal according to the CA policy */
-        if (ca_file_policy_get_int (ca_id, "C_FORCE_SAME") && 
+        if (policy->c_force_same && 
             (tls_ca_cert->c != tls_csr->c) && // If they are the same, they both are NULL, so it is OK
             (tls_ca_cert->c == NULL || tls_csr->c == NULL || strcmp(tls_ca_cert->c, tls_csr->c))) {
                 dialog_error (_("The policy of this CA obligue the country field of the certificates to be the same as the one in the CA cert."));
                 return;
         }
-        if (ca_file_policy_get_int (ca_id, "ST_FORCE_SAME") && 
+        if (policy->st_force_same && 
             (tls_ca_cert->st != tls_csr->st) && // If they are the same, they both are NULL, so it is OK
             (tls_ca_cert->st == NULL || tls_csr->st == NULL || strcmp(tls_ca_cert->st, tls_csr->st))) {
                 dialog_error (_("The policy of this CA obligue the state/province field of the certificates to be the same as the one in the CA cert."));
                 return;
         }
-        if (ca_file_policy_get_int (ca_id, "L_FORCE_SAME") && 
+        if (policy->l_force_same && 
             (tls_ca_cert->l != tls_csr->l) && // If they are the same, they both are NULL, so it is OK
             (tls_ca_cert->l == NULL || tls_csr->st == NULL || strcmp(tls_ca_cert->l, tls_csr->l))) {
                 dialog_error (_("The policy of this CA obligue the locality/city field of the certificates to be the same as the one in the CA cert."));
                 return;
         }
-        if (ca_file_policy_get_int (ca_id, "O_FORCE_SAME") && 
+        if (policy->o_force_same && 
             (tls_ca_cert->o != tls_csr->o) && // If they are the same, they both are NULL, so it is OK
             (tls_ca_cert->o == NULL || tls_csr->o == NULL || strcmp(tls_ca_cert->o, tls_csr->o))) {
                 dialog_error (_("The policy of this CA obligue the organization field of the certificates to be the same as the one in the CA cert."));
                 return;
         }
-        if (ca_file_policy_get_int (ca_id, "OU_FORCE_SAME") && 
+        if (policy->ou_force_same && 
             (tls_ca_cert->ou != tls_csr->ou) && // If they are the same, they both are NULL, so it is OK
             (tls_ca_cert->ou == NULL || tls_csr->ou == NULL || strcmp(tls_ca_cert->ou, tls_csr->ou))) {
                 dialog_error (_("The policy of this CA obligue the organizational unit field of the certificates to be the same as the one in the CA cert."));
@@ -352,12 +355,12 @@ G_MODULE_EXPORT void on_new_cert_next2_clicked (GtkButton *button,
 
         tls_cert_free (tls_ca_cert);
 
-	i_value = ca_file_policy_get_int (ca_id, "MONTHS_TO_EXPIRE");
+	i_value = policy->months_to_expire;
 	object = gtk_builder_get_object (new_cert_window_gtkb, "months_before_expiration_spinbutton1");
 	gtk_spin_button_set_range (GTK_SPIN_BUTTON(object), 1, i_value);
 	gtk_spin_button_set_value (GTK_SPIN_BUTTON(object), i_value);
 
-	i_value = ca_file_policy_get_int (ca_id, "CA");
+	i_value = policy->ca;
 	object = gtk_builder_get_object (new_cert_window_gtkb, "ca_check");
 	gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(object), i_value);
 
@@ -365,66 +368,66 @@ G_MODULE_EXPORT void on_new_cert_next2_clicked (GtkButton *button,
 /* 	object = gtk_builder_get_object (new_cert_window_gtkb, "cert_signing_check2"); */
 /* 	gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(object), i_value); */
 
-	i_value = ca_file_policy_get_int (ca_id, "CRL_SIGN");
+	i_value = policy->crl_sign;
 	object = gtk_builder_get_object (new_cert_window_gtkb, "crl_signing_check");
 	gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(object), i_value);
 
-	i_value = ca_file_policy_get_int (ca_id, "NON_REPUDIATION");
+	i_value = policy->non_repudiation;
 	object = gtk_builder_get_object (new_cert_window_gtkb, "non_repudiation_check");
 	gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(object), i_value);
 	gtk_widget_set_sensitive (GTK_WIDGET(object), i_value);
 
-	i_value = ca_file_policy_get_int (ca_id, "DIGITAL_SIGNATURE");
+	i_value = policy->digital_signature;
 	object = gtk_builder_get_object (new_cert_window_gtkb, "digital_signature_check");
 	gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(object), i_value);
 	gtk_widget_set_sensitive (GTK_WIDGET(object), i_value);
 
-	i_value = ca_file_policy_get_int (ca_id, "KEY_ENCIPHERMENT");
+	i_value = policy->key_encipherment;
 	object = gtk_builder_get_object (new_cert_window_gtkb, "key_encipherment_check");
 	gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(object), i_value);
 	gtk_widget_set_sensitive (GTK_WIDGET(object), i_value);
 
-	i_value = ca_file_policy_get_int (ca_id, "KEY_AGREEMENT");
+	i_value = policy->key_agreement;
 	object = gtk_builder_get_object (new_cert_window_gtkb, "key_agreement_check");
 	gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(object), i_value);
 	gtk_widget_set_sensitive (GTK_WIDGET(object), i_value);
 
-	i_value = ca_file_policy_get_int (ca_id, "DATA_ENCIPHERMENT");
+	i_value = policy->data_encipherment;
 	object = gtk_builder_get_object (new_cert_window_gtkb, "data_encipherment_check");
 	gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(object), i_value);
 	gtk_widget_set_sensitive (GTK_WIDGET(object), i_value);
 
-	i_value = ca_file_policy_get_int (ca_id, "TLS_WEB_SERVER");
+	i_value = policy->tls_web_server;
 	object = gtk_builder_get_object (new_cert_window_gtkb, "webserver_check");
 	gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(object), i_value);
 	gtk_widget_set_sensitive (GTK_WIDGET(object), i_value);
 
-	i_value = ca_file_policy_get_int (ca_id, "TLS_WEB_CLIENT");
+	i_value = policy->tls_web_client;
 	object = gtk_builder_get_object (new_cert_window_gtkb, "webclient_check");
 	gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(object), i_value);
 	gtk_widget_set_sensitive (GTK_WIDGET(object), i_value);
 
-	i_value = ca_file_policy_get_int (ca_id, "TIME_STAMPING");
+	i_value = policy->time_stamping;
 	object = gtk_builder_get_object (new_cert_window_gtkb, "time_stamping_check");
 	gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(object), i_value);
 	gtk_widget_set_sensitive (GTK_WIDGET(object), i_value);
 
-	i_value = ca_file_policy_get_int (ca_id, "CODE_SIGNING");
+	i_value = policy->code_signing;
 	object = gtk_builder_get_object (new_cert_window_gtkb, "code_signing_check");
 	gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(object), i_value);
 	gtk_widget_set_sensitive (GTK_WIDGET(object), i_value);
 
-	i_value = ca_file_policy_get_int (ca_id, "EMAIL_PROTECTION");
+	i_value = policy->email_protection;
 	object = gtk_builder_get_object (new_cert_window_gtkb, "email_protection_check");
 	gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(object), i_value);
 	gtk_widget_set_sensitive (GTK_WIDGET(object), i_value);
 	
-	i_value = ca_file_policy_get_int (ca_id, "OCSP_SIGNING");
+	i_value = policy->ocsp_signing;
 	object = gtk_builder_get_object (new_cert_window_gtkb, "ocsp_signing_check");
 	gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(object), i_value);
 	gtk_widget_set_sensitive (GTK_WIDGET(object), i_value);
 
-	i_value = ca_file_policy_get_int (ca_id, "ANY_PURPOSE");
+	i_value = policy->any_purpose;
 	object = gtk_builder_get_object (new_cert_window_gtkb, "any_purpose_check");
 	gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON(object), i_value);
 	gtk_widget_set_sensitive (GTK_WIDGET(object), i_value);
@@ -734,8 +737,6 @@ G_MODULE_EXPORT void on_new_cert_commit_clicked (GtkButton *widg,
 	widget = gtk_builder_get_object (new_cert_window_gtkb, "any_purpose_check");
 	cert_creation_data->any_purpose = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON(widget));
 
-	cert_creation_data->crl_distribution_point = ca_file_policy_get (ca_id, "CRL_DISTRIBUTION_POINT");
-
 	strerror = new_cert_sign_csr (csr_id, ca_id, cert_creation_data);
 
 	if (strerror) {
@@ -762,6 +763,8 @@ const gchar *new_cert_sign_csr (guint64 csr_id, guint64 ca_id, TlsCertCreationDa
 	gchar *pkey_pem;
 	PkeyManageData *crypted_pkey;
 
+	const CaPolicy *policy;
+
 	time_t tmp;
 	struct tm * expiration_time;
 
@@ -784,6 +787,10 @@ const gchar *new_cert_sign_csr (guint64 csr_id, guint64 ca_id, TlsCertCreationDa
 
         ca_file_get_next_serial (&cert_creation_data->serial, ca_id);
 
+	policy = ca_file_policy_get_all (ca_id);
+	if (! cert_creation_data->crl_distribution_point && policy->crl_distribution_point)
+		cert_creation_data->crl_distribution_point = g_strdup (policy->crl_distribution_point);
+
 	csr_pem = ca_file_get_public_pem_from_id (CA_FILE_ELEMENT_TYPE_CSR, csr_id);
 	pem = ca_file_get_public_pem_from_id (CA_FILE_ELEMENT_TYPE_CERT, ca_id);
 	crypted_pkey = pkey_manage_get_certificate_pkey (ca_id);
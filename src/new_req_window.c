@@ -55,6 +55,7 @@ typedef struct {
 
 int __new_req_window_refresh_model_add_ca (void *pArg, int argc, char **argv, char **columnNames);
 void __new_req_populate_ca_treeview (GtkTreeView *treeview);
+gint __new_req_window_get_key_type (void);
 gboolean __new_req_window_lookup_country (GtkTreeModel *model,
                                           GtkTreePath *path,
                                           GtkTreeIter *iter,
@@ -242,22 +243,54 @@ void new_req_tab_activate (int tab_number)
 
 }
 
+gint __new_req_window_get_key_type (void)
+{
+	if (gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON(gtk_builder_get_object (new_req_window_gtkb, "dsa_radiobutton1"))))
+		return TLS_KEY_TYPE_DSA;
+	if (gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON(gtk_builder_get_object (new_req_window_gtkb, "ecdsa_radiobutton1"))))
+		return TLS_KEY_TYPE_ECDSA;
+	if (gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON(gtk_builder_get_object (new_req_window_gtkb, "ed25519_radiobutton1"))))
+		return TLS_KEY_TYPE_ED25519;
+	return TLS_KEY_TYPE_RSA;
+}
+
 G_MODULE_EXPORT void on_new_req_privkey_type_toggle (GtkToggleButton *button,
 						     gpointer        user_data)
 {
-	GtkToggleButton *rsatoggle = GTK_TOGGLE_BUTTON(gtk_builder_get_object (new_req_window_gtkb, "rsa_radiobutton1"));
 	GtkAdjustment *adj = GTK_ADJUSTMENT(gtk_builder_get_object (new_req_window_gtkb, "AdjustmentKeyLengthSpinButton1"));
-	gdouble value = gtk_spin_button_get_value (GTK_SPIN_BUTTON(gtk_builder_get_object(new_req_window_gtkb, "keylength_spinbutton1")));
-
-	if (gtk_toggle_button_get_active(rsatoggle)) {
-		// RSA is active
-		gtk_adjustment_set_upper (adj, 10240);
-	} else {
-		// DSA is active
-		gtk_adjustment_set_upper (adj, 3072);
-		if (value > 3072)
-			gtk_spin_button_set_value (GTK_SPIN_BUTTON(gtk_builder_get_object(new_req_window_gtkb, "keylength_spinbutton1")), 
-						   3072);
+	GtkSpinButton *spin = GTK_SPIN_BUTTON(gtk_builder_get_object(new_req_window_gtkb, "keylength_spinbutton1"));
+	gdouble value = gtk_spin_button_get_value (spin);
+
+	// Called for the button being deactivated too
+	if (! gtk_toggle_button_get_active (button))
+		return;
+
+	switch (__new_req_window_get_key_type ()) {
+	case TLS_KEY_TYPE_ECDSA:
+		// Curve size: P-256 or P-384
+		gtk_adjustment_set_lower (adj, 256);
+		gtk_adjustment_set_upper (adj, 384);
+		gtk_adjustment_set_step_increment (adj, 128);
+		gtk_adjustment_set_page_increment (adj, 128);
+		gtk_spin_button_set_value (spin, 256);
+		gtk_widget_set_sensitive (GTK_WIDGET(spin), TRUE);
+		break;
+	case TLS_KEY_TYPE_ED25519:
+		gtk_adjustment_set_lower (adj, 256);
+		gtk_adjustment_set_upper (adj, 256);
+		gtk_spin_button_set_value (spin, 256);
+		gtk_widget_set_sensitive (GTK_WIDGET(spin), FALSE);
+		break;
+	default:
+		gtk_adjustment_set_lower (adj, 1024);
+		gtk_adjustment_set_upper (adj, (__new_req_window_get_key_type () == TLS_KEY_TYPE_DSA ? 3072 : 10240));
+		gtk_adjustment_set_step_increment (adj, 1024);
+		gtk_adjustment_set_page_increment (adj, 1024);
+		if (value < 1024)
+			value = 2048;
+		gtk_spin_button_set_value (spin, MIN (value, gtk_adjustment_get_upper (adj)));
+		gtk_widget_set_sensitive (GTK_WIDGET(spin), TRUE);
+		break;
 	}
 }
 
@@ -305,6 +338,7 @@ G_MODULE_EXPORT void on_new_req_next1_clicked (GtkButton *button,
         TlsCert * tlscert;
         GtkWidget * widget; 
 	const gchar *pem;
+	const CaPolicy *policy;
 
         if (gtk_tree_selection_get_selected (selection, &model, &iter)) {
 
@@ -319,10 +353,11 @@ G_MODULE_EXPORT void on_new_req_next1_clicked (GtkButton *button,
                 gtk_tree_model_get_value (model, &iter, NEW_REQ_CA_MODEL_COLUMN_ID, value);
                 new_req_ca_id_valid = TRUE;
                 new_req_ca_id = g_value_get_uint64(value);
+                policy = ca_file_policy_get_all (new_req_ca_id);
 
 		widget = GTK_WIDGET(gtk_builder_get_object(new_req_window_gtkb,"country_combobox1"));
-                if (ca_file_policy_get (new_req_ca_id, "C_INHERIT")) {
-                        gtk_widget_set_sensitive (widget, ! ca_file_policy_get (new_req_ca_id, "C_FORCE_SAME"));
+                if (policy->c_inherit) {
+                        gtk_widget_set_sensitive (widget, ! policy->c_force_same);
                         model = GTK_TREE_MODEL(gtk_combo_box_get_model (GTK_COMBO_BOX(widget)));
                         gtk_tree_model_foreach (model, __new_req_window_lookup_country, tlscert->c);
                 } else {
@@ -331,8 +366,8 @@ G_MODULE_EXPORT void on_new_req_next1_clicked (GtkButton *button,
                 }
                 
 		widget = GTK_WIDGET(gtk_builder_get_object(new_req_window_gtkb,"st_entry1"));
-                if (ca_file_policy_get (new_req_ca_id, "ST_INHERIT")) {
-                        gtk_widget_set_sensitive (widget, ! ca_file_policy_get (new_req_ca_id, "ST_FORCE_SAME"));
+                if (policy->st_inherit) {
+                        gtk_widget_set_sensitive (widget, ! policy->st_force_same);
                         gtk_entry_set_text(GTK_ENTRY(widget), tlscert->st);
                 } else {
                         gtk_widget_set_sensitive (widget, TRUE);
@@ -340,8 +375,8 @@ G_MODULE_EXPORT void on_new_req_next1_clicked (GtkButton *button,
                 }
                 
 		widget = GTK_WIDGET(gtk_builder_get_object(new_req_window_gtkb,"city_entry1"));
-                if (ca_file_policy_get (new_req_ca_id, "L_INHERIT")) {
-                        gtk_widget_set_sensitive (widget, ! ca_file_policy_get (new_req_ca_id, "L_FORCE_SAME"));
+                if (policy->l_inherit) {
+                        gtk_widget_set_sensitive (widget, ! policy->l_force_same);
                         gtk_entry_set_text(GTK_ENTRY(widget), tlscert->l);
                 } else {
                         gtk_widget_set_sensitive (widget, TRUE);
@@ -349,8 +384,8 @@ G_MODULE_EXPORT void on_new_req_next1_clicked (GtkButton *button,
                 }
                 
 		widget = GTK_WIDGET(gtk_builder_get_object(new_req_window_gtkb,"o_entry1"));
-                if (ca_file_policy_get (new_req_ca_id, "O_INHERIT")) {
-                        gtk_widget_set_sensitive (widget, ! ca_file_policy_get (new_req_ca_id, "O_FORCE_SAME"));
+                if (policy->o_inherit) {
+                        gtk_widget_set_sensitive (widget, ! policy->o_force_same);
                         gtk_entry_set_text(GTK_ENTRY(widget), tlscert->o);
                 } else {
                         gtk_widget_set_sensitive (widget, TRUE);
@@ -358,8 +393,8 @@ G_MODULE_EXPORT void on_new_req_next1_clicked (GtkButton *button,
                 }
                 
                 widget = GTK_WIDGET(gtk_builder_get_object(new_req_window_gtkb,"ou_entry1"));
-                if (ca_file_policy_get (new_req_ca_id, "OU_INHERIT")) {
-                        gtk_widget_set_sensitive (widget, ! ca_file_policy_get (new_req_ca_id, "OU_FORCE_SAME"));
+                if (policy->ou_inherit) {
+                        gtk_widget_set_sensitive (widget, ! policy->ou_force_same);
                         gtk_entry_set_text(GTK_ENTRY(widget), tlscert->ou);
                 } else {
                         gtk_widget_set_sensitive (widget, TRUE);
@@ -480,9 +515,7 @@ G_MODULE_EXPORT void on_new_req_commit_clicked (GtkButton *widg,
 	else
 		csr_creation_data->cn = NULL;
 
-	widget = GTK_WIDGET(gtk_builder_get_object (new_req_window_gtkb, "dsa_radiobutton1"));
-	active = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON(widget));
-	csr_creation_data->key_type = active;
+	csr_creation_data->key_type = __new_req_window_get_key_type ();
 
 	widget = GTK_WIDGET(gtk_builder_get_object (new_req_window_gtkb, "keylength_spinbutton1"));
 	active = gtk_spin_button_get_value_as_int (GTK_SPIN_BUTTON(widget));
@@ -35,6 +35,7 @@
 #include "ca_file.h"
 #include "dialog.h"
 #include "pkey_manage.h"
+#include "stats.h"
 
 #include <glib/gi18n.h>
 
@@ -123,6 +124,9 @@ gchar * __pkey_manage_ask_external_file_password (const gchar *cert_dn)
 	gchar *aux = NULL;
 
 
+	if (dialog_is_batch_mode ())
+		return dialog_ask_for_password (NULL);
+
 	printf (_("The file that holds private key for certificate\n'%s' is password-protected.\n\n"), cert_dn);
 
 	aux = getpass ("Please, insert the password corresponding to this file:");
@@ -792,6 +796,10 @@ gchar * pkey_manage_ask_password ()
 	if (! ca_file_is_password_protected())
 		return NULL;
 
+	/* Databases unlocked beforehand (e.g. for running a command over several of them) */
+	if (ca_file_get_unlocked_password () && ca_file_check_password (ca_file_get_unlocked_password ()))
+		return g_strdup (ca_file_get_unlocked_password ());
+
 	is_key_ok = FALSE;
 
 	while (! is_key_ok) {
@@ -801,20 +809,31 @@ gchar * pkey_manage_ask_password ()
 			password = NULL;
 		}
 
-		printf (_("This action requires using one or more private keys saved in the database.\n"));
-		pass = getpass (_("Please insert the database password:"));
-	
-		if (! pass || pass[0] == '\0') {
-			return NULL;
+		if (dialog_is_batch_mode ()) {
+			password = dialog_ask_for_password (NULL);
+			if (! password)
+				return NULL;
 		} else {
-			password = g_strdup (pass);
-			memset (pass, 0, strlen(pass));
+			printf (_("This action requires using one or more private keys saved in the database.\n"));
+			pass = getpass (_("Please insert the database password:"));
+	
+			if (! pass || pass[0] == '\0') {
+				return NULL;
+			} else {
+				password = g_strdup (pass);
+				memset (pass, 0, strlen(pass));
+			}
 		}
 
 		is_key_ok = ca_file_check_password (password);
 		
 		if (! is_key_ok) {
 			dialog_error (_("The given password doesn't match the one used in the database"));
+			/* In batch mode, the password won't change in the next try */
+			if (dialog_is_batch_mode ()) {
+				g_free (password);
+				return NULL;
+			}
 		}
 
 	}
@@ -882,15 +901,18 @@ gchar * pkey_manage_uncrypt_w_pwd (PkeyManageData *pem_private_key, const gchar
 {
  	gchar *res; 
 	gchar *password;
+	gint64 start;
 
 	if (! pem_private_key->is_in_db || ! pem_private_key->is_ciphered_with_db_pwd)
 		return g_strdup(pem_private_key->pkey_data);
 		
+	start = stats_start ();
 	password = g_strdup_printf ("gnoMintPrivateKey%s%s", pwd, dn);
 
 	res = __pkey_manage_aes_decrypt (pem_private_key->pkey_data, password);
 
 	g_free (password);
+	stats_record (STATS_KEY_UNCIPHER, start);
 
 	return res;
 }
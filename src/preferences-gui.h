@@ -40,6 +40,10 @@ void preferences_set_crq_visible (gboolean new_value);
 gboolean preferences_get_gnome_keyring_export (void);
 void preferences_set_gnome_keyring_export (gboolean new_value);
 
+// Milliseconds from which SQL statements are logged to standard error (0 = never)
+gint preferences_get_slow_query_threshold (void);
+void preferences_set_slow_query_threshold (gint new_value);
+
 void preferences_deinit (void);
 
 
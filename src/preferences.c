@@ -44,6 +44,16 @@ void preferences_set_gnome_keyring_export (gboolean new_value)
         gconf_engine_set_bool (preferences_engine, "/apps/gnomint/gnome_keyring_export", new_value, NULL);
 }
 
+gint preferences_get_slow_query_threshold ()
+{
+        return gconf_engine_get_int (preferences_engine, "/apps/gnomint/slow_query_threshold", NULL);
+}
+
+void preferences_set_slow_query_threshold (gint new_value)
+{
+        gconf_engine_set_int (preferences_engine, "/apps/gnomint/slow_query_threshold", new_value, NULL);
+}
+
 
 void preferences_deinit ()
 {
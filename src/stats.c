@@ -0,0 +1,167 @@
+//  gnoMint: a graphical interface for managing a certification authority
+//  Copyright (C) 2006-2009 David Marín Carreño <davefx@gmail.com>
+//
+//  This file is part of gnoMint.
+//
+//  gnoMint is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 3 of the License, or   
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of 
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the  
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stats.h"
+
+#include <glib/gi18n.h>
+
+static const gchar * stats_operation_names[STATS_OPERATION_NUMBER] = {
+	"db_query",
+	"key_generation",
+	"key_load",
+	"key_uncipher",
+	"sign",
+	"crl_generation",
+	"parse"
+};
+
+static const gchar * stats_histogram_bucket_names[STATS_HISTOGRAM_BUCKETS] = {
+	"lt_10us",
+	"lt_100us",
+	"lt_1ms",
+	"lt_10ms",
+	"lt_100ms",
+	"lt_1s",
+	"ge_1s"
+};
+
+static GMutex stats_mutex;
+static StatsCounter stats_counters[STATS_OPERATION_NUMBER];
+static gboolean stats_dump_on_exit = FALSE;
+static gboolean stats_atexit_registered = FALSE;
+
+void __stats_atexit (void);
+
+
+void __stats_atexit ()
+{
+	const gchar *target = g_getenv ("GNOMINT_STATS");
+	FILE *file = stderr;
+
+	if (! stats_dump_on_exit)
+		return;
+
+	if (target && strcmp (target, "1")) {
+		file = fopen (target, "a");
+		if (! file)
+			return;
+	}
+
+	stats_dump (file);
+
+	if (file != stderr)
+		fclose (file);
+}
+
+
+void stats_init ()
+{
+	if (g_getenv ("GNOMINT_STATS"))
+		stats_set_dump_on_exit (TRUE);
+}
+
+void stats_set_dump_on_exit (gboolean dump)
+{
+	stats_dump_on_exit = dump;
+
+	if (dump && ! stats_atexit_registered) {
+		atexit (__stats_atexit);
+		stats_atexit_registered = TRUE;
+	}
+}
+
+gint64 stats_start ()
+{
+	return g_get_monotonic_time ();
+}
+
+void stats_record (StatsOperation operation, gint64 start)
+{
+	stats_record_elapsed (operation, g_get_monotonic_time () - start);
+}
+
+void stats_record_elapsed (StatsOperation operation, gint64 elapsed)
+{
+	StatsCounter *counter = &stats_counters[operation];
+	gint64 limit = 10;
+	guint bucket = 0;
+
+	while (bucket < STATS_HISTOGRAM_BUCKETS - 1 && elapsed >= limit) {
+		bucket ++;
+		limit *= 10;
+	}
+
+	g_mutex_lock (&stats_mutex);
+	counter->count ++;
+	counter->total += elapsed;
+	if (elapsed > counter->max)
+		counter->max = elapsed;
+	counter->histogram[bucket] ++;
+	g_mutex_unlock (&stats_mutex);
+}
+
+const gchar * stats_operation_name (StatsOperation operation)
+{
+	return stats_operation_names[operation];
+}
+
+const gchar * stats_histogram_bucket_name (guint bucket)
+{
+	return stats_histogram_bucket_names[bucket];
+}
+
+void stats_get (StatsOperation operation, StatsCounter *counter)
+{
+	g_mutex_lock (&stats_mutex);
+	memcpy (counter, &stats_counters[operation], sizeof (StatsCounter));
+	g_mutex_unlock (&stats_mutex);
+}
+
+void stats_reset ()
+{
+	g_mutex_lock (&stats_mutex);
+	memset (stats_counters, 0, sizeof (stats_counters));
+	g_mutex_unlock (&stats_mutex);
+}
+
+void stats_dump (FILE *file)
+{
+	StatsCounter counter;
+	guint i, j;
+
+	fprintf (file, "%-16s %10s %12s %10s %10s", _("Operation"), _("Count"), _("Total (ms)"), _("Mean (us)"), _("Max (us)"));
+	for (j = 0; j < STATS_HISTOGRAM_BUCKETS; j++)
+		fprintf (file, " %9s", stats_histogram_bucket_names[j]);
+	fprintf (file, "\n");
+
+	for (i = 0; i < STATS_OPERATION_NUMBER; i++) {
+		stats_get (i, &counter);
+		fprintf (file, "%-16s %10"G_GUINT64_FORMAT" %12.1f %10"G_GINT64_FORMAT" %10"G_GINT64_FORMAT, 
+			 stats_operation_names[i], counter.count, counter.total / 1000.0,
+			 (counter.count ? counter.total / (gint64) counter.count : 0), counter.max);
+		for (j = 0; j < STATS_HISTOGRAM_BUCKETS; j++)
+			fprintf (file, " %9"G_GUINT64_FORMAT, counter.histogram[j]);
+		fprintf (file, "\n");
+	}
+}
@@ -0,0 +1,65 @@
+//  gnoMint: a graphical interface for managing a certification authority
+//  Copyright (C) 2006-2009 David Marín Carreño <davefx@gmail.com>
+//
+//  This file is part of gnoMint.
+//
+//  gnoMint is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 3 of the License, or   
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of 
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the  
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include <glib.h>
+#include <stdio.h>
+
+// Operations whose number and duration are recorded
+typedef enum {
+	STATS_DB_QUERY = 0,        // Each SQL statement
+	STATS_KEY_GENERATION = 1,
+	STATS_KEY_LOAD = 2,        // Loading PEM or PKCS#8 private keys
+	STATS_KEY_UNCIPHER = 3,    // Unciphering keys protected with the database password
+	STATS_SIGN = 4,            // Certificates and CSRs
+	STATS_CRL_GENERATION = 5,
+	STATS_PARSE = 6            // Certificates and CSRs
+} StatsOperation;
+#define STATS_OPERATION_NUMBER 7
+
+// Histogram buckets: <10us, <100us, <1ms, <10ms, <100ms, <1s and the rest
+#define STATS_HISTOGRAM_BUCKETS 7
+
+typedef struct {
+	guint64 count;
+	gint64 total;              // Microseconds
+	gint64 max;
+	guint64 histogram[STATS_HISTOGRAM_BUCKETS];
+} StatsCounter;
+
+// Dumps the counters on exit if the environment variable GNOMINT_STATS is set: to standard
+// error if it is "1", or appended to the file it names otherwise
+void stats_init (void);
+void stats_set_dump_on_exit (gboolean dump);
+
+// Usage: start = stats_start (); ...operation...; stats_record (STATS_SIGN, start);
+gint64 stats_start (void);
+void stats_record (StatsOperation operation, gint64 start);
+void stats_record_elapsed (StatsOperation operation, gint64 elapsed);
+
+const gchar * stats_operation_name (StatsOperation operation);
+const gchar * stats_histogram_bucket_name (guint bucket);
+void stats_get (StatsOperation operation, StatsCounter *counter);
+void stats_reset (void);
+
+void stats_dump (FILE *file);
+
+#endif
@@ -23,6 +23,25 @@
 #include <glib/gi18n.h>
 #include "uint160.h"
 #include "tls.h"
+#include "stats.h"
+
+const gchar * __tls_set_uses_extensions (gnutls_x509_crt_t crt, gnutls_x509_crt_t ca_crt, 
+					 const TlsCertCreationData *creation_data);
+const gchar * __tls_cert_template_apply (const TlsCertTemplate *cert_template, gnutls_x509_crt_t crt);
+gnutls_digest_algorithm_t __tls_get_sign_digest (gnutls_x509_privkey_t key);
+gchar * __tls_export_dh_params (gnutls_dh_params_t dh_params);
+gchar * __tls_generate_keys (TlsCreationData *creation_data, gchar ** private_key, gnutls_x509_privkey_t **key);
+gchar * __tls_load_private_key (const gchar *private_key, gnutls_x509_privkey_t **key);
+gchar * __tls_load_pkcs8_private_key (gchar *pkcs8_pem, gchar *passphrase, const gchar *cert_key_id, gint *error);
+gchar * __tls_generate_self_signed_certificate (TlsCreationData * creation_data, gnutls_x509_privkey_t *key,
+						gchar ** certificate);
+gchar * __tls_generate_csr (TlsCreationData * creation_data, gnutls_x509_privkey_t *key, gchar ** csr);
+gchar * __tls_generate_certificate (TlsCertCreationData * creation_data, gchar *csr_pem, gchar *ca_cert_pem,
+				    gchar *ca_priv_key_pem, gchar **certificate);
+TlsCert * __tls_parse_cert_pem (const char * pem_certificate);
+TlsCsr * __tls_parse_csr_pem (const char * pem_csr);
+gchar * __tls_generate_crl (GList * revoked_certs, guchar *ca_pem, guchar *ca_private_key, gint crl_version,
+			    time_t current_timestamp, time_t next_crl_timestamp);
 
 void tls_init ()
 {
@@ -99,6 +118,189 @@ gchar * tls_generate_dsa_keys (TlsCreationData *creation_data,
 
 }
 
+gchar * tls_generate_ecdsa_keys (TlsCreationData *creation_data,
+				 gchar ** private_key,
+				 gnutls_x509_privkey_t **key)
+{
+#ifdef ECC_GNUTLS
+	size_t private_key_len = 0;
+        gint error;
+	gnutls_ecc_curve_t curve;
+
+	switch (creation_data->key_bitlength) {
+	case 256:
+		curve = GNUTLS_ECC_CURVE_SECP256R1;
+		break;
+	case 384:
+		curve = GNUTLS_ECC_CURVE_SECP384R1;
+		break;
+	default:
+		return g_strdup_printf(_("Unsupported elliptic curve size: %d"), creation_data->key_bitlength);
+	}
+
+	(*key) = g_new0 (gnutls_x509_privkey_t, 1);
+	if (gnutls_x509_privkey_init (*key) < 0) {
+		return g_strdup_printf(_("Error initializing private key structure."));
+	}
+
+	/* Generate ECDSA private key over the NIST P-256 or P-384 curve. */
+        error = gnutls_x509_privkey_generate ((** key), GNUTLS_PK_EC, GNUTLS_CURVE_TO_BITS (curve), 0);
+	if (error < 0) {
+		return g_strdup_printf(_("Error creating private key: %d"), error);
+	}
+
+	/* Calculate private key length */
+	(* private_key) = g_new0 (gchar, 1);	
+	gnutls_x509_privkey_export ((** key), GNUTLS_X509_FMT_PEM, (* private_key), &private_key_len);
+	g_free (* private_key);
+
+	/* Save the private key to a PEM format */
+	(* private_key) = g_new0 (gchar, private_key_len);	
+	if (gnutls_x509_privkey_export ((** key), GNUTLS_X509_FMT_PEM, (* private_key), &private_key_len) < 0) {
+		return g_strdup_printf(_("Error exporting private key to PEM structure."));
+	}
+
+	return NULL;
+#else
+	return g_strdup_printf(_("Elliptic curve keys need a newer GnuTLS version."));
+#endif
+}
+
+gchar * tls_generate_ed25519_keys (TlsCreationData *creation_data,
+				   gchar ** private_key,
+				   gnutls_x509_privkey_t **key)
+{
+#ifdef ECC_GNUTLS
+	size_t private_key_len = 0;
+        gint error;
+
+	(*key) = g_new0 (gnutls_x509_privkey_t, 1);
+	if (gnutls_x509_privkey_init (*key) < 0) {
+		return g_strdup_printf(_("Error initializing private key structure."));
+	}
+
+	/* Generate Ed25519 private key. Its size is fixed. */
+        error = gnutls_x509_privkey_generate ((** key), GNUTLS_PK_EDDSA_ED25519, 
+					      GNUTLS_CURVE_TO_BITS (GNUTLS_ECC_CURVE_ED25519), 0);
+	if (error < 0) {
+		return g_strdup_printf(_("Error creating private key: %d"), error);
+	}
+
+	/* Calculate private key length */
+	(* private_key) = g_new0 (gchar, 1);	
+	gnutls_x509_privkey_export ((** key), GNUTLS_X509_FMT_PEM, (* private_key), &private_key_len);
+	g_free (* private_key);
+
+	/* Save the private key to a PEM format */
+	(* private_key) = g_new0 (gchar, private_key_len);	
+	if (gnutls_x509_privkey_export ((** key), GNUTLS_X509_FMT_PEM, (* private_key), &private_key_len) < 0) {
+		return g_strdup_printf(_("Error exporting private key to PEM structure."));
+	}
+
+	return NULL;
+#else
+	return g_strdup_printf(_("Elliptic curve keys need a newer GnuTLS version."));
+#endif
+}
+
+gchar * __tls_generate_keys (TlsCreationData *creation_data,
+			     gchar ** private_key,
+			     gnutls_x509_privkey_t **key)
+{
+	switch (creation_data->key_type) {
+	case TLS_KEY_TYPE_RSA:
+		return tls_generate_rsa_keys (creation_data, private_key, key);
+	case TLS_KEY_TYPE_DSA:
+		return tls_generate_dsa_keys (creation_data, private_key, key);
+	case TLS_KEY_TYPE_ECDSA:
+		return tls_generate_ecdsa_keys (creation_data, private_key, key);
+	case TLS_KEY_TYPE_ED25519:
+		return tls_generate_ed25519_keys (creation_data, private_key, key);
+	default:
+		return g_strdup_printf(_("Unknown key type: %d"), creation_data->key_type);
+	}
+}
+
+const gchar * tls_key_type_name (gint key_type)
+{
+	switch (key_type) {
+	case TLS_KEY_TYPE_RSA:
+		return "RSA";
+	case TLS_KEY_TYPE_DSA:
+		return "DSA";
+	case TLS_KEY_TYPE_ECDSA:
+		return "ECDSA";
+	case TLS_KEY_TYPE_ED25519:
+		return "Ed25519";
+	default:
+		return "?";
+	}
+}
+
+gint tls_key_type_from_name (const gchar *name)
+{
+	gint key_type;
+
+	for (key_type = TLS_KEY_TYPE_RSA; key_type <= TLS_KEY_TYPE_ED25519; key_type++) {
+		if (! g_ascii_strcasecmp (name, tls_key_type_name (key_type)))
+			return key_type;
+	}
+
+	return -1;
+}
+
+gboolean tls_key_type_check_bitlength (gint key_type, gint key_bitlength)
+{
+	switch (key_type) {
+	case TLS_KEY_TYPE_RSA:
+		return (key_bitlength >= 1024 && key_bitlength <= 10240 && ! (key_bitlength % 1024));
+	case TLS_KEY_TYPE_DSA:
+		return (key_bitlength >= 1024 && key_bitlength <= 3072 && ! (key_bitlength % 1024));
+	case TLS_KEY_TYPE_ECDSA:
+		return (key_bitlength == 256 || key_bitlength == 384);
+	case TLS_KEY_TYPE_ED25519:
+		return (key_bitlength == 256);
+	default:
+		return FALSE;
+	}
+}
+
+/* SHA-512 is used for signing, but for ECDSA keys, that use the hash matching their curve */
+gnutls_digest_algorithm_t __tls_get_sign_digest (gnutls_x509_privkey_t key)
+{
+#ifdef ECC_GNUTLS
+	guint bits = 0;
+
+	if (gnutls_x509_privkey_get_pk_algorithm2 (key, &bits) == GNUTLS_PK_EC) {
+		if (bits <= 256)
+			return GNUTLS_DIG_SHA256;
+		if (bits <= 384)
+			return GNUTLS_DIG_SHA384;
+	}
+#endif
+	return GNUTLS_DIG_SHA512;
+}
+
+gchar * __tls_load_private_key (const gchar *private_key,
+			        gnutls_x509_privkey_t **key)
+{
+	gnutls_datum_t pem_datum;
+
+	pem_datum.data = (unsigned char *) private_key;
+	pem_datum.size = strlen(private_key);
+
+	(*key) = g_new0 (gnutls_x509_privkey_t, 1);
+	if (gnutls_x509_privkey_init (*key) < 0) {
+		return g_strdup_printf(_("Error initializing private key structure."));
+	}
+
+	if (gnutls_x509_privkey_import ((** key), &pem_datum, GNUTLS_X509_FMT_PEM) < 0) {
+		return g_strdup_printf(_("Error importing private key from PEM structure."));
+	}
+
+	return NULL;
+}
+
 gchar * tls_generate_pkcs8_encrypted_private_key (gchar *pem_private_key, gchar *passphrase)
 {
 	gnutls_datum_t pem_datum;
@@ -136,7 +338,7 @@ gchar * tls_generate_pkcs8_encrypted_private_key (gchar *pem_private_key, gchar
 	return pkcs8_private_key;
 }
 
-gchar * tls_load_pkcs8_private_key (gchar *pkcs8_pem, gchar *passphrase, const gchar *cert_key_id, gint *error)
+gchar * __tls_load_pkcs8_private_key (gchar *pkcs8_pem, gchar *passphrase, const gchar *cert_key_id, gint *error)
 {
 	gnutls_datum_t pkcs8_datum;
 	gchar * pem_private_key = NULL;
@@ -414,15 +616,15 @@ gnutls_datum_t * tls_generate_pkcs12 (gchar *pem_cert, gchar *pem_private_key, g
 }
 
 
-gchar * tls_generate_self_signed_certificate (TlsCreationData * creation_data, 
-					      gnutls_x509_privkey_t *key,
-					      gchar ** certificate)
+gchar * __tls_generate_self_signed_certificate (TlsCreationData * creation_data, 
+					        gnutls_x509_privkey_t *key,
+					        gchar ** certificate)
 {
 	gnutls_x509_crt_t crt;
         UInt160 *sn = uint160_new();
 	guchar * keyid = NULL;
 	size_t keyidsize = 0;
-	guchar * serialstr = NULL;
+	guchar serialstr[UINT160_SERIAL_MAX_SIZE];
 	size_t serialsize = 0;
 	size_t certificate_len = 0;
 
@@ -439,9 +641,7 @@ gchar * tls_generate_self_signed_certificate (TlsCreationData * creation_data,
 		return g_strdup_printf(_("Error when setting certificate version"));
 	}
 	
-        uint160_write (sn, NULL, &serialsize);
-        serialstr = g_new0 (guchar, serialsize);
-        uint160_write (sn, serialstr, &serialsize);
+        serialsize = uint160_write_serial (sn, serialstr);
 
 	if (gnutls_x509_crt_set_serial (crt, serialstr, serialsize) < 0) {
 		gnutls_x509_crt_deinit (crt);
@@ -449,8 +649,6 @@ gchar * tls_generate_self_signed_certificate (TlsCreationData * creation_data,
 		return g_strdup_printf(_("Error when setting certificate serial number"));
 	}
 
-        g_free (serialstr);
-
         uint160_free (sn);
 
 	if (gnutls_x509_crt_set_activation_time (crt, creation_data->activation) < 0) {
@@ -538,7 +736,7 @@ gchar * tls_generate_self_signed_certificate (TlsCreationData * creation_data,
 	//
 	//__add_ext (certificate, NID_netscape_comment, "gnoMint Generated Certificate");
 
-	if (gnutls_x509_crt_sign2(crt, crt, (* key), GNUTLS_DIG_SHA512, 0)) {
+	if (gnutls_x509_crt_sign2(crt, crt, (* key), __tls_get_sign_digest (* key), 0)) {
 		gnutls_x509_crt_deinit (crt);
 		return g_strdup_printf(_("Error when signing self-signed certificate"));
 	}
@@ -562,9 +760,9 @@ gchar * tls_generate_self_signed_certificate (TlsCreationData * creation_data,
 }
 
 
-gchar * tls_generate_csr (TlsCreationData * creation_data, 
-			  gnutls_x509_privkey_t *key,
-			  gchar ** csr)
+gchar * __tls_generate_csr (TlsCreationData * creation_data, 
+			    gnutls_x509_privkey_t *key,
+			    gchar ** csr)
 {
 	gnutls_x509_crq_t crq;
 	size_t csr_len = 0;
@@ -615,7 +813,7 @@ gchar * tls_generate_csr (TlsCreationData * creation_data,
 	}
 	
 
-	if (gnutls_x509_crq_privkey_sign(crq, pkey, GNUTLS_DIG_SHA512, 0)) {
+	if (gnutls_x509_crq_privkey_sign(crq, pkey, __tls_get_sign_digest (* key), 0)) {
 		return g_strdup_printf(_("Error when signing self-signed csr"));
 	}
 	
@@ -636,25 +834,25 @@ gchar * tls_generate_csr (TlsCreationData * creation_data,
 
 }
 
-gchar * tls_generate_certificate (TlsCertCreationData * creation_data,
-				  gchar *csr_pem,
-				  gchar *ca_cert_pem,
-				  gchar *ca_priv_key_pem,
-				  gchar **certificate)
+gchar * __tls_generate_certificate (TlsCertCreationData * creation_data,
+				    gchar *csr_pem,
+				    gchar *ca_cert_pem,
+				    gchar *ca_priv_key_pem,
+				    gchar **certificate)
 {
 	gnutls_datum_t csr_pem_datum, ca_cert_pem_datum, ca_priv_key_pem_datum;
 	gnutls_x509_crt_t crt;
 	gnutls_x509_crq_t csr;
 	gnutls_x509_crt_t ca_crt;
 	gnutls_x509_privkey_t ca_pkey;
-	guchar * serialstr = NULL;
+	guchar serialstr[UINT160_SERIAL_MAX_SIZE];
         guchar * keyid = NULL;
         guchar * ca_keyid = NULL;
         size_t keyidsize = 0;
         size_t ca_keyidsize = 0;
 	size_t serialsize = 0;
 
-	gint key_usage;
+	const gchar *error = NULL;
 	size_t certificate_len = 0;
 
 	TlsCert *ca_cert_data = tls_parse_cert_pem (ca_cert_pem);
@@ -700,19 +898,15 @@ gchar * tls_generate_certificate (TlsCertCreationData * creation_data,
 		return g_strdup_printf(_("Error when setting certificate version"));
 	}
 	
-        uint160_write (&creation_data->serial, NULL, &serialsize);
-        serialstr = g_new0 (guchar, serialsize);
-        uint160_write (&creation_data->serial, serialstr, &serialsize);
+        serialsize = uint160_write_serial (&creation_data->serial, serialstr);
 
 	if (gnutls_x509_crt_set_serial (crt, serialstr, serialsize) < 0) {
-		g_free (serialstr);
 		gnutls_x509_crq_deinit (csr);
 		gnutls_x509_crt_deinit (crt);
 		gnutls_x509_crt_deinit (ca_crt);
 		gnutls_x509_privkey_deinit (ca_pkey);
 		return g_strdup_printf(_("Error when setting certificate serial number"));
 	}
-	g_free (serialstr);
 
 	if (gnutls_x509_crt_set_activation_time (crt, creation_data->activation) < 0) {
 		gnutls_x509_crq_deinit (csr);
@@ -771,12 +965,17 @@ gchar * tls_generate_certificate (TlsCertCreationData * creation_data,
         }
 
 
-	if (gnutls_x509_crt_set_ca_status (crt, creation_data->ca) != 0) {
+	if (creation_data->extensions)
+		error = __tls_cert_template_apply (creation_data->extensions, crt);
+	else
+		error = __tls_set_uses_extensions (crt, ca_crt, creation_data);
+
+	if (error) {
 		gnutls_x509_crq_deinit (csr);
 		gnutls_x509_crt_deinit (crt);
 		gnutls_x509_crt_deinit (ca_crt);
 		gnutls_x509_privkey_deinit (ca_pkey);
-		return g_strdup_printf(_("Error when setting basicConstraint extension"));
+		return g_strdup (error);
 	}
 	
 
@@ -796,6 +995,46 @@ gchar * tls_generate_certificate (TlsCertCreationData * creation_data,
                 }
         }       
         
+
+	if (gnutls_x509_crt_sign2(crt, ca_crt, ca_pkey, __tls_get_sign_digest (ca_pkey), 0)) {
+		gnutls_x509_crq_deinit (csr);
+		gnutls_x509_crt_deinit (crt);
+		gnutls_x509_crt_deinit (ca_crt);
+		gnutls_x509_privkey_deinit (ca_pkey);
+		return g_strdup_printf(_("Error when signing certificate"));
+	}
+	
+	/* Calculate certificate length */
+	(* certificate) = g_new0 (gchar, 1);	
+	gnutls_x509_crt_export (crt, GNUTLS_X509_FMT_PEM, (* certificate), &certificate_len);
+	g_free (* certificate);
+
+	/* Save the private key to a PEM format */
+	(* certificate) = g_new0 (gchar, certificate_len);	
+	if (gnutls_x509_crt_export (crt, GNUTLS_X509_FMT_PEM, (* certificate), &certificate_len) < 0) {
+		gnutls_x509_crq_deinit (csr);
+		gnutls_x509_crt_deinit (crt);
+		gnutls_x509_crt_deinit (ca_crt);
+		gnutls_x509_privkey_deinit (ca_pkey);
+		return g_strdup_printf(_("Error exporting private key to PEM structure."));
+	}	
+
+	gnutls_x509_crq_deinit (csr);
+	gnutls_x509_crt_deinit (crt);
+	gnutls_x509_crt_deinit (ca_crt);
+	gnutls_x509_privkey_deinit (ca_pkey);
+	return NULL;
+}
+
+
+const gchar * __tls_set_uses_extensions (gnutls_x509_crt_t crt, gnutls_x509_crt_t ca_crt, 
+					 const TlsCertCreationData *creation_data)
+{
+	gint key_usage;
+
+	if (gnutls_x509_crt_set_ca_status (crt, creation_data->ca) != 0)
+		return _("Error when setting basicConstraint extension");
+
 	key_usage = 0;
 	if (creation_data->ca)
 		key_usage |= GNUTLS_KEY_KEY_CERT_SIGN;
@@ -812,14 +1051,8 @@ gchar * tls_generate_certificate (TlsCertCreationData * creation_data,
 	if (creation_data->key_agreement)
 		key_usage |= GNUTLS_KEY_KEY_AGREEMENT;
 
-
-	if (gnutls_x509_crt_set_key_usage (crt, key_usage) != 0) {
-		gnutls_x509_crq_deinit (csr);
-		gnutls_x509_crt_deinit (crt);
-		gnutls_x509_crt_deinit (ca_crt);
-		gnutls_x509_privkey_deinit (ca_pkey);
-		return g_strdup_printf(_("Error when setting keyUsage extension"));
-	}
+	if (gnutls_x509_crt_set_key_usage (crt, key_usage) != 0)
+		return _("Error when setting keyUsage extension");
 
 	if (creation_data->email_protection)
 		gnutls_x509_crt_set_key_purpose_oid (crt, GNUTLS_KP_EMAIL_PROTECTION, FALSE);
@@ -847,40 +1080,158 @@ gchar * tls_generate_certificate (TlsCertCreationData * creation_data,
 		gnutls_x509_crt_set_crl_dist_points (crt, GNUTLS_SAN_URI, creation_data->crl_distribution_point, 0);
 	else
 		gnutls_x509_crt_cpy_crl_dist_points (crt, ca_crt);
-		
 
-	if (gnutls_x509_crt_sign2(crt, ca_crt, ca_pkey, GNUTLS_DIG_SHA512, 0)) {
-		gnutls_x509_crq_deinit (csr);
-		gnutls_x509_crt_deinit (crt);
+	return NULL;
+}
+
+const gchar * __tls_cert_template_apply (const TlsCertTemplate *cert_template, gnutls_x509_crt_t crt)
+{
+	TlsCertExtension *extension;
+	guint i;
+
+	for (i = 0; i < cert_template->extensions->len; i++) {
+		extension = &g_array_index (cert_template->extensions, TlsCertExtension, i);
+		if (gnutls_x509_crt_set_extension_by_oid (crt, extension->oid, extension->value.data, 
+							  extension->value.size, extension->critical) != 0)
+			return _("Error when copying the extensions of the issuance profile");
+	}
+
+	return NULL;
+}
+
+guint tls_cert_creation_data_get_uses (const TlsCertCreationData *creation_data)
+{
+	guint uses = 0;
+
+	if (creation_data->ca)
+		uses |= TLS_CERT_USE_CA;
+	if (creation_data->crl_signing)
+		uses |= TLS_CERT_USE_CRL_SIGNING;
+	if (creation_data->digital_signature)
+		uses |= TLS_CERT_USE_DIGITAL_SIGNATURE;
+	if (creation_data->data_encipherment)
+		uses |= TLS_CERT_USE_DATA_ENCIPHERMENT;
+	if (creation_data->key_encipherment)
+		uses |= TLS_CERT_USE_KEY_ENCIPHERMENT;
+	if (creation_data->non_repudiation)
+		uses |= TLS_CERT_USE_NON_REPUDIATION;
+	if (creation_data->key_agreement)
+		uses |= TLS_CERT_USE_KEY_AGREEMENT;
+	if (creation_data->email_protection)
+		uses |= TLS_CERT_USE_EMAIL_PROTECTION;
+	if (creation_data->code_signing)
+		uses |= TLS_CERT_USE_CODE_SIGNING;
+	if (creation_data->web_client)
+		uses |= TLS_CERT_USE_WEB_CLIENT;
+	if (creation_data->web_server)
+		uses |= TLS_CERT_USE_WEB_SERVER;
+	if (creation_data->time_stamping)
+		uses |= TLS_CERT_USE_TIME_STAMPING;
+	if (creation_data->ocsp_signing)
+		uses |= TLS_CERT_USE_OCSP_SIGNING;
+	if (creation_data->any_purpose)
+		uses |= TLS_CERT_USE_ANY_PURPOSE;
+
+	return uses;
+}
+
+void tls_cert_creation_data_set_uses (TlsCertCreationData *creation_data, guint uses)
+{
+	creation_data->ca = (uses & TLS_CERT_USE_CA) != 0;
+	creation_data->crl_signing = (uses & TLS_CERT_USE_CRL_SIGNING) != 0;
+	creation_data->digital_signature = (uses & TLS_CERT_USE_DIGITAL_SIGNATURE) != 0;
+	creation_data->data_encipherment = (uses & TLS_CERT_USE_DATA_ENCIPHERMENT) != 0;
+	creation_data->key_encipherment = (uses & TLS_CERT_USE_KEY_ENCIPHERMENT) != 0;
+	creation_data->non_repudiation = (uses & TLS_CERT_USE_NON_REPUDIATION) != 0;
+	creation_data->key_agreement = (uses & TLS_CERT_USE_KEY_AGREEMENT) != 0;
+	creation_data->email_protection = (uses & TLS_CERT_USE_EMAIL_PROTECTION) != 0;
+	creation_data->code_signing = (uses & TLS_CERT_USE_CODE_SIGNING) != 0;
+	creation_data->web_client = (uses & TLS_CERT_USE_WEB_CLIENT) != 0;
+	creation_data->web_server = (uses & TLS_CERT_USE_WEB_SERVER) != 0;
+	creation_data->time_stamping = (uses & TLS_CERT_USE_TIME_STAMPING) != 0;
+	creation_data->ocsp_signing = (uses & TLS_CERT_USE_OCSP_SIGNING) != 0;
+	creation_data->any_purpose = (uses & TLS_CERT_USE_ANY_PURPOSE) != 0;
+}
+
+TlsCertTemplate * tls_cert_template_new (const TlsCertCreationData *creation_data, const gchar *ca_cert_pem)
+{
+	gnutls_datum_t ca_cert_pem_datum;
+	gnutls_x509_crt_t crt;
+	gnutls_x509_crt_t ca_crt;
+	TlsCertTemplate *res;
+	TlsCertExtension extension;
+	gchar oid[128];
+	size_t oid_size;
+	size_t value_size;
+	gint i;
+
+	ca_cert_pem_datum.data = (unsigned char *) ca_cert_pem;
+	ca_cert_pem_datum.size = strlen(ca_cert_pem);
+
+	gnutls_x509_crt_init (&ca_crt);
+	if (gnutls_x509_crt_import (ca_crt, &ca_cert_pem_datum, GNUTLS_X509_FMT_PEM) < 0) {
 		gnutls_x509_crt_deinit (ca_crt);
-		gnutls_x509_privkey_deinit (ca_pkey);
-		return g_strdup_printf(_("Error when signing certificate"));
+		return NULL;
 	}
-	
-	/* Calculate certificate length */
-	(* certificate) = g_new0 (gchar, 1);	
-	gnutls_x509_crt_export (crt, GNUTLS_X509_FMT_PEM, (* certificate), &certificate_len);
-	g_free (* certificate);
 
-	/* Save the private key to a PEM format */
-	(* certificate) = g_new0 (gchar, certificate_len);	
-	if (gnutls_x509_crt_export (crt, GNUTLS_X509_FMT_PEM, (* certificate), &certificate_len) < 0) {
-		gnutls_x509_crq_deinit (csr);
+	/* The extensions are generated once on a scratch certificate, and then kept encoded */
+	gnutls_x509_crt_init (&crt);
+	gnutls_x509_crt_set_version (crt, 3);
+
+	if (__tls_set_uses_extensions (crt, ca_crt, creation_data)) {
 		gnutls_x509_crt_deinit (crt);
 		gnutls_x509_crt_deinit (ca_crt);
-		gnutls_x509_privkey_deinit (ca_pkey);
-		return g_strdup_printf(_("Error exporting private key to PEM structure."));
-	}	
+		return NULL;
+	}
+
+	res = g_new0 (TlsCertTemplate, 1);
+	res->extensions = g_array_new (FALSE, TRUE, sizeof (TlsCertExtension));
+
+	for (i = 0; ; i++) {
+		oid_size = sizeof (oid);
+		if (gnutls_x509_crt_get_extension_info (crt, i, oid, &oid_size, &extension.critical) < 0)
+			break;
+
+		value_size = 0;
+		gnutls_x509_crt_get_extension_data (crt, i, NULL, &value_size);
+		extension.value.data = g_new0 (guchar, value_size);
+		if (gnutls_x509_crt_get_extension_data (crt, i, extension.value.data, &value_size) < 0) {
+			g_free (extension.value.data);
+			gnutls_x509_crt_deinit (crt);
+			gnutls_x509_crt_deinit (ca_crt);
+			tls_cert_template_free (res);
+			return NULL;
+		}
+		extension.value.size = value_size;
+		extension.oid = g_strdup (oid);
+
+		g_array_append_val (res->extensions, extension);
+	}
 
-	gnutls_x509_crq_deinit (csr);
 	gnutls_x509_crt_deinit (crt);
 	gnutls_x509_crt_deinit (ca_crt);
-	gnutls_x509_privkey_deinit (ca_pkey);
-	return NULL;
+
+	return res;
 }
 
+void tls_cert_template_free (TlsCertTemplate *cert_template)
+{
+	TlsCertExtension *extension;
+	guint i;
 
-TlsCert * tls_parse_cert_pem (const char * pem_certificate)
+	if (! cert_template)
+		return;
+
+	for (i = 0; i < cert_template->extensions->len; i++) {
+		extension = &g_array_index (cert_template->extensions, TlsCertExtension, i);
+		g_free (extension->oid);
+		g_free (extension->value.data);
+	}
+	g_array_free (cert_template->extensions, TRUE);
+	g_free (cert_template);
+}
+
+TlsCert * __tls_parse_cert_pem (const char * pem_certificate)
 {
 	gnutls_datum_t pem_datum;
 	gnutls_x509_crt_t * cert = g_new0 (gnutls_x509_crt_t, 1);
@@ -1243,7 +1594,7 @@ void tls_cert_free (TlsCert *tlscert)
 }
 
 
-TlsCsr * tls_parse_csr_pem (const char * pem_csr)
+TlsCsr * __tls_parse_csr_pem (const char * pem_csr)
 {
 	gnutls_datum_t pem_datum;
 	gnutls_x509_crq_t * csr = g_new0 (gnutls_x509_crq_t, 1);
@@ -1386,12 +1737,12 @@ void tls_csr_free (TlsCsr *tlscsr)
 	g_free (tlscsr);
 }
 
-gchar * tls_generate_crl (GList * revoked_certs, 
-                          guchar *ca_pem, 
-                          guchar *ca_private_key,
-                          gint crl_version,
-                          time_t current_timestamp,
-                          time_t next_crl_timestamp)
+gchar * __tls_generate_crl (GList * revoked_certs, 
+                            guchar *ca_pem, 
+                            guchar *ca_private_key,
+                            gint crl_version,
+                            time_t current_timestamp,
+                            time_t next_crl_timestamp)
 {
         gnutls_datum_t pem_datum;
 
@@ -1488,8 +1839,9 @@ gchar * tls_generate_crl (GList * revoked_certs,
 	}
 
 	
-        if (gnutls_x509_crl_privkey_sign (crl, ca_crt, ca_privkey, GNUTLS_DIG_SHA512, 0)) {
-		fprintf (stderr, "Error signing CRL: %d\n", gnutls_x509_crl_privkey_sign (crl, ca_crt, ca_privkey, GNUTLS_DIG_SHA512, 0));
+        if (gnutls_x509_crl_privkey_sign (crl, ca_crt, ca_privkey, __tls_get_sign_digest (ca_pkey), 0)) {
+		fprintf (stderr, "Error signing CRL: %d\n", 
+			 gnutls_x509_crl_privkey_sign (crl, ca_crt, ca_privkey, __tls_get_sign_digest (ca_pkey), 0));
                 return NULL;
         }
 
@@ -1509,11 +1861,29 @@ gchar * tls_generate_crl (GList * revoked_certs,
         return result;
 }
 
-gchar * tls_generate_dh_params (guint bits)
+gchar * __tls_export_dh_params (gnutls_dh_params_t dh_params)
 {
-	gnutls_dh_params_t dh_params;
 	size_t dh_params_pem_len = 0;
 	guchar * result = NULL;
+
+	result = g_new (guchar, 0);
+	gnutls_dh_params_export_pkcs3 (dh_params, GNUTLS_X509_FMT_PEM, result, &dh_params_pem_len);
+	g_free (result);
+
+	result = g_new0 (guchar, dh_params_pem_len + 1);
+	if (gnutls_dh_params_export_pkcs3 (dh_params, GNUTLS_X509_FMT_PEM, result, &dh_params_pem_len)) {
+		fprintf (stderr, "Error exporting DH params pem\n");
+		g_free (result);
+		return NULL;
+	}
+	
+	return (gchar *) result;
+}
+
+gchar * tls_generate_dh_params (guint bits)
+{
+	gnutls_dh_params_t dh_params;
+	gchar * result = NULL;
 	gint ret;
 
 	gnutls_dh_params_init (&dh_params);
@@ -1523,20 +1893,60 @@ gchar * tls_generate_dh_params (guint bits)
 	{
 		fprintf (stderr, "Error generating parameters: %s\n",
 			 gnutls_strerror (ret));
+		gnutls_dh_params_deinit (dh_params);
 		return NULL;
 	}
 		
-	result = g_new (guchar, 0);
-	gnutls_dh_params_export_pkcs3 (dh_params, GNUTLS_X509_FMT_PEM, result, &dh_params_pem_len);
-	g_free (result);
+	result = __tls_export_dh_params (dh_params);
+	gnutls_dh_params_deinit (dh_params);
 
-	result = g_new (guchar, dh_params_pem_len);
-	if (gnutls_dh_params_export_pkcs3 (dh_params, GNUTLS_X509_FMT_PEM, result, &dh_params_pem_len)) {
-		fprintf (stderr, "Error exporting DH params pem\n");
+	return result;
+}
+
+gchar * tls_get_dh_well_known_group (guint bits)
+{
+#ifdef FFDHE_GNUTLS
+	gnutls_dh_params_t dh_params;
+	const gnutls_datum_t *prime = NULL;
+	const gnutls_datum_t *generator = NULL;
+	gchar * result = NULL;
+
+	switch (bits) {
+	case 2048:
+		prime = &gnutls_ffdhe_2048_group_prime;
+		generator = &gnutls_ffdhe_2048_group_generator;
+		break;
+	case 3072:
+		prime = &gnutls_ffdhe_3072_group_prime;
+		generator = &gnutls_ffdhe_3072_group_generator;
+		break;
+	case 4096:
+		prime = &gnutls_ffdhe_4096_group_prime;
+		generator = &gnutls_ffdhe_4096_group_generator;
+		break;
+	case 6144:
+		prime = &gnutls_ffdhe_6144_group_prime;
+		generator = &gnutls_ffdhe_6144_group_generator;
+		break;
+	case 8192:
+		prime = &gnutls_ffdhe_8192_group_prime;
+		generator = &gnutls_ffdhe_8192_group_generator;
+		break;
+	default:
 		return NULL;
 	}
-	
-	return (gchar *) result;
+
+	gnutls_dh_params_init (&dh_params);
+
+	if (gnutls_dh_params_import_raw (dh_params, prime, generator) == 0)
+		result = __tls_export_dh_params (dh_params);
+
+	gnutls_dh_params_deinit (dh_params);
+
+	return result;
+#else
+	return NULL;
+#endif
 }
 
 gboolean tls_cert_check_issuer (const gchar *cert_pem, const gchar *ca_pem) 
@@ -1747,3 +2157,105 @@ gchar * tls_get_csr_public_key_id (const gchar *csr_pem)
 
 
 #endif
+
+
+
+// Public entry points: they record the time spent in each operation (see stats.h)
+
+gchar * tls_generate_keys (TlsCreationData *creation_data,
+			   gchar ** private_key,
+			   gnutls_x509_privkey_t **key)
+{
+	gint64 start = stats_start ();
+	gchar *error = __tls_generate_keys (creation_data, private_key, key);
+
+	stats_record (STATS_KEY_GENERATION, start);
+	return error;
+}
+
+gchar * tls_load_private_key (const gchar *private_key,
+			      gnutls_x509_privkey_t **key)
+{
+	gint64 start = stats_start ();
+	gchar *error = __tls_load_private_key (private_key, key);
+
+	stats_record (STATS_KEY_LOAD, start);
+	return error;
+}
+
+gchar * tls_load_pkcs8_private_key (gchar *pkcs8_pem, gchar *passphrase, const gchar *cert_key_id, gint *error)
+{
+	gint64 start = stats_start ();
+	gchar *result = __tls_load_pkcs8_private_key (pkcs8_pem, passphrase, cert_key_id, error);
+
+	stats_record (STATS_KEY_LOAD, start);
+	return result;
+}
+
+gchar * tls_generate_self_signed_certificate (TlsCreationData * creation_data, 
+					      gnutls_x509_privkey_t *key,
+					      gchar ** certificate)
+{
+	gint64 start = stats_start ();
+	gchar *error = __tls_generate_self_signed_certificate (creation_data, key, certificate);
+
+	stats_record (STATS_SIGN, start);
+	return error;
+}
+
+gchar * tls_generate_csr (TlsCreationData * creation_data, 
+			  gnutls_x509_privkey_t *key,
+			  gchar ** csr)
+{
+	gint64 start = stats_start ();
+	gchar *error = __tls_generate_csr (creation_data, key, csr);
+
+	stats_record (STATS_SIGN, start);
+	return error;
+}
+
+gchar * tls_generate_certificate (TlsCertCreationData * creation_data,
+				  gchar *csr_pem,
+				  gchar *ca_cert_pem,
+				  gchar *ca_priv_key_pem,
+				  gchar **certificate)
+{
+	gint64 start = stats_start ();
+	gchar *error = __tls_generate_certificate (creation_data, csr_pem, ca_cert_pem, ca_priv_key_pem, certificate);
+
+	stats_record (STATS_SIGN, start);
+	return error;
+}
+
+TlsCert * tls_parse_cert_pem (const char * pem_certificate)
+{
+	gint64 start = stats_start ();
+	TlsCert *result = __tls_parse_cert_pem (pem_certificate);
+
+	stats_record (STATS_PARSE, start);
+	return result;
+}
+
+TlsCsr * tls_parse_csr_pem (const char * pem_csr)
+{
+	gint64 start = stats_start ();
+	TlsCsr *result = __tls_parse_csr_pem (pem_csr);
+
+	stats_record (STATS_PARSE, start);
+	return result;
+}
+
+gchar * tls_generate_crl (GList * revoked_certs, 
+                          guchar *ca_pem, 
+                          guchar *ca_private_key,
+                          gint crl_version,
+                          time_t current_timestamp,
+                          time_t next_crl_timestamp)
+{
+	gint64 start = stats_start ();
+	gchar *result = __tls_generate_crl (revoked_certs, ca_pem, ca_private_key, crl_version,
+					    current_timestamp, next_crl_timestamp);
+
+	stats_record (STATS_CRL_GENERATION, start);
+	return result;
+}
@@ -31,6 +31,12 @@
 #define TLS_INVALID_PASSWORD GNUTLS_E_DECRYPTION_FAILED
 #define TLS_NON_MATCHING_PRIVATE_KEY -2000
 
+// Values of TlsCreationData.key_type
+enum TlsKeyType {TLS_KEY_TYPE_RSA=0,
+      TLS_KEY_TYPE_DSA=1,
+      TLS_KEY_TYPE_ECDSA=2,     // key_bitlength is the curve size: 256 (P-256) or 384 (P-384)
+      TLS_KEY_TYPE_ED25519=3};  // key_bitlength is always 256
+
 typedef struct {
 	gchar * country;
 	gchar * state;
@@ -54,6 +60,36 @@ typedef struct {
         gchar * parent_ca_id_str;
 } TlsCreationData;
 
+/* Uses and purposes of a new certificate, as a bit mask for storing them */
+typedef enum {
+	TLS_CERT_USE_CA = 1 << 0,
+	TLS_CERT_USE_CRL_SIGNING = 1 << 1,
+	TLS_CERT_USE_DIGITAL_SIGNATURE = 1 << 2,
+	TLS_CERT_USE_DATA_ENCIPHERMENT = 1 << 3,
+	TLS_CERT_USE_KEY_ENCIPHERMENT = 1 << 4,
+	TLS_CERT_USE_NON_REPUDIATION = 1 << 5,
+	TLS_CERT_USE_KEY_AGREEMENT = 1 << 6,
+	TLS_CERT_USE_EMAIL_PROTECTION = 1 << 7,
+	TLS_CERT_USE_CODE_SIGNING = 1 << 8,
+	TLS_CERT_USE_WEB_CLIENT = 1 << 9,
+	TLS_CERT_USE_WEB_SERVER = 1 << 10,
+	TLS_CERT_USE_TIME_STAMPING = 1 << 11,
+	TLS_CERT_USE_OCSP_SIGNING = 1 << 12,
+	TLS_CERT_USE_ANY_PURPOSE = 1 << 13
+} TlsCertUses;
+
+/* An already encoded extension, ready to be copied into a certificate */
+typedef struct {
+	gchar * oid;
+	guint critical;
+	gnutls_datum_t value;
+} TlsCertExtension;
+
+/* The extensions derived from a set of uses and purposes, encoded only once */
+typedef struct __TlsCertTemplate {
+	GArray * extensions;
+} TlsCertTemplate;
+
 typedef struct {
 	gint key_months_before_expiration;
 	time_t activation;
@@ -81,6 +117,9 @@ typedef struct {
 
 	gchar * cadb_password;
 
+	// If set, it replaces the uses, purposes and CRL distribution point above
+	const TlsCertTemplate * extensions;
+
 } TlsCertCreationData;
 
 typedef struct __TlsCert {	
@@ -142,6 +181,27 @@ gchar * tls_generate_dsa_keys (TlsCreationData *creation_data,
 			       gchar ** private_key,
 			       gnutls_x509_privkey_t **key);
 
+gchar * tls_generate_ecdsa_keys (TlsCreationData *creation_data,
+				 gchar ** private_key,
+				 gnutls_x509_privkey_t **key);
+
+gchar * tls_generate_ed25519_keys (TlsCreationData *creation_data,
+				   gchar ** private_key,
+				   gnutls_x509_privkey_t **key);
+
+// Any of the former ones, depending on creation_data->key_type
+gchar * tls_generate_keys (TlsCreationData *creation_data,
+			   gchar ** private_key,
+			   gnutls_x509_privkey_t **key);
+
+const gchar * tls_key_type_name (gint key_type);
+gint tls_key_type_from_name (const gchar *name);     // -1 if unknown
+gboolean tls_key_type_check_bitlength (gint key_type, gint key_bitlength);
+
+// Builds the key structure of an already generated PEM private key
+gchar * tls_load_private_key (const gchar *private_key,
+			      gnutls_x509_privkey_t **key);
+
 gchar * tls_generate_pkcs8_encrypted_private_key (gchar *private_key, gchar *passphrase);
 gchar * tls_load_pkcs8_private_key (gchar *pem, gchar *passphrase, const gchar * key_id, gint *tls_error);
 
@@ -161,6 +221,12 @@ gchar * tls_generate_certificate (TlsCertCreationData * creation_data,
 				  gchar *ca_priv_key_pem,
 				  gchar **certificate);
 
+guint tls_cert_creation_data_get_uses (const TlsCertCreationData *creation_data);
+void tls_cert_creation_data_set_uses (TlsCertCreationData *creation_data, guint uses);
+
+TlsCertTemplate * tls_cert_template_new (const TlsCertCreationData *creation_data, const gchar *ca_cert_pem);
+void tls_cert_template_free (TlsCertTemplate *cert_template);
+
 TlsCert * tls_parse_cert_pem (const char * pem_certificate);
 gboolean tls_is_ca_pem (const char * pem_certificate);
 void tls_cert_free (TlsCert *);
@@ -179,6 +245,10 @@ gchar * tls_generate_crl (GList * revoked_certs,
 
 gchar * tls_generate_dh_params (guint bits);
 
+// Returns the RFC 7919 (ffdhe) group with the given prime bit-length, or NULL if there is none
+// (always NULL with GnuTLS older than 3.5.6)
+gchar * tls_get_dh_well_known_group (guint bits);
+
 gboolean tls_cert_check_issuer (const gchar *cert_pem, const gchar *ca_pem);
 
 gchar * tls_get_private_key_id (const gchar *privkey_pem);
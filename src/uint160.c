@@ -22,6 +22,55 @@
 #include <string.h>
 #include <glib/gprintf.h>
 
+static const gchar uint160_hex_digits[] = "0123456789abcdef";
+static const gchar uint160_hex_digits_upper[] = "0123456789ABCDEF";
+
+static void __uint160_from_bytes (UInt160 *var, const guchar *bytes)
+{
+        gint i;
+
+	memset (var, 0, sizeof(UInt160));
+
+        for (i = 0; i < 4; i++)
+                var->value2 = (var->value2 << 8) | bytes[i];
+        for (i = 4; i < 12; i++)
+                var->value1 = (var->value1 << 8) | bytes[i];
+        for (i = 12; i < 20; i++)
+                var->value0 = (var->value0 << 8) | bytes[i];
+}
+
+/* Hex digits are read from the last one, straight into their byte. If separators are
+   allowed, ':' between bytes (as written by uint160_strdup_printf) is skipped */
+static gboolean __uint160_read_hex (UInt160 *var, const gchar *buffer, gsize buffer_size, gboolean separators)
+{
+        guchar bytes[UINT160_SIZE];
+        guint nibble = 0;
+        gint value;
+        gint i;
+
+        memset (bytes, 0, UINT160_SIZE);
+
+        for (i = buffer_size - 1; i >= 0; i--) {
+                if (separators && buffer[i] == ':')
+                        continue;
+
+                value = g_ascii_xdigit_value (buffer[i]);
+                if (value < 0) {
+                        memset (var, 0, sizeof (UInt160));
+                        return FALSE;
+                }
+
+                // Bigger values are truncated to their 160 lower bits
+                if (nibble < UINT160_SIZE * 2)
+                        bytes[UINT160_SIZE - 1 - nibble / 2] |= (value << (4 * (nibble % 2)));
+                nibble++;
+        }
+
+        __uint160_from_bytes (var, bytes);
+
+        return TRUE;
+}
+
 UInt160 * uint160_new()
 {
         UInt160 *res = g_new0(UInt160, 1);
@@ -54,89 +103,16 @@ void uint160_assign (UInt160 *var, guint64 new_value)
 
 gboolean uint160_assign_hexstr (UInt160 *var, const gchar *new_value_hex)
 {
-        guint i;
-        gchar c;
-
         gchar * orig_stripped_value = g_strdup (new_value_hex);
 	gchar * stripped_value = g_strstrip (orig_stripped_value);
 
-        /* fprintf (stderr, "Antes de asignar Uint160=%s: %u:%"G_GUINT64_FORMAT":%"G_GUINT64_FORMAT"\n", */
-	/* 	 stripped_value, var->value2, var->value1, var->value0); */
-	
-	memset (var, 0, sizeof(UInt160));
-
-        for (i=0; i < strlen(stripped_value); i++) {
-
-                c = g_ascii_tolower(stripped_value[i]);
-
-                // Check if the character is valid
-
-                if (!((c >= '0' && c <= '9') ||
-                      (c >= 'a' && c <= 'f'))) {
-                        memset (var, 0, sizeof(UInt160));
-                        fprintf (stderr, "Error al asignar valor %s Uint160: caracter «%c» encontrado.\n",
-                                 stripped_value, c);
-			g_free (orig_stripped_value);
-                        return FALSE;
-                }
-                
-                uint160_shift (var, 4);
-
-                switch(c) {
-                case '0': 
-                        break;
-                case '1': 
-                        uint160_add (var, 1); 
-                        break;
-                case '2': 
-                        uint160_add (var, 2); 
-                        break;
-                case '3': 
-                        uint160_add (var, 3); 
-                        break;
-                case '4': 
-                        uint160_add (var, 4); 
-                        break;
-                case '5': 
-                        uint160_add (var, 5); 
-                        break;
-                case '6': 
-                        uint160_add (var, 6); 
-                        break;
-                case '7': 
-                        uint160_add (var, 7); 
-                        break;
-                case '8': 
-                        uint160_add (var, 8); 
-                        break;
-                case '9': 
-                        uint160_add (var, 9); 
-                        break;
-                case 'a': 
-                        uint160_add (var, 10); 
-                        break;
-                case 'b': 
-                        uint160_add (var, 11); 
-                        break;
-                case 'c': 
-                        uint160_add (var, 12); 
-                        break;
-                case 'd': 
-                        uint160_add (var, 13); 
-                        break;
-                case 'e': 
-                        uint160_add (var, 14); 
-                        break;
-                case 'f': 
-                        uint160_add (var, 15); 
-                        break;
-                }
-
+        if (! __uint160_read_hex (var, stripped_value, strlen (stripped_value), FALSE)) {
+                fprintf (stderr, "Error al asignar valor %s Uint160: caracter no hexadecimal encontrado.\n",
+                         stripped_value);
+                g_free (orig_stripped_value);
+                return FALSE;
         }
 
-
-        /* fprintf (stderr, "Asignado valor %s Uint160: %u:%"G_GUINT64_FORMAT":%"G_GUINT64_FORMAT"\n", */
-	/* 	 stripped_value, var->value2, var->value1, var->value0); */
 	g_free (orig_stripped_value);
         return TRUE;
 }
@@ -187,20 +163,16 @@ void uint160_dec (UInt160 *var)
 
 void uint160_shift (UInt160 *var, guint positions)
 {
-        /* fprintf (stderr, "Shifting %u a Uint160: %u:%"G_GUINT64_FORMAT":%"G_GUINT64_FORMAT"\n",  */
-	/* 	 positions, var->value2, var->value1, var->value0); */
-        guint64 carry0_to_1;
-        guint64 carry1_to_2;
+        guint step;
 
-        if (positions > 0) {
-                carry0_to_1 = (var->value0 & G_GUINT64_CONSTANT(0x8000000000000000));
-                carry1_to_2 = (var->value1 & G_GUINT64_CONSTANT(0x8000000000000000));
+        while (positions > 0) {
+                step = MIN (positions, 32);
 
-                var->value0 = var->value0 * 2;
-                var->value1 = (var->value1 * 2) + (carry0_to_1 ? 1 : 0);
-                var->value2 = (var->value2 * 2) + (carry1_to_2 ? 1 : 0);
+                var->value2 = (guint32) (((guint64) var->value2 << step) | (var->value1 >> (64 - step)));
+                var->value1 = (var->value1 << step) | (var->value0 >> (64 - step));
+                var->value0 = var->value0 << step;
 
-                uint160_shift (var, positions - 1);
+                positions -= step;
         }
         
         return;
@@ -242,35 +214,24 @@ gboolean uint160_write (const UInt160 *var, guchar *buffer, gsize * max_size)
         
 }
 
-gboolean uint160_read (UInt160 *var, guchar *buffer, gsize buffer_size)
+gboolean uint160_read (UInt160 *var, const guchar *buffer, gsize buffer_size)
 {
-        gint start, i;
-        guchar c;
-        
-	memset (var, 0, sizeof(UInt160));
+        guchar bytes[UINT160_SIZE];
+        gsize size = MIN (buffer_size, UINT160_SIZE);
 
-        var->value0=0;
-        var->value1=0;
-        var->value2=0;
+        // Bigger values are truncated to their 160 lower bits
+        memset (bytes, 0, UINT160_SIZE);
+        memcpy (&bytes[UINT160_SIZE - size], &buffer[buffer_size - size], size);
 
-        start = 0;
-
-        while (start < buffer_size && buffer[start] == 0)
-                start++;
+        __uint160_from_bytes (var, bytes);
 
-        for (i=start; i < buffer_size; i++) {
-                c = buffer[i];
-                uint160_shift (var, 8);
-                uint160_add (var, c);
-        }
         return TRUE;
 }
 
 gboolean uint160_write_escaped (const UInt160 *var, gchar *buffer, gsize * max_size)
 {
+        gchar hex[UINT160_HEX_SIZE];
         gsize size = 0;
-        guint32 value = 0;
-        gsize pos = 0;
 
         if (var->value2 > 0)
                 size = 16 + 16 + 8 + 1;
@@ -284,31 +245,8 @@ gboolean uint160_write_escaped (const UInt160 *var, gchar *buffer, gsize * max_s
                 return FALSE;
         }
 
-        memset (buffer, 0, size);
-
-        if (var->value2 > 0) {
-                value = var->value2;
-                sprintf (&buffer[pos], "%08" G_GINT32_MODIFIER "x", value);
-                pos = pos + 8;
-        }
-
-        if (var->value2 > 0 || var->value1 > 0) {
-                value = (var->value1 / G_GUINT64_CONSTANT(0x100000000));
-                sprintf (&buffer[pos], "%08" G_GINT32_MODIFIER "x", value);
-                pos = pos + 8;
-
-                value = (var->value1 % G_GUINT64_CONSTANT(0x100000000));
-                sprintf (&buffer[pos], "%08" G_GINT32_MODIFIER "x", value);
-                pos = pos + 8;
-        }
-
-        value = (var->value0 / G_GUINT64_CONSTANT(0x100000000));
-        sprintf (&buffer[pos], "%08" G_GINT32_MODIFIER "x", value);
-        pos = pos + 8;
-        
-        value = (var->value0 % G_GUINT64_CONSTANT(0x100000000));
-        sprintf (&buffer[pos], "%08" G_GINT32_MODIFIER "x", value);
-        pos = pos + 8;
+        uint160_write_hex (var, hex);
+        memcpy (buffer, &hex[UINT160_HEX_SIZE - size], size);
 
         return TRUE;
         
@@ -316,35 +254,38 @@ gboolean uint160_write_escaped (const UInt160 *var, gchar *buffer, gsize * max_s
 
 gboolean uint160_read_escaped (UInt160 *var, gchar *buffer, gsize buffer_size)
 {
-        gchar aux[2];
-        guint i;
-        guint num;
-        gboolean res = TRUE;
+        return __uint160_read_hex (var, buffer, buffer_size, FALSE);
+}
 
-        /* fprintf (stderr, "Uint160_read_escaped <%s>\n", buffer); */
+void uint160_write_hex (const UInt160 *var, gchar *buffer)
+{
+        guchar bytes[UINT160_SIZE];
+        gsize size = UINT160_SIZE;
+        gint i;
 
-        memset (var, 0, sizeof (UInt160));
-        memset (aux, 0, 2);
-        
-        for (i=0; i<buffer_size; i++) {
-                aux[0] = buffer[i];
-                if (sscanf (aux, "%x", &num)) {
-                        /* fprintf (stderr, "pos: %d. Char: %s. Val: %d\n", i, aux, num); */
-                        uint160_shift (var, 4);
-                        uint160_add (var, num);
-                } else {
-                        memset (var, 0, sizeof (UInt160));
-                        res = FALSE;
-                        break;
-                }
+        uint160_write (var, bytes, &size);
+
+        for (i = 0; i < UINT160_SIZE; i++) {
+                buffer[i * 2] = uint160_hex_digits[bytes[i] >> 4];
+                buffer[i * 2 + 1] = uint160_hex_digits[bytes[i] & 0x0F];
         }
+        buffer[UINT160_HEX_SIZE - 1] = '\0';
+}
 
-        /* fprintf (stderr, "Uint160_read_escaped <%s> = : %u:%"G_GUINT64_FORMAT":%"G_GUINT64_FORMAT"\n",   */
-        /*          buffer, var->value2, var->value1, var->value0); */
-        
-        return res;
+gboolean uint160_read_hex (UInt160 *var, const gchar *buffer, gsize buffer_size)
+{
+        return __uint160_read_hex (var, buffer, buffer_size, TRUE);
 }
 
+gsize uint160_write_serial (const UInt160 *var, guchar *buffer)
+{
+        gsize size = UINT160_SERIAL_MAX_SIZE;
+
+        // The same fixed 20-byte form certificates have always been issued with
+        uint160_write (var, buffer, &size);
+
+        return size;
+}
 
 gboolean uint160_read_escaped_old_format (UInt160 *var, gchar *buffer, gsize buffer_size)
 {
@@ -380,51 +321,31 @@ gboolean uint160_read_escaped_old_format (UInt160 *var, gchar *buffer, gsize buf
 
 gchar * uint160_strdup_printf (const UInt160 *var)
 {
+        guchar bytes[UINT160_SIZE];
+        gsize size = UINT160_SIZE;
+        gchar *result;
+        gchar *pos;
+        gint start = 0;
+        gint i;
 
-	GString *string = g_string_new("");
-	guint64 val;
-	gsize size = 0;
-	guchar * pointer;
-	int i;
-	
-	/* First, we calculate how many bytes are filled */
-	if (var->value2 != 0) {
-		size = 16;
-		val = var->value2;
-		while (val != 0) {
-			val = val >> 8;
-			size++;
-		}
-	} else if (var->value1 != 0) {
-		size = 8;
-		val = var->value1;
-		while (val != 0) {
-			val = val >> 8;
-			size ++;
-		}
-	} else if (var->value0 != 0) {
-		val = var->value0;
-		while (val != 0) {
-			val = val >> 8;
-			size ++;
-		}
-	}
-        
-	for (i=size-1; i>=0; i--) {
-		if (i < 8) {
-			pointer = (guchar *) &(var->value0);
-			g_string_append_printf (string, "%s%02X", (i==(size-1)?"":":"), pointer[i]);
-		} else if (i < 16) {
-			pointer = (guchar *) &(var->value1);
-			g_string_append_printf (string, "%s%02X", (i==(size-1)?"":":"), pointer[i-8]);
-		} else {
-                                pointer = (guchar *) &(var->value2);
-                                g_string_append_printf (string, "%s%02X", (i==(size-1)?"":":"), pointer[i-16]);
-		}
-	}
-                
-	return g_string_free (string, FALSE);
+        uint160_write (var, bytes, &size);
+
+	/* Only the filled bytes are written, and nothing at all for zero */
+        while (start < UINT160_SIZE && bytes[start] == 0)
+                start++;
+
+        result = g_new (gchar, (UINT160_SIZE - start) * 3 + 1);
+        pos = result;
+
+        for (i = start; i < UINT160_SIZE; i++) {
+                if (i > start)
+                        *(pos++) = ':';
+                *(pos++) = uint160_hex_digits_upper[bytes[i] >> 4];
+                *(pos++) = uint160_hex_digits_upper[bytes[i] & 0x0F];
+        }
+        *pos = '\0';
 
+        return result;
 }
 
 void uint160_free (UInt160 *var)
@@ -22,6 +22,13 @@
 
 #include <glib.h>
 
+// Size of the big-endian binary form, as written by uint160_write and stored in the database
+#define UINT160_SIZE 20
+// Size of the buffer for uint160_write_hex (40 digits and '\0')
+#define UINT160_HEX_SIZE 41
+// Size of a certificate serial written by uint160_write_serial
+#define UINT160_SERIAL_MAX_SIZE UINT160_SIZE
+
 typedef struct _UInt160 {
         guint64 value0;
         guint64 value1;
@@ -38,12 +45,20 @@ void uint160_dec (UInt160 *var);
 void uint160_shift (UInt160 *var, guint positions);
 
 gboolean uint160_write (const UInt160 *var, guchar *buffer, gsize * max_size);
-gboolean uint160_read (UInt160 *var, guchar *buffer, gsize size);
+gboolean uint160_read (UInt160 *var, const guchar *buffer, gsize size);
 
 gboolean uint160_write_escaped (const UInt160 *var, gchar *buffer, gsize * max_size);
 gboolean uint160_read_escaped (UInt160 *var, gchar *buffer, gsize size);
 gboolean uint160_read_escaped_old_format (UInt160 *var, gchar *buffer, gsize size);
 
+// Fixed-size hex form (UINT160_HEX_SIZE), suitable for X'' blob literals
+void uint160_write_hex (const UInt160 *var, gchar *buffer);
+// Reads hex digits, optionally separated by ':' as in uint160_strdup_printf
+gboolean uint160_read_hex (UInt160 *var, const gchar *buffer, gsize size);
+
+// Big-endian form for gnutls_x509_crt_set_serial (UINT160_SERIAL_MAX_SIZE bytes)
+gsize uint160_write_serial (const UInt160 *var, guchar *buffer);
+
 
 
 gchar * uint160_strdup_printf (const UInt160 *var);